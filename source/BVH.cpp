@@ -0,0 +1,310 @@
+#include "BVH.h"
+
+#include <algorithm>
+#include <limits>
+
+// Number of candidate split positions evaluated along each axis
+static const int SAH_BIN_COUNT = 16;
+
+
+void BVH::build( const std::vector<BoundingBox> & primitiveBounds, ThreadPool * threadPool, int maxLeafSize )
+{
+	clear();
+
+	this->maxLeafSize = std::max( 1, maxLeafSize );
+
+	int primitiveCount = static_cast<int>( primitiveBounds.size() );
+	if( primitiveCount == 0 ) {
+		return;
+	}
+
+	buildBounds = &primitiveBounds;
+	buildCentroids.resize( primitiveCount );
+	primitiveIndices.resize( primitiveCount );
+
+	for( int i = 0; i < primitiveCount; i++ ) {
+		buildCentroids[i] = primitiveBounds[i].centroid();
+		primitiveIndices[i] = i;
+	}
+
+	int threadCount = threadPool != nullptr ? threadPool->getThreadCount() : 1;
+
+	// Ranges with this many primitives or fewer are built as independent subtrees
+	int subtreeSize = primitiveCount;
+	if( threadCount > 1 ) {
+		subtreeSize = std::max( 1024, primitiveCount / ( 8 * threadCount ) );
+	}
+
+	// Split the top of the tree on this thread until the ranges are small
+	// enough to be handed out to the workers.
+	std::vector<BuildTask> pending;
+	std::vector<BuildTask> subtrees;
+
+	nodes.push_back( Node() );
+	pending.push_back( { 0, 0, primitiveCount, 0 } );
+
+	while( !pending.empty() ) {
+
+		BuildTask task = pending.back();
+		pending.pop_back();
+
+		if( task.end - task.begin <= subtreeSize ) {
+			subtrees.push_back( task );
+			continue;
+		}
+
+		Node node;
+		int mid;
+		if( !splitRange( node, task.begin, task.end, task.depth, mid ) ) {
+			node.firstIndex = task.begin;
+			node.primitiveCount = task.end - task.begin;
+			nodes[task.nodeIndex] = node;
+			continue;
+		}
+
+		int firstChild = static_cast<int>( nodes.size() );
+		node.firstIndex = firstChild;
+		nodes[task.nodeIndex] = node;
+		nodes.push_back( Node() );
+		nodes.push_back( Node() );
+
+		pending.push_back( { firstChild, task.begin, mid, task.depth + 1 } );
+		pending.push_back( { firstChild + 1, mid, task.end, task.depth + 1 } );
+	}
+
+	// Build the subtrees. Each one works on a separate range of the primitive
+	// index list and a separate node list, so they can be built concurrently.
+	std::vector<std::vector<Node>> subtreeNodes( subtrees.size() );
+
+	for( size_t i = 0; i < subtrees.size(); i++ ) {
+
+		const BuildTask & task = subtrees[i];
+		std::vector<Node> & localNodes = subtreeNodes[i];
+
+		if( threadCount > 1 ) {
+			threadPool->submit( [this, &localNodes, task] {
+				buildSubtree( localNodes, 0, task.begin, task.end, task.depth );
+			} );
+		}
+		else {
+			buildSubtree( localNodes, 0, task.begin, task.end, task.depth );
+		}
+	}
+
+	if( threadCount > 1 ) {
+		threadPool->wait();
+	}
+
+	// Attach the subtrees. The root of each subtree replaces the placeholder node
+	// and the remaining nodes are appended to the end of the node list.
+	for( size_t i = 0; i < subtrees.size(); i++ ) {
+
+		const std::vector<Node> & localNodes = subtreeNodes[i];
+		int offset = static_cast<int>( nodes.size() ) - 1;
+
+		for( size_t j = 0; j < localNodes.size(); j++ ) {
+
+			Node node = localNodes[j];
+			if( !node.isLeaf() ) {
+				node.firstIndex += offset;
+			}
+
+			if( j == 0 ) {
+				nodes[subtrees[i].nodeIndex] = node;
+			}
+			else {
+				nodes.push_back( node );
+			}
+		}
+	}
+
+	buildBounds = nullptr;
+	buildCentroids.clear();
+	buildCentroids.shrink_to_fit();
+
+} // end build
+
+
+bool BVH::isConsistent( int primitiveCount ) const
+{
+	if( static_cast<int>( primitiveIndices.size() ) != primitiveCount || nodes.empty() != ( primitiveCount == 0 ) ) {
+		return false;
+	}
+
+	// Children always follow their parent, so a tree that passes cannot loop,
+	// and the depth of every parent is final before its children are reached.
+	// The ranges are compared by subtraction so that no sum can overflow.
+	int nodeCount = static_cast<int>( nodes.size() );
+	std::vector<int> depths( nodeCount, 0 );
+	for( int i = 0; i < nodeCount; i++ ) {
+
+		const Node & node = nodes[i];
+		if( node.primitiveCount < 0 || node.firstIndex < 0 ) {
+			return false;
+		}
+
+		if( node.isLeaf() ) {
+			if( node.firstIndex > primitiveCount - node.primitiveCount ) {
+				return false;
+			}
+			continue;
+		}
+
+		if( node.firstIndex <= i || node.firstIndex >= nodeCount - 1 ) {
+			return false;
+		}
+
+		// Traversal keeps at most one deferred sibling per level on its stack
+		// and pushes both children of the node it visits
+		int childDepth = depths[i] + 1;
+		if( childDepth >= MAX_STACK_SIZE ) {
+			return false;
+		}
+		for( int child = node.firstIndex; child <= node.firstIndex + 1; child++ ) {
+			depths[child] = std::max( depths[child], childDepth );
+		}
+	}
+
+	std::vector<bool> seen( primitiveCount, false );
+	for( int index : primitiveIndices ) {
+
+		if( index < 0 || index >= primitiveCount || seen[index] ) {
+			return false;
+		}
+		seen[index] = true;
+	}
+
+	return true;
+
+} // end isConsistent
+
+
+void BVH::buildSubtree( std::vector<Node> & subtreeNodes, int nodeIndex, int begin, int end, int depth )
+{
+	if( subtreeNodes.empty() ) {
+		subtreeNodes.push_back( Node() );
+	}
+
+	Node node;
+	int mid;
+	if( !splitRange( node, begin, end, depth, mid ) ) {
+		node.firstIndex = begin;
+		node.primitiveCount = end - begin;
+		subtreeNodes[nodeIndex] = node;
+		return;
+	}
+
+	int firstChild = static_cast<int>( subtreeNodes.size() );
+	node.firstIndex = firstChild;
+	subtreeNodes[nodeIndex] = node;
+	subtreeNodes.push_back( Node() );
+	subtreeNodes.push_back( Node() );
+
+	buildSubtree( subtreeNodes, firstChild, begin, mid, depth + 1 );
+	buildSubtree( subtreeNodes, firstChild + 1, mid, end, depth + 1 );
+
+} // end buildSubtree
+
+
+bool BVH::splitRange( Node & node, int begin, int end, int depth, int & mid )
+{
+	const std::vector<BoundingBox> & bounds = *buildBounds;
+	const std::vector<vec3> & centroids = buildCentroids;
+
+	BoundingBox centroidBounds;
+	node.bounds = BoundingBox();
+
+	for( int i = begin; i < end; i++ ) {
+		node.bounds.expand( bounds[primitiveIndices[i]] );
+		centroidBounds.expand( centroids[primitiveIndices[i]] );
+	}
+
+	if( end - begin <= maxLeafSize ) {
+		return false;
+	}
+
+	int bestAxis = -1;
+	int bestBin = 0;
+	real bestCost = std::numeric_limits<real>::max();
+
+	// Sort the centroids into bins along each axis and evaluate the surface area
+	// heuristic for a split between every pair of neighboring bins.
+	for( int axis = 0; axis < 3 && depth < MAX_SAH_DEPTH; axis++ ) {
+
+		real low = centroidBounds.minPoint[axis];
+		real extent = centroidBounds.maxPoint[axis] - low;
+		if( extent <= 0.0 ) {
+			continue;
+		}
+		real scale = SAH_BIN_COUNT / extent;
+
+		BoundingBox binBounds[SAH_BIN_COUNT];
+		int binCounts[SAH_BIN_COUNT] = { 0 };
+
+		for( int i = begin; i < end; i++ ) {
+			int index = primitiveIndices[i];
+			int bin = std::min( SAH_BIN_COUNT - 1, static_cast<int>( ( centroids[index][axis] - low ) * scale ) );
+			binCounts[bin]++;
+			binBounds[bin].expand( bounds[index] );
+		}
+
+		// Area and count of everything above each split, gathered from the right
+		real aboveArea[SAH_BIN_COUNT];
+		int aboveCount[SAH_BIN_COUNT];
+		BoundingBox accumulated;
+		int accumulatedCount = 0;
+
+		for( int bin = SAH_BIN_COUNT - 1; bin > 0; bin-- ) {
+			accumulated.expand( binBounds[bin] );
+			accumulatedCount += binCounts[bin];
+			aboveArea[bin] = accumulated.surfaceArea();
+			aboveCount[bin] = accumulatedCount;
+		}
+
+		accumulated = BoundingBox();
+		accumulatedCount = 0;
+
+		for( int bin = 0; bin < SAH_BIN_COUNT - 1; bin++ ) {
+
+			accumulated.expand( binBounds[bin] );
+			accumulatedCount += binCounts[bin];
+
+			if( accumulatedCount == 0 || aboveCount[bin + 1] == 0 ) {
+				continue;
+			}
+
+			real cost = accumulatedCount * accumulated.surfaceArea() + aboveCount[bin + 1] * aboveArea[bin + 1];
+			if( cost < bestCost ) {
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = bin;
+			}
+		}
+	}
+
+	if( bestAxis >= 0 ) {
+
+		real low = centroidBounds.minPoint[bestAxis];
+		real scale = SAH_BIN_COUNT / ( centroidBounds.maxPoint[bestAxis] - low );
+
+		auto below = std::partition( primitiveIndices.begin() + begin, primitiveIndices.begin() + end,
+			[&]( int index ) {
+				return std::min( SAH_BIN_COUNT - 1, static_cast<int>( ( centroids[index][bestAxis] - low ) * scale ) ) <= bestBin;
+			} );
+
+		mid = static_cast<int>( below - primitiveIndices.begin() );
+		if( mid > begin && mid < end ) {
+			return true;
+		}
+	}
+
+	// Centroids coincide or the tree is already deep. Split at the median
+	// along the axis with the largest centroid extent.
+	int axis = centroidBounds.longestAxis();
+	mid = ( begin + end ) / 2;
+	std::nth_element( primitiveIndices.begin() + begin, primitiveIndices.begin() + mid, primitiveIndices.begin() + end,
+		[&]( int a, int b ) { return centroids[a][axis] < centroids[b][axis]; } );
+
+	return true;
+
+} // end splitRange
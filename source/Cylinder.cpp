@@ -1,45 +1,195 @@
 #include "Cylinder.h"
 
-Cylinder::Cylinder(const dvec3 & position, const color & mat, double radius, double length)
-    : QuadricSurface(position, mat), radius(radius), length(length)
-{}
+#include <algorithm>
+#include <cmath>
 
-Cylinder::Cylinder(const dvec3 & position, const Material & mat, double radius, double length)
-    : QuadricSurface(position, mat), radius(radius), length(length)
-{}
 
-HitRecord Cylinder::findClosestIntersection(const Ray & ray) 
+Cylinder::Cylinder(const vec3 & position, const color & mat, real radius, real length)
+	: Surface(mat), center(position), axis(1.0, 0.0, 0.0), radius(radius), length(length), capped(false)
 {
-    HitRecord hr = QuadricSurface::findClosestIntersection(ray);
+}
+
+Cylinder::Cylinder(const vec3 & position, const Material & mat, real radius, real length)
+	: Surface(mat), center(position), axis(1.0, 0.0, 0.0), radius(radius), length(length), capped(false)
+{
+}
+
+Cylinder::Cylinder(const vec3 & position, const vec3 & axis, const Material & mat, real radius, real length,
+				   bool capped)
+	: Surface(mat), center(position), axis(glm::normalize(axis)), radius(radius), length(length), capped(capped)
+{
+}
+
+
+bool Cylinder::intersect( const Ray & ray, real tMin, real tMax, RayHit & hit ) const
+{
+	return Cylinder::intersectFromOrigin( ray, Cylinder::computeOriginTerm( ray.origin ), tMin, tMax, hit );
 
-    if (hr.t == FLT_MAX)
-    {
-        return hr;
-    }
+} // end intersect
 
-    // if the dot product of n and direction is < 0, we're on the back side of the cylinder and need to invert the normal
-   // if (glm::dot(hr.surfaceNormal, ray.direct) < 0) 
-   // {
-   //   hr.surfaceNormal = (-1.0) * hr.surfaceNormal;
-   // }
 
-    float tmp = glm::length(hr.interceptPoint - center);
+/*
+* |o - c|^2 - ((o - c) . u)^2 - r^2, which is negative inside the infinite
+* cylinder and positive outside of it.
+*/
+real Cylinder::computeOriginTerm( const vec3 & origin ) const
+{
+	vec3 toOrigin = origin - center;
+	real alongAxis = glm::dot(toOrigin, axis);
 
-    if (pow(tmp, 2) - pow(radius, 2) > pow(length / 2, 2)) 
-    {
-        hr.t = FLT_MAX;
-        Ray newRay;
-        newRay.origin = hr.interceptPoint + (ray.direct * EPSILON);
-        newRay.direct = ray.direct;
+	return glm::dot(toOrigin, toOrigin) - alongAxis * alongAxis - radius * radius;
 
-        HitRecord newHR = Cylinder::findClosestIntersection(newRay);
-        tmp = glm::length(newHR.interceptPoint - center);
+} // end computeOriginTerm
 
-        if (pow(tmp, 2) - pow(radius, 2) < pow(length / 2, 2))
-        {
-            return newHR;
-        } 
-    }
 
-    return hr;
-}
+bool Cylinder::intersectFromOrigin( const Ray & ray, real originTerm, real tMin, real tMax, RayHit & hit ) const
+{
+	vec3 toOrigin = ray.origin - center;
+
+	real directionAlongAxis = glm::dot(ray.direct, axis);
+	real originAlongAxis = glm::dot(toOrigin, axis);
+	real halfLength = length / 2;
+
+	// Interval in which the ray is between the planes of the two ends
+	real slabEntry, slabExit;
+	if( directionAlongAxis != 0 ) {
+
+		slabEntry = (-halfLength - originAlongAxis) / directionAlongAxis;
+		slabExit = (halfLength - originAlongAxis) / directionAlongAxis;
+		if( slabEntry > slabExit ) {
+			std::swap(slabEntry, slabExit);
+		}
+	}
+	else if( std::abs(originAlongAxis) <= halfLength ) {
+
+		slabEntry = -INFINITY;
+		slabExit = INFINITY;
+	}
+	else {
+		return false;
+	}
+
+	if( slabEntry >= tMax || slabExit < tMin ) {
+		return false;
+	}
+
+	// Interval in which the ray is inside the infinite cylinder. Only the parts
+	// of the direction and of the origin that are perpendicular to the axis count.
+	real a = 1 - directionAlongAxis * directionAlongAxis;
+	real b = glm::dot(ray.direct, toOrigin) - directionAlongAxis * originAlongAxis;
+	real c = originTerm;
+
+	real sideEntry, sideExit;
+	if( a > 0 ) {
+
+		real discriminant = b * b - a * c;
+		if( discriminant < 0 ) {
+			return false;
+		}
+
+		real halfChord = sqrt(discriminant) / a;
+		sideEntry = -b / a - halfChord;
+		sideExit = -b / a + halfChord;
+	}
+	else if( c <= 0 ) {
+
+		// Parallel to the axis and inside the cylinder
+		sideEntry = -INFINITY;
+		sideExit = INFINITY;
+	}
+	else {
+		return false;
+	}
+
+	real t;
+	int element;
+
+	if( capped ) {
+
+		// The solid cylinder is the overlap of the two intervals. Its surface is
+		// crossed where the overlap begins and ends.
+		real entry = std::max(sideEntry, slabEntry);
+		real exit = std::min(sideExit, slabExit);
+
+		if( entry > exit ) {
+			return false;
+		}
+
+		if( entry >= tMin ) {
+			t = entry;
+			element = slabEntry > sideEntry ? CAP : SIDE;
+		}
+		else {
+			t = exit;
+			element = slabExit < sideExit ? CAP : SIDE;
+		}
+	}
+	else {
+
+		// Only the side is there. Use the near root unless it is before the start
+		// of the interval or beyond one of the ends.
+		element = SIDE;
+		if( sideEntry >= tMin && sideEntry >= slabEntry && sideEntry <= slabExit ) {
+			t = sideEntry;
+		}
+		else if( sideExit >= slabEntry && sideExit <= slabExit ) {
+			t = sideExit;
+		}
+		else {
+			return false;
+		}
+	}
+
+	if( t < tMin || t >= tMax ) {
+		return false;
+	}
+
+	hit.t = t;
+	hit.element = element;
+	return true;
+
+} // end intersectFromOrigin
+
+
+void Cylinder::completeHitRecord( const Ray & ray, const RayHit & hit, HitRecord & hitRecord ) const
+{
+	hitRecord.t = hit.t;
+	hitRecord.interceptPoint = ray.origin + hit.t * ray.direct;
+
+	vec3 fromCenter = hitRecord.interceptPoint - center;
+	real alongAxis = glm::dot(fromCenter, axis);
+
+	vec3 n;
+	if( hit.element == CAP ) {
+		n = alongAxis > 0 ? axis : -axis;
+	}
+	else {
+		n = glm::normalize(fromCenter - alongAxis * axis);
+	}
+
+	// Check for back face intersection
+	if( glm::dot( n, ray.direct ) > 0 ) {
+
+		n = -n; // reverse the normal
+	}
+
+	hitRecord.surfaceNormal = n;
+	hitRecord.material = &material;
+
+} // end completeHitRecord
+
+
+/*
+* Along each coordinate axis the ends reach |u_i| * length / 2 from the center
+* and the rims add radius * sqrt(1 - u_i^2).
+*/
+BoundingBox Cylinder::bounds() const
+{
+	vec3 halfExtent;
+	for( int i = 0; i < 3; i++ ) {
+		halfExtent[i] = std::abs(axis[i]) * length / 2 + radius * sqrt(std::max(real(0), 1 - axis[i] * axis[i]));
+	}
+
+	return BoundingBox(center - halfExtent, center + halfExtent);
+
+} // end bounds
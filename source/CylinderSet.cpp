@@ -0,0 +1,568 @@
+#include "CylinderSet.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Cylinders per leaf of the hierarchy. Two groups of lanes per leaf.
+static const int MAX_LEAF_SIZE = 2 * CylinderSet::LANE_GROUP_SIZE;
+
+
+/*
+* Reference kernel. Also used on processors without SSE2 or AVX2. Follows
+* Cylinder::intersectFromOrigin. Only the parts of the direction and of the
+* origin that are perpendicular to the axis enter the quadratic a*t*t + 2bt + c.
+* Its discriminant b*b - a*c is computed as a*r*r minus the square of
+* ((o - center) x axis) . direction, which does not lose digits to cancellation
+* when the cylinder is far away. Divisions are replaced by multiplications with
+* reciprocals, as in the vector kernels, so that all kernels find the same hits.
+*/
+static bool intersectScalar( const CylinderSet::Lanes & lanes, int begin, int end, const Ray & ray,
+							 real tMin, real & tMax, int & hitSlot, int & hitElement, bool anyHit )
+{
+	bool found = false;
+
+	for( int slot = begin; slot < end; slot++ ) {
+
+		real ocX = ray.origin.x - lanes.centerX[slot];
+		real ocY = ray.origin.y - lanes.centerY[slot];
+		real ocZ = ray.origin.z - lanes.centerZ[slot];
+
+		real axisX = lanes.axisX[slot];
+		real axisY = lanes.axisY[slot];
+		real axisZ = lanes.axisZ[slot];
+
+		real directionAlongAxis = ray.direct.x * axisX + ray.direct.y * axisY + ray.direct.z * axisZ;
+		real originAlongAxis = ocX * axisX + ocY * axisY + ocZ * axisZ;
+
+		// Interval in which the ray is inside the infinite cylinder
+		real a = 1 - directionAlongAxis * directionAlongAxis;
+
+		real sideEntry, sideExit;
+		if( a > 0 ) {
+
+			real mX = ocY * axisZ - ocZ * axisY;
+			real mY = ocZ * axisX - ocX * axisZ;
+			real mZ = ocX * axisY - ocY * axisX;
+			real w = ray.direct.x * mX + ray.direct.y * mY + ray.direct.z * mZ;
+
+			real discriminant = a * lanes.radiusSquared[slot] - w * w;
+			if( discriminant < 0 ) {
+				continue;
+			}
+
+			real inverseA = 1 / a;
+			real b = ray.direct.x * ocX + ray.direct.y * ocY + ray.direct.z * ocZ - directionAlongAxis * originAlongAxis;
+			real middle = -b * inverseA;
+			real halfChord = std::sqrt( discriminant ) * inverseA;
+
+			sideEntry = middle - halfChord;
+			sideExit = middle + halfChord;
+		}
+		else if( ocX * ocX + ocY * ocY + ocZ * ocZ - originAlongAxis * originAlongAxis - lanes.radiusSquared[slot] <= 0 ) {
+
+			// Parallel to the axis and inside the cylinder
+			sideEntry = -std::numeric_limits<real>::infinity();
+			sideExit = std::numeric_limits<real>::infinity();
+		}
+		else {
+			continue;
+		}
+
+		// Interval in which the ray is between the planes of the two ends. A ray
+		// parallel to them gets infinite bounds of the same sign, an empty
+		// interval, unless it lies between them.
+		real halfLength = lanes.halfLength[slot];
+		real inverseDirection = 1 / directionAlongAxis;
+		real slab1 = ( -halfLength - originAlongAxis ) * inverseDirection;
+		real slab2 = ( halfLength - originAlongAxis ) * inverseDirection;
+		real slabEntry = std::min( slab1, slab2 );
+		real slabExit = std::max( slab1, slab2 );
+
+		real t;
+		int element;
+
+		if( lanes.capped[slot] > 0 ) {
+
+			real entry = std::max( sideEntry, slabEntry );
+			real exit = std::min( sideExit, slabExit );
+
+			if( !( exit >= entry ) ) {
+				continue;
+			}
+
+			if( entry >= tMin ) {
+				t = entry;
+				element = sideEntry < slabEntry ? Cylinder::CAP : Cylinder::SIDE;
+			}
+			else {
+				t = exit;
+				element = slabExit < sideExit ? Cylinder::CAP : Cylinder::SIDE;
+			}
+		}
+		else {
+
+			element = Cylinder::SIDE;
+			if( sideEntry >= tMin && sideEntry >= slabEntry && slabExit >= sideEntry ) {
+				t = sideEntry;
+			}
+			else if( sideExit >= slabEntry && slabExit >= sideExit ) {
+				t = sideExit;
+			}
+			else {
+				continue;
+			}
+		}
+
+		if( t >= tMin && t < tMax ) {
+
+			tMax = t;
+			hitSlot = slot;
+			hitElement = element;
+			found = true;
+
+			if( anyHit ) {
+				return true;
+			}
+		}
+	}
+
+	return found;
+
+} // end intersectScalar
+
+
+#ifdef RAYTRACER_X86_SIMD
+
+/*
+* Tests SSE2_LANES cylinders per instruction: two in double precision and four
+* in single precision. Every lane computes both the capped and the open result
+* and the capped flag of the cylinder selects one of them.
+*/
+static bool intersectSse2( const CylinderSet::Lanes & lanes, int begin, int end, const Ray & ray,
+						   real tMin, real & tMax, int & hitSlot, int & hitElement, bool anyHit )
+{
+	const Sse2Real directX = sse2Set( ray.direct.x );
+	const Sse2Real directY = sse2Set( ray.direct.y );
+	const Sse2Real directZ = sse2Set( ray.direct.z );
+	const Sse2Real originX = sse2Set( ray.origin.x );
+	const Sse2Real originY = sse2Set( ray.origin.y );
+	const Sse2Real originZ = sse2Set( ray.origin.z );
+	const Sse2Real start = sse2Set( tMin );
+	const Sse2Real zero = sse2Zero();
+	const Sse2Real one = sse2Set( 1 );
+	const Sse2Real infinity = sse2Set( std::numeric_limits<real>::infinity() );
+
+	bool found = false;
+
+	for( int slot = begin; slot < end; slot += SSE2_LANES ) {
+
+		Sse2Real ocX = sse2Sub( originX, sse2LoadUnaligned( &lanes.centerX[slot] ) );
+		Sse2Real ocY = sse2Sub( originY, sse2LoadUnaligned( &lanes.centerY[slot] ) );
+		Sse2Real ocZ = sse2Sub( originZ, sse2LoadUnaligned( &lanes.centerZ[slot] ) );
+
+		Sse2Real axisX = sse2LoadUnaligned( &lanes.axisX[slot] );
+		Sse2Real axisY = sse2LoadUnaligned( &lanes.axisY[slot] );
+		Sse2Real axisZ = sse2LoadUnaligned( &lanes.axisZ[slot] );
+		Sse2Real radiusSquared = sse2LoadUnaligned( &lanes.radiusSquared[slot] );
+
+		Sse2Real directionAlongAxis = sse2Add( sse2Add( sse2Mul( directX, axisX ), sse2Mul( directY, axisY ) ),
+											   sse2Mul( directZ, axisZ ) );
+		Sse2Real originAlongAxis = sse2Add( sse2Add( sse2Mul( ocX, axisX ), sse2Mul( ocY, axisY ) ), sse2Mul( ocZ, axisZ ) );
+
+		// Interval in which the ray is inside the infinite cylinder
+		Sse2Real a = sse2Sub( one, sse2Mul( directionAlongAxis, directionAlongAxis ) );
+		Sse2Real mX = sse2Sub( sse2Mul( ocY, axisZ ), sse2Mul( ocZ, axisY ) );
+		Sse2Real mY = sse2Sub( sse2Mul( ocZ, axisX ), sse2Mul( ocX, axisZ ) );
+		Sse2Real mZ = sse2Sub( sse2Mul( ocX, axisY ), sse2Mul( ocY, axisX ) );
+		Sse2Real w = sse2Add( sse2Add( sse2Mul( directX, mX ), sse2Mul( directY, mY ) ), sse2Mul( directZ, mZ ) );
+		Sse2Real discriminant = sse2Sub( sse2Mul( a, radiusSquared ), sse2Mul( w, w ) );
+
+		Sse2Real hit = sse2GreaterEqual( discriminant, zero );
+
+		// Rays parallel to the axis are rare, so their test is only made when needed
+		Sse2Real parallel = sse2GreaterEqual( zero, a );
+		int parallelMask = sse2Mask( parallel );
+		if( parallelMask != 0 ) {
+
+			Sse2Real c = sse2Sub( sse2Sub( sse2Add( sse2Add( sse2Mul( ocX, ocX ), sse2Mul( ocY, ocY ) ), sse2Mul( ocZ, ocZ ) ),
+										   sse2Mul( originAlongAxis, originAlongAxis ) ),
+								  radiusSquared );
+			hit = sse2Select( parallel, sse2GreaterEqual( zero, c ), hit );
+		}
+
+		if( sse2Mask( hit ) == 0 ) {
+			continue;
+		}
+
+		Sse2Real inverseA = sse2Div( one, a );
+		Sse2Real b = sse2Sub( sse2Add( sse2Add( sse2Mul( directX, ocX ), sse2Mul( directY, ocY ) ), sse2Mul( directZ, ocZ ) ),
+							  sse2Mul( directionAlongAxis, originAlongAxis ) );
+		Sse2Real middle = sse2Mul( sse2Sub( zero, b ), inverseA );
+		Sse2Real halfChord = sse2Mul( sse2Sqrt( sse2Max( discriminant, zero ) ), inverseA );
+
+		Sse2Real sideEntry = sse2Sub( middle, halfChord );
+		Sse2Real sideExit = sse2Add( middle, halfChord );
+		if( parallelMask != 0 ) {
+			sideEntry = sse2Select( parallel, sse2Sub( zero, infinity ), sideEntry );
+			sideExit = sse2Select( parallel, infinity, sideExit );
+		}
+
+		// Interval in which the ray is between the planes of the two ends
+		Sse2Real halfLength = sse2LoadUnaligned( &lanes.halfLength[slot] );
+		Sse2Real inverseDirection = sse2Div( one, directionAlongAxis );
+		Sse2Real slab1 = sse2Mul( sse2Sub( sse2Sub( zero, halfLength ), originAlongAxis ), inverseDirection );
+		Sse2Real slab2 = sse2Mul( sse2Sub( halfLength, originAlongAxis ), inverseDirection );
+		Sse2Real slabEntry = sse2Min( slab1, slab2 );
+		Sse2Real slabExit = sse2Max( slab1, slab2 );
+
+		// Capped: the surface is crossed where the overlap of the intervals begins and ends
+		Sse2Real entry = sse2Max( sideEntry, slabEntry );
+		Sse2Real exit = sse2Min( sideExit, slabExit );
+		Sse2Real useEntry = sse2GreaterEqual( entry, start );
+		Sse2Real cappedT = sse2Select( useEntry, entry, exit );
+		Sse2Real cappedHit = sse2GreaterEqual( exit, entry );
+		Sse2Real capHit = sse2Select( useEntry, sse2Less( sideEntry, slabEntry ), sse2Less( slabExit, sideExit ) );
+
+		// Open: a root of the side that lies between the ends
+		Sse2Real useNear = sse2And( sse2And( sse2GreaterEqual( sideEntry, start ), sse2GreaterEqual( sideEntry, slabEntry ) ),
+									sse2GreaterEqual( slabExit, sideEntry ) );
+		Sse2Real farInside = sse2And( sse2GreaterEqual( sideExit, slabEntry ), sse2GreaterEqual( slabExit, sideExit ) );
+		Sse2Real openT = sse2Select( useNear, sideEntry, sideExit );
+		Sse2Real openHit = sse2Or( useNear, farInside );
+
+		Sse2Real capped = sse2Less( zero, sse2LoadUnaligned( &lanes.capped[slot] ) );
+		Sse2Real t = sse2Select( capped, cappedT, openT );
+
+		hit = sse2And( hit, sse2Select( capped, cappedHit, openHit ) );
+		hit = sse2And( hit, sse2GreaterEqual( t, start ) );
+		hit = sse2And( hit, sse2Less( t, sse2Set( tMax ) ) );
+
+		int mask = sse2Mask( hit );
+		if( mask == 0 ) {
+			continue;
+		}
+
+		int capMask = sse2Mask( sse2And( capped, capHit ) );
+
+		real tLanes[SSE2_LANES];
+		sse2Store( tLanes, t );
+
+		for( int lane = 0; lane < SSE2_LANES; lane++ ) {
+
+			if( ( mask & ( 1 << lane ) ) && tLanes[lane] < tMax ) {
+
+				tMax = tLanes[lane];
+				hitSlot = slot + lane;
+				hitElement = ( capMask & ( 1 << lane ) ) ? Cylinder::CAP : Cylinder::SIDE;
+				found = true;
+
+				if( anyHit ) {
+					return true;
+				}
+			}
+		}
+	}
+
+	return found;
+
+} // end intersectSse2
+
+
+/*
+* Tests AVX2_LANES cylinders per instruction: four in double precision and eight
+* in single precision. Compiled for AVX2 regardless of the compiler flags and
+* only called when the processor supports it.
+*/
+RAYTRACER_AVX2
+static bool intersectAvx2( const CylinderSet::Lanes & lanes, int begin, int end, const Ray & ray,
+						   real tMin, real & tMax, int & hitSlot, int & hitElement, bool anyHit )
+{
+	const Avx2Real directX = avx2Set( ray.direct.x );
+	const Avx2Real directY = avx2Set( ray.direct.y );
+	const Avx2Real directZ = avx2Set( ray.direct.z );
+	const Avx2Real originX = avx2Set( ray.origin.x );
+	const Avx2Real originY = avx2Set( ray.origin.y );
+	const Avx2Real originZ = avx2Set( ray.origin.z );
+	const Avx2Real start = avx2Set( tMin );
+	const Avx2Real zero = avx2Zero();
+	const Avx2Real one = avx2Set( 1 );
+	const Avx2Real infinity = avx2Set( std::numeric_limits<real>::infinity() );
+
+	bool found = false;
+
+	for( int slot = begin; slot < end; slot += AVX2_LANES ) {
+
+		Avx2Real ocX = avx2Sub( originX, avx2LoadUnaligned( &lanes.centerX[slot] ) );
+		Avx2Real ocY = avx2Sub( originY, avx2LoadUnaligned( &lanes.centerY[slot] ) );
+		Avx2Real ocZ = avx2Sub( originZ, avx2LoadUnaligned( &lanes.centerZ[slot] ) );
+
+		Avx2Real axisX = avx2LoadUnaligned( &lanes.axisX[slot] );
+		Avx2Real axisY = avx2LoadUnaligned( &lanes.axisY[slot] );
+		Avx2Real axisZ = avx2LoadUnaligned( &lanes.axisZ[slot] );
+		Avx2Real radiusSquared = avx2LoadUnaligned( &lanes.radiusSquared[slot] );
+
+		Avx2Real directionAlongAxis = avx2Add( avx2Add( avx2Mul( directX, axisX ), avx2Mul( directY, axisY ) ),
+											   avx2Mul( directZ, axisZ ) );
+		Avx2Real originAlongAxis = avx2Add( avx2Add( avx2Mul( ocX, axisX ), avx2Mul( ocY, axisY ) ), avx2Mul( ocZ, axisZ ) );
+
+		// Interval in which the ray is inside the infinite cylinder
+		Avx2Real a = avx2Sub( one, avx2Mul( directionAlongAxis, directionAlongAxis ) );
+		Avx2Real mX = avx2Sub( avx2Mul( ocY, axisZ ), avx2Mul( ocZ, axisY ) );
+		Avx2Real mY = avx2Sub( avx2Mul( ocZ, axisX ), avx2Mul( ocX, axisZ ) );
+		Avx2Real mZ = avx2Sub( avx2Mul( ocX, axisY ), avx2Mul( ocY, axisX ) );
+		Avx2Real w = avx2Add( avx2Add( avx2Mul( directX, mX ), avx2Mul( directY, mY ) ), avx2Mul( directZ, mZ ) );
+		Avx2Real discriminant = avx2Sub( avx2Mul( a, radiusSquared ), avx2Mul( w, w ) );
+
+		Avx2Real hit = avx2GreaterEqual( discriminant, zero );
+
+		// Rays parallel to the axis are rare, so their test is only made when needed
+		Avx2Real parallel = avx2GreaterEqual( zero, a );
+		int parallelMask = avx2Mask( parallel );
+		if( parallelMask != 0 ) {
+
+			Avx2Real c = avx2Sub( avx2Sub( avx2Add( avx2Add( avx2Mul( ocX, ocX ), avx2Mul( ocY, ocY ) ), avx2Mul( ocZ, ocZ ) ),
+										   avx2Mul( originAlongAxis, originAlongAxis ) ),
+								  radiusSquared );
+			hit = avx2Select( parallel, avx2GreaterEqual( zero, c ), hit );
+		}
+
+		if( avx2Mask( hit ) == 0 ) {
+			continue;
+		}
+
+		Avx2Real inverseA = avx2Div( one, a );
+		Avx2Real b = avx2Sub( avx2Add( avx2Add( avx2Mul( directX, ocX ), avx2Mul( directY, ocY ) ), avx2Mul( directZ, ocZ ) ),
+							  avx2Mul( directionAlongAxis, originAlongAxis ) );
+		Avx2Real middle = avx2Mul( avx2Sub( zero, b ), inverseA );
+		Avx2Real halfChord = avx2Mul( avx2Sqrt( avx2Max( discriminant, zero ) ), inverseA );
+
+		Avx2Real sideEntry = avx2Sub( middle, halfChord );
+		Avx2Real sideExit = avx2Add( middle, halfChord );
+		if( parallelMask != 0 ) {
+			sideEntry = avx2Select( parallel, avx2Sub( zero, infinity ), sideEntry );
+			sideExit = avx2Select( parallel, infinity, sideExit );
+		}
+
+		// Interval in which the ray is between the planes of the two ends
+		Avx2Real halfLength = avx2LoadUnaligned( &lanes.halfLength[slot] );
+		Avx2Real inverseDirection = avx2Div( one, directionAlongAxis );
+		Avx2Real slab1 = avx2Mul( avx2Sub( avx2Sub( zero, halfLength ), originAlongAxis ), inverseDirection );
+		Avx2Real slab2 = avx2Mul( avx2Sub( halfLength, originAlongAxis ), inverseDirection );
+		Avx2Real slabEntry = avx2Min( slab1, slab2 );
+		Avx2Real slabExit = avx2Max( slab1, slab2 );
+
+		// Capped: the surface is crossed where the overlap of the intervals begins and ends
+		Avx2Real entry = avx2Max( sideEntry, slabEntry );
+		Avx2Real exit = avx2Min( sideExit, slabExit );
+		Avx2Real useEntry = avx2GreaterEqual( entry, start );
+		Avx2Real cappedT = avx2Select( useEntry, entry, exit );
+		Avx2Real cappedHit = avx2GreaterEqual( exit, entry );
+		Avx2Real capHit = avx2Select( useEntry, avx2Less( sideEntry, slabEntry ), avx2Less( slabExit, sideExit ) );
+
+		// Open: a root of the side that lies between the ends
+		Avx2Real useNear = avx2And( avx2And( avx2GreaterEqual( sideEntry, start ), avx2GreaterEqual( sideEntry, slabEntry ) ),
+									avx2GreaterEqual( slabExit, sideEntry ) );
+		Avx2Real farInside = avx2And( avx2GreaterEqual( sideExit, slabEntry ), avx2GreaterEqual( slabExit, sideExit ) );
+		Avx2Real openT = avx2Select( useNear, sideEntry, sideExit );
+		Avx2Real openHit = avx2Or( useNear, farInside );
+
+		Avx2Real capped = avx2Less( zero, avx2LoadUnaligned( &lanes.capped[slot] ) );
+		Avx2Real t = avx2Select( capped, cappedT, openT );
+
+		hit = avx2And( hit, avx2Select( capped, cappedHit, openHit ) );
+		hit = avx2And( hit, avx2GreaterEqual( t, start ) );
+		hit = avx2And( hit, avx2Less( t, avx2Set( tMax ) ) );
+
+		int mask = avx2Mask( hit );
+		if( mask == 0 ) {
+			continue;
+		}
+
+		int capMask = avx2Mask( avx2And( capped, capHit ) );
+
+		real tLanes[AVX2_LANES];
+		avx2Store( tLanes, t );
+
+		for( int lane = 0; lane < AVX2_LANES; lane++ ) {
+
+			if( ( mask & ( 1 << lane ) ) && tLanes[lane] < tMax ) {
+
+				tMax = tLanes[lane];
+				hitSlot = slot + lane;
+				hitElement = ( capMask & ( 1 << lane ) ) ? Cylinder::CAP : Cylinder::SIDE;
+				found = true;
+
+				if( anyHit ) {
+					return true;
+				}
+			}
+		}
+	}
+
+	return found;
+
+} // end intersectAvx2
+
+#endif // RAYTRACER_X86_SIMD
+
+
+CylinderSet::CylinderSet( const std::vector<std::shared_ptr<Cylinder>> & cylinders, ThreadPool * threadPool )
+	: Surface( Material() ), cylinders( cylinders ), kernel( getKernel( getSimdLevel() ) )
+{
+	std::vector<BoundingBox> cylinderBounds( cylinders.size() );
+
+	for( size_t i = 0; i < cylinders.size(); i++ ) {
+		cylinderBounds[i] = cylinders[i]->bounds();
+	}
+
+	bvh.build( cylinderBounds, threadPool, MAX_LEAF_SIZE );
+
+	fillLanes();
+
+} // end CylinderSet constructor
+
+
+CylinderSet::Kernel CylinderSet::getKernel( SimdLevel level )
+{
+#ifdef RAYTRACER_X86_SIMD
+	if( level == SimdLevel::AVX2 ) {
+		return intersectAvx2;
+	}
+	if( level == SimdLevel::SSE2 ) {
+		return intersectSse2;
+	}
+#endif
+	return intersectScalar;
+
+} // end getKernel
+
+
+void CylinderSet::fillLanes( )
+{
+	const std::vector<BVH::Node> & nodes = bvh.getNodes();
+	const std::vector<int> & primitiveIndices = bvh.getPrimitiveIndices();
+
+	// Lay the leaves out in the order of the primitive index list, which keeps
+	// cylinders that are close in space close in memory.
+	std::vector<const BVH::Node *> leaves;
+	for( const BVH::Node & node : nodes ) {
+		if( node.isLeaf() ) {
+			leaves.push_back( &node );
+		}
+	}
+	std::sort( leaves.begin(), leaves.end(), []( const BVH::Node * a, const BVH::Node * b ) {
+		return a->firstIndex < b->firstIndex;
+	} );
+
+	lanes = Lanes();
+	leafSlots.assign( primitiveIndices.size(), -1 );
+
+	for( const BVH::Node * leaf : leaves ) {
+
+		leafSlots[leaf->firstIndex] = static_cast<int>( lanes.cylinder.size() );
+
+		int paddedCount = ( leaf->primitiveCount + LANE_GROUP_SIZE - 1 ) / LANE_GROUP_SIZE * LANE_GROUP_SIZE;
+
+		for( int i = 0; i < paddedCount; i++ ) {
+
+			if( i < leaf->primitiveCount ) {
+
+				int index = primitiveIndices[leaf->firstIndex + i];
+				const Cylinder & cylinder = *cylinders[index];
+
+				lanes.centerX.push_back( cylinder.center.x );
+				lanes.centerY.push_back( cylinder.center.y );
+				lanes.centerZ.push_back( cylinder.center.z );
+				lanes.axisX.push_back( cylinder.axis.x );
+				lanes.axisY.push_back( cylinder.axis.y );
+				lanes.axisZ.push_back( cylinder.axis.z );
+				lanes.radiusSquared.push_back( cylinder.radius * cylinder.radius );
+				lanes.halfLength.push_back( cylinder.length / 2 );
+				lanes.capped.push_back( cylinder.capped ? 1.0 : 0.0 );
+				lanes.cylinder.push_back( index );
+			}
+			else {
+
+				// A negative squared radius makes the discriminant negative for
+				// rays that are not parallel to the axis and puts rays that are
+				// parallel outside of the cylinder
+				lanes.centerX.push_back( 0.0 );
+				lanes.centerY.push_back( 0.0 );
+				lanes.centerZ.push_back( 0.0 );
+				lanes.axisX.push_back( 1.0 );
+				lanes.axisY.push_back( 0.0 );
+				lanes.axisZ.push_back( 0.0 );
+				lanes.radiusSquared.push_back( -std::numeric_limits<real>::max() );
+				lanes.halfLength.push_back( 0.0 );
+				lanes.capped.push_back( 0.0 );
+				lanes.cylinder.push_back( -1 );
+			}
+		}
+	}
+
+} // end fillLanes
+
+
+/*
+* Checks a ray for intersection with every cylinder in the collection. Finds the
+* parameter of the closest point of intersection within [tMin, tMax) if one exits.
+*/
+bool CylinderSet::intersect( const Ray & ray, real tMin, real tMax, RayHit & hit ) const
+{
+	int hitSlot = -1;
+	int hitElement = Cylinder::SIDE;
+	real limit = tMax;
+
+	bvh.traverseLeaves( ray, tMin, tMax, [&]( const BVH::Node & leaf, real & tMax ) {
+
+		int begin = leafSlots[leaf.firstIndex];
+		int end = begin + ( leaf.primitiveCount + LANE_GROUP_SIZE - 1 ) / LANE_GROUP_SIZE * LANE_GROUP_SIZE;
+
+		kernel( lanes, begin, end, ray, tMin, limit, hitSlot, hitElement, false );
+		tMax = limit;
+		return false;
+	} );
+
+	if( hitSlot < 0 ) {
+		return false;
+	}
+
+	hit.t = limit;
+	hit.element = 2 * lanes.cylinder[hitSlot] + ( hitElement == Cylinder::CAP ? 1 : 0 );
+	return true;
+
+} // end intersect
+
+
+void CylinderSet::completeHitRecord( const Ray & ray, const RayHit & hit, HitRecord & hitRecord ) const
+{
+	RayHit cylinderHit = hit;
+	cylinderHit.element = hit.element % 2 == 1 ? Cylinder::CAP : Cylinder::SIDE;
+
+	cylinders[hit.element / 2]->completeHitRecord( ray, cylinderHit, hitRecord );
+
+} // end completeHitRecord
+
+
+bool CylinderSet::occludes( const Ray & ray, real tMin, real tMax ) const
+{
+	real limit = tMax;
+
+	return bvh.traverseLeaves( ray, tMin, tMax, [&]( const BVH::Node & leaf, real & ) {
+
+		int begin = leafSlots[leaf.firstIndex];
+		int end = begin + ( leaf.primitiveCount + LANE_GROUP_SIZE - 1 ) / LANE_GROUP_SIZE * LANE_GROUP_SIZE;
+		int hitSlot, hitElement;
+
+		return kernel( lanes, begin, end, ray, tMin, limit, hitSlot, hitElement, true );
+	} );
+
+} // end occludes
+
+
+BoundingBox CylinderSet::bounds( ) const
+{
+	return bvh.getBounds();
+
+} // end bounds
@@ -8,7 +8,7 @@ color getRandomColor()
 	float green = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
 	float blue = static_cast <float> (rand()) / static_cast <float> (RAND_MAX);
 
-	return color(red, green, blue, 1.0);
+	return color(red, green, blue);
 
 } // end getRandomColor
 
@@ -116,3 +116,22 @@ ostream &operator << ( ostream &os, const dmat4 &M )
 }
 
 
+
+#ifdef RAYTRACER_SINGLE_PRECISION
+
+ostream &operator << ( ostream &os, const vec2 &V )
+{
+	return os << dvec2( V );
+}
+
+ostream &operator << ( ostream &os, const vec3 &V )
+{
+	return os << dvec3( V );
+}
+
+ostream &operator << ( ostream &os, const vec4 &V )
+{
+	return os << dvec4( V );
+}
+
+#endif
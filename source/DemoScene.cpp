@@ -0,0 +1,69 @@
+#include "DemoScene.h"
+
+#include "Sphere.h"
+#include "Plane.h"
+#include "Cylinder.h"
+#include "Ellipsoid.h"
+#include "SimplePolygon.h"
+
+
+void buildDemoScene( DemoScene & scene )
+{
+    Material redMat(RED);
+    redMat.emissiveColor = real(.03) * RED;
+
+    std::vector<vec3> polygonVector = {vec3(2, 0, -10), vec3(2, 2, -10), vec3(-2, 2, -10), vec3(-2, 0, -10)};
+
+    shared_ptr<SimplePolygon> polygon = make_shared<SimplePolygon>(polygonVector, RED);
+    shared_ptr<Ellipsoid> ellipsoid = make_shared<Ellipsoid>(vec3(-3.0, 0.0, -10.0), BLACK, 1, 2, 2);
+    shared_ptr<Cylinder> cylinder = make_shared<Cylinder>(vec3(2.7, 2.8, -10.0), GREEN, 1, 2 );
+	shared_ptr<Sphere> redBall = make_shared<Sphere>(vec3( 0.0, -1.0, -10.0 ), 1.5, RED);
+	shared_ptr<Sphere> blueBall = make_shared<Sphere>(vec3( -1.5, 0.25, -8.0 ), 0.5, BLUE);
+	shared_ptr<Sphere> whiteBall = make_shared<Sphere>(vec3( 1.5, 0.25, -8.0 ), 0.5, WHITE);
+	shared_ptr<Plane> plane = make_shared<Plane>(vec3(0, -20.0, 0.0), vec3(0, 1, 0), WHITE);
+    redBall->material = redMat;
+
+    scene.surfaces.push_back(plane);
+    scene.surfaces.push_back(ellipsoid);
+	scene.surfaces.push_back(whiteBall);
+	scene.whiteBall = whiteBall;
+	scene.surfaces.push_back(blueBall);
+	scene.surfaces.push_back(redBall);
+    scene.surfaces.push_back(cylinder);
+    scene.surfaces.push_back(polygon);
+
+    scene.ambientLight = make_shared<LightSource>(BLACK);
+    scene.ambientLight->ambientLightColor = color(0.15, 0.15, 0.15);
+	scene.lightPos = make_shared<PositionalLight>(vec3(-10.0, 10.0, 10.0), color(1.0, 1.0, 1.0));
+	scene.lightDir = make_shared<DirectionalLight>(vec3(-10.0,10.0 ,-10.0), color(0.75, 0.75, 0.75));
+    scene.spotlight = make_shared<Spotlight>(vec3(500, 1000, -10), vec3(0,-1,0), glm::cos(glm::radians(15.0)), color(0.75, 0.75, 0.75));
+
+    scene.lights.push_back(scene.spotlight);
+	scene.lights.push_back(scene.lightPos);
+	scene.lights.push_back(scene.lightDir);
+	scene.lights.push_back(scene.ambientLight);
+
+} // end buildDemoScene
+
+
+void setDemoTimeOfDay( DemoScene & scene, bool night )
+{
+    scene.ambientLight->enabled = true;
+    scene.lightPos->enabled = true;
+    scene.lightDir->enabled = true;
+    scene.spotlight->enabled = true;
+
+    scene.ambientLight->ambientLightColor = color(0.15, 0.15, 0.15);
+	scene.lightPos->diffuseLightColor = color(1.0, 1.0, 1.0);
+	scene.lightDir->diffuseLightColor = color(0.75, 0.75, 0.75);
+    scene.spotlight->diffuseLightColor = color(0.75, 0.75, 0.75);
+
+    if (night)
+    {
+        scene.ambientLight->ambientLightColor = scene.ambientLight->ambientLightColor * real(0.0002);
+        scene.lightPos->diffuseLightColor = scene.lightPos->diffuseLightColor * real(0.0002);
+        scene.lightDir->diffuseLightColor = scene.lightDir->diffuseLightColor * real(0.0002);
+        scene.spotlight->enabled = false;
+    }
+
+} // end setDemoTimeOfDay
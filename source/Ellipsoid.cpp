@@ -1,29 +1,24 @@
 #include "Ellipsoid.h"
 
-Ellipsoid::Ellipsoid(const dvec3 & position, const color & mat, double a, double b, double c)
+Ellipsoid::Ellipsoid(const vec3 & position, const color & mat, real a, real b, real c)
     : QuadricSurface(position, mat), a(a), b(b), c(c)
 {
-    // a = 1, b = 2, c = 2, centroid (position) = <0,0,0>
-    A = 1/1.0;
-    B = 1/4.0;
-    C = 1/4.0;
-    D = 0;
-    E = 0;
-    F = 0;
-    G = 0;
-    H = 0;
-    I = 0;
-    J = -1;
+    setCoefficients();
 }
 
 
-Ellipsoid::Ellipsoid(const dvec3 & position, const Material & mat, double a, double b, double c)
+Ellipsoid::Ellipsoid(const vec3 & position, const Material & mat, real a, real b, real c)
     : QuadricSurface(position, mat), a(a), b(b), c(c)
 {
-    // a = 1, b = 2, c = 2
-    A = 1/1.0;
-    B = 1/4.0;
-    C = 1/4.0;
+    setCoefficients();
+}
+
+void Ellipsoid::setCoefficients()
+{
+    // x2/a2 + y2/b2 + z2/c2 - 1 = 0
+    A = 1 / (a * a);
+    B = 1 / (b * b);
+    C = 1 / (c * c);
     D = 0;
     E = 0;
     F = 0;
@@ -32,4 +27,3 @@ Ellipsoid::Ellipsoid(const dvec3 & position, const Material & mat, double a, dou
     I = 0;
     J = -1;
 }
-
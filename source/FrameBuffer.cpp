@@ -1,4 +1,174 @@
 #include "FrameBuffer.h"
+#include "Simd.h"
+#include "TiledImageFile.h"
+
+#include <cmath>
+#include <cstring>
+
+// Number of entries of the gamma table
+static const int GAMMA_TABLE_SIZE = 4096;
+
+/**
+* Settings that the resolve kernels read.
+*/
+struct ResolveSettings
+{
+	bool reinhard;
+	float exposure;
+
+	// Null when gamma is one
+	const unsigned char * gammaTable;
+};
+
+/**
+* Converts a span of accumulated pixels into RGBA bytes. Pixels without
+* samples are left unchanged.
+* @param in - FLOATS_PER_ACCUMULATED_PIXEL floats per pixel
+* @param out - BYTES_PER_PIXEL bytes per pixel
+* @param count - number of pixels in the span
+*/
+typedef void (*ResolveKernel)(const float * in, unsigned char * out, int count, const ResolveSettings & settings);
+
+
+/*
+* Reference kernel. Also converts the pixels at the end of a span that the SIMD
+* kernel leaves over. The comparisons are written to treat NaN the way the
+* minimum and maximum instructions of SSE2 do, so both kernels give the same bytes.
+*/
+static void resolveSpanScalar(const float * in, unsigned char * out, int count, const ResolveSettings & settings)
+{
+	for (int i = 0; i < count; i++, in += FLOATS_PER_ACCUMULATED_PIXEL, out += BYTES_PER_PIXEL) {
+
+		float weight = in[3];
+		if (!(weight > 0.0f)) {
+			continue;
+		}
+
+		for (int k = 0; k < 3; k++) {
+
+			float c = in[k] / weight * settings.exposure;
+			if (settings.reinhard) {
+				c = c / (1.0f + c);
+			}
+			c = c > 0.0f ? c : 0.0f;
+			c = c < 1.0f ? c : 1.0f;
+
+			if (settings.gammaTable != nullptr) {
+				out[k] = settings.gammaTable[(int)(c * float(GAMMA_TABLE_SIZE - 1))];
+			}
+			else {
+				out[k] = (unsigned char)(c * 255.0f);
+			}
+		}
+		out[3] = 255;
+	}
+
+} // end resolveSpanScalar
+
+
+#ifdef RAYTRACER_X86_SIMD
+
+/*
+* Converts four pixels per iteration. Each pixel fills one register, with its
+* weight in the last lane. The quantized values of the four pixels are packed
+* into 16 bytes and merged with the old bytes of the pixels that have no samples.
+*/
+static void resolveSpanSse2(const float * in, unsigned char * out, int count, const ResolveSettings & settings)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 exposure = _mm_set1_ps(settings.exposure);
+	const __m128 scale = _mm_set1_ps(settings.gammaTable != nullptr ? float(GAMMA_TABLE_SIZE - 1) : 255.0f);
+	const __m128i colorLanes = _mm_set_epi32(0, -1, -1, -1);
+	const __m128i opaque = _mm_set_epi32(255, 0, 0, 0);
+
+	int i = 0;
+	for (; i + 4 <= count; i += 4) {
+
+		__m128i quantized[4];
+		__m128i sampled[4];
+
+		for (int p = 0; p < 4; p++) {
+
+			__m128 sum = _mm_loadu_ps(in + FLOATS_PER_ACCUMULATED_PIXEL * (i + p));
+			__m128 weight = _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(3, 3, 3, 3));
+			sampled[p] = _mm_castps_si128(_mm_cmpgt_ps(weight, zero));
+
+			__m128 c = _mm_mul_ps(_mm_div_ps(sum, weight), exposure);
+			if (settings.reinhard) {
+				c = _mm_div_ps(c, _mm_add_ps(one, c));
+			}
+			c = _mm_min_ps(_mm_max_ps(c, zero), one);
+
+			quantized[p] = _mm_or_si128(_mm_and_si128(_mm_cvttps_epi32(_mm_mul_ps(c, scale)), colorLanes), opaque);
+		}
+
+		unsigned char * pixels = out + BYTES_PER_PIXEL * i;
+
+		if (settings.gammaTable != nullptr) {
+
+			alignas(16) int32_t indices[16];
+			alignas(16) int32_t masks[16];
+			for (int p = 0; p < 4; p++) {
+				_mm_store_si128((__m128i *)(indices + 4 * p), quantized[p]);
+				_mm_store_si128((__m128i *)(masks + 4 * p), sampled[p]);
+			}
+			for (int p = 0; p < 4; p++) {
+				if (masks[4 * p] != 0) {
+					for (int k = 0; k < 3; k++) {
+						pixels[4 * p + k] = settings.gammaTable[indices[4 * p + k]];
+					}
+					pixels[4 * p + 3] = 255;
+				}
+			}
+			continue;
+		}
+
+		__m128i bytes = _mm_packus_epi16(_mm_packs_epi32(quantized[0], quantized[1]),
+										 _mm_packs_epi32(quantized[2], quantized[3]));
+		__m128i mask = _mm_packs_epi16(_mm_packs_epi32(sampled[0], sampled[1]),
+									   _mm_packs_epi32(sampled[2], sampled[3]));
+		__m128i old = _mm_loadu_si128((const __m128i *)pixels);
+
+		_mm_storeu_si128((__m128i *)pixels, _mm_or_si128(_mm_and_si128(mask, bytes), _mm_andnot_si128(mask, old)));
+	}
+
+	resolveSpanScalar(in + FLOATS_PER_ACCUMULATED_PIXEL * i, out + BYTES_PER_PIXEL * i, count - i, settings);
+
+} // end resolveSpanSse2
+
+#endif // RAYTRACER_X86_SIMD
+
+
+/**
+* Returns the kernel for the instruction set of the processor.
+*/
+static ResolveKernel getResolveKernel()
+{
+#ifdef RAYTRACER_X86_SIMD
+	if (getSimdLevel() != SimdLevel::SCALAR) {
+		return resolveSpanSse2;
+	}
+#endif
+	return resolveSpanScalar;
+
+} // end getResolveKernel
+
+
+/**
+* Collects the tone mapping settings of a frame buffer for the kernels.
+*/
+static ResolveSettings getResolveSettings(ToneMapping toneMapping, float exposure,
+										  const std::vector<unsigned char> & gammaTable)
+{
+	ResolveSettings settings;
+	settings.reinhard = toneMapping == ToneMapping::REINHARD;
+	settings.exposure = exposure;
+	settings.gammaTable = gammaTable.empty() ? nullptr : gammaTable.data();
+
+	return settings;
+
+} // end getResolveSettings
 
 /**
 * Constructor. Allocates memory for storing pixel values.
@@ -18,6 +188,7 @@ FrameBuffer::~FrameBuffer(void)
 	// Free the memory associated with the color buffer
 	delete[] colorBuffer;
 	delete[] depthBuffer;
+	delete[] accumulationBuffer;
 
 } // end FrameBuffer destructor
 
@@ -32,33 +203,225 @@ void FrameBuffer::setFrameBufferSize(const int width, const int height) {
 	window.width = width;
 	window.height = height;
 
-	// Set pixel storage modes. 
-	// (https://www.opengl.org/archives/resources/features/KilgardTechniques/oglpitfall/)
-#warning UNCOMMENT glPixelStore
-	//glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-	// glPixelStorei(GL_PACK_ALIGNMENT, 1);
-
 	// Free the memory previously associated with the color buffer
 	delete[] colorBuffer;
 	delete[] depthBuffer;
+	delete[] accumulationBuffer;
+
+	// Tiled layouts store the tiles at the right and top edges whole
+	int tileSize = getTileSize();
+	tilesAcross = (width + tileSize - 1) >> tileShift;
+	tilesDown = (height + tileSize - 1) >> tileShift;
+	if (layout == PixelLayout::LINEAR) {
+		storedPixelCount = (size_t)width * height;
+	}
+	else if (streamWriter == nullptr) {
+		storedPixelCount = (size_t)tilesAcross * tilesDown * tileSize * tileSize;
+	}
+	else {
+		storedPixelCount = (size_t)residentTileCount * tileSize * tileSize;
+	}
+
+	// When streaming, the buffers hold the slots of the tiles in memory
+	tileSlots.clear();
+	pendingPixels.clear();
+	freeSlots.clear();
+	if (streamWriter != nullptr) {
+
+		tileSlots.assign((size_t)tilesAcross * tilesDown, -1);
+		for (int tileY = 0; tileY < tilesDown; tileY++) {
+			for (int tileX = 0; tileX < tilesAcross; tileX++) {
+				int columns = std::min(tileSize, width - (tileX << tileShift));
+				int rows = std::min(tileSize, height - (tileY << tileShift));
+				pendingPixels.push_back(columns * rows);
+			}
+		}
+		for (int slot = residentTileCount - 1; slot >= 0; slot--) {
+			freeSlots.push_back(slot);
+		}
+	}
 
 	// Allocate the color buffer to match the size of the window
-	colorBuffer = new GLubyte[width*BYTES_PER_PIXEL*height];
-	depthBuffer = new float[width*height];
+	colorBuffer = new unsigned char[storedPixelCount*BYTES_PER_PIXEL];
+	depthBuffer = streamWriter == nullptr ? new float[width*height] : nullptr;
+	accumulationBuffer = new float[storedPixelCount*FLOATS_PER_ACCUMULATED_PIXEL];
+	linearColorBuffer.clear();
+
+	clearAccumulationBuffer();
 
 } // end setFrameBufferSize
 
 
+void FrameBuffer::setPixelLayout(PixelLayout layout, int tileSize) {
+
+	this->layout = layout;
+
+	tileShift = 0;
+	while ((1 << tileShift) < tileSize && tileShift < 15) {
+		tileShift++;
+	}
+
+	setFrameBufferSize(window.width, window.height);
+
+} // end setPixelLayout
+
+
+void FrameBuffer::setStreamingOutput(TileOutput * output, int residentTiles) {
+
+	streamWriter = output;
+	residentTileCount = std::max(residentTiles, 1);
+
+	if (output != nullptr) {
+		window.width = output->getWidth();
+		window.height = output->getHeight();
+		setPixelLayout(PixelLayout::TILED, output->getTileSize());
+	}
+	else {
+		setFrameBufferSize(window.width, window.height);
+	}
+
+} // end setStreamingOutput
+
+
+void FrameBuffer::acquireTiles(const int xStart, const int yStart, const int xEnd, const int yEnd) {
+
+	int tileSize = getTileSize();
+	std::unique_lock<std::mutex> lock(slotMutex);
+
+	for (int tileY = yStart >> tileShift; tileY <= (yEnd - 1) >> tileShift; tileY++) {
+		for (int tileX = xStart >> tileShift; tileX <= (xEnd - 1) >> tileShift; tileX++) {
+
+			int & slot = tileSlots[(size_t)tileY * tilesAcross + tileX];
+			if (slot >= 0) {
+				continue;
+			}
+
+			slotReleased.wait(lock, [this] { return !freeSlots.empty(); });
+			slot = freeSlots.back();
+			freeSlots.pop_back();
+
+			// Start the tile without samples and with the clear color
+			size_t first = (size_t)slot * tileSize * tileSize;
+			std::memset(accumulationBuffer + FLOATS_PER_ACCUMULATED_PIXEL * first, 0,
+						sizeof(float) * FLOATS_PER_ACCUMULATED_PIXEL * tileSize * tileSize);
+			for (int i = 0; i < tileSize * tileSize; i++) {
+				std::memcpy(colorBuffer + BYTES_PER_PIXEL * (first + i), clearColor, BYTES_PER_PIXEL);
+			}
+		}
+	}
+
+} // end acquireTiles
+
+
+void FrameBuffer::releaseResolvedPixels(const int tileX, const int tileY, const int count) {
+
+	size_t tile = (size_t)tileY * tilesAcross + tileX;
+	int slot;
+	{
+		std::lock_guard<std::mutex> lock(slotMutex);
+		pendingPixels[tile] -= count;
+		if (pendingPixels[tile] > 0) {
+			return;
+		}
+		slot = tileSlots[tile];
+	}
+
+	// No other block has pixels left in the tile, so it is written without the lock
+	size_t tilePixels = (size_t)getTileSize() * getTileSize();
+	streamWriter->writeTile(tileX, tileY, colorBuffer + BYTES_PER_PIXEL * slot * tilePixels);
+
+	{
+		std::lock_guard<std::mutex> lock(slotMutex);
+		tileSlots[tile] = -1;
+		freeSlots.push_back(slot);
+	}
+	slotReleased.notify_one();
+
+} // end releaseResolvedPixels
+
+
+/**
+* Spreads the lower 16 bits of a value out to the even bits.
+*/
+static inline size_t spreadBits(size_t value)
+{
+	value &= 0xFFFF;
+	value = (value | (value << 8)) & 0x00FF00FF;
+	value = (value | (value << 4)) & 0x0F0F0F0F;
+	value = (value | (value << 2)) & 0x33333333;
+	value = (value | (value << 1)) & 0x55555555;
+
+	return value;
+
+} // end spreadBits
+
+
+size_t FrameBuffer::getStorageIndex(const int x, const int y) const {
+
+	if (layout == PixelLayout::LINEAR) {
+		return (size_t)y * window.width + x;
+	}
+
+	size_t tile = (size_t)(y >> tileShift) * tilesAcross + (x >> tileShift);
+	int mask = getTileSize() - 1;
+
+	if (streamWriter != nullptr) {
+		tile = tileSlots[tile];
+	}
+
+	if (layout == PixelLayout::TILED) {
+		return (tile << (2 * tileShift)) + ((size_t)(y & mask) << tileShift) + (x & mask);
+	}
+	else {
+		return (tile << (2 * tileShift)) + (spreadBits(x & mask) | (spreadBits(y & mask) << 1));
+	}
+
+} // end getStorageIndex
+
+
+const unsigned char * FrameBuffer::getColorBuffer() const {
+
+	if (layout == PixelLayout::LINEAR) {
+		return colorBuffer;
+	}
+	if (streamWriter != nullptr) {
+		return nullptr;
+	}
+
+	linearColorBuffer.resize((size_t)window.width * window.height * BYTES_PER_PIXEL);
+	unsigned char * out = linearColorBuffer.data();
+
+	// Rows of tiles are copied in runs, Z order one pixel at a time
+	for (int y = 0; y < window.height; y++) {
+		int x = 0;
+		while (x < window.width) {
+
+			int run = 1;
+			if (layout == PixelLayout::TILED) {
+				run = std::min(getTileSize() - (x & (getTileSize() - 1)), window.width - x);
+			}
+
+			std::memcpy(out, colorBuffer + BYTES_PER_PIXEL * getStorageIndex(x, y), BYTES_PER_PIXEL * run);
+			out += BYTES_PER_PIXEL * run;
+			x += run;
+		}
+	}
+
+	return linearColorBuffer.data();
+
+} // end getColorBuffer
+
+
 /**
 * Sets the color to which the window will be cleared. Does NOT
 * actually clear the window
 */
 void FrameBuffer::setClearColor(const color & clear) {
 
-	clearColor[0] = (GLubyte)(clear.r * 255.0);
-	clearColor[1] = (GLubyte)(clear.g * 255.0);
-	clearColor[2] = (GLubyte)(clear.b * 255.0);
-	clearColor[3] = (GLubyte)(clear.a * 255.0);
+	clearColor[0] = (unsigned char)(clear.r * 255.0);
+	clearColor[1] = (unsigned char)(clear.g * 255.0);
+	clearColor[2] = (unsigned char)(clear.b * 255.0);
+	clearColor[3] = 255;
 
 } // end setClearColor
 
@@ -68,35 +431,21 @@ void FrameBuffer::setClearColor(const color & clear) {
 */
 void FrameBuffer::clearColorAndDepthBuffers() {
 
-	for (int y = 0; y < window.height; ++y) {
+	for (size_t i = 0; i < storedPixelCount; ++i) {
+
+		std::memcpy(colorBuffer + BYTES_PER_PIXEL * i, clearColor, BYTES_PER_PIXEL);
+	}
+
+	for (int y = 0; y < window.height && depthBuffer != nullptr; ++y) {
 		for (int x = 0; x < window.width; ++x) {
 
-			std::memcpy(colorBuffer + BYTES_PER_PIXEL * (x + y * window.width),
-				clearColor, BYTES_PER_PIXEL);
 			depthBuffer[y * window.width + x] = 1.0;
 		}
 	}
 
-} // end clearFrameBuffer
-
-
-/**
-* Copies memory into frame buffer and updates the window
-* using an OpenGL command.
-*/
-void FrameBuffer::showColorBuffer()
-{
-	// Insure raster position is lower left hand corner of the window. (OpenGL command)
-	glRasterPos2d(-1, -1);
-
-	// Copy color buffer to raster (Legacy OpenGL command)
-	glDrawPixels(window.width, window.height, GL_RGBA, GL_UNSIGNED_BYTE, colorBuffer);
-
-	// Flush all drawing commands and swapbuffers (Glut command)
-	glutSwapBuffers();
-
-} // end showFrameBuffer
+	clearAccumulationBuffer();
 
+} // end clearFrameBuffer
 
 
 bool FrameBuffer::checkInWindow(const int & x, const int & y)
@@ -112,27 +461,309 @@ bool FrameBuffer::checkInWindow(const int & x, const int & y)
 } // end checkInWindow
 
 
+bool FrameBuffer::checkStored(const int x, const int y)
+{
+	if (!checkInWindow(x, y)) {
+		return false;
+	}
+
+	return streamWriter == nullptr || tileSlots[(size_t)(y >> tileShift) * tilesAcross + (x >> tileShift)] >= 0;
+
+} // end checkStored
+
+
 /**
 * Sets an individual pixel value in the color buffer. Origin (0,0)
 * is the lower left hand corner of the window.
 */
 void FrameBuffer::setPixel(const int x, const int y, const color & rgba) {
 
-	if ( checkInWindow(x, y) == true ) {
+	if ( checkStored(x, y) == true ) {
 
-		color clampedColor = glm::clamp(rgba, 0.0, 1.0);
+		color clampedColor = glm::clamp(rgba, real(0.0), real(1.0));
 
-		GLubyte c[] = { (GLubyte)(clampedColor.r * 255),
-			(GLubyte)(clampedColor.g * 255),
-			(GLubyte)(clampedColor.b * 255),
-			(GLubyte)(clampedColor.a * 255) };
+		unsigned char c[] = { (unsigned char)(clampedColor.r * 255),
+			(unsigned char)(clampedColor.g * 255),
+			(unsigned char)(clampedColor.b * 255),
+			255 };
 
-		std::memcpy(colorBuffer + BYTES_PER_PIXEL * (x + y * window.width), c, BYTES_PER_PIXEL);
+		std::memcpy(colorBuffer + BYTES_PER_PIXEL * getStorageIndex(x, y), c, BYTES_PER_PIXEL);
 	}
 
 } // end setPixel
 
 
+void FrameBuffer::setHdrPixel(const int x, const int y, const color & rgb) {
+
+	if (checkStored(x, y)) {
+
+		float * pixel = accumulationBuffer + FLOATS_PER_ACCUMULATED_PIXEL * getStorageIndex(x, y);
+		pixel[0] = (float)rgb.r;
+		pixel[1] = (float)rgb.g;
+		pixel[2] = (float)rgb.b;
+		pixel[3] = 1.0f;
+	}
+
+} // end setHdrPixel
+
+
+color FrameBuffer::getHdrPixel(const int x, const int y) {
+
+	if (checkStored(x, y)) {
+
+		const float * pixel = accumulationBuffer + FLOATS_PER_ACCUMULATED_PIXEL * getStorageIndex(x, y);
+		if (pixel[3] > 0.0f) {
+			return color(pixel[0], pixel[1], pixel[2]) / real(pixel[3]);
+		}
+	}
+
+	return BLACK;
+
+} // end getHdrPixel
+
+
+void FrameBuffer::accumulatePixel(const int x, const int y, const color & rgb, const float weight) {
+
+	if (checkStored(x, y)) {
+
+		float * pixel = accumulationBuffer + FLOATS_PER_ACCUMULATED_PIXEL * getStorageIndex(x, y);
+		pixel[0] += weight * (float)rgb.r;
+		pixel[1] += weight * (float)rgb.g;
+		pixel[2] += weight * (float)rgb.b;
+		pixel[3] += weight;
+	}
+
+} // end accumulatePixel
+
+
+void FrameBuffer::storeSpan(int x, const int y, int count, const color * colors) {
+
+	while (count > 0) {
+
+		// Pixels that follow each other in a row are stored next to each other
+		// up to the end of the row of the tile
+		int run = count;
+		if (layout == PixelLayout::TILED) {
+			run = std::min(count, getTileSize() - (x & (getTileSize() - 1)));
+		}
+		else if (layout == PixelLayout::MORTON) {
+			run = 1;
+		}
+
+		float * pixel = accumulationBuffer + FLOATS_PER_ACCUMULATED_PIXEL * getStorageIndex(x, y);
+		for (int i = 0; i < run; i++, pixel += FLOATS_PER_ACCUMULATED_PIXEL) {
+			pixel[0] = (float)colors[i].r;
+			pixel[1] = (float)colors[i].g;
+			pixel[2] = (float)colors[i].b;
+			pixel[3] = 1.0f;
+		}
+
+		x += run;
+		colors += run;
+		count -= run;
+	}
+
+} // end storeSpan
+
+
+void FrameBuffer::writeSpan(const int x, const int y, const int count, const color * colors) {
+
+	if (y < 0 || y >= window.height) {
+		return;
+	}
+
+	int xStart = std::max(x, 0);
+	int xEnd = std::min(x + count, window.width);
+
+	if (xStart < xEnd) {
+		if (streamWriter != nullptr) {
+			acquireTiles(xStart, y, xEnd, y + 1);
+		}
+		storeSpan(xStart, y, xEnd - xStart, colors + (xStart - x));
+	}
+
+} // end writeSpan
+
+
+void FrameBuffer::writeTile(const int xStart, const int yStart, const int xEnd, const int yEnd, const color * colors) {
+
+	int x0 = std::max(xStart, 0);
+	int x1 = std::min(xEnd, window.width);
+	int width = xEnd - xStart;
+
+	int y0 = std::max(yStart, 0);
+	int y1 = std::min(yEnd, window.height);
+
+	if (x0 >= x1 || y0 >= y1) {
+		return;
+	}
+
+	if (streamWriter != nullptr) {
+		acquireTiles(x0, y0, x1, y1);
+	}
+
+	for (int y = y0; y < y1; y++) {
+		storeSpan(x0, y, x1 - x0, colors + (size_t)(y - yStart) * width + (x0 - xStart));
+	}
+
+} // end writeTile
+
+
+void FrameBuffer::writeColorTile(const int tileX, const int tileY, const int tileSize, const unsigned char * pixels) {
+
+	if (streamWriter != nullptr) {
+		return;
+	}
+
+	int x0 = std::max(tileX * tileSize, 0);
+	int x1 = std::min((tileX + 1) * tileSize, window.width);
+
+	for (int y = std::max(tileY * tileSize, 0); y < std::min((tileY + 1) * tileSize, window.height); y++) {
+
+		const unsigned char * row = pixels + BYTES_PER_PIXEL * ((size_t)(y - tileY * tileSize) * tileSize + (x0 - tileX * tileSize));
+		int x = x0;
+		while (x < x1) {
+
+			// Same runs as storeSpan
+			int run = x1 - x;
+			if (layout == PixelLayout::TILED) {
+				run = std::min(run, getTileSize() - (x & (getTileSize() - 1)));
+			}
+			else if (layout == PixelLayout::MORTON) {
+				run = 1;
+			}
+
+			std::memcpy(colorBuffer + BYTES_PER_PIXEL * getStorageIndex(x, y), row, BYTES_PER_PIXEL * run);
+			row += BYTES_PER_PIXEL * run;
+			x += run;
+		}
+	}
+
+} // end writeColorTile
+
+
+void FrameBuffer::clearAccumulationBuffer() {
+
+	std::memset(accumulationBuffer, 0, sizeof(float) * FLOATS_PER_ACCUMULATED_PIXEL * storedPixelCount);
+
+} // end clearAccumulationBuffer
+
+
+void FrameBuffer::setToneMapping(ToneMapping toneMapping, float exposure, float gamma) {
+
+	this->toneMapping = toneMapping;
+	this->exposure = exposure;
+	this->gamma = gamma;
+
+	gammaTable.clear();
+	if (gamma != 1.0f) {
+
+		gammaTable.resize(GAMMA_TABLE_SIZE);
+		for (int i = 0; i < GAMMA_TABLE_SIZE; i++) {
+			gammaTable[i] = (unsigned char)(std::pow(i / float(GAMMA_TABLE_SIZE - 1), 1.0f / gamma) * 255.0f);
+		}
+	}
+
+} // end setToneMapping
+
+
+void FrameBuffer::resolve() {
+
+	resolve(0, 0, window.width, window.height);
+
+} // end resolve
+
+
+void FrameBuffer::resolve(const int xStart, const int yStart, const int xEnd, const int yEnd) {
+
+	static const ResolveKernel kernel = getResolveKernel();
+	ResolveSettings settings = getResolveSettings(toneMapping, exposure, gammaTable);
+
+	int x0 = std::max(xStart, 0);
+	int x1 = std::min(xEnd, window.width);
+	int y0 = std::max(yStart, 0);
+	int y1 = std::min(yEnd, window.height);
+
+	if (x0 >= x1 || y0 >= y1) {
+		return;
+	}
+
+	if (layout != PixelLayout::LINEAR) {
+		for (int tileY = y0 >> tileShift; tileY <= (y1 - 1) >> tileShift; tileY++) {
+			for (int tileX = x0 >> tileShift; tileX <= (x1 - 1) >> tileShift; tileX++) {
+				if (streamWriter == nullptr) {
+					resolveTile(tileX, tileY, x0, y0, x1, y1);
+					continue;
+				}
+
+				// Tiles that were never written are not in memory
+				if (tileSlots[(size_t)tileY * tilesAcross + tileX] >= 0) {
+					resolveTile(tileX, tileY, x0, y0, x1, y1);
+
+					int columns = std::min(x1, (tileX + 1) << tileShift) - std::max(x0, tileX << tileShift);
+					int rows = std::min(y1, (tileY + 1) << tileShift) - std::max(y0, tileY << tileShift);
+					releaseResolvedPixels(tileX, tileY, columns * rows);
+				}
+			}
+		}
+		return;
+	}
+
+	for (int y = y0; y < y1; y++) {
+
+		size_t first = (size_t)y * window.width + x0;
+		kernel(accumulationBuffer + FLOATS_PER_ACCUMULATED_PIXEL * first, colorBuffer + BYTES_PER_PIXEL * first,
+			   x1 - x0, settings);
+	}
+
+} // end resolve
+
+
+void FrameBuffer::resolveTile(const int tileX, const int tileY, const int xStart, const int yStart,
+							  const int xEnd, const int yEnd) {
+
+	static const ResolveKernel kernel = getResolveKernel();
+	ResolveSettings settings = getResolveSettings(toneMapping, exposure, gammaTable);
+
+	int tileSize = getTileSize();
+	int tileX0 = tileX << tileShift;
+	int tileY0 = tileY << tileShift;
+	int tileX1 = std::min(tileX0 + tileSize, window.width);
+	int tileY1 = std::min(tileY0 + tileSize, window.height);
+
+	// Parts of the tile outside of the window have no samples, so they belong
+	// to the block as well
+	if (xStart <= tileX0 && tileX1 <= xEnd && yStart <= tileY0 && tileY1 <= yEnd) {
+
+		size_t first = getStorageIndex(tileX0, tileY0);
+		kernel(accumulationBuffer + FLOATS_PER_ACCUMULATED_PIXEL * first, colorBuffer + BYTES_PER_PIXEL * first,
+			   tileSize * tileSize, settings);
+		return;
+	}
+
+	// Other blocks own pixels of the tile. The kernel writes the pixels of a
+	// run and nothing else, so runs are limited to pixels of this block.
+	int x0 = std::max(xStart, tileX0);
+	int x1 = std::min(xEnd, tileX1);
+	for (int y = std::max(yStart, tileY0); y < std::min(yEnd, tileY1); y++) {
+
+		if (layout == PixelLayout::TILED) {
+			size_t first = getStorageIndex(x0, y);
+			kernel(accumulationBuffer + FLOATS_PER_ACCUMULATED_PIXEL * first, colorBuffer + BYTES_PER_PIXEL * first,
+				   x1 - x0, settings);
+			continue;
+		}
+
+		for (int x = x0; x < x1; x++) {
+			size_t index = getStorageIndex(x, y);
+			kernel(accumulationBuffer + FLOATS_PER_ACCUMULATED_PIXEL * index, colorBuffer + BYTES_PER_PIXEL * index,
+				   1, settings);
+		}
+	}
+
+} // end resolveTile
+
+
 /**
 * Returns the stored RGBA color valute for an individual pixel position
 * in the color buffer. Origin (0,0) is the lower left hand corner
@@ -140,25 +771,24 @@ void FrameBuffer::setPixel(const int x, const int y, const color & rgba) {
 */
 color FrameBuffer::getPixel(const int x, const int y)
 {
-	if (checkInWindow(x, y) == true) {
+	if (checkStored(x, y) == true) {
 
-		GLubyte c[BYTES_PER_PIXEL];
+		unsigned char c[BYTES_PER_PIXEL];
 
 		// Retrieve color values from the color buffer
-		std::memcpy(c, colorBuffer + BYTES_PER_PIXEL * (x + y * window.width), BYTES_PER_PIXEL);
+		std::memcpy(c, colorBuffer + BYTES_PER_PIXEL * getStorageIndex(x, y), BYTES_PER_PIXEL);
 
 		// Convert individual color components back to floating point values
-		double red = c[0]/ 255.0;
-		double green = c[1] / 255.0;
-		double blue = c[2] / 255.0;
-		double alpha = c[3] / 255.0;
+		real red = c[0]/ 255.0;
+		real green = c[1] / 255.0;
+		real blue = c[2] / 255.0;
 
-		return color(red, green, blue, alpha);
+		return color(red, green, blue);
 
 	}
 	else {
 
-		return color(clearColor[0] / 255.0, clearColor[1] / 255.0, clearColor[2] / 255.0, clearColor[3] / 255.0 );
+		return color(clearColor[0] / 255.0, clearColor[1] / 255.0, clearColor[2] / 255.0 );
 	}
 
 } // end getPixel
@@ -179,7 +809,7 @@ void FrameBuffer::setDepth(const float x, const float y, const float depth) {
 */
 void FrameBuffer::setDepth(const int x, const int y, const float depth) {
 
-	if (checkInWindow(x, y)) {
+	if (checkInWindow(x, y) && depthBuffer != nullptr) {
 
 		depthBuffer[y * window.width + x] = depth;
 	}
@@ -191,7 +821,7 @@ void FrameBuffer::setDepth(const int x, const int y, const float depth) {
 */
 float FrameBuffer::getDepth(const int x, const int y) {
 
-	if (checkInWindow(x, y)) {
+	if (checkInWindow(x, y) && depthBuffer != nullptr) {
 
 		return depthBuffer[y * window.width + x];
 	}
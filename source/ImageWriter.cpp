@@ -0,0 +1,192 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <fstream>
+#include <stdint.h>
+
+/**
+* Copies the red, green, and blue values of the pixels into rows that start at
+* the top of the window. Every row is preceded by rowPrefix bytes set to zero.
+*/
+static std::vector<unsigned char> getRGBRows( const FrameBuffer & frameBuffer, int rowPrefix )
+{
+	int width = frameBuffer.getWindowWidth( );
+	int height = frameBuffer.getWindowHeight( );
+	const unsigned char * pixels = frameBuffer.getColorBuffer( );
+
+	std::vector<unsigned char> rows( (size_t)( rowPrefix + 3 * width ) * height, 0 );
+	unsigned char * out = rows.data( );
+
+	for( int y = height - 1; y >= 0; y-- ) {
+
+		out += rowPrefix;
+
+		const unsigned char * in = pixels + (size_t)y * width * BYTES_PER_PIXEL;
+		for( int x = 0; x < width; x++ ) {
+			*out++ = in[0];
+			*out++ = in[1];
+			*out++ = in[2];
+			in += BYTES_PER_PIXEL;
+		}
+	}
+
+	return rows;
+
+} // end getRGBRows
+
+
+bool writePPM( const FrameBuffer & frameBuffer, const string & fileName )
+{
+	std::ofstream file( fileName.c_str( ), std::ios::binary );
+
+	if( !file ) {
+		return false;
+	}
+
+	std::vector<unsigned char> rows = getRGBRows( frameBuffer, 0 );
+
+	file << "P6\n" << frameBuffer.getWindowWidth( ) << " " << frameBuffer.getWindowHeight( ) << "\n255\n";
+	file.write( (const char *)rows.data( ), rows.size( ) );
+
+	return file.good( );
+
+} // end writePPM
+
+
+/**
+* Cyclic redundancy check used by PNG chunks.
+*/
+static uint32_t crc32( const unsigned char * data, size_t length, uint32_t crc = 0 )
+{
+	// Built by the first call. The initialization of a local static is safe
+	// when several threads write images at once.
+	static const std::array<uint32_t, 256> table = []( ) {
+		std::array<uint32_t, 256> entries;
+		for( uint32_t n = 0; n < 256; n++ ) {
+			uint32_t c = n;
+			for( int k = 0; k < 8; k++ ) {
+				c = ( c & 1 ) ? 0xEDB88320u ^ ( c >> 1 ) : c >> 1;
+			}
+			entries[n] = c;
+		}
+		return entries;
+	}( );
+
+	crc = ~crc;
+	for( size_t i = 0; i < length; i++ ) {
+		crc = table[( crc ^ data[i] ) & 0xFF] ^ ( crc >> 8 );
+	}
+	return ~crc;
+
+} // end crc32
+
+
+/**
+* Appends a 32 bit value with the most significant byte first.
+*/
+static void appendBigEndian( std::vector<unsigned char> & bytes, uint32_t value )
+{
+	bytes.push_back( (unsigned char)( value >> 24 ) );
+	bytes.push_back( (unsigned char)( value >> 16 ) );
+	bytes.push_back( (unsigned char)( value >> 8 ) );
+	bytes.push_back( (unsigned char)value );
+
+} // end appendBigEndian
+
+
+/**
+* Writes a PNG chunk: length, type, data, and the CRC of the type and data.
+*/
+static void writeChunk( std::ofstream & file, const char * type, const std::vector<unsigned char> & data )
+{
+	std::vector<unsigned char> chunk;
+	appendBigEndian( chunk, (uint32_t)data.size( ) );
+	chunk.insert( chunk.end( ), type, type + 4 );
+	chunk.insert( chunk.end( ), data.begin( ), data.end( ) );
+	appendBigEndian( chunk, crc32( chunk.data( ) + 4, chunk.size( ) - 4 ) );
+
+	file.write( (const char *)chunk.data( ), chunk.size( ) );
+
+} // end writeChunk
+
+
+bool writePNG( const FrameBuffer & frameBuffer, const string & fileName )
+{
+	std::ofstream file( fileName.c_str( ), std::ios::binary );
+
+	if( !file ) {
+		return false;
+	}
+
+	static const unsigned char signature[] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	file.write( (const char *)signature, sizeof( signature ) );
+
+	// Width, height, 8 bits per sample, RGB, deflate, adaptive filtering, no interlace
+	std::vector<unsigned char> header;
+	appendBigEndian( header, (uint32_t)frameBuffer.getWindowWidth( ) );
+	appendBigEndian( header, (uint32_t)frameBuffer.getWindowHeight( ) );
+	header.push_back( 8 );
+	header.push_back( 2 );
+	header.push_back( 0 );
+	header.push_back( 0 );
+	header.push_back( 0 );
+	writeChunk( file, "IHDR", header );
+
+	// Every row starts with filter type zero (none)
+	std::vector<unsigned char> rows = getRGBRows( frameBuffer, 1 );
+
+	// zlib stream made of uncompressed deflate blocks of at most 65535 bytes
+	std::vector<unsigned char> data;
+	data.push_back( 0x78 );
+	data.push_back( 0x01 );
+
+	size_t offset = 0;
+	do {
+		size_t length = std::min( rows.size( ) - offset, (size_t)65535 );
+		bool last = offset + length == rows.size( );
+
+		data.push_back( last ? 1 : 0 );
+		data.push_back( (unsigned char)length );
+		data.push_back( (unsigned char)( length >> 8 ) );
+		data.push_back( (unsigned char)~length );
+		data.push_back( (unsigned char)( ~length >> 8 ) );
+		data.insert( data.end( ), rows.begin( ) + offset, rows.begin( ) + offset + length );
+
+		offset += length;
+
+	} while( offset < rows.size( ) );
+
+	uint32_t a = 1, b = 0;
+	for( size_t i = 0; i < rows.size( ); i++ ) {
+		a = ( a + rows[i] ) % 65521;
+		b = ( b + a ) % 65521;
+	}
+	appendBigEndian( data, ( b << 16 ) | a );
+
+	writeChunk( file, "IDAT", data );
+	writeChunk( file, "IEND", std::vector<unsigned char>( ) );
+
+	return file.good( );
+
+} // end writePNG
+
+
+bool writeImage( const FrameBuffer & frameBuffer, const string & fileName )
+{
+	size_t dot = fileName.find_last_of( '.' );
+	string extension = dot == string::npos ? "" : fileName.substr( dot + 1 );
+
+	for( size_t i = 0; i < extension.size( ); i++ ) {
+		extension[i] = (char)tolower( extension[i] );
+	}
+
+	if( extension == "png" ) {
+		return writePNG( frameBuffer, fileName );
+	}
+	else {
+		return writePPM( frameBuffer, fileName );
+	}
+
+} // end writeImage
@@ -0,0 +1,126 @@
+#include "MappedFile.h"
+
+#if defined( __unix__ ) || defined( __APPLE__ )
+#define RAYTRACER_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+
+MappedFile::MappedFile( MappedFile && other )
+	: data( other.data ), size( other.size ), buffer( std::move( other.buffer ) )
+{
+	other.data = nullptr;
+	other.size = 0;
+
+} // end MappedFile move constructor
+
+
+MappedFile & MappedFile::operator=( MappedFile && other )
+{
+	if( this != &other ) {
+
+		close( );
+
+		data = other.data;
+		size = other.size;
+		buffer = std::move( other.buffer );
+
+		other.data = nullptr;
+		other.size = 0;
+	}
+
+	return *this;
+
+} // end operator=
+
+
+#ifdef RAYTRACER_HAS_MMAP
+
+bool MappedFile::open( const string & fileName )
+{
+	close( );
+
+	int descriptor = ::open( fileName.c_str( ), O_RDONLY );
+	if( descriptor < 0 ) {
+		return false;
+	}
+
+	struct stat status;
+	if( fstat( descriptor, &status ) != 0 || status.st_size <= 0 ) {
+		::close( descriptor );
+		return false;
+	}
+
+	void * mapping = mmap( nullptr, static_cast<size_t>( status.st_size ), PROT_READ, MAP_PRIVATE, descriptor, 0 );
+
+	// The mapping stays valid after the descriptor is closed
+	::close( descriptor );
+
+	if( mapping == MAP_FAILED ) {
+		return false;
+	}
+
+	data = static_cast<const unsigned char *>( mapping );
+	size = static_cast<size_t>( status.st_size );
+	return true;
+
+} // end open
+
+
+void MappedFile::close( )
+{
+	if( data != nullptr ) {
+		munmap( const_cast<unsigned char *>( data ), size );
+	}
+
+	data = nullptr;
+	size = 0;
+
+} // end close
+
+#else
+
+bool MappedFile::open( const string & fileName )
+{
+	close( );
+
+	std::ifstream file( fileName.c_str( ), std::ios::binary | std::ios::ate );
+	if( !file ) {
+		return false;
+	}
+
+	std::streamoff length = file.tellg( );
+	if( length <= 0 ) {
+		return false;
+	}
+
+	buffer.resize( static_cast<size_t>( length ) );
+	file.seekg( 0 );
+	if( !file.read( reinterpret_cast<char *>( buffer.data( ) ), length ) ) {
+		buffer.clear( );
+		return false;
+	}
+
+	data = buffer.data( );
+	size = buffer.size( );
+	return true;
+
+} // end open
+
+
+void MappedFile::close( )
+{
+	buffer.clear( );
+	buffer.shrink_to_fit( );
+
+	data = nullptr;
+	size = 0;
+
+} // end close
+
+#endif // RAYTRACER_HAS_MMAP
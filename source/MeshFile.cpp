@@ -0,0 +1,156 @@
+#include "MeshFile.h"
+
+#include <cstring>
+#include <fstream>
+
+
+bool getMeshData( const unsigned char * data, size_t size, MeshData & mesh )
+{
+	if( data == nullptr || size < sizeof( MeshFileHeader ) ) {
+		return false;
+	}
+
+	MeshFileHeader header;
+	memcpy( &header, data, sizeof( header ) );
+
+	if( memcmp( header.magic, MESH_FILE_MAGIC, sizeof( header.magic ) ) != 0 ||
+		header.version != MESH_FILE_VERSION ) {
+		return false;
+	}
+
+	// Sizes are computed in 64 bits so that a corrupt header cannot overflow them
+	uint64_t positionBytes = uint64_t( header.vertexCount ) * 3 * sizeof( float );
+	uint64_t indexBytes = uint64_t( header.triangleCount ) * 3 * sizeof( uint32_t );
+
+	if( sizeof( MeshFileHeader ) + positionBytes + indexBytes > size ) {
+		return false;
+	}
+
+	mesh.positions = reinterpret_cast<const float *>( data + sizeof( MeshFileHeader ) );
+	mesh.indices = reinterpret_cast<const uint32_t *>( data + sizeof( MeshFileHeader ) + positionBytes );
+	mesh.vertexCount = header.vertexCount;
+	mesh.triangleCount = header.triangleCount;
+	return true;
+
+} // end getMeshData
+
+
+bool writeMeshFile( const string & fileName, const std::vector<float> & positions,
+					const std::vector<uint32_t> & indices )
+{
+	std::ofstream file( fileName.c_str( ), std::ios::binary );
+
+	if( !file ) {
+		return false;
+	}
+
+	MeshFileHeader header;
+	memcpy( header.magic, MESH_FILE_MAGIC, sizeof( header.magic ) );
+	header.version = MESH_FILE_VERSION;
+	header.vertexCount = static_cast<uint32_t>( positions.size( ) / 3 );
+	header.triangleCount = static_cast<uint32_t>( indices.size( ) / 3 );
+	header.reserved = 0;
+
+	file.write( (const char *)&header, sizeof( header ) );
+	file.write( (const char *)positions.data( ), header.vertexCount * 3 * sizeof( float ) );
+	file.write( (const char *)indices.data( ), header.triangleCount * 3 * sizeof( uint32_t ) );
+
+	return file.good( );
+
+} // end writeMeshFile
+
+
+/**
+* Reads the vertex index at the start of a face corner such as "7", "7/2",
+* "7//3", or "-1/2/3". Negative indices count back from the last vertex read.
+* @return false if there is no index or the vertex does not exist
+*/
+static bool parseCorner( const char * & cursor, size_t vertexCount, uint32_t & index )
+{
+	char * end;
+	long value = strtol( cursor, &end, 10 );
+	if( end == cursor ) {
+		return false;
+	}
+
+	// Skip the texture coordinate and normal indices
+	cursor = end;
+	while( *cursor != '\0' && *cursor != ' ' && *cursor != '\t' ) {
+		cursor++;
+	}
+
+	long long resolved = value > 0 ? value - 1 : static_cast<long long>( vertexCount ) + value;
+	if( value == 0 || resolved < 0 || resolved >= static_cast<long long>( vertexCount ) ) {
+		return false;
+	}
+
+	index = static_cast<uint32_t>( resolved );
+	return true;
+
+} // end parseCorner
+
+
+bool readObjFile( const string & fileName, std::vector<float> & positions,
+				  std::vector<uint32_t> & indices )
+{
+	std::ifstream file( fileName.c_str( ) );
+
+	if( !file ) {
+		return false;
+	}
+
+	positions.clear( );
+	indices.clear( );
+
+	string line;
+	std::vector<uint32_t> face;
+
+	while( std::getline( file, line ) ) {
+
+		const char * cursor = line.c_str( );
+		while( *cursor == ' ' || *cursor == '\t' ) {
+			cursor++;
+		}
+
+		if( cursor[0] == 'v' && ( cursor[1] == ' ' || cursor[1] == '\t' ) ) {
+
+			char * end;
+			cursor += 2;
+			for( int i = 0; i < 3; i++ ) {
+				positions.push_back( strtof( cursor, &end ) );
+				cursor = end;
+			}
+		}
+		else if( cursor[0] == 'f' && ( cursor[1] == ' ' || cursor[1] == '\t' ) ) {
+
+			cursor += 2;
+			face.clear( );
+
+			for( ;; ) {
+
+				while( *cursor == ' ' || *cursor == '\t' || *cursor == '\r' ) {
+					cursor++;
+				}
+				if( *cursor == '\0' ) {
+					break;
+				}
+
+				uint32_t index;
+				if( !parseCorner( cursor, positions.size( ) / 3, index ) ) {
+					return false;
+				}
+				face.push_back( index );
+			}
+
+			// Fan around the first corner
+			for( size_t i = 2; i < face.size( ); i++ ) {
+				indices.push_back( face[0] );
+				indices.push_back( face[i - 1] );
+				indices.push_back( face[i] );
+			}
+		}
+	}
+
+	return true;
+
+} // end readObjFile
@@ -3,12 +3,12 @@
 /**
 * Constructor for the Plane.
 */
-Plane::Plane(const dvec3 & point, const dvec3 & normal, const color & material)
+Plane::Plane(const vec3 & point, const vec3 & normal, const color & material)
 	: Surface(material), a(point), n(normalize(normal))
 {
 }
 
-Plane::Plane(std::vector<dvec3> vertices, const color & material)
+Plane::Plane(std::vector<vec3> vertices, const color & material)
 	: Surface(material)
 {
 	a = vertices[0];
@@ -17,24 +17,63 @@ Plane::Plane(std::vector<dvec3> vertices, const color & material)
 }
 
 /*
-* Checks a ray for intersection with the surface. Finds the closest point of intersection
-* if one exits. Returns a HitRecord with the t parmeter set to FLT_MAX if there is no
-* intersection.
+* Finds the parameter, t, of the point where the ray crosses the plane. Returns
+* false if the ray is parallel to the plane or the crossing is not within [tMin, tMax).
 */
-HitRecord Plane::findClosestIntersection( const Ray & ray )
+bool Plane::intersect( const Ray & ray, real tMin, real tMax, RayHit & hit ) const
 {
-	HitRecord hitRecord;
+    return Plane::intersectFromOrigin(ray, Plane::computeOriginTerm(ray.origin), tMin, tMax, hit);
 
-    if (glm::dot(ray.direct, n) == 0) return hitRecord;
-    
-    hitRecord.t = glm::dot(a - ray.origin, n) / glm::dot(ray.direct, n);
+} // end intersect
 
-    if (hitRecord.t < 0) hitRecord.t = FLT_MAX;
-    
-    hitRecord.interceptPoint = ray.origin + hitRecord.t * ray.direct;
-    hitRecord.material = material;
-	
-    return hitRecord;
 
-} // end findClosestIntersection
+/*
+* Distance from the origin to the plane along the normal. The parameter of the
+* crossing is this distance divided by the cosine between the ray and the normal.
+*/
+real Plane::computeOriginTerm( const vec3 & origin ) const
+{
+    return glm::dot(a - origin, n);
+
+} // end computeOriginTerm
+
+
+bool Plane::intersectFromOrigin( const Ray & ray, real originTerm, real tMin, real tMax, RayHit & hit ) const
+{
+    real denominator = glm::dot(ray.direct, n);
+
+    if (denominator == 0) return false;
+
+    real t = originTerm / denominator;
+
+    if (t < tMin || t >= tMax) return false;
+
+    hit.t = t;
+    hit.element = 0;
+    return true;
+
+} // end intersectFromOrigin
+
+
+/*
+* Computes the point of intersection and a normal that faces the ray for a hit
+* found by intersect.
+*/
+void Plane::completeHitRecord( const Ray & ray, const RayHit & hit, HitRecord & hitRecord ) const
+{
+    hitRecord.t = hit.t;
+    hitRecord.interceptPoint = ray.origin + hit.t * ray.direct;
+
+    // Face the normal toward the ray so that both sides are lit and reflect
+    hitRecord.surfaceNormal = glm::dot(ray.direct, n) > 0 ? -n : n;
+    hitRecord.material = &material;
+
+} // end completeHitRecord
+
+
+BoundingBox Plane::bounds( ) const
+{
+	return BoundingBox::infinite( );
+
+} // end bounds
 
@@ -0,0 +1,533 @@
+#include "QuadricSet.h"
+
+#include <algorithm>
+
+// Quadrics per leaf of the hierarchy. Two groups of lanes per leaf.
+static const int MAX_LEAF_SIZE = 2 * QuadricSet::LANE_GROUP_SIZE;
+
+
+/*
+* Reference kernel. Also used on processors without SSE2 or AVX2. Follows
+* QuadricSurface::intersect.
+*/
+template <bool AxisAligned>
+static bool intersectScalar( const QuadricSet::Lanes & lanes, int begin, int end, const Ray & ray,
+							 double tMin, double & tMax, int & hitSlot, bool anyHit )
+{
+	const dvec3 Rd( ray.direct );
+
+	bool found = false;
+
+	for( int slot = begin; slot < end; slot++ ) {
+
+		dvec3 Ro( ray.origin.x - lanes.centerX[slot], ray.origin.y - lanes.centerY[slot], ray.origin.z - lanes.centerZ[slot] );
+
+		double A = lanes.A[slot], B = lanes.B[slot], C = lanes.C[slot];
+
+		double Aq = A * ( Rd.x * Rd.x ) + B * ( Rd.y * Rd.y ) + C * ( Rd.z * Rd.z );
+		double Bq = 2 * ( A * Ro.x * Rd.x + B * Ro.y * Rd.y + C * Ro.z * Rd.z );
+		double Cq = A * ( Ro.x * Ro.x ) + B * ( Ro.y * Ro.y ) + C * ( Ro.z * Ro.z ) + lanes.J[slot];
+
+		if( !AxisAligned ) {
+
+			double D = lanes.D[slot], E = lanes.E[slot], F = lanes.F[slot];
+			double G = lanes.G[slot], H = lanes.H[slot], I = lanes.I[slot];
+
+			Aq += D * ( Rd.x * Rd.y ) + E * ( Rd.x * Rd.z ) + F * ( Rd.y * Rd.z );
+			Bq += D * ( Ro.x * Rd.y + Ro.y * Rd.x ) + E * ( Ro.x * Rd.z + Ro.z * Rd.x ) +
+				  F * ( Ro.y * Rd.z + Ro.z * Rd.y ) + G * Rd.x + H * Rd.y + I * Rd.z;
+			Cq += D * ( Ro.x * Ro.y ) + E * ( Ro.x * Ro.z ) + F * ( Ro.y * Ro.z ) + G * Ro.x + H * Ro.y + I * Ro.z;
+		}
+
+		double roots[2];
+
+		if( Aq == 0 ) {
+
+			roots[0] = roots[1] = -Cq / Bq;
+		}
+		else {
+
+			double discriminant = Bq * Bq - 4 * Aq * Cq;
+			if( discriminant < 0 ) {
+				continue;
+			}
+
+			double tMid = -Bq / ( 2 * Aq );
+			double halfWidth = sqrt( discriminant / ( 4 * Aq * Aq ) );
+			roots[0] = tMid - halfWidth;
+			roots[1] = tMid + halfWidth;
+		}
+
+		for( double t : roots ) {
+
+			if( !( t >= tMin && t < tMax ) ) {
+				continue;
+			}
+
+			tMax = t;
+			hitSlot = slot;
+			found = true;
+
+			if( anyHit ) {
+				return true;
+			}
+			break;
+		}
+	}
+
+	return found;
+
+} // end intersectScalar
+
+
+#ifdef RAYTRACER_X86_SIMD
+
+/*
+* Selects b where the mask is set and a elsewhere. SSE2 has no blend instruction.
+*/
+static inline __m128d selectSse2( __m128d a, __m128d b, __m128d mask )
+{
+	return _mm_or_pd( _mm_and_pd( mask, b ), _mm_andnot_pd( mask, a ) );
+
+} // end selectSse2
+
+
+/*
+* Tests two quadrics per instruction.
+*/
+template <bool AxisAligned>
+static bool intersectSse2( const QuadricSet::Lanes & lanes, int begin, int end, const Ray & ray,
+						   double tMin, double & tMax, int & hitSlot, bool anyHit )
+{
+	const __m128d originX = _mm_set1_pd( ray.origin.x );
+	const __m128d originY = _mm_set1_pd( ray.origin.y );
+	const __m128d originZ = _mm_set1_pd( ray.origin.z );
+	const __m128d RdX = _mm_set1_pd( ray.direct.x );
+	const __m128d RdY = _mm_set1_pd( ray.direct.y );
+	const __m128d RdZ = _mm_set1_pd( ray.direct.z );
+	const __m128d RdXX = _mm_set1_pd( ray.direct.x * ray.direct.x );
+	const __m128d RdYY = _mm_set1_pd( ray.direct.y * ray.direct.y );
+	const __m128d RdZZ = _mm_set1_pd( ray.direct.z * ray.direct.z );
+	const __m128d start = _mm_set1_pd( tMin );
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d two = _mm_set1_pd( 2.0 );
+	const __m128d four = _mm_set1_pd( 4.0 );
+
+	bool found = false;
+
+	for( int slot = begin; slot < end; slot += 2 ) {
+
+		__m128d RoX = _mm_sub_pd( originX, _mm_loadu_pd( &lanes.centerX[slot] ) );
+		__m128d RoY = _mm_sub_pd( originY, _mm_loadu_pd( &lanes.centerY[slot] ) );
+		__m128d RoZ = _mm_sub_pd( originZ, _mm_loadu_pd( &lanes.centerZ[slot] ) );
+
+		__m128d A = _mm_loadu_pd( &lanes.A[slot] );
+		__m128d B = _mm_loadu_pd( &lanes.B[slot] );
+		__m128d C = _mm_loadu_pd( &lanes.C[slot] );
+
+		__m128d ARoX = _mm_mul_pd( A, RoX );
+		__m128d BRoY = _mm_mul_pd( B, RoY );
+		__m128d CRoZ = _mm_mul_pd( C, RoZ );
+
+		__m128d Aq = _mm_add_pd( _mm_add_pd( _mm_mul_pd( A, RdXX ), _mm_mul_pd( B, RdYY ) ), _mm_mul_pd( C, RdZZ ) );
+		__m128d Bq = _mm_mul_pd( two, _mm_add_pd( _mm_add_pd( _mm_mul_pd( ARoX, RdX ), _mm_mul_pd( BRoY, RdY ) ),
+												  _mm_mul_pd( CRoZ, RdZ ) ) );
+		__m128d Cq = _mm_add_pd( _mm_add_pd( _mm_add_pd( _mm_mul_pd( ARoX, RoX ), _mm_mul_pd( BRoY, RoY ) ),
+											 _mm_mul_pd( CRoZ, RoZ ) ),
+								 _mm_loadu_pd( &lanes.J[slot] ) );
+
+		if( !AxisAligned ) {
+
+			__m128d D = _mm_loadu_pd( &lanes.D[slot] );
+			__m128d E = _mm_loadu_pd( &lanes.E[slot] );
+			__m128d F = _mm_loadu_pd( &lanes.F[slot] );
+			__m128d G = _mm_loadu_pd( &lanes.G[slot] );
+			__m128d H = _mm_loadu_pd( &lanes.H[slot] );
+			__m128d I = _mm_loadu_pd( &lanes.I[slot] );
+
+			Aq = _mm_add_pd( Aq, _mm_add_pd( _mm_add_pd( _mm_mul_pd( D, _mm_mul_pd( RdX, RdY ) ),
+														 _mm_mul_pd( E, _mm_mul_pd( RdX, RdZ ) ) ),
+											 _mm_mul_pd( F, _mm_mul_pd( RdY, RdZ ) ) ) );
+
+			__m128d crossTerms = _mm_add_pd( _mm_add_pd(
+				_mm_mul_pd( D, _mm_add_pd( _mm_mul_pd( RoX, RdY ), _mm_mul_pd( RoY, RdX ) ) ),
+				_mm_mul_pd( E, _mm_add_pd( _mm_mul_pd( RoX, RdZ ), _mm_mul_pd( RoZ, RdX ) ) ) ),
+				_mm_mul_pd( F, _mm_add_pd( _mm_mul_pd( RoY, RdZ ), _mm_mul_pd( RoZ, RdY ) ) ) );
+			__m128d linearTerms = _mm_add_pd( _mm_add_pd( _mm_mul_pd( G, RdX ), _mm_mul_pd( H, RdY ) ), _mm_mul_pd( I, RdZ ) );
+			Bq = _mm_add_pd( Bq, _mm_add_pd( crossTerms, linearTerms ) );
+
+			crossTerms = _mm_add_pd( _mm_add_pd( _mm_mul_pd( D, _mm_mul_pd( RoX, RoY ) ), _mm_mul_pd( E, _mm_mul_pd( RoX, RoZ ) ) ),
+									 _mm_mul_pd( F, _mm_mul_pd( RoY, RoZ ) ) );
+			linearTerms = _mm_add_pd( _mm_add_pd( _mm_mul_pd( G, RoX ), _mm_mul_pd( H, RoY ) ), _mm_mul_pd( I, RoZ ) );
+			Cq = _mm_add_pd( Cq, _mm_add_pd( crossTerms, linearTerms ) );
+		}
+
+		// Lanes in which Aq is zero have a single root at -Cq / Bq
+		__m128d linear = _mm_cmpeq_pd( Aq, zero );
+		__m128d discriminant = _mm_sub_pd( _mm_mul_pd( Bq, Bq ), _mm_mul_pd( four, _mm_mul_pd( Aq, Cq ) ) );
+
+		__m128d hit = _mm_or_pd( linear, _mm_cmpge_pd( discriminant, zero ) );
+		if( _mm_movemask_pd( hit ) == 0 ) {
+			continue;
+		}
+
+		__m128d tMid = _mm_div_pd( _mm_sub_pd( zero, Bq ), _mm_mul_pd( two, Aq ) );
+		__m128d halfWidth = _mm_sqrt_pd( _mm_div_pd( _mm_max_pd( discriminant, zero ), _mm_mul_pd( four, _mm_mul_pd( Aq, Aq ) ) ) );
+		__m128d linearRoot = _mm_div_pd( _mm_sub_pd( zero, Cq ), Bq );
+
+		__m128d nearT = selectSse2( _mm_sub_pd( tMid, halfWidth ), linearRoot, linear );
+		__m128d farT = selectSse2( _mm_add_pd( tMid, halfWidth ), linearRoot, linear );
+
+		__m128d limit = _mm_set1_pd( tMax );
+		__m128d acceptNear = _mm_and_pd( hit, _mm_and_pd( _mm_cmpge_pd( nearT, start ), _mm_cmplt_pd( nearT, limit ) ) );
+		__m128d acceptFar = _mm_and_pd( hit, _mm_and_pd( _mm_cmpge_pd( farT, start ), _mm_cmplt_pd( farT, limit ) ) );
+
+		int mask = _mm_movemask_pd( _mm_or_pd( acceptNear, acceptFar ) );
+		if( mask == 0 ) {
+			continue;
+		}
+
+		double tLanes[2];
+		_mm_storeu_pd( tLanes, selectSse2( farT, nearT, acceptNear ) );
+
+		for( int lane = 0; lane < 2; lane++ ) {
+
+			if( ( mask & ( 1 << lane ) ) && tLanes[lane] < tMax ) {
+
+				tMax = tLanes[lane];
+				hitSlot = slot + lane;
+				found = true;
+
+				if( anyHit ) {
+					return true;
+				}
+			}
+		}
+	}
+
+	return found;
+
+} // end intersectSse2
+
+
+/*
+* Tests four quadrics per instruction. Compiled for AVX2 regardless of the
+* compiler flags and only called when the processor supports it.
+*/
+template <bool AxisAligned>
+__attribute__(( target( "avx2" ) ))
+static bool intersectAvx2( const QuadricSet::Lanes & lanes, int begin, int end, const Ray & ray,
+						   double tMin, double & tMax, int & hitSlot, bool anyHit )
+{
+	const __m256d originX = _mm256_set1_pd( ray.origin.x );
+	const __m256d originY = _mm256_set1_pd( ray.origin.y );
+	const __m256d originZ = _mm256_set1_pd( ray.origin.z );
+	const __m256d RdX = _mm256_set1_pd( ray.direct.x );
+	const __m256d RdY = _mm256_set1_pd( ray.direct.y );
+	const __m256d RdZ = _mm256_set1_pd( ray.direct.z );
+	const __m256d RdXX = _mm256_set1_pd( ray.direct.x * ray.direct.x );
+	const __m256d RdYY = _mm256_set1_pd( ray.direct.y * ray.direct.y );
+	const __m256d RdZZ = _mm256_set1_pd( ray.direct.z * ray.direct.z );
+	const __m256d start = _mm256_set1_pd( tMin );
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d two = _mm256_set1_pd( 2.0 );
+	const __m256d four = _mm256_set1_pd( 4.0 );
+
+	bool found = false;
+
+	for( int slot = begin; slot < end; slot += 4 ) {
+
+		__m256d RoX = _mm256_sub_pd( originX, _mm256_loadu_pd( &lanes.centerX[slot] ) );
+		__m256d RoY = _mm256_sub_pd( originY, _mm256_loadu_pd( &lanes.centerY[slot] ) );
+		__m256d RoZ = _mm256_sub_pd( originZ, _mm256_loadu_pd( &lanes.centerZ[slot] ) );
+
+		__m256d A = _mm256_loadu_pd( &lanes.A[slot] );
+		__m256d B = _mm256_loadu_pd( &lanes.B[slot] );
+		__m256d C = _mm256_loadu_pd( &lanes.C[slot] );
+
+		__m256d ARoX = _mm256_mul_pd( A, RoX );
+		__m256d BRoY = _mm256_mul_pd( B, RoY );
+		__m256d CRoZ = _mm256_mul_pd( C, RoZ );
+
+		__m256d Aq = _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( A, RdXX ), _mm256_mul_pd( B, RdYY ) ), _mm256_mul_pd( C, RdZZ ) );
+		__m256d Bq = _mm256_mul_pd( two, _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( ARoX, RdX ), _mm256_mul_pd( BRoY, RdY ) ),
+														_mm256_mul_pd( CRoZ, RdZ ) ) );
+		__m256d Cq = _mm256_add_pd( _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( ARoX, RoX ), _mm256_mul_pd( BRoY, RoY ) ),
+												   _mm256_mul_pd( CRoZ, RoZ ) ),
+									_mm256_loadu_pd( &lanes.J[slot] ) );
+
+		if( !AxisAligned ) {
+
+			__m256d D = _mm256_loadu_pd( &lanes.D[slot] );
+			__m256d E = _mm256_loadu_pd( &lanes.E[slot] );
+			__m256d F = _mm256_loadu_pd( &lanes.F[slot] );
+			__m256d G = _mm256_loadu_pd( &lanes.G[slot] );
+			__m256d H = _mm256_loadu_pd( &lanes.H[slot] );
+			__m256d I = _mm256_loadu_pd( &lanes.I[slot] );
+
+			Aq = _mm256_add_pd( Aq, _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( D, _mm256_mul_pd( RdX, RdY ) ),
+																  _mm256_mul_pd( E, _mm256_mul_pd( RdX, RdZ ) ) ),
+												   _mm256_mul_pd( F, _mm256_mul_pd( RdY, RdZ ) ) ) );
+
+			__m256d crossTerms = _mm256_add_pd( _mm256_add_pd(
+				_mm256_mul_pd( D, _mm256_add_pd( _mm256_mul_pd( RoX, RdY ), _mm256_mul_pd( RoY, RdX ) ) ),
+				_mm256_mul_pd( E, _mm256_add_pd( _mm256_mul_pd( RoX, RdZ ), _mm256_mul_pd( RoZ, RdX ) ) ) ),
+				_mm256_mul_pd( F, _mm256_add_pd( _mm256_mul_pd( RoY, RdZ ), _mm256_mul_pd( RoZ, RdY ) ) ) );
+			__m256d linearTerms = _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( G, RdX ), _mm256_mul_pd( H, RdY ) ),
+												 _mm256_mul_pd( I, RdZ ) );
+			Bq = _mm256_add_pd( Bq, _mm256_add_pd( crossTerms, linearTerms ) );
+
+			crossTerms = _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( D, _mm256_mul_pd( RoX, RoY ) ),
+													   _mm256_mul_pd( E, _mm256_mul_pd( RoX, RoZ ) ) ),
+										_mm256_mul_pd( F, _mm256_mul_pd( RoY, RoZ ) ) );
+			linearTerms = _mm256_add_pd( _mm256_add_pd( _mm256_mul_pd( G, RoX ), _mm256_mul_pd( H, RoY ) ),
+										 _mm256_mul_pd( I, RoZ ) );
+			Cq = _mm256_add_pd( Cq, _mm256_add_pd( crossTerms, linearTerms ) );
+		}
+
+		// Lanes in which Aq is zero have a single root at -Cq / Bq
+		__m256d linear = _mm256_cmp_pd( Aq, zero, _CMP_EQ_OQ );
+		__m256d discriminant = _mm256_sub_pd( _mm256_mul_pd( Bq, Bq ), _mm256_mul_pd( four, _mm256_mul_pd( Aq, Cq ) ) );
+
+		__m256d hit = _mm256_or_pd( linear, _mm256_cmp_pd( discriminant, zero, _CMP_GE_OQ ) );
+		if( _mm256_movemask_pd( hit ) == 0 ) {
+			continue;
+		}
+
+		__m256d tMid = _mm256_div_pd( _mm256_sub_pd( zero, Bq ), _mm256_mul_pd( two, Aq ) );
+		__m256d halfWidth = _mm256_sqrt_pd( _mm256_div_pd( _mm256_max_pd( discriminant, zero ),
+														   _mm256_mul_pd( four, _mm256_mul_pd( Aq, Aq ) ) ) );
+		__m256d linearRoot = _mm256_div_pd( _mm256_sub_pd( zero, Cq ), Bq );
+
+		__m256d nearT = _mm256_blendv_pd( _mm256_sub_pd( tMid, halfWidth ), linearRoot, linear );
+		__m256d farT = _mm256_blendv_pd( _mm256_add_pd( tMid, halfWidth ), linearRoot, linear );
+
+		__m256d limit = _mm256_set1_pd( tMax );
+		__m256d acceptNear = _mm256_and_pd( hit, _mm256_and_pd( _mm256_cmp_pd( nearT, start, _CMP_GE_OQ ),
+															  _mm256_cmp_pd( nearT, limit, _CMP_LT_OQ ) ) );
+		__m256d acceptFar = _mm256_and_pd( hit, _mm256_and_pd( _mm256_cmp_pd( farT, start, _CMP_GE_OQ ),
+															 _mm256_cmp_pd( farT, limit, _CMP_LT_OQ ) ) );
+
+		int mask = _mm256_movemask_pd( _mm256_or_pd( acceptNear, acceptFar ) );
+		if( mask == 0 ) {
+			continue;
+		}
+
+		double tLanes[4];
+		_mm256_storeu_pd( tLanes, _mm256_blendv_pd( farT, nearT, acceptNear ) );
+
+		for( int lane = 0; lane < 4; lane++ ) {
+
+			if( ( mask & ( 1 << lane ) ) && tLanes[lane] < tMax ) {
+
+				tMax = tLanes[lane];
+				hitSlot = slot + lane;
+				found = true;
+
+				if( anyHit ) {
+					return true;
+				}
+			}
+		}
+	}
+
+	return found;
+
+} // end intersectAvx2
+
+#endif // RAYTRACER_X86_SIMD
+
+
+QuadricSet::QuadricSet( const std::vector<std::shared_ptr<QuadricSurface>> & quadrics, ThreadPool * threadPool )
+	: Surface( Material() ), quadrics( quadrics ),
+	  generalKernel( getKernel( getSimdLevel(), false ) ), axisAlignedKernel( getKernel( getSimdLevel(), true ) )
+{
+	// Quadrics with a finite box go into the hierarchy. The rest are tested
+	// against every ray.
+	std::vector<int> boundedQuadrics;
+	std::vector<int> unboundedQuadrics;
+	std::vector<BoundingBox> quadricBounds;
+
+	for( size_t i = 0; i < quadrics.size(); i++ ) {
+
+		BoundingBox box = quadrics[i]->bounds();
+
+		if( box.isFinite() ) {
+			boundedQuadrics.push_back( static_cast<int>( i ) );
+			quadricBounds.push_back( box );
+		}
+		else {
+			unboundedQuadrics.push_back( static_cast<int>( i ) );
+		}
+	}
+
+	bvh.build( quadricBounds, threadPool, MAX_LEAF_SIZE );
+
+	unboundedSlots = appendSlots( unboundedQuadrics.data(), static_cast<int>( unboundedQuadrics.size() ) );
+
+	// Lay the leaves out in the order of the primitive index list, which keeps
+	// quadrics that are close in space close in memory.
+	const std::vector<BVH::Node> & nodes = bvh.getNodes();
+	const std::vector<int> & primitiveIndices = bvh.getPrimitiveIndices();
+
+	std::vector<const BVH::Node *> leaves;
+	for( const BVH::Node & node : nodes ) {
+		if( node.isLeaf() ) {
+			leaves.push_back( &node );
+		}
+	}
+	std::sort( leaves.begin(), leaves.end(), []( const BVH::Node * a, const BVH::Node * b ) {
+		return a->firstIndex < b->firstIndex;
+	} );
+
+	leafSlots.assign( primitiveIndices.size(), SlotRange() );
+
+	for( const BVH::Node * leaf : leaves ) {
+
+		int leafQuadrics[MAX_LEAF_SIZE];
+		for( int i = 0; i < leaf->primitiveCount; i++ ) {
+			leafQuadrics[i] = boundedQuadrics[primitiveIndices[leaf->firstIndex + i]];
+		}
+
+		leafSlots[leaf->firstIndex] = appendSlots( leafQuadrics, leaf->primitiveCount );
+	}
+
+} // end QuadricSet constructor
+
+
+QuadricSet::Kernel QuadricSet::getKernel( SimdLevel level, bool axisAligned )
+{
+#ifdef RAYTRACER_X86_SIMD
+	if( level == SimdLevel::AVX2 ) {
+		return axisAligned ? intersectAvx2<true> : intersectAvx2<false>;
+	}
+	if( level == SimdLevel::SSE2 ) {
+		return axisAligned ? intersectSse2<true> : intersectSse2<false>;
+	}
+#endif
+	return axisAligned ? intersectScalar<true> : intersectScalar<false>;
+
+} // end getKernel
+
+
+QuadricSet::SlotRange QuadricSet::appendSlots( const int * quadricIndices, int count )
+{
+	SlotRange range;
+	range.begin = static_cast<int>( lanes.quadric.size() );
+	range.end = range.begin + ( count + LANE_GROUP_SIZE - 1 ) / LANE_GROUP_SIZE * LANE_GROUP_SIZE;
+
+	for( int slot = range.begin; slot < range.end; slot++ ) {
+
+		int index = slot - range.begin < count ? quadricIndices[slot - range.begin] : -1;
+
+		if( index >= 0 ) {
+
+			const QuadricSurface & q = *quadrics[index];
+
+			lanes.centerX.push_back( q.center.x );
+			lanes.centerY.push_back( q.center.y );
+			lanes.centerZ.push_back( q.center.z );
+			lanes.A.push_back( q.A );
+			lanes.B.push_back( q.B );
+			lanes.C.push_back( q.C );
+			lanes.D.push_back( q.D );
+			lanes.E.push_back( q.E );
+			lanes.F.push_back( q.F );
+			lanes.G.push_back( q.G );
+			lanes.H.push_back( q.H );
+			lanes.I.push_back( q.I );
+			lanes.J.push_back( q.J );
+
+			if( q.D != 0 || q.E != 0 || q.F != 0 || q.G != 0 || q.H != 0 || q.I != 0 ) {
+				range.axisAligned = false;
+			}
+		}
+		else {
+
+			// 0 = 1 has no solutions, so padding is never hit
+			lanes.centerX.push_back( 0.0 );
+			lanes.centerY.push_back( 0.0 );
+			lanes.centerZ.push_back( 0.0 );
+			lanes.A.push_back( 0.0 );
+			lanes.B.push_back( 0.0 );
+			lanes.C.push_back( 0.0 );
+			lanes.D.push_back( 0.0 );
+			lanes.E.push_back( 0.0 );
+			lanes.F.push_back( 0.0 );
+			lanes.G.push_back( 0.0 );
+			lanes.H.push_back( 0.0 );
+			lanes.I.push_back( 0.0 );
+			lanes.J.push_back( 1.0 );
+		}
+
+		lanes.quadric.push_back( index );
+	}
+
+	return range;
+
+} // end appendSlots
+
+
+/*
+* Checks a ray for intersection with every quadric in the collection. Finds the
+* parameter of the closest point of intersection within [tMin, tMax) if one exits.
+*/
+bool QuadricSet::intersect( const Ray & ray, real tMin, real tMax, RayHit & hit ) const
+{
+	int hitSlot = -1;
+	double limit = tMax;
+
+	intersectSlots( unboundedSlots, ray, tMin, limit, hitSlot, false );
+	tMax = static_cast<real>( limit );
+
+	bvh.traverseLeaves( ray, tMin, tMax, [&]( const BVH::Node & leaf, real & tMax ) {
+
+		intersectSlots( leafSlots[leaf.firstIndex], ray, tMin, limit, hitSlot, false );
+		tMax = static_cast<real>( limit );
+		return false;
+	} );
+
+	if( hitSlot < 0 ) {
+		return false;
+	}
+
+	hit.t = static_cast<real>( limit );
+	hit.element = lanes.quadric[hitSlot];
+	return true;
+
+} // end intersect
+
+
+void QuadricSet::completeHitRecord( const Ray & ray, const RayHit & hit, HitRecord & hitRecord ) const
+{
+	quadrics[hit.element]->completeHitRecord( ray, hit, hitRecord );
+
+} // end completeHitRecord
+
+
+bool QuadricSet::occludes( const Ray & ray, real tMin, real tMax ) const
+{
+	int hitSlot;
+	double limit = tMax;
+
+	if( intersectSlots( unboundedSlots, ray, tMin, limit, hitSlot, true ) ) {
+		return true;
+	}
+
+	return bvh.traverseLeaves( ray, tMin, tMax, [&]( const BVH::Node & leaf, real & ) {
+
+		return intersectSlots( leafSlots[leaf.firstIndex], ray, tMin, limit, hitSlot, true );
+	} );
+
+} // end occludes
+
+
+BoundingBox QuadricSet::bounds( ) const
+{
+	if( unboundedSlots.end > unboundedSlots.begin ) {
+		return BoundingBox::infinite();
+	}
+
+	return bvh.getBounds();
+
+} // end bounds
@@ -1,7 +1,7 @@
 #include "QuadricSurface.h"
 
 
-QuadricSurface::QuadricSurface( const dvec3 & position, const color & mat )
+QuadricSurface::QuadricSurface( const vec3 & position, const color & mat )
 	: Surface( mat ), center( position )
 {
 	// Sphere
@@ -42,107 +42,168 @@ QuadricSurface::QuadricSurface( const dvec3 & position, const color & mat )
 
 }
 
-QuadricSurface::QuadricSurface( const dvec3 & position, const Material & mat )
+QuadricSurface::QuadricSurface( const vec3 & position, const Material & mat )
 	: Surface( mat ), center( position )
 {}
 
 /*
-* Checks a ray for intersection with the surface. Finds the closest point of intersection
-* if one exits. Returns a HitRecord with the t parmeter set to FLT_MAX if there is no
-* intersection.
+* Finds the parameter, t, of the closest point of intersection within the
+* interval [tMin, tMax). Returns false if there is no intersection in it.
 */
-HitRecord QuadricSurface::findClosestIntersection( const Ray & ray ) 
+bool QuadricSurface::intersect( const Ray & ray, real tMin, real tMax, RayHit & hit ) const
 {
-	HitRecord hitRecord; 
+	return QuadricSurface::intersectFromOrigin( ray, QuadricSurface::computeOriginTerm( ray.origin ), tMin, tMax, hit );
 
-	dvec3 Ro = ray.origin - center;
-	dvec3 Rd = ray.direct;
+} // end intersect
+
+
+/*
+* The constant term, Cq, of the quadratic equation in t. It is the quadric
+* equation evaluated at the origin of the ray.
+*/
+real QuadricSurface::computeOriginTerm( const vec3 & origin ) const
+{
+	vec3 Ro = origin - center;
+
+	return A * (Ro.x * Ro.x) + B * (Ro.y * Ro.y) + C * (Ro.z * Ro.z) +
+		   D * (Ro.x * Ro.y) + E * (Ro.x * Ro.z) + F * (Ro.y * Ro.z) +
+		   G * Ro.x + H * Ro.y + I * Ro.z + J;
+
+} // end computeOriginTerm
+
+
+bool QuadricSurface::intersectFromOrigin( const Ray & ray, real originTerm, real tMin, real tMax,
+										  RayHit & hit ) const
+{
+	vec3 Ro = ray.origin - center;
+	vec3 Rd = ray.direct;
 
 	// After substituting the parametric form of the ray, Ro + t* Rd, into the 
 	// generalized form of the quadratic equation for a quadric surface the equation
 	// reduces to Aq(tt) + Bq(t) + Cq where
 
-	double Aq = A * (Rd.x*Rd.x) + B * (Rd.y*Rd.y) + C * (Rd.z*Rd.z) + 
+	real Aq = A * (Rd.x*Rd.x) + B * (Rd.y*Rd.y) + C * (Rd.z*Rd.z) + 
 			   D * (Rd.x * Rd.y) + E * (Rd.x * Rd.z) + F * (Rd.y * Rd.z);
 
-	double Bq = (2 * A * Ro.x*Rd.x) + (2 * B * Ro.y*Rd.y) + (2 * C * Ro.z*Rd.z) +
+	real Bq = (2 * A * Ro.x*Rd.x) + (2 * B * Ro.y*Rd.y) + (2 * C * Ro.z*Rd.z) +
 			   D * (Ro.x * Rd.y + Ro.y * Rd.x) + 
 			   E * (Ro.x * Rd.z + Ro.z * Rd.x) + 
 			   F * (Ro.y * Rd.z + Ro.z * Rd.y) +
 			   G * Rd.x + H * Rd.y + I * Rd.z;
 
-	double Cq = A * (Ro.x * Ro.x) + B * (Ro.y * Ro.y) + C * (Ro.z * Ro.z) +
-			   D * (Ro.x * Ro.y) + E * (Ro.x * Ro.z) + F * (Ro.y * Ro.z) +
-			   G * Ro.x + H * Ro.y + I * Ro.z + J; 
+	real Cq = originTerm;
 	
 	// The quadratic equation in the form (-Bq +/- sqrt(Bq*Bq-4 * Aq * Cq))/(2*Aq) is 
 	// used to solve for the parameter t..
 
 	//  Part of the quadratic equation under the square root sign
-	double discriminant = Bq * Bq - 4 * Aq * Cq;
+	real discriminant = Bq * Bq - 4 * Aq * Cq;
 	 
 	// Check if there are any real (non-imaginary) roots to the equation
-	if (discriminant >= 0) {
+	if (discriminant < 0) {
 
-		// Initialize parameter for the point of intersection to largest float possible
-		double t = FLT_MAX; 
+		return false;
+	}
 
-		// Does the ray just graze the surface intersecting at only one point?
-		if (Aq == 0) {
+	// Initialize parameter for the point of intersection to largest float possible
+	real t = FLT_MAX; 
 
-			t = -Cq / Bq; // Set parameter, t, for the point of intersection
+	// Does the ray just graze the surface intersecting at only one point?
+	if (Aq == 0) {
 
-		} 
-		else {
+		t = -Cq / Bq; // Set parameter, t, for the point of intersection
 
-			// Use quadratic equation to solve for the closest of the two roots.
-			double t0 = (-Bq - sqrt(discriminant)) / (2 * Aq);
+	} 
+	else {
 
-			// Is closest point of intersection on the ray or on the negative side of 
-			// Ro on a geometric line described by Ro + t* Rd?
-			if (t0 > 0) {
+		// The roots lie sqrt(discriminant) / (2 * Aq) on either side of the
+		// midpoint. Comparing squared distances rejects surfaces that are hit
+		// only outside the interval without taking the square root.
+		real tMid = -Bq / (2 * Aq);
+		real halfWidthSquared = discriminant / (4 * Aq * Aq);
 
-				t = t0;
-			}
-			else {
+		real beyondMax = tMid - tMax;
+		if (beyondMax >= 0 && beyondMax * beyondMax >= halfWidthSquared) {
 
-				// Use quadratic equation to solve for the second closest of the two roots.
-				t = (-Bq + sqrt(discriminant)) / (2 * Aq);
-			}
+			return false;
 		}
 
-		if (t < 0) {
-			// Set parameter, t, in the hit record to indicate "no intersection."
-			hitRecord.t = FLT_MAX;
-			return hitRecord;
+		real beforeMin = tMin - tMid;
+		if (beforeMin > 0 && beforeMin * beforeMin > halfWidthSquared) {
+
+			return false;
 		}
 
-		// Calculate the point of intersection using the parameter t
-		dvec3 Ri = Ro + t * Rd;
-		
-		// Find the normal vector of the surface at the point of intersection
-		// using partial derivativex with respect to x, y, and z
-		dvec3 Rn;
-		Rn.x = 2 * A * Ri.x + D * Ri.y + E * Ri.z + G;
-		Rn.y = 2 * B * Ri.y + D * Ri.x + F * Ri.z + H;
-		Rn.z = 2 * C * Ri.z + E * Ri.x + F * Ri.y + I;
-
-		// Check if the intersection with the inside or back of the surface
-		if (glm::dot(Rn, Rd) > 0) { Rn = -Rn; }
-
-		// Set hit record information about the intersetion.
-		hitRecord.t = t;
-		hitRecord.interceptPoint = Ri + center;
-		hitRecord.surfaceNormal = normalize( Rn );
-		hitRecord.material = material;
+		// Use quadratic equation to solve for the closest of the two roots.
+		real halfWidth = sqrt(halfWidthSquared);
+
+		// Is closest point of intersection inside the interval or before its
+		// start on a geometric line described by Ro + t* Rd?
+		t = tMid - halfWidth;
+
+		if (t < tMin) {
+
+			// Use the second closest of the two roots.
+			t = tMid + halfWidth;
+		}
 	}
-	else {
 
-		// Set parameter, t, in the hit record to indicate "no intersection."
-		hitRecord.t = FLT_MAX;
+	if (t < tMin || t >= tMax) {
+
+		return false;
 	}
 
-	return hitRecord;
+	hit.t = t;
+	hit.element = 0;
+	return true;
+
+} // end intersectFromOrigin
+
+
+/*
+* Computes the point of intersection and the normal from the gradient of the
+* quadric equation for a hit found by intersect.
+*/
+void QuadricSurface::completeHitRecord( const Ray & ray, const RayHit & hit, HitRecord & hitRecord ) const
+{
+	real t = hit.t;
+	vec3 Rd = ray.direct;
+
+	// Calculate the point of intersection using the parameter t
+	vec3 Ri = (ray.origin - center) + t * Rd;
+	
+	// Find the normal vector of the surface at the point of intersection
+	// using partial derivativex with respect to x, y, and z
+	vec3 Rn;
+	Rn.x = 2 * A * Ri.x + D * Ri.y + E * Ri.z + G;
+	Rn.y = 2 * B * Ri.y + D * Ri.x + F * Ri.z + H;
+	Rn.z = 2 * C * Ri.z + E * Ri.x + F * Ri.y + I;
+
+	// Check if the intersection with the inside or back of the surface
+	if (glm::dot(Rn, Rd) > 0) { Rn = -Rn; }
+
+	// Set hit record information about the intersetion.
+	hitRecord.t = t;
+	hitRecord.interceptPoint = Ri + center;
+	hitRecord.surfaceNormal = normalize( Rn );
+	hitRecord.material = &material;
+
+} // end completeHitRecord
+
+
+BoundingBox QuadricSurface::bounds( ) const
+{
+	bool axisAligned = D == 0 && E == 0 && F == 0 && G == 0 && H == 0 && I == 0;
+
+	if( axisAligned && A > 0 && B > 0 && C > 0 && J < 0 ) {
+
+		// Ax2 + By2 + Cz2 = -J reaches its largest x when y and z are zero
+		vec3 halfExtent( sqrt( -J / A ), sqrt( -J / B ), sqrt( -J / C ) );
+		return BoundingBox( center - halfExtent, center + halfExtent );
+	}
+
+	return BoundingBox::infinite( );
+
+} // end bounds
 
-} // end checkIntercept
 
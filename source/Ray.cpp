@@ -6,14 +6,18 @@ HitRecord findIntersection(const Ray & ray, const SurfaceVector & surfaces)
 {
     HitRecord closest = HitRecord();
     closest.t = FLT_MAX;
-    HitRecord curHR;
-    for(auto surface : surfaces) {
-        curHR = surface->findClosestIntersection(ray);
-        
-        if (curHR.t < closest.t) {
-            closest = curHR;
+    RayHit closestHit;
+    const Surface * closestSurface = nullptr;
+    for(const auto & surface : surfaces) {
+        if (surface->intersect(ray, 0.0, closestHit.t, closestHit)) {
+            closestSurface = surface.get();
         }
     }
 
+    // Only the closest hit is turned into a full hit record
+    if (closestSurface != nullptr) {
+        closestSurface->completeHitRecord(ray, closestHit, closest);
+    }
+
     return closest;
 }
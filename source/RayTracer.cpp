@@ -1,5 +1,9 @@
 #include "RayTracer.h"
 
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
 
 RayTracer::RayTracer(FrameBuffer & cBuffer, color defaultColor )
 :colorBuffer(cBuffer), defaultColor(defaultColor), recursionDepth(2)
@@ -8,103 +12,940 @@ RayTracer::RayTracer(FrameBuffer & cBuffer, color defaultColor )
 }
 
 
-void RayTracer::setCameraFrame(const dvec3 & viewPosition, const dvec3 & viewingDirection, dvec3 up)
+void RayTracer::setCameraFrame(const vec3 & viewPosition, const vec3 & viewingDirection, vec3 up)
 {
 
-//    eye = viewPosition;
+    eye = viewPosition;
 
     w = glm::normalize(-viewingDirection);
     u = glm::normalize(glm::cross(up, w));
     v = glm::normalize(glm::cross(w, u));
+
+    invalidateFrame();
 } // end setCameraFrame
 
 
-void RayTracer::calculatePerspectiveViewingParameters(const double & verticalFieldOfViewDegrees)
+void RayTracer::calculatePerspectiveViewingParameters(const real & verticalFieldOfViewDegrees)
 {
 
-    double verticalFOV = glm::radians(verticalFieldOfViewDegrees / 2.0);
+    real verticalFOV = glm::radians(verticalFieldOfViewDegrees / 2.0);
     
     distToPlane = 1 / glm::tan(verticalFOV );
     topLimit = distToPlane * tan(verticalFOV );
-	rightLimit = topLimit * ((double)colorBuffer.getWindowWidth()/colorBuffer.getWindowHeight());
+	rightLimit = topLimit * ((real)colorBuffer.getWindowWidth()/colorBuffer.getWindowHeight());
     leftLimit = -rightLimit;
     bottomLimit = -topLimit;
-	nx = (double)colorBuffer.getWindowWidth();
-	ny = (double)colorBuffer.getWindowHeight();
+	nx = (real)colorBuffer.getWindowWidth();
+	ny = (real)colorBuffer.getWindowHeight();
 	renderPerspectiveView = true; // generate perspective view rays
+	invalidateFrame();
 	
 } // end calculatePerspectiveViewingParameters
 
 
-void RayTracer::calculateOrthographicViewingParameters(const double & viewPlaneHeight)
+void RayTracer::calculateOrthographicViewingParameters(const real & viewPlaneHeight)
 {
 	topLimit = fabs(viewPlaneHeight) / 2.0;
 
-	rightLimit = topLimit * ((double)colorBuffer.getWindowWidth()/colorBuffer.getWindowHeight()); // Set r based on aspect ratio and height of plane
+	rightLimit = topLimit * ((real)colorBuffer.getWindowWidth()/colorBuffer.getWindowHeight()); // Set r based on aspect ratio and height of plane
 
 	// Make view plane symetrical about the viewing direction
 	leftLimit = -rightLimit; 
 	bottomLimit = -topLimit;
 
 	// Calculate the distance between pixels in the horizontal and vertical directions
-	nx = (double)colorBuffer.getWindowWidth();
-	ny = (double)colorBuffer.getWindowHeight();
+	nx = (real)colorBuffer.getWindowWidth();
+	ny = (real)colorBuffer.getWindowHeight();
 
 	distToPlane = 0.0; // Rays start on the view plane
 
 	renderPerspectiveView = false; // generate orthographic view rays
+	invalidateFrame();
 	
 } // end calculateOrthographicViewingParameters
 
 
-void RayTracer::raytraceScene(const SurfaceVector & surfaces, const LightVector & lights)
+void RayTracer::commitScene(const SurfaceVector & surfaces, const LightVector & lights, const BVH * hierarchy)
 {
 	this->surfacesInScene = surfaces;
 	this->lightsInScene = lights;
 
-	// Iterate through each and every pixel in the rendering window
-    
-    for(int i = 0; i < colorBuffer.getWindowWidth(); i ++) {
-        for(int j = 0; j < colorBuffer.getWindowHeight(); j++) {
-            Ray ray;
-            renderPerspectiveView == true ? ray = getPerspectiveViewRay(i, j) : ray = getOrthoViewRay(i, j); 
-            colorBuffer.setPixel(i, j, traceIndividualRay(ray, recursionDepth));
+	scene.build(surfacesInScene, lightsInScene, &threadPool, hierarchy);
+
+} // end commitScene
+
+
+void RayTracer::raytraceScene(const SurfaceVector & surfaces, const LightVector & lights)
+{
+	// Comparing the lists compares the pointers they hold
+	if (scene.getVersion() == 0 || surfaces != surfacesInScene || lights != lightsInScene) {
+		commitScene(surfaces, lights);
+	}
+
+	raytraceScene();
+
+} // end raytraceScene
+
+
+void RayTracer::raytraceScene()
+{
+	raytraceRegion(0, 0, colorBuffer.getWindowWidth(), colorBuffer.getWindowHeight());
+	refineFrame(nullptr);
+
+	// Only a whole frame can be shaded again or updated
+	shadingCacheValid = reshadingEnabled && !colorBuffer.isStreaming();
+	shadedVersion = scene.getVersion();
+	dependenciesValid = trackingDependencies && !colorBuffer.isStreaming();
+	dependencyVersion = scene.getVersion();
+
+} // end raytraceScene
+
+
+void RayTracer::setReshadingEnabled(bool enabled)
+{
+	reshadingEnabled = enabled;
+	shadingCacheValid = false;
+
+	if (!enabled) {
+		shadingCache.release();
+	}
+
+} // end setReshadingEnabled
+
+
+bool RayTracer::reshadeScene()
+{
+	int width = colorBuffer.getWindowWidth();
+	int height = colorBuffer.getWindowHeight();
+
+	if (!shadingCacheValid || shadedVersion != scene.getVersion() || colorBuffer.isStreaming() ||
+		shadingCache.getWidth() != width || shadingCache.getHeight() != height ||
+		shadingCache.getLightCount() != (int)scene.getLights().size()) {
+		return false;
+	}
+
+	runTiles(0, 0, width, height, &RayTracer::reshadeTile);
+	return true;
+
+} // end reshadeScene
+
+
+void RayTracer::setDependencyTracking(bool enabled)
+{
+	trackingDependencies = enabled;
+	dependenciesValid = false;
+
+	if (!enabled) {
+		tileDependencies = std::vector<TileDependencies>();
+		dependencyTileSize = 0;
+		dependencyTilesAcross = 0;
+	}
+
+} // end setDependencyTracking
+
+
+int RayTracer::raytraceChanges(const std::vector<int> & changedSurfaces)
+{
+	int width = colorBuffer.getWindowWidth();
+	int height = colorBuffer.getWindowHeight();
+	int taskSize = getTaskSize();
+	int tilesAcross = (width + taskSize - 1) / taskSize;
+	int tilesDown = (height + taskSize - 1) / taskSize;
+
+	bool valid = dependenciesValid && dependencyVersion == scene.getVersion() && !colorBuffer.isStreaming() &&
+				 dependencyTileSize == taskSize && dependencyTilesAcross == tilesAcross &&
+				 (int)tileDependencies.size() == tilesAcross * tilesDown;
+
+	// Primitive indices stay the same as long as the list does and no surface
+	// gains or loses a finite bounding box
+	std::vector<int> changedPrimitives;
+	for (int surface : changedSurfaces) {
+		if (surface < 0 || surface >= (int)surfacesInScene.size()) {
+			valid = false;
+			break;
+		}
+		if (valid) {
+			changedPrimitives.push_back(scene.getPrimitiveIndex(surface));
+		}
+	}
+
+	commitScene(surfacesInScene, lightsInScene);
+
+	for (size_t i = 0; valid && i < changedPrimitives.size(); i++) {
+		valid = scene.getPrimitiveIndex(changedSurfaces[i]) == changedPrimitives[i];
+	}
+
+	if (!valid) {
+		raytraceScene();
+		return -1;
+	}
+
+	std::sort(changedPrimitives.begin(), changedPrimitives.end());
+
+	// Tiles whose rays hit a changed surface where it was
+	std::vector<char> tileMask(tileDependencies.size(), 0);
+	for (size_t tile = 0; tile < tileDependencies.size(); tile++) {
+		const std::vector<int> & primitives = tileDependencies[tile].primitives;
+		for (int primitive : changedPrimitives) {
+			if (std::binary_search(primitives.begin(), primitives.end(), primitive)) {
+				tileMask[tile] = 1;
+				break;
+			}
+		}
+	}
+
+	// Tiles whose rays may reach a changed surface where it is now
+	for (int surface : changedSurfaces) {
+		BoundingBox bounds = surfacesInScene[surface]->bounds();
+
+		int xMin, yMin, xMax, yMax;
+		if (!getScreenBounds(bounds, xMin, yMin, xMax, yMax)) {
+			std::fill(tileMask.begin(), tileMask.end(), 1);
+			break;
+		}
+		for (int tileY = std::max(yMin, 0) / taskSize; tileY <= std::min(yMax, height - 1) / taskSize; tileY++) {
+			for (int tileX = std::max(xMin, 0) / taskSize; tileX <= std::min(xMax, width - 1) / taskSize; tileX++) {
+				tileMask[tileY * tilesAcross + tileX] = 1;
+			}
+		}
+
+		for (size_t tile = 0; tile < tileDependencies.size(); tile++) {
+			if (!tileMask[tile] && mayReach(tileDependencies[tile], bounds)) {
+				tileMask[tile] = 1;
+			}
+		}
+	}
+
+	prepareFrame();
+	runTiles(0, 0, width, height, &RayTracer::recordTile, &tileMask);
+	refineFrame(&tileMask);
+
+	// The traced tiles replaced their records, so the rest still match
+	dependencyVersion = scene.getVersion();
+	if (shadingCacheValid) {
+		shadedVersion = scene.getVersion();
+	}
+
+	return (int)std::count(tileMask.begin(), tileMask.end(), 1);
+
+} // end raytraceChanges
+
+
+void RayTracer::setAdaptiveSampling(int samplesPerSide, real contrastThreshold, real sampleBudget)
+{
+	this->samplesPerSide = std::max(samplesPerSide, 1);
+	this->contrastThreshold = contrastThreshold;
+	this->sampleBudget = std::max(sampleBudget, real(0.0));
+	invalidateFrame();
+
+} // end setAdaptiveSampling
+
+
+void RayTracer::refineFrame(const std::vector<char> * tileMask)
+{
+	supersampledPixelCount = 0;
+
+	if (samplesPerSide <= 1 || colorBuffer.isStreaming()) {
+		return;
+	}
+
+	int width = colorBuffer.getWindowWidth();
+	int height = colorBuffer.getWindowHeight();
+	int taskSize = getTaskSize();
+	int tilesAcross = (width + taskSize - 1) / taskSize;
+	int tilesDown = (height + taskSize - 1) / taskSize;
+
+	tileCandidates.assign((size_t)tilesAcross * tilesDown, std::vector<SampleCandidate>());
+	runTiles(0, 0, width, height, &RayTracer::measureTile, tileMask);
+
+	std::vector<SampleCandidate> candidates;
+	for (std::vector<SampleCandidate> & tile : tileCandidates) {
+		candidates.insert(candidates.end(), tile.begin(), tile.end());
+		tile.clear();
+	}
+
+	// Keep the pixels that differ most when the budget does not cover all of them
+	size_t limit = (size_t)(sampleBudget * width * height / (samplesPerSide * samplesPerSide));
+	if (candidates.size() > limit) {
+		std::nth_element(candidates.begin(), candidates.begin() + limit, candidates.end(),
+						 [](const SampleCandidate & a, const SampleCandidate & b) { return a.contrast > b.contrast; });
+		candidates.resize(limit);
+	}
+
+	std::vector<char> sampleMask(tileCandidates.size(), 0);
+	for (const SampleCandidate & candidate : candidates) {
+		int tile = getTileIndex(candidate.x - candidate.x % taskSize, candidate.y - candidate.y % taskSize);
+		tileCandidates[tile].push_back(candidate);
+		sampleMask[tile] = 1;
+	}
+
+	runTiles(0, 0, width, height, &RayTracer::sampleTile, &sampleMask);
+
+	supersampledPixelCount = (int)candidates.size();
+
+} // end refineFrame
+
+
+int RayTracer::getTileIndex(const int x, const int y) const
+{
+	int taskSize = getTaskSize();
+	int tilesAcross = (colorBuffer.getWindowWidth() + taskSize - 1) / taskSize;
+
+	return y / taskSize * tilesAcross + x / taskSize;
+
+} // end getTileIndex
+
+
+void RayTracer::raytraceRegion(const int xStart, const int yStart, const int xEnd, const int yEnd)
+{
+	// Pixels outside the region keep their records, but the records no longer
+	// match a single frame until raytraceScene finishes one
+	shadingCacheValid = false;
+	dependenciesValid = false;
+
+	prepareFrame();
+
+	bool recording = trackingDependencies && !colorBuffer.isStreaming();
+	runTiles(xStart, yStart, xEnd, yEnd, recording ? &RayTracer::recordTile : &RayTracer::traceTile);
+
+} // end raytraceRegion
+
+
+void RayTracer::prepareFrame()
+{
+	// Points at which many rays of the frame start: the eye for primary rays of
+	// a perspective view and every light with a position for shadow rays. The
+	// terms are only recomputed when the points or the scene have changed.
+	std::vector<vec3> origins;
+	if (renderPerspectiveView) {
+		origins.push_back(eye);
+	}
+#ifndef RAYTRACER_SINGLE_PRECISION
+	// In single precision the terms computed at a distant light are too coarse
+	// to tell a shaded point from the surface it lies on, so shadow rays are
+	// traced from the point instead.
+	for (const LightSource * light : scene.getLights()) {
+		vec3 position;
+		if (light->enabled && light->getPosition(position)) {
+			origins.push_back(position);
+		}
+	}
+#endif
+
+	if (origins != preparedOrigins || scene.getVersion() != preparedVersion) {
+		scene.prepareOrigins(origins);
+		preparedOrigins = origins;
+		preparedVersion = scene.getVersion();
+	}
+
+	if (reshadingEnabled && !colorBuffer.isStreaming()) {
+		int lightCount = (int)scene.getLights().size();
+		if (shadingCache.getWidth() != colorBuffer.getWindowWidth() ||
+			shadingCache.getHeight() != colorBuffer.getWindowHeight() ||
+			shadingCache.getLightCount() != lightCount) {
+			shadingCache.resize(colorBuffer.getWindowWidth(), colorBuffer.getWindowHeight(), lightCount);
+		}
+	}
+
+	if (trackingDependencies && !colorBuffer.isStreaming()) {
+		int taskSize = getTaskSize();
+		int tilesAcross = (colorBuffer.getWindowWidth() + taskSize - 1) / taskSize;
+		int tilesDown = (colorBuffer.getWindowHeight() + taskSize - 1) / taskSize;
+		if (dependencyTileSize != taskSize || dependencyTilesAcross != tilesAcross ||
+			(int)tileDependencies.size() != tilesAcross * tilesDown) {
+			tileDependencies.assign((size_t)tilesAcross * tilesDown, TileDependencies());
+			dependencyTileSize = taskSize;
+			dependencyTilesAcross = tilesAcross;
+		}
+	}
+
+} // end prepareFrame
+
+
+int RayTracer::getTaskSize() const
+{
+	// Tiles of a tiled frame buffer are written and resolved as a whole
+	if (colorBuffer.getPixelLayout() != PixelLayout::LINEAR) {
+		return colorBuffer.getTileSize();
+	}
+	return tileSize;
+
+} // end getTaskSize
+
+
+void RayTracer::runTiles(const int xStart, const int yStart, const int xEnd, const int yEnd,
+						 void (RayTracer::*task)(const int, const int, const int, const int),
+						 const std::vector<char> * tileMask)
+{
+	int x0 = std::max(xStart, 0);
+	int y0 = std::max(yStart, 0);
+	int x1 = std::min(xEnd, colorBuffer.getWindowWidth());
+	int y1 = std::min(yEnd, colorBuffer.getWindowHeight());
+
+	int taskSize = getTaskSize();
+	int tilesAcross = (x1 - x0 + taskSize - 1) / taskSize;
+
+	// Hand out one task per tile. Tiles do not overlap, so every worker
+	// writes to a different set of pixels.
+	bool serial = threadPool.getThreadCount() == 1;
+	for (int y = y0; y < y1; y += taskSize) {
+		for (int x = x0; x < x1; x += taskSize) {
+			if (tileMask != nullptr && !(*tileMask)[(y - y0) / taskSize * tilesAcross + (x - x0) / taskSize]) {
+				continue;
+			}
+			int tileXEnd = std::min(x + taskSize, x1);
+			int tileYEnd = std::min(y + taskSize, y1);
+			if (serial) {
+				(this->*task)(x, y, tileXEnd, tileYEnd);
+			}
+			else {
+				threadPool.submit([this, task, x, y, tileXEnd, tileYEnd] { (this->*task)(x, y, tileXEnd, tileYEnd); });
+			}
+		}
+	}
+	threadPool.wait();
+
+} // end runTiles
+
+
+void RayTracer::traceTile(const int xStart, const int yStart, const int xEnd, const int yEnd)
+{
+    // Primary rays of a perspective view all start at the eye
+    const OriginContext * eyeContext = renderPerspectiveView ? scene.getOriginContext(eye) : nullptr;
+
+    // Colors of the tile, row by row, handed to the frame buffer in one call
+    int tileWidth = xEnd - xStart;
+    std::vector<color> colors((size_t)tileWidth * (yEnd - yStart));
+
+    // Pixels are shaded through the shading cache while it is kept, so that
+    // reshaded frames match traced ones
+    bool caching = reshadingEnabled && !colorBuffer.isStreaming();
+    std::vector<LightTerms> lightTerms;
+
+    if (packetSize == 1 || recursionDepth < 0) {
+        for(int j = yStart; j < yEnd; j++) {
+            for(int i = xStart; i < xEnd; i++) {
+                Ray ray;
+                renderPerspectiveView == true ? ray = getPerspectiveViewRay(i, j) : ray = getOrthoViewRay(i, j); 
+                color & pixel = colors[(j - yStart) * tileWidth + (i - xStart)];
+                if (caching) {
+                    HitRecord closest = scene.findIntersection(ray, 0.0, FLT_MAX, eyeContext);
+                    pixel = shadeCached(i, j, ray, closest, lightTerms);
+                }
+                else {
+                    pixel = traceIndividualRay(ray, recursionDepth, 0.0, eyeContext);
+                }
+            }
         }
+        colorBuffer.writeTile(xStart, yStart, xEnd, yEnd, colors.data());
+        colorBuffer.resolve(xStart, yStart, xEnd, yEnd);
+        return;
     }
-} // end raytraceScene
 
+    RayPacket packet;
+    HitRecord hits[RayPacket::MAX_SIZE];
 
+    // Find the first hits of a square group of pixels at once, then shade the
+    // pixels one at a time. Groups at the edges of the tile may be smaller.
+    for(int j = yStart; j < yEnd; j += packetSize) {
+        for(int i = xStart; i < xEnd; i += packetSize) {
 
-color RayTracer::traceIndividualRay(const Ray & viewRay, int recursionLevel)
+            int width = std::min(packetSize, xEnd - i);
+            int height = std::min(packetSize, yEnd - j);
+
+            getViewRayPacket(i, j, width, height, packet);
+            scene.findIntersections(packet, 0.0, hits, eyeContext);
+
+            for(int lane = 0; lane < packet.size; lane++) {
+                int x = i + lane % width - xStart;
+                int y = j + lane / width - yStart;
+                if (caching) {
+                    colors[y * tileWidth + x] = shadeCached(i + lane % width, j + lane / width, packet.getRay(lane),
+                                                            hits[lane], lightTerms);
+                }
+                else {
+                    colors[y * tileWidth + x] = shadeHit(packet.getRay(lane), hits[lane], recursionDepth);
+                }
+            }
+        }
+    }
+
+    // Convert the tile while its pixels are still in the cache
+    colorBuffer.writeTile(xStart, yStart, xEnd, yEnd, colors.data());
+    colorBuffer.resolve(xStart, yStart, xEnd, yEnd);
+} // end traceTile
+
+
+void RayTracer::recordTile(const int xStart, const int yStart, const int xEnd, const int yEnd)
+{
+    DependencySet dependencies;
+    dependencies.reset(scene.getPrimitiveCount());
+
+    Scene::recordDependencies(&dependencies);
+    traceTile(xStart, yStart, xEnd, yEnd);
+    Scene::recordDependencies(nullptr);
+
+    // Tiles of a region that does not start on the tiles of the frame have
+    // no set of their own. Such regions leave the sets invalid anyway.
+    if (xStart % dependencyTileSize == 0 && yStart % dependencyTileSize == 0) {
+        TileDependencies & tile = tileDependencies[yStart / dependencyTileSize * dependencyTilesAcross +
+                                                   xStart / dependencyTileSize];
+        tile.primitives = dependencies.getSortedIndices();
+        tile.pathBounds = dependencies.getPathBounds();
+        tile.escapeDirections = dependencies.getEscapeDirections();
+    }
+} // end recordTile
+
+
+void RayTracer::measureTile(const int xStart, const int yStart, const int xEnd, const int yEnd)
+{
+    std::vector<SampleCandidate> & candidates = tileCandidates[getTileIndex(xStart, yStart)];
+
+    int width = colorBuffer.getWindowWidth();
+    int height = colorBuffer.getWindowHeight();
+
+    // Colors are compared as they are displayed, so that differences among
+    // components above one do not count
+    auto displayed = [&](int x, int y) {
+        return glm::min(glm::max(colorBuffer.getHdrPixel(x, y), color(0.0)), color(1.0));
+    };
+
+    for(int j = yStart; j < yEnd; j++) {
+        for(int i = xStart; i < xEnd; i++) {
+
+            color center = displayed(i, j);
+            real contrast = 0.0;
+
+            const int neighbors[4][2] = { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } };
+            for (const int * offset : neighbors) {
+                int x = i + offset[0];
+                int y = j + offset[1];
+                if (x >= 0 && x < width && y >= 0 && y < height) {
+                    color difference = glm::abs(center - displayed(x, y));
+                    contrast = std::max(contrast, std::max(difference.r, std::max(difference.g, difference.b)));
+                }
+            }
+
+            if (contrast > contrastThreshold) {
+                candidates.push_back({ i, j, (float)contrast });
+            }
+        }
+    }
+} // end measureTile
+
+
+/**
+* Returns a number in [0, 1) that depends only on a pixel and an index, so
+* that the rays of a pixel are the same in every frame.
+*/
+static real getJitter(const int x, const int y, const int index)
+{
+    unsigned hash = (unsigned)x * 73856093u ^ (unsigned)y * 19349663u ^ (unsigned)index * 83492791u;
+    hash ^= hash >> 16;
+    hash *= 0x7feb352du;
+    hash ^= hash >> 15;
+    hash *= 0x846ca68bu;
+    hash ^= hash >> 16;
+
+    return (hash >> 8) * real(1.0 / 16777216.0);
+
+} // end getJitter
+
+
+void RayTracer::sampleTile(const int xStart, const int yStart, const int xEnd, const int yEnd)
+{
+    const OriginContext * eyeContext = renderPerspectiveView ? scene.getOriginContext(eye) : nullptr;
+
+    bool caching = reshadingEnabled && !colorBuffer.isStreaming();
+    bool tracking = trackingDependencies && !colorBuffer.isStreaming();
+
+    // The extra rays add to the dependencies that the tile already has
+    DependencySet dependencies;
+    if (tracking) {
+        dependencies.reset(scene.getPrimitiveCount());
+        Scene::recordDependencies(&dependencies);
+    }
+
+    int sampleCount = samplesPerSide * samplesPerSide;
+    real weight = real(1.0) / sampleCount;
+    std::vector<LightTerms> lightTerms;
+
+    for (const SampleCandidate & pixel : tileCandidates[getTileIndex(xStart, yStart)]) {
+
+        color total = BLACK;
+        color constant = BLACK;
+        if (caching) {
+            lightTerms.assign(scene.getLights().size(), LightTerms());
+        }
+
+        // One ray through a random point of every cell of a grid over the pixel
+        for (int sample = 0; sample < sampleCount; sample++) {
+            vec2 offset((sample % samplesPerSide + getJitter(pixel.x, pixel.y, 2 * sample)) / samplesPerSide,
+                        (sample / samplesPerSide + getJitter(pixel.x, pixel.y, 2 * sample + 1)) / samplesPerSide);
+            Ray ray = getSampleViewRay(pixel.x, pixel.y, offset);
+
+            if (caching) {
+                HitRecord closest = scene.findIntersection(ray, 0.0, FLT_MAX, eyeContext);
+                accumulateTerms(ray, closest, recursionDepth, weight, lightTerms.data(), constant);
+            }
+            else {
+                total += weight * traceIndividualRay(ray, recursionDepth, 0.0, eyeContext);
+            }
+        }
+
+        // The terms are linear in the samples, so their average reshades the
+        // pixel.
+        if (caching) {
+            shadingCache.store(pixel.x, pixel.y, lightTerms.data(), constant);
+            total = shadingCache.shade(pixel.x, pixel.y, scene.getLights());
+        }
+
+        colorBuffer.setHdrPixel(pixel.x, pixel.y, total);
+    }
+
+    if (tracking) {
+        Scene::recordDependencies(nullptr);
+
+        if (xStart % dependencyTileSize == 0 && yStart % dependencyTileSize == 0) {
+            TileDependencies & tile = tileDependencies[yStart / dependencyTileSize * dependencyTilesAcross +
+                                                       xStart / dependencyTileSize];
+
+            std::vector<int> added = dependencies.getSortedIndices();
+            std::vector<int> primitives;
+            std::set_union(tile.primitives.begin(), tile.primitives.end(), added.begin(), added.end(),
+                           std::back_inserter(primitives));
+            tile.primitives.swap(primitives);
+
+            const std::vector<BoundingBox> & pathBounds = dependencies.getPathBounds();
+            const std::vector<BoundingBox> & escapeDirections = dependencies.getEscapeDirections();
+            if (tile.pathBounds.size() < pathBounds.size()) {
+                tile.pathBounds.resize(pathBounds.size());
+                tile.escapeDirections.resize(pathBounds.size());
+            }
+            for (size_t level = 0; level < pathBounds.size(); level++) {
+                tile.pathBounds[level].expand(pathBounds[level]);
+                tile.escapeDirections[level].expand(escapeDirections[level]);
+            }
+        }
+    }
+
+    colorBuffer.resolve(xStart, yStart, xEnd, yEnd);
+} // end sampleTile
+
+
+bool RayTracer::getScreenBounds(const BoundingBox & box, int & xMin, int & yMin, int & xMax, int & yMax) const
+{
+    if (!box.isFinite()) {
+        return false;
+    }
+
+    // Projection plane coordinates of the corners of the box. The box lies
+    // within the convex hull of its corners on the plane, as long as none of
+    // them is behind the eye.
+    vec2 low(std::numeric_limits<real>::max());
+    vec2 high(-std::numeric_limits<real>::max());
+    for (int corner = 0; corner < 8; corner++) {
+        vec3 point((corner & 1) ? box.maxPoint.x : box.minPoint.x,
+                   (corner & 2) ? box.maxPoint.y : box.minPoint.y,
+                   (corner & 4) ? box.maxPoint.z : box.minPoint.z);
+        vec3 offset = point - eye;
+        vec2 coords(glm::dot(offset, u), glm::dot(offset, v));
+
+        if (renderPerspectiveView) {
+            real depth = -glm::dot(offset, w);
+            if (depth <= EPSILON) {
+                return false;
+            }
+            coords *= distToPlane / depth;
+        }
+        low = glm::min(low, coords);
+        high = glm::max(high, coords);
+    }
+
+    // Pixels whose centers lie within the projection, widened by a pixel and
+    // clamped to just outside the window
+    auto column = [&](real coord) {
+        return (int)glm::clamp(std::floor((coord - leftLimit) / (rightLimit - leftLimit) * nx), real(-2.0), nx + 1);
+    };
+    auto row = [&](real coord) {
+        return (int)glm::clamp(std::floor((coord - bottomLimit) / (topLimit - bottomLimit) * ny), real(-2.0), ny + 1);
+    };
+    xMin = column(low.x) - 1;
+    xMax = column(high.x) + 1;
+    yMin = row(low.y) - 1;
+    yMax = row(high.y) + 1;
+    return true;
+
+} // end getScreenBounds
+
+
+/**
+* Returns true if a segment from a point to the light may pass through a box,
+* for any point in a box of receivers. Both boxes are projected from the light
+* onto a plane facing the receivers, where the segments cover no more than the
+* receivers do, and stop at the receivers.
+*/
+static bool mayShadowFromPoint(const vec3 & light, const BoundingBox & receivers, const BoundingBox & box)
+{
+    vec3 axis = receivers.centroid() - light;
+    if (glm::length(axis) <= EPSILON) {
+        return true;
+    }
+    axis = glm::normalize(axis);
+    vec3 side = glm::normalize(glm::cross(axis, std::abs(axis.x) < 0.9 ? vec3(1, 0, 0) : vec3(0, 1, 0)));
+    vec3 up = glm::cross(axis, side);
+
+    vec2 receiverLow(std::numeric_limits<real>::max()), receiverHigh(-std::numeric_limits<real>::max());
+    vec2 boxLow(std::numeric_limits<real>::max()), boxHigh(-std::numeric_limits<real>::max());
+    real receiverFar = 0.0;
+    real boxNear = std::numeric_limits<real>::max();
+
+    for (int corner = 0; corner < 8; corner++) {
+        vec3 mask((corner & 1) != 0, (corner & 2) != 0, (corner & 4) != 0);
+
+        vec3 offset = glm::mix(receivers.minPoint, receivers.maxPoint, mask) - light;
+        real depth = glm::dot(offset, axis);
+        if (depth <= EPSILON) {
+            return box.overlaps(BoundingBox(glm::min(receivers.minPoint, light), glm::max(receivers.maxPoint, light)));
+        }
+        vec2 coords = vec2(glm::dot(offset, side), glm::dot(offset, up)) / depth;
+        receiverLow = glm::min(receiverLow, coords);
+        receiverHigh = glm::max(receiverHigh, coords);
+        receiverFar = std::max(receiverFar, depth);
+
+        offset = glm::mix(box.minPoint, box.maxPoint, mask) - light;
+        depth = glm::dot(offset, axis);
+        if (depth <= EPSILON) {
+            // The box reaches around the light, where any segment may start
+            return true;
+        }
+        coords = vec2(glm::dot(offset, side), glm::dot(offset, up)) / depth;
+        boxLow = glm::min(boxLow, coords);
+        boxHigh = glm::max(boxHigh, coords);
+        boxNear = std::min(boxNear, depth);
+    }
+
+    return boxNear <= receiverFar && boxLow.x <= receiverHigh.x && receiverLow.x <= boxHigh.x &&
+           boxLow.y <= receiverHigh.y && receiverLow.y <= boxHigh.y;
+
+} // end mayShadowFromPoint
+
+
+/**
+* Returns true if a ray from any point in a box of receivers toward a light
+* without a position may pass through a box. The boxes are projected along
+* the direction of the light.
+*/
+static bool mayShadowFromDirection(const vec3 & direction, const BoundingBox & receivers, const BoundingBox & box)
+{
+    vec3 side = glm::normalize(glm::cross(direction, std::abs(direction.x) < 0.9 ? vec3(1, 0, 0) : vec3(0, 1, 0)));
+    vec3 up = glm::cross(direction, side);
+
+    vec3 receiverLow(std::numeric_limits<real>::max()), receiverHigh(-std::numeric_limits<real>::max());
+    vec3 boxLow(std::numeric_limits<real>::max()), boxHigh(-std::numeric_limits<real>::max());
+
+    for (int corner = 0; corner < 8; corner++) {
+        vec3 mask((corner & 1) != 0, (corner & 2) != 0, (corner & 4) != 0);
+
+        vec3 point = glm::mix(receivers.minPoint, receivers.maxPoint, mask);
+        vec3 coords(glm::dot(point, side), glm::dot(point, up), glm::dot(point, direction));
+        receiverLow = glm::min(receiverLow, coords);
+        receiverHigh = glm::max(receiverHigh, coords);
+
+        point = glm::mix(box.minPoint, box.maxPoint, mask);
+        coords = vec3(glm::dot(point, side), glm::dot(point, up), glm::dot(point, direction));
+        boxLow = glm::min(boxLow, coords);
+        boxHigh = glm::max(boxHigh, coords);
+    }
+
+    // The rays go on without end in the direction of the light
+    return boxHigh.z >= receiverLow.z && boxLow.x <= receiverHigh.x && receiverLow.x <= boxHigh.x &&
+           boxLow.y <= receiverHigh.y && receiverLow.y <= boxHigh.y;
+
+} // end mayShadowFromDirection
+
+
+bool RayTracer::mayReach(const TileDependencies & dependencies, const BoundingBox & box) const
+{
+    size_t levels = dependencies.pathBounds.size();
+
+    for (size_t level = 0; level < levels; level++) {
+
+        const BoundingBox & receivers = dependencies.pathBounds[level];
+        if (receivers.isEmpty()) {
+            continue;
+        }
+
+        // Shadow rays toward every light
+        for (const LightSource * light : scene.getLights()) {
+            vec3 position, direction;
+            if (light->getPosition(position) && mayShadowFromPoint(position, receivers, box)) {
+                return true;
+            }
+            if (light->getDirection(direction) && mayShadowFromDirection(direction, receivers, box)) {
+                return true;
+            }
+        }
+
+        if (level + 1 == levels) {
+            continue;
+        }
+
+        // Reflected rays that hit something lie between the points of the two
+        // levels. Those that hit nothing go on in their directions.
+        BoundingBox reflected = receivers;
+        reflected.expand(dependencies.pathBounds[level + 1]);
+        if (!dependencies.pathBounds[level + 1].isEmpty() && box.overlaps(reflected)) {
+            return true;
+        }
+
+        const BoundingBox & directions = dependencies.escapeDirections[level + 1];
+        if (!directions.isEmpty()) {
+            BoundingBox swept = receivers;
+            for (int axis = 0; axis < 3; axis++) {
+                if (directions.minPoint[axis] < 0) {
+                    swept.minPoint[axis] = -INFINITY;
+                }
+                if (directions.maxPoint[axis] > 0) {
+                    swept.maxPoint[axis] = INFINITY;
+                }
+            }
+            if (box.overlaps(swept)) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+
+} // end mayReach
+
+
+void RayTracer::recordPath(const Ray & viewRay, const HitRecord & closest, int recursionLevel) const
+{
+    DependencySet * dependencies = Scene::getRecordedDependencies();
+
+    if (dependencies != nullptr) {
+        int level = recursionDepth - recursionLevel;
+        if (closest.t < FLT_MAX) {
+            dependencies->addPathPoint(level, closest.interceptPoint);
+        }
+        else if (level > 0) {
+            dependencies->addEscape(level, viewRay.direct);
+        }
+    }
+
+} // end recordPath
+
+
+void RayTracer::reshadeTile(const int xStart, const int yStart, const int xEnd, const int yEnd)
+{
+    int tileWidth = xEnd - xStart;
+    std::vector<color> colors((size_t)tileWidth * (yEnd - yStart));
+
+    for(int j = yStart; j < yEnd; j++) {
+        for(int i = xStart; i < xEnd; i++) {
+            colors[(j - yStart) * tileWidth + (i - xStart)] = shadingCache.shade(i, j, scene.getLights());
+        }
+    }
+
+    colorBuffer.writeTile(xStart, yStart, xEnd, yEnd, colors.data());
+    colorBuffer.resolve(xStart, yStart, xEnd, yEnd);
+} // end reshadeTile
+
+
+color RayTracer::shadeCached(const int x, const int y, const Ray & viewRay, const HitRecord & closest,
+                             std::vector<LightTerms> & lightTerms)
+{
+    lightTerms.assign(scene.getLights().size(), LightTerms());
+    color constant = BLACK;
+
+    accumulateTerms(viewRay, closest, recursionDepth, real(1.0), lightTerms.data(), constant);
+
+    shadingCache.store(x, y, lightTerms.data(), constant);
+    return shadingCache.shade(x, y, scene.getLights());
+
+} // end shadeCached
+
+
+void RayTracer::accumulateTerms(const Ray & viewRay, const HitRecord & closest, int recursionLevel, real weight,
+                                LightTerms * lightTerms, color & constant) const
+{
+    if (recursionLevel < 0) {
+        return;
+    }
+
+    recordPath(viewRay, closest, recursionLevel);
+
+    if (closest.t < FLT_MAX) {
+
+        if (recursionLevel > 0) {
+            Ray reflectRay = Ray(closest.interceptPoint,
+                    glm::reflect(viewRay.direct, closest.surfaceNormal));
+            HitRecord reflected = scene.findIntersection(reflectRay, EPSILON, FLT_MAX);
+            accumulateTerms(reflectRay, reflected, recursionLevel - 1, weight * real(0.3), lightTerms, constant);
+        }
+
+        const std::vector<const LightSource *> & lights = scene.getLights();
+        for (size_t i = 0; i < lights.size(); i++) {
+            LightTerms terms = lights[i]->getTerms(viewRay.direct, closest, scene);
+            lightTerms[i].ambient += weight * terms.ambient;
+            lightTerms[i].diffuse += weight * terms.diffuse;
+            lightTerms[i].specular += weight * terms.specular;
+            lightTerms[i].constant += weight * terms.constant;
+
+            // shadeHit adds the emission once per light, enabled or not
+            constant += weight * closest.material->emissiveColor;
+        }
+    }
+    else {
+        constant += weight * defaultColor;
+    }
+
+} // end accumulateTerms
+
+
+
+color RayTracer::traceIndividualRay(const Ray & viewRay, int recursionLevel, real tMin,
+                                    const OriginContext * context) const
 {
     if (recursionLevel < 0) {
         return BLACK;
     }
     HitRecord closest = HitRecord();
-    closest = findIntersection(viewRay, surfacesInScene);
+    closest = scene.findIntersection(viewRay, tMin, FLT_MAX, context);
+
+    return shadeHit(viewRay, closest, recursionLevel);
+
+} // end traceRay
+
+
+color RayTracer::shadeHit(const Ray & viewRay, const HitRecord & closest, int recursionLevel) const
+{
+    recordPath(viewRay, closest, recursionLevel);
 
     if (closest.t < FLT_MAX) {
         color total = BLACK;
-        Ray reflectRay = Ray(closest.interceptPoint + (EPSILON * closest.surfaceNormal), 
+        Ray reflectRay = Ray(closest.interceptPoint, 
                 glm::reflect(viewRay.direct, closest.surfaceNormal)); 
-        total += 0.3 * RayTracer::traceIndividualRay(reflectRay, recursionLevel - 1);
+        total += real(0.3) * RayTracer::traceIndividualRay(reflectRay, recursionLevel - 1, EPSILON);
  
-        for (auto light : lightsInScene) {
-            total += light->illuminate(viewRay.direct, closest, surfacesInScene);
-            total += closest.material.emissiveColor;
+        for (const LightSource * light : scene.getLights()) {
+            total += light->illuminate(viewRay.direct, closest, scene);
+            total += closest.material->emissiveColor;
         }
        return total;
     }
-    return (closest.t != FLT_MAX) ? closest.material.diffuseColor : defaultColor; 
+    return (closest.t != FLT_MAX) ? closest.material->diffuseColor : defaultColor; 
 
-} // end traceRay
+} // end shadeHit
 
 
-Ray RayTracer::getOrthoViewRay( const int x, const int y)
+Ray RayTracer::getOrthoViewRay( const int x, const int y) const
 {
 	Ray orthoViewRay;
 
-	dvec2 uv = getImagePlaneCoordinates(x, y);
+	vec2 uv = getImagePlaneCoordinates(x, y);
 	
 	orthoViewRay.origin = eye + uv.x * u + uv.y * v;
 	orthoViewRay.direct = glm::normalize( -w );
@@ -114,13 +955,13 @@ Ray RayTracer::getOrthoViewRay( const int x, const int y)
 } // end getOrthoViewRay
 
 
-Ray RayTracer::getPerspectiveViewRay(const int x, const int y)
+Ray RayTracer::getPerspectiveViewRay(const int x, const int y) const
 {
 	Ray perspectiveViewRay;
     perspectiveViewRay.origin = eye;
 
-    dvec2 coords = getImagePlaneCoordinates(x, y);
-    dvec3 numerator = (-distToPlane * w) + (coords.x * u) + (coords.y * v);
+    vec2 coords = getImagePlaneCoordinates(x, y);
+    vec3 numerator = (-distToPlane * w) + (coords.x * u) + (coords.y * v);
     perspectiveViewRay.direct = normalize(numerator);
 
 	return perspectiveViewRay;
@@ -128,12 +969,57 @@ Ray RayTracer::getPerspectiveViewRay(const int x, const int y)
 } // end getPerspectiveViewRay
 
 
-dvec2 RayTracer::getImagePlaneCoordinates(const int x, const int y)
+void RayTracer::getViewRayPacket(const int x, const int y, const int width, const int height, RayPacket & packet) const
+{
+    packet.size = width * height;
+
+    for (int row = 0; row < height; row++) {
+        for (int column = 0; column < width; column++) {
+
+            vec2 coords = getImagePlaneCoordinates(x + column, y + row);
+            int lane = row * width + column;
+
+            if (renderPerspectiveView) {
+                vec3 numerator = (-distToPlane * w) + (coords.x * u) + (coords.y * v);
+                packet.setRay(lane, eye, normalize(numerator));
+            }
+            else {
+                packet.setRay(lane, eye + coords.x * u + coords.y * v, glm::normalize(-w));
+            }
+        }
+    }
+
+    packet.prepare();
+
+} // end getViewRayPacket
+
+
+Ray RayTracer::getSampleViewRay(const int x, const int y, const vec2 & offset) const
+{
+    real ux = leftLimit + (rightLimit - leftLimit) * ((x + offset.x) / nx);
+    real vx = bottomLimit + (topLimit - bottomLimit) * ((y + offset.y) / ny);
+
+    Ray sampleRay;
+    if (renderPerspectiveView) {
+        sampleRay.origin = eye;
+        sampleRay.direct = normalize((-distToPlane * w) + (ux * u) + (vx * v));
+    }
+    else {
+        sampleRay.origin = eye + ux * u + vx * v;
+        sampleRay.direct = glm::normalize(-w);
+    }
+
+    return sampleRay;
+
+} // end getSampleViewRay
+
+
+vec2 RayTracer::getImagePlaneCoordinates(const int x, const int y) const
 {
-    double ux = leftLimit + (rightLimit - leftLimit) * ((x + 0.5) / nx);
-    double vx = bottomLimit + (topLimit - bottomLimit) * ((y + 0.5) / ny);
+    real ux = leftLimit + (rightLimit - leftLimit) * ((x + 0.5) / nx);
+    real vx = bottomLimit + (topLimit - bottomLimit) * ((y + 0.5) / ny);
 
-	return dvec2(ux, vx);
+	return vec2(ux, vx);
 }
 
 
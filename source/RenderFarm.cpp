@@ -0,0 +1,436 @@
+#include "RenderFarm.h"
+
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <thread>
+
+#if defined( __unix__ ) || defined( __APPLE__ )
+#define RAYTRACER_HAS_PROCESSES
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+
+#ifdef RAYTRACER_HAS_PROCESSES
+
+/**
+* Reads exactly size bytes.
+* @return false if the other end closed the socket or an error occurred
+*/
+static bool receiveAll( int socket, void * data, size_t size )
+{
+	unsigned char * bytes = static_cast<unsigned char *>( data );
+
+	while( size > 0 ) {
+		ssize_t result = recv( socket, bytes, size, 0 );
+		if( result <= 0 ) {
+			return false;
+		}
+		bytes += result;
+		size -= (size_t)result;
+	}
+
+	return true;
+
+} // end receiveAll
+
+
+/**
+* Writes exactly size bytes. A closed socket is reported instead of raising
+* SIGPIPE.
+*/
+static bool sendAll( int socket, const void * data, size_t size )
+{
+	const unsigned char * bytes = static_cast<const unsigned char *>( data );
+
+	while( size > 0 ) {
+		ssize_t result = send( socket, bytes, size, MSG_NOSIGNAL );
+		if( result <= 0 ) {
+			return false;
+		}
+		bytes += result;
+		size -= (size_t)result;
+	}
+
+	return true;
+
+} // end sendAll
+
+
+bool WorkerConnection::writeTile( int tileX, int tileY, const unsigned char * pixels )
+{
+	TileMessage message;
+	message.tileX = tileX;
+	message.tileY = tileY;
+
+	std::lock_guard<std::mutex> lock( sendMutex );
+
+	if( !sendAll( socket, &message, sizeof( message ) ) ||
+		!sendAll( socket, pixels, (size_t)tileSize * tileSize * 4 ) ) {
+		failed = true;
+	}
+
+	return !failed;
+
+} // end writeTile
+
+
+bool WorkerConnection::serve( RayTracer & rayTracer )
+{
+	int tilesAcross = ( width + tileSize - 1 ) / tileSize;
+
+	RangeMessage range;
+	while( !failed && receiveAll( socket, &range, sizeof( range ) ) && range.tileCount > 0 ) {
+
+		// Trace the part of every row of tiles that the range covers at once,
+		// so that the threads of the worker share the tiles of the row
+		int tile = range.firstTile;
+		int end = range.firstTile + range.tileCount;
+		while( tile < end ) {
+
+			int tileX = tile % tilesAcross;
+			int tileY = tile / tilesAcross;
+			int count = std::min( end - tile, tilesAcross - tileX );
+
+			rayTracer.raytraceRegion( tileX * tileSize, tileY * tileSize,
+									  ( tileX + count ) * tileSize, ( tileY + 1 ) * tileSize );
+			tile += count;
+		}
+	}
+
+	return !failed;
+
+} // end serve
+
+
+/**
+* Coordinator side of a worker process.
+*/
+struct WorkerProcess
+{
+	pid_t processId = -1;
+
+	int socket = -1;
+
+	// Range being rendered, or -1 if the worker is idle
+	int range = -1;
+
+	// Tiles of the range received so far
+	int received = 0;
+
+	std::chrono::steady_clock::time_point rangeStart;
+
+	// Entry of the worker in the statistics
+	size_t statsIndex = 0;
+};
+
+
+/**
+* Starts a worker process connected to the coordinator by a socket pair.
+* @return false if the process could not be started
+*/
+static bool startWorker( const FarmSettings & settings, WorkerProcess & worker )
+{
+	int sockets[2];
+	if( socketpair( AF_UNIX, SOCK_STREAM, 0, sockets ) != 0 ) {
+		return false;
+	}
+
+	// Later workers must not inherit the end of the coordinator, or the socket
+	// would stay open after this worker dies
+	fcntl( sockets[0], F_SETFD, FD_CLOEXEC );
+
+	// A worker that hangs in the middle of a tile makes the receive fail
+	// instead of blocking the coordinator
+	if( settings.rangeTimeout > 0.0 ) {
+		timeval timeout;
+		timeout.tv_sec = (time_t)settings.rangeTimeout;
+		timeout.tv_usec = (suseconds_t)( ( settings.rangeTimeout - (double)timeout.tv_sec ) * 1.0e6 );
+		setsockopt( sockets[0], SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+	}
+
+	std::vector<string> arguments = settings.workerCommand;
+	arguments.push_back( "--worker-fd" );
+	arguments.push_back( std::to_string( sockets[1] ) );
+
+	std::vector<char *> argv;
+	for( string & argument : arguments ) {
+		argv.push_back( &argument[0] );
+	}
+	argv.push_back( nullptr );
+
+	pid_t processId = fork( );
+	if( processId < 0 ) {
+		close( sockets[0] );
+		close( sockets[1] );
+		return false;
+	}
+
+	if( processId == 0 ) {
+		execvp( argv[0], argv.data( ) );
+		_exit( 127 );
+	}
+
+	close( sockets[1] );
+
+	worker = WorkerProcess( );
+	worker.processId = processId;
+	worker.socket = sockets[0];
+	return true;
+
+} // end startWorker
+
+
+/**
+* Kills a worker, if it is still running, and waits for it to exit.
+* @param force - true to kill the worker right away. Otherwise it is given
+* timeout seconds to exit on its own before it is killed.
+* @param timeout - seconds to wait. Zero or less waits forever.
+*/
+static void stopWorker( WorkerProcess & worker, bool force, double timeout )
+{
+	if( worker.socket >= 0 ) {
+		close( worker.socket );
+		worker.socket = -1;
+	}
+
+	if( worker.processId > 0 ) {
+
+		// A worker that does not exit in time is killed after all
+		bool exited = false;
+		if( !force && timeout > 0.0 ) {
+			std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now( ) +
+				std::chrono::duration_cast<std::chrono::steady_clock::duration>( std::chrono::duration<double>( timeout ) );
+			while( !( exited = waitpid( worker.processId, nullptr, WNOHANG ) != 0 ) &&
+				   std::chrono::steady_clock::now( ) < deadline ) {
+				std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+			}
+			force = !exited;
+		}
+
+		if( !exited ) {
+			if( force ) {
+				kill( worker.processId, SIGKILL );
+			}
+			waitpid( worker.processId, nullptr, 0 );
+		}
+		worker.processId = -1;
+	}
+
+} // end stopWorker
+
+
+bool renderWithWorkers( const FarmSettings & settings, TileOutput & output, std::vector<WorkerStats> & stats,
+						string & error )
+{
+	stats.clear( );
+
+	int tileSize = output.getTileSize( );
+	int tilesAcross = ( output.getWidth( ) + tileSize - 1 ) / tileSize;
+	int tileCount = tilesAcross * ( ( output.getHeight( ) + tileSize - 1 ) / tileSize );
+	int tilesPerRange = std::max( settings.tilesPerRange, 1 );
+	int rangeCount = ( tileCount + tilesPerRange - 1 ) / tilesPerRange;
+
+	std::deque<int> pendingRanges;
+	for( int range = 0; range < rangeCount; range++ ) {
+		pendingRanges.push_back( range );
+	}
+	std::vector<int> attempts( rangeCount, 0 );
+	int rangesLeft = rangeCount;
+
+	// Every worker may be replaced as often as a range may be retried
+	int startsLeft = std::max( settings.workerCount, 1 ) * std::max( settings.maxAttempts, 1 );
+	std::vector<WorkerProcess> workers;
+
+	auto start = [&]( ) {
+		WorkerProcess worker;
+		if( startsLeft <= 0 || !startWorker( settings, worker ) ) {
+			return false;
+		}
+		startsLeft--;
+		worker.statsIndex = stats.size( );
+		stats.push_back( WorkerStats( ) );
+		stats.back( ).processId = worker.processId;
+		workers.push_back( worker );
+		return true;
+	};
+
+	auto finish = [&]( bool succeeded ) {
+		RangeMessage stop = { 0, 0 };
+		for( WorkerProcess & worker : workers ) {
+			if( succeeded ) {
+				sendAll( worker.socket, &stop, sizeof( stop ) );
+			}
+			stopWorker( worker, !succeeded, settings.rangeTimeout );
+		}
+		return succeeded;
+	};
+
+	typedef std::chrono::duration<double> Seconds;
+	bool faultSent = false;
+
+	std::signal( SIGPIPE, SIG_IGN );
+
+	for( int i = 0; i < settings.workerCount; i++ ) {
+		start( );
+	}
+
+	std::vector<unsigned char> pixels( (size_t)tileSize * tileSize * 4 );
+
+	while( rangesLeft > 0 ) {
+
+		// Hand out ranges to idle workers
+		for( WorkerProcess & worker : workers ) {
+			if( worker.range < 0 && !pendingRanges.empty( ) ) {
+
+				worker.range = pendingRanges.front( );
+				worker.received = 0;
+				worker.rangeStart = std::chrono::steady_clock::now( );
+				pendingRanges.pop_front( );
+				attempts[worker.range]++;
+
+				RangeMessage message;
+				message.firstTile = worker.range * tilesPerRange;
+				message.tileCount = std::min( tilesPerRange, tileCount - message.firstTile );
+
+				// A worker that cannot be reached is found to be dead by poll
+				sendAll( worker.socket, &message, sizeof( message ) );
+			}
+		}
+
+		if( workers.empty( ) ) {
+			error = "No worker process is left running";
+			return finish( false );
+		}
+
+		// Wait no longer than until the earliest deadline of a busy worker
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now( );
+		int waitMilliseconds = -1;
+		std::vector<pollfd> descriptors( workers.size( ) );
+		for( size_t i = 0; i < workers.size( ); i++ ) {
+			descriptors[i].fd = workers[i].socket;
+			descriptors[i].events = POLLIN;
+			descriptors[i].revents = 0;
+
+			if( settings.rangeTimeout > 0.0 && workers[i].range >= 0 ) {
+				Seconds left = Seconds( settings.rangeTimeout ) - ( now - workers[i].rangeStart );
+				int milliseconds = std::max( (int)std::ceil( left.count( ) * 1000.0 ), 0 );
+				waitMilliseconds = waitMilliseconds < 0 ? milliseconds : std::min( waitMilliseconds, milliseconds );
+			}
+		}
+		if( poll( descriptors.data( ), descriptors.size( ), waitMilliseconds ) < 0 ) {
+			continue;
+		}
+		now = std::chrono::steady_clock::now( );
+
+		for( size_t i = workers.size( ); i-- > 0; ) {
+
+			WorkerProcess & worker = workers[i];
+			WorkerStats & workerStats = stats[worker.statsIndex];
+			int firstTile = worker.range * tilesPerRange;
+			int rangeTiles = std::min( tilesPerRange, tileCount - firstTile );
+
+			// A worker past its deadline is treated like one that died
+			bool late = settings.rangeTimeout > 0.0 && worker.range >= 0 &&
+						now - worker.rangeStart >= Seconds( settings.rangeTimeout );
+
+			if( descriptors[i].revents == 0 && !late ) {
+				continue;
+			}
+
+			// Only tiles of the range of the worker are accepted
+			TileMessage message = { -1, -1 };
+			bool received = !late && descriptors[i].revents != 0 && worker.range >= 0 &&
+							receiveAll( worker.socket, &message, sizeof( message ) );
+			int tile = message.tileY * tilesAcross + message.tileX;
+			received = received && message.tileX >= 0 && message.tileX < tilesAcross &&
+					   tile >= firstTile && tile < firstTile + rangeTiles &&
+					   receiveAll( worker.socket, pixels.data( ), pixels.size( ) );
+
+			if( !received ) {
+
+				workerStats.failed = true;
+				workerStats.timedOut = late;
+				stopWorker( worker, true, settings.rangeTimeout );
+
+				if( worker.range >= 0 ) {
+					if( attempts[worker.range] >= settings.maxAttempts ) {
+						error = "Tiles " + std::to_string( firstTile ) + " to " +
+								std::to_string( firstTile + rangeTiles - 1 ) + " failed " +
+								std::to_string( attempts[worker.range] ) + " times";
+						workers.erase( workers.begin( ) + i );
+						return finish( false );
+					}
+					pendingRanges.push_front( worker.range );
+				}
+
+				workers.erase( workers.begin( ) + i );
+				start( );
+				continue;
+			}
+
+			if( !output.writeTile( message.tileX, message.tileY, pixels.data( ) ) ) {
+				error = "Could not store a tile";
+				return finish( false );
+			}
+
+			int columns = std::min( tileSize, output.getWidth( ) - message.tileX * tileSize );
+			int rows = std::min( tileSize, output.getHeight( ) - message.tileY * tileSize );
+			workerStats.tiles++;
+			workerStats.pixels += (long long)columns * rows;
+
+			// Only in the middle of a range, so that the range has to be redone
+			if( settings.fault != WorkerFault::NONE && !faultSent && worker.statsIndex == 0 &&
+				workerStats.tiles >= settings.faultAfterTiles && worker.received + 1 < rangeTiles ) {
+				kill( worker.processId, settings.fault == WorkerFault::DIE ? SIGKILL : SIGSTOP );
+				faultSent = true;
+			}
+
+			if( ++worker.received == rangeTiles ) {
+				std::chrono::duration<double> busy = std::chrono::steady_clock::now( ) - worker.rangeStart;
+				workerStats.busySeconds += busy.count( );
+				worker.range = -1;
+				rangesLeft--;
+			}
+		}
+	}
+
+	return finish( true );
+
+} // end renderWithWorkers
+
+#else
+
+bool WorkerConnection::writeTile( int tileX, int tileY, const unsigned char * pixels )
+{
+	return false;
+
+} // end writeTile
+
+
+bool WorkerConnection::serve( RayTracer & rayTracer )
+{
+	return false;
+
+} // end serve
+
+
+bool renderWithWorkers( const FarmSettings & settings, TileOutput & output, std::vector<WorkerStats> & stats,
+						string & error )
+{
+	error = "Worker processes are not supported on this system";
+	return false;
+
+} // end renderWithWorkers
+
+#endif // RAYTRACER_HAS_PROCESSES
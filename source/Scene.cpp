@@ -0,0 +1,472 @@
+#include "Scene.h"
+
+#include "Ellipsoid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <typeinfo>
+
+
+thread_local DependencySet * Scene::recordedDependencies = nullptr;
+
+
+std::vector<int> DependencySet::getSortedIndices( ) const
+{
+	std::vector<int> sorted = indices;
+	std::sort( sorted.begin(), sorted.end() );
+	return sorted;
+
+} // end getSortedIndices
+
+
+void DependencySet::addPathPoint( int level, const vec3 & point )
+{
+	if( level >= static_cast<int>( pathBounds.size() ) ) {
+		pathBounds.resize( level + 1 );
+		escapeDirections.resize( level + 1 );
+	}
+	pathBounds[level].expand( point );
+
+} // end addPathPoint
+
+
+void DependencySet::addEscape( int level, const vec3 & direction )
+{
+	if( level >= static_cast<int>( pathBounds.size() ) ) {
+		pathBounds.resize( level + 1 );
+		escapeDirections.resize( level + 1 );
+	}
+	escapeDirections[level].expand( direction );
+
+} // end addEscape
+
+
+void Scene::build( const SurfaceVector & surfaces, ThreadPool * threadPool )
+{
+	build( surfaces, LightVector(), threadPool );
+
+} // end build
+
+
+void Scene::build( const SurfaceVector & surfaces, const LightVector & lights, ThreadPool * threadPool,
+				   const BVH * hierarchy )
+{
+	spheres.clear();
+	planes.clear();
+	quadrics.clear();
+	cylinders.clear();
+	polygons.clear();
+	customSurfaces.clear();
+	primitives.clear();
+
+	std::vector<BoundingBox> primitiveBounds;
+	std::vector<PrimitiveRef> unboundedPrimitives;
+	std::vector<int> unboundedSurfaces;
+
+	surfacePrimitives.assign( surfaces.size(), -1 );
+
+	for( size_t i = 0; i < surfaces.size(); i++ ) {
+
+		const Surface * surface = surfaces[i].get();
+		BoundingBox box = surface->bounds();
+
+		if( box.isFinite() ) {
+			surfacePrimitives[i] = static_cast<int>( primitives.size() );
+			primitives.push_back( addPrimitive( surface ) );
+			primitiveBounds.push_back( box );
+		}
+		else {
+			unboundedPrimitives.push_back( addPrimitive( surface ) );
+			unboundedSurfaces.push_back( static_cast<int>( i ) );
+		}
+	}
+
+	boundedCount = static_cast<int>( primitives.size() );
+
+	std::vector<int> order( unboundedPrimitives.size() );
+	for( size_t i = 0; i < order.size(); i++ ) {
+		order[i] = static_cast<int>( i );
+	}
+	std::stable_sort( order.begin(), order.end(), [&]( int a, int b ) {
+		return unboundedPrimitives[a].type < unboundedPrimitives[b].type;
+	} );
+	for( int i : order ) {
+		surfacePrimitives[unboundedSurfaces[i]] = static_cast<int>( primitives.size() );
+		primitives.push_back( unboundedPrimitives[i] );
+	}
+
+	if( hierarchy != nullptr && hierarchy->isConsistent( boundedCount ) ) {
+		bvh = *hierarchy;
+	}
+	else {
+		bvh.build( primitiveBounds, threadPool );
+	}
+
+	this->lights.clear();
+	for( const auto & light : lights ) {
+		this->lights.push_back( light.get() );
+	}
+
+	originContexts.clear();
+
+	version++;
+
+} // end build
+
+
+PrimitiveRef Scene::addPrimitive( const Surface * surface )
+{
+	PrimitiveRef primitive;
+
+	// Only exact types are copied. A subclass may override any of the tests.
+	// Ellipsoid only sets the coefficients of its base class.
+	const std::type_info & type = typeid( *surface );
+
+	if( type == typeid( Sphere ) ) {
+		primitive.type = PrimitiveRef::Type::SPHERE;
+		primitive.slot = static_cast<int>( spheres.size() );
+		spheres.push_back( static_cast<const Sphere &>( *surface ) );
+	}
+	else if( type == typeid( Plane ) ) {
+		primitive.type = PrimitiveRef::Type::PLANE;
+		primitive.slot = static_cast<int>( planes.size() );
+		planes.push_back( static_cast<const Plane &>( *surface ) );
+	}
+	else if( type == typeid( QuadricSurface ) || type == typeid( Ellipsoid ) ) {
+		primitive.type = PrimitiveRef::Type::QUADRIC;
+		primitive.slot = static_cast<int>( quadrics.size() );
+		quadrics.push_back( static_cast<const QuadricSurface &>( *surface ) );
+	}
+	else if( type == typeid( Cylinder ) ) {
+		primitive.type = PrimitiveRef::Type::CYLINDER;
+		primitive.slot = static_cast<int>( cylinders.size() );
+		cylinders.push_back( static_cast<const Cylinder &>( *surface ) );
+	}
+	else if( type == typeid( SimplePolygon ) ) {
+		primitive.type = PrimitiveRef::Type::POLYGON;
+		primitive.slot = static_cast<int>( polygons.size() );
+		polygons.push_back( static_cast<const SimplePolygon &>( *surface ) );
+	}
+	else {
+		primitive.type = PrimitiveRef::Type::CUSTOM;
+		primitive.slot = static_cast<int>( customSurfaces.size() );
+		customSurfaces.push_back( surface );
+	}
+
+	return primitive;
+
+} // end addPrimitive
+
+
+template <class Function>
+typename Function::result_type Scene::visit( PrimitiveRef primitive, const Function & function ) const
+{
+	switch( primitive.type ) {
+	case PrimitiveRef::Type::SPHERE:
+		return function( spheres[primitive.slot] );
+	case PrimitiveRef::Type::PLANE:
+		return function( planes[primitive.slot] );
+	case PrimitiveRef::Type::QUADRIC:
+		return function( quadrics[primitive.slot] );
+	case PrimitiveRef::Type::CYLINDER:
+		return function( cylinders[primitive.slot] );
+	case PrimitiveRef::Type::POLYGON:
+		return function( polygons[primitive.slot] );
+	default:
+		return function( *customSurfaces[primitive.slot] );
+	}
+
+} // end visit
+
+
+const Surface & Scene::getSurface( int index ) const
+{
+	PrimitiveRef primitive = primitives[index];
+
+	switch( primitive.type ) {
+	case PrimitiveRef::Type::SPHERE:
+		return spheres[primitive.slot];
+	case PrimitiveRef::Type::PLANE:
+		return planes[primitive.slot];
+	case PrimitiveRef::Type::QUADRIC:
+		return quadrics[primitive.slot];
+	case PrimitiveRef::Type::CYLINDER:
+		return cylinders[primitive.slot];
+	case PrimitiveRef::Type::POLYGON:
+		return polygons[primitive.slot];
+	default:
+		return *customSurfaces[primitive.slot];
+	}
+
+} // end getSurface
+
+
+void Scene::prepareOrigins( const std::vector<vec3> & origins )
+{
+	originContexts.resize( origins.size() );
+
+	for( size_t o = 0; o < origins.size(); o++ ) {
+
+		OriginContext & context = originContexts[o];
+		context.origin = origins[o];
+		context.terms.resize( primitives.size() );
+
+		for( size_t i = 0; i < primitives.size(); i++ ) {
+			context.terms[i] = getSurface( static_cast<int>( i ) ).computeOriginTerm( origins[o] );
+		}
+	}
+
+} // end prepareOrigins
+
+
+const OriginContext * Scene::getOriginContext( const vec3 & origin ) const
+{
+	for( const OriginContext & context : originContexts ) {
+
+		if( context.origin == origin ) {
+			return &context;
+		}
+	}
+
+	return nullptr;
+
+} // end getOriginContext
+
+
+/**
+* Returns the origin term of a surface if the ray starts at the origin of a
+* context, and NaN otherwise.
+*/
+static inline real getOriginTerm( const OriginContext * context, int index )
+{
+	return context != nullptr ? context->terms[index] : std::numeric_limits<real>::quiet_NaN();
+
+} // end getOriginTerm
+
+
+/**
+* Closest hit test of a ray against one surface. The built in types are called
+* by qualified name, which skips the virtual call. The test with the origin term
+* is used when the term is not NaN.
+*/
+struct IntersectRay
+{
+	typedef bool result_type;
+
+	const Ray & ray;
+	real originTerm;
+	real tMin;
+	real tMax;
+	RayHit & hit;
+
+	template <class SurfaceType>
+	bool operator()( const SurfaceType & surface ) const
+	{
+		if( !std::isnan( originTerm ) ) {
+			return surface.SurfaceType::intersectFromOrigin( ray, originTerm, tMin, tMax, hit );
+		}
+		return surface.SurfaceType::intersect( ray, tMin, tMax, hit );
+	}
+
+	bool operator()( const Surface & surface ) const
+	{
+		if( !std::isnan( originTerm ) ) {
+			return surface.intersectFromOrigin( ray, originTerm, tMin, tMax, hit );
+		}
+		return surface.intersect( ray, tMin, tMax, hit );
+	}
+};
+
+
+/**
+* Closest hit test of the rays of a packet against one surface. Types without a
+* packet test of their own are tested one lane at a time.
+*/
+struct IntersectPacket
+{
+	typedef unsigned result_type;
+
+	const RayPacket & packet;
+	real originTerm;
+	unsigned laneMask;
+	real tMin;
+	real * tMax;
+	RayHit * hits;
+
+	template <class SurfaceType>
+	unsigned operator()( const SurfaceType & surface ) const
+	{
+		unsigned hitMask = 0;
+
+		for( int lane = 0; lane < packet.size; lane++ ) {
+
+			if( ( laneMask & ( 1u << lane ) ) &&
+				IntersectRay{ packet.getRay( lane ), originTerm, tMin, tMax[lane], hits[lane] }( surface ) ) {
+				tMax[lane] = hits[lane].t;
+				hitMask |= 1u << lane;
+			}
+		}
+
+		return hitMask;
+	}
+
+	unsigned operator()( const Sphere & sphere ) const
+	{
+		if( !std::isnan( originTerm ) ) {
+			return sphere.Sphere::intersectPacketFromOrigin( packet, originTerm, laneMask, tMin, tMax, hits );
+		}
+		return sphere.Sphere::intersectPacket( packet, laneMask, tMin, tMax, hits );
+	}
+
+	unsigned operator()( const Surface & surface ) const
+	{
+		if( !std::isnan( originTerm ) ) {
+			return surface.intersectPacketFromOrigin( packet, originTerm, laneMask, tMin, tMax, hits );
+		}
+		return surface.intersectPacket( packet, laneMask, tMin, tMax, hits );
+	}
+};
+
+
+/**
+* Checks whether a surface blocks a ray. Surfaces that use an origin term are
+* simple enough that any hit is found as quickly by the closest hit test, and
+* none of the built in types has a faster test of its own.
+*/
+struct OccludesRay
+{
+	typedef bool result_type;
+
+	const Ray & ray;
+	real originTerm;
+	real tMin;
+	real tMax;
+
+	template <class SurfaceType>
+	bool operator()( const SurfaceType & surface ) const
+	{
+		RayHit hit;
+		return IntersectRay{ ray, originTerm, tMin, tMax, hit }( surface );
+	}
+
+	bool operator()( const Surface & surface ) const
+	{
+		if( !std::isnan( originTerm ) ) {
+			RayHit hit;
+			return surface.intersectFromOrigin( ray, originTerm, tMin, tMax, hit );
+		}
+		return surface.occludes( ray, tMin, tMax );
+	}
+};
+
+
+HitRecord Scene::findIntersection( const Ray & ray, real tMin, real tMax, const OriginContext * context ) const
+{
+	HitRecord closest;
+	closest.t = FLT_MAX;
+
+	// Surfaces only report the parameter of a hit while searching. Every hit
+	// that is found shortens the interval for the remaining surfaces.
+	RayHit closestHit;
+	closestHit.t = tMax;
+
+	for( int index = boundedCount; index < static_cast<int>( primitives.size() ); index++ ) {
+
+		if( visit( primitives[index], IntersectRay{ ray, getOriginTerm( context, index ), tMin, closestHit.t, closestHit } ) ) {
+			closestHit.primitive = index;
+		}
+	}
+
+	real tLimit = closestHit.t;
+
+	bvh.traverse( ray, tMin, tLimit, [&]( int index, real & tMax ) {
+
+		if( visit( primitives[index], IntersectRay{ ray, getOriginTerm( context, index ), tMin, tMax, closestHit } ) ) {
+			closestHit.primitive = index;
+			tMax = closestHit.t;
+		}
+		return false;
+	} );
+
+	// The normal and material are only computed for the closest hit
+	if( closestHit.primitive >= 0 ) {
+		getSurface( closestHit.primitive ).completeHitRecord( ray, closestHit, closest );
+		recordHit( closestHit.primitive );
+	}
+
+	return closest;
+
+} // end findIntersection
+
+
+void Scene::findIntersections( const RayPacket & packet, real tMin, HitRecord hitRecords[],
+							   const OriginContext * context ) const
+{
+	RayHit closestHits[RayPacket::MAX_SIZE];
+	real tMax[RayPacket::MAX_SIZE];
+
+	for( int lane = 0; lane < RayPacket::MAX_SIZE; lane++ ) {
+		tMax[lane] = FLT_MAX;
+	}
+
+	unsigned laneMask = packet.activeMask();
+
+	auto intersectPacket = [&]( int index, unsigned mask ) {
+
+		unsigned hitMask = visit( primitives[index], IntersectPacket{ packet, getOriginTerm( context, index ), mask,
+																	  tMin, tMax, closestHits } );
+
+		for( int lane = 0; hitMask != 0; lane++, hitMask >>= 1 ) {
+			if( hitMask & 1u ) {
+				closestHits[lane].primitive = index;
+			}
+		}
+	};
+
+	for( int index = boundedCount; index < static_cast<int>( primitives.size() ); index++ ) {
+		intersectPacket( index, laneMask );
+	}
+
+	bvh.traversePacket( packet, laneMask, tMin, tMax, [&]( const BVH::Node & leaf, unsigned leafMask ) {
+
+		for( int i = leaf.firstIndex; i < leaf.firstIndex + leaf.primitiveCount; i++ ) {
+			intersectPacket( bvh.getPrimitiveIndices()[i], leafMask );
+		}
+		return false;
+	} );
+
+	// The normal and material are only computed for the closest hit of each ray
+	for( int lane = 0; lane < packet.size; lane++ ) {
+
+		hitRecords[lane] = HitRecord();
+
+		if( closestHits[lane].primitive >= 0 ) {
+			getSurface( closestHits[lane].primitive ).completeHitRecord( packet.getRay( lane ), closestHits[lane], hitRecords[lane] );
+			recordHit( closestHits[lane].primitive );
+		}
+	}
+
+} // end findIntersections
+
+
+bool Scene::occluded( const Ray & ray, real tMin, real tMax, const OriginContext * context ) const
+{
+	for( int index = boundedCount; index < static_cast<int>( primitives.size() ); index++ ) {
+
+		if( visit( primitives[index], OccludesRay{ ray, getOriginTerm( context, index ), tMin, tMax } ) ) {
+			recordHit( index );
+			return true;
+		}
+	}
+
+	return bvh.traverse( ray, tMin, tMax, [&]( int index, real & tMax ) {
+
+		if( visit( primitives[index], OccludesRay{ ray, getOriginTerm( context, index ), tMin, tMax } ) ) {
+			recordHit( index );
+			return true;
+		}
+		return false;
+	} );
+
+} // end occluded
@@ -0,0 +1,752 @@
+#include "SceneFile.h"
+
+#include "Cylinder.h"
+#include "Ellipsoid.h"
+#include "MappedFile.h"
+#include "Plane.h"
+#include "Scene.h"
+#include "SimplePolygon.h"
+#include "Sphere.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdint.h>
+
+#if defined( __unix__ ) || defined( __APPLE__ )
+#include <unistd.h>
+#endif
+
+/*
+* The parser turns the text into flat arrays of fixed size records, and the
+* surfaces and lights are always created from the records. The cache stores
+* the same records, so a scene read from the cache is identical to one parsed
+* from the text.
+*/
+
+enum class SurfaceType : uint32_t { SPHERE, PLANE, ELLIPSOID, CYLINDER, POLYGON };
+
+enum class LightType : uint32_t { AMBIENT, POSITIONAL, DIRECTIONAL, SPOTLIGHT };
+
+struct MaterialRecord
+{
+	real ambient[3];
+	real diffuse[3];
+	real specular[3];
+	real emissive[3];
+	real shininess;
+};
+
+struct SurfaceRecord
+{
+	SurfaceType type;
+
+	// Cylinders: 1 if the ends are closed
+	uint32_t capped;
+
+	// Polygons: range of their corners in the vertex array
+	uint32_t firstVertex;
+	uint32_t vertexCount;
+
+	// Center, or point on a plane
+	real position[3];
+
+	// Normal of a plane, or axis of a cylinder
+	real direction[3];
+
+	// Radius of a sphere, semi axes of an ellipsoid, or radius and length of a cylinder
+	real size[3];
+
+	MaterialRecord material;
+};
+
+struct LightRecord
+{
+	LightType type;
+
+	real position[3];
+
+	// Direction of a directional light or of the beam of a spotlight
+	real direction[3];
+
+	// Diffuse color, or ambient color of an ambient light
+	real lightColor[3];
+
+	// Half of the beam of a spotlight in degrees
+	real cutoff;
+};
+
+struct CameraRecord
+{
+	real eye[3];
+	real direction[3];
+	real up[3];
+	real fieldOfView;
+	real orthoHeight;
+	real background[3];
+};
+
+struct SceneRecords
+{
+	CameraRecord camera;
+	std::vector<SurfaceRecord> surfaces;
+	std::vector<real> vertices;
+	std::vector<LightRecord> lights;
+};
+
+/**
+* Layout of a cache file. The header is followed by one CameraRecord and by
+* the surface records, vertex coordinates, light records, hierarchy nodes, and
+* hierarchy primitive indices. The sizes of the records are stored so that a
+* cache written by a build with another precision or layout is rebuilt.
+*/
+struct SceneCacheHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t realSize;
+	uint32_t surfaceRecordSize;
+	uint32_t lightRecordSize;
+	uint32_t nodeSize;
+	uint32_t surfaceCount;
+	uint32_t vertexCount;
+	uint32_t lightCount;
+	uint32_t nodeCount;
+	uint32_t primitiveIndexCount;
+
+	// Size and hash of the text file that the cache was compiled from
+	uint64_t sourceSize;
+	uint64_t sourceHash;
+};
+
+static const char SCENE_CACHE_MAGIC[8] = { 'R', 'T', 'S', 'C', 'E', 'N', 'E', '\n' };
+
+static const uint32_t SCENE_CACHE_VERSION = 1;
+
+
+static void store( real out[3], const vec3 & v )
+{
+	out[0] = v.x;
+	out[1] = v.y;
+	out[2] = v.z;
+
+} // end store
+
+
+static vec3 load( const real in[3] )
+{
+	return vec3( in[0], in[1], in[2] );
+
+} // end load
+
+
+/**
+* 64 bit FNV-1a hash of the contents of a file.
+*/
+static uint64_t hashBytes( const unsigned char * data, size_t size )
+{
+	uint64_t hash = 14695981039346656037ull;
+	for( size_t i = 0; i < size; i++ ) {
+		hash = ( hash ^ data[i] ) * 1099511628211ull;
+	}
+
+	return hash;
+
+} // end hashBytes
+
+
+string getSceneCacheName( const string & fileName )
+{
+	return fileName + ".cache";
+
+} // end getSceneCacheName
+
+
+/**
+* Reads a number of values from a statement.
+* @return false if the statement ends early or a value is not a number
+*/
+static bool readReals( std::istream & in, real * values, int count )
+{
+	for( int i = 0; i < count; i++ ) {
+		if( !( in >> values[i] ) ) {
+			return false;
+		}
+	}
+
+	return true;
+
+} // end readReals
+
+
+/**
+* Reads the name of a material from a statement and copies the material.
+* @return false if there is no name or no material of that name
+*/
+static bool readMaterial( std::istream & in, const std::map<string, MaterialRecord> & materials,
+						  MaterialRecord & material, string & error )
+{
+	string name;
+	if( !( in >> name ) ) {
+		error = "missing material name";
+		return false;
+	}
+
+	std::map<string, MaterialRecord>::const_iterator found = materials.find( name );
+	if( found == materials.end( ) ) {
+		error = "unknown material " + name;
+		return false;
+	}
+
+	material = found->second;
+	return true;
+
+} // end readMaterial
+
+
+/**
+* Parses one statement into the records.
+* @return false and sets error if the statement is not valid
+*/
+static bool parseStatement( std::istringstream & in, const string & keyword, SceneRecords & records,
+							std::map<string, MaterialRecord> & materials, string & error )
+{
+	CameraRecord & camera = records.camera;
+
+	if( keyword == "camera" || keyword == "ortho" ) {
+
+		real values[10];
+		if( !readReals( in, values, 10 ) ) {
+			error = "expected eye, direction, up, and " + string( keyword == "camera" ? "field of view" : "height" );
+			return false;
+		}
+		std::copy( values, values + 3, camera.eye );
+		std::copy( values + 3, values + 6, camera.direction );
+		std::copy( values + 6, values + 9, camera.up );
+
+		if( glm::length( glm::cross( load( camera.direction ), load( camera.up ) ) ) == 0 ) {
+			error = "the up vector cannot be parallel to the viewing direction";
+			return false;
+		}
+
+		camera.fieldOfView = keyword == "camera" ? values[9] : real( 45.0 );
+		camera.orthoHeight = keyword == "ortho" ? values[9] : real( 0.0 );
+	}
+	else if( keyword == "background" ) {
+
+		if( !readReals( in, camera.background, 3 ) ) {
+			error = "expected a color";
+			return false;
+		}
+	}
+	else if( keyword == "material" ) {
+
+		string name;
+		real diffuse[3];
+		if( !( in >> name ) || !readReals( in, diffuse, 3 ) ) {
+			error = "expected a name and a color";
+			return false;
+		}
+
+		Material defaults( load( diffuse ) );
+		MaterialRecord material;
+		store( material.ambient, defaults.ambientColor );
+		store( material.diffuse, defaults.diffuseColor );
+		store( material.specular, defaults.specularColor );
+		store( material.emissive, defaults.emissiveColor );
+		material.shininess = defaults.shininess;
+
+		string property;
+		while( in >> property ) {
+
+			bool valid;
+			if( property == "shininess" ) {
+				valid = readReals( in, &material.shininess, 1 );
+			}
+			else if( property == "specular" ) {
+				valid = readReals( in, material.specular, 3 );
+			}
+			else if( property == "emissive" ) {
+				valid = readReals( in, material.emissive, 3 );
+			}
+			else if( property == "ambient" ) {
+				valid = readReals( in, material.ambient, 3 );
+			}
+			else {
+				error = "unknown material property " + property;
+				return false;
+			}
+
+			if( !valid ) {
+				error = "missing value for " + property;
+				return false;
+			}
+		}
+
+		materials[name] = material;
+		return true;
+	}
+	else if( keyword == "sphere" || keyword == "plane" || keyword == "ellipsoid" || keyword == "cylinder" ) {
+
+		SurfaceRecord surface = SurfaceRecord( );
+		real values[8];
+
+		if( keyword == "sphere" ) {
+			surface.type = SurfaceType::SPHERE;
+			if( !readReals( in, values, 4 ) ) {
+				error = "expected a center and a radius";
+				return false;
+			}
+			if( values[3] <= 0 ) {
+				error = "the radius must be positive";
+				return false;
+			}
+			surface.size[0] = values[3];
+		}
+		else if( keyword == "plane" ) {
+			surface.type = SurfaceType::PLANE;
+			if( !readReals( in, values, 6 ) ) {
+				error = "expected a point and a normal";
+				return false;
+			}
+			if( glm::length( load( values + 3 ) ) == 0 ) {
+				error = "the normal cannot be zero";
+				return false;
+			}
+			std::copy( values + 3, values + 6, surface.direction );
+		}
+		else if( keyword == "ellipsoid" ) {
+			surface.type = SurfaceType::ELLIPSOID;
+			if( !readReals( in, values, 6 ) ) {
+				error = "expected a center and three semi axes";
+				return false;
+			}
+			if( values[3] <= 0 || values[4] <= 0 || values[5] <= 0 ) {
+				error = "the semi axes must be positive";
+				return false;
+			}
+			std::copy( values + 3, values + 6, surface.size );
+		}
+		else {
+			surface.type = SurfaceType::CYLINDER;
+			if( !readReals( in, values, 8 ) ) {
+				error = "expected a center, an axis, a radius, and a length";
+				return false;
+			}
+			if( glm::length( load( values + 3 ) ) == 0 ) {
+				error = "the axis cannot be zero";
+				return false;
+			}
+			if( values[6] <= 0 || values[7] <= 0 ) {
+				error = "the radius and the length must be positive";
+				return false;
+			}
+			std::copy( values + 3, values + 6, surface.direction );
+			std::copy( values + 6, values + 8, surface.size );
+		}
+		std::copy( values, values + 3, surface.position );
+
+		if( !readMaterial( in, materials, surface.material, error ) ) {
+			return false;
+		}
+
+		string flag;
+		if( surface.type == SurfaceType::CYLINDER && in >> flag ) {
+			if( flag != "capped" ) {
+				error = "unexpected " + flag;
+				return false;
+			}
+			surface.capped = 1;
+		}
+
+		records.surfaces.push_back( surface );
+	}
+	else if( keyword == "polygon" ) {
+
+		SurfaceRecord surface = SurfaceRecord( );
+		surface.type = SurfaceType::POLYGON;
+		surface.firstVertex = static_cast<uint32_t>( records.vertices.size( ) / 3 );
+
+		if( !readMaterial( in, materials, surface.material, error ) ) {
+			return false;
+		}
+
+		real value;
+		while( in >> value ) {
+			records.vertices.push_back( value );
+		}
+
+		size_t coordinates = records.vertices.size( ) - 3 * size_t( surface.firstVertex );
+		if( coordinates % 3 != 0 || coordinates < 9 ) {
+			error = "expected at least three corners";
+			return false;
+		}
+		surface.vertexCount = static_cast<uint32_t>( coordinates / 3 );
+
+		// The normal of a polygon is taken from its first three corners
+		const real * corners = &records.vertices[3 * size_t( surface.firstVertex )];
+		vec3 first = load( corners ), second = load( corners + 3 ), third = load( corners + 6 );
+		if( glm::length( glm::cross( third - second, first - second ) ) == 0 ) {
+			error = "the first three corners cannot be on one line";
+			return false;
+		}
+
+		records.surfaces.push_back( surface );
+	}
+	else if( keyword == "ambient" || keyword == "positional" || keyword == "directional" || keyword == "spotlight" ) {
+
+		LightRecord light = LightRecord( );
+
+		bool valid;
+		if( keyword == "ambient" ) {
+			light.type = LightType::AMBIENT;
+			valid = readReals( in, light.lightColor, 3 );
+		}
+		else if( keyword == "positional" ) {
+			light.type = LightType::POSITIONAL;
+			valid = readReals( in, light.position, 3 ) && readReals( in, light.lightColor, 3 );
+		}
+		else if( keyword == "directional" ) {
+			light.type = LightType::DIRECTIONAL;
+			valid = readReals( in, light.direction, 3 ) && readReals( in, light.lightColor, 3 );
+		}
+		else {
+			light.type = LightType::SPOTLIGHT;
+			valid = readReals( in, light.position, 3 ) && readReals( in, light.direction, 3 ) &&
+					readReals( in, &light.cutoff, 1 ) && readReals( in, light.lightColor, 3 );
+		}
+
+		if( !valid ) {
+			error = "missing or invalid values for " + keyword;
+			return false;
+		}
+
+		records.lights.push_back( light );
+	}
+	else {
+		error = "unknown statement " + keyword;
+		return false;
+	}
+
+	string extra;
+	if( in >> extra ) {
+		error = "unexpected " + extra;
+		return false;
+	}
+
+	return true;
+
+} // end parseStatement
+
+
+/**
+* Parses the text of a scene file into records.
+*/
+static bool parseScene( const string & text, const string & fileName, SceneRecords & records, string & error )
+{
+	SceneDescription defaults;
+	store( records.camera.eye, defaults.eye );
+	store( records.camera.direction, defaults.direction );
+	store( records.camera.up, defaults.up );
+	records.camera.fieldOfView = defaults.fieldOfView;
+	records.camera.orthoHeight = defaults.orthoHeight;
+	store( records.camera.background, defaults.background );
+
+	std::map<string, MaterialRecord> materials;
+
+	std::istringstream lines( text );
+	string line;
+
+	for( int lineNumber = 1; std::getline( lines, line ); lineNumber++ ) {
+
+		line = line.substr( 0, line.find( '#' ) );
+
+		std::istringstream in( line );
+		string keyword;
+		if( !( in >> keyword ) ) {
+			continue;
+		}
+
+		string statementError;
+		if( !parseStatement( in, keyword, records, materials, statementError ) ) {
+			error = fileName + ":" + std::to_string( lineNumber ) + ": " + statementError;
+			return false;
+		}
+	}
+
+	return true;
+
+} // end parseScene
+
+
+static Material createMaterial( const MaterialRecord & record )
+{
+	Material material( load( record.diffuse ) );
+	material.ambientColor = load( record.ambient );
+	material.specularColor = load( record.specular );
+	material.emissiveColor = load( record.emissive );
+	material.shininess = record.shininess;
+
+	return material;
+
+} // end createMaterial
+
+
+/**
+* Creates the surfaces, lights, and camera that the records describe.
+*/
+static void createScene( const SceneRecords & records, SceneDescription & scene )
+{
+	const CameraRecord & camera = records.camera;
+	scene.eye = load( camera.eye );
+	scene.direction = load( camera.direction );
+	scene.up = load( camera.up );
+	scene.fieldOfView = camera.fieldOfView;
+	scene.orthoHeight = camera.orthoHeight;
+	scene.background = load( camera.background );
+
+	scene.surfaces.clear( );
+	for( const SurfaceRecord & record : records.surfaces ) {
+
+		Material material = createMaterial( record.material );
+		vec3 position = load( record.position );
+		shared_ptr<Surface> surface;
+
+		switch( record.type ) {
+		case SurfaceType::SPHERE:
+			surface = make_shared<Sphere>( position, record.size[0], material.diffuseColor );
+			break;
+		case SurfaceType::PLANE:
+			surface = make_shared<Plane>( position, load( record.direction ), material.diffuseColor );
+			break;
+		case SurfaceType::ELLIPSOID:
+			surface = make_shared<Ellipsoid>( position, material, record.size[0], record.size[1], record.size[2] );
+			break;
+		case SurfaceType::CYLINDER:
+			surface = make_shared<Cylinder>( position, load( record.direction ), material, record.size[0],
+											 record.size[1], record.capped != 0 );
+			break;
+		case SurfaceType::POLYGON: {
+			std::vector<vec3> vertices;
+			for( uint32_t i = 0; i < record.vertexCount; i++ ) {
+				vertices.push_back( load( &records.vertices[3 * size_t( record.firstVertex + i )] ) );
+			}
+			surface = make_shared<SimplePolygon>( vertices, material.diffuseColor );
+			break;
+		}
+		}
+
+		surface->material = material;
+		scene.surfaces.push_back( surface );
+	}
+
+	scene.lights.clear( );
+	for( const LightRecord & record : records.lights ) {
+
+		color lightColor = load( record.lightColor );
+		shared_ptr<LightSource> light;
+
+		switch( record.type ) {
+		case LightType::AMBIENT:
+			light = make_shared<LightSource>( BLACK );
+			light->ambientLightColor = lightColor;
+			break;
+		case LightType::POSITIONAL:
+			light = make_shared<PositionalLight>( load( record.position ), lightColor );
+			break;
+		case LightType::DIRECTIONAL:
+			light = make_shared<DirectionalLight>( load( record.direction ), lightColor );
+			break;
+		case LightType::SPOTLIGHT:
+			light = make_shared<Spotlight>( load( record.position ), load( record.direction ),
+											glm::cos( glm::radians( record.cutoff ) ), lightColor );
+			break;
+		}
+
+		scene.lights.push_back( light );
+	}
+
+} // end createScene
+
+
+/**
+* Copies an array out of the contents of a cache and advances past it.
+*/
+template <class T>
+static void readArray( const unsigned char * & cursor, std::vector<T> & values, size_t count )
+{
+	values.resize( count );
+	if( count > 0 ) {
+		memcpy( values.data( ), cursor, count * sizeof( T ) );
+	}
+	cursor += count * sizeof( T );
+
+} // end readArray
+
+
+/**
+* Reads a cache written by writeSceneCache for the current contents of the
+* scene file.
+* @return false if the cache is missing, was compiled from other contents or
+* by a build with another layout, or is damaged
+*/
+static bool readSceneCache( const string & cacheName, uint64_t sourceSize, uint64_t sourceHash,
+							SceneRecords & records, BVH & hierarchy )
+{
+	MappedFile file;
+	if( !file.open( cacheName ) || file.getSize( ) < sizeof( SceneCacheHeader ) ) {
+		return false;
+	}
+
+	SceneCacheHeader header;
+	memcpy( &header, file.getData( ), sizeof( header ) );
+
+	if( memcmp( header.magic, SCENE_CACHE_MAGIC, sizeof( header.magic ) ) != 0 ||
+		header.version != SCENE_CACHE_VERSION || header.realSize != sizeof( real ) ||
+		header.surfaceRecordSize != sizeof( SurfaceRecord ) || header.lightRecordSize != sizeof( LightRecord ) ||
+		header.nodeSize != sizeof( BVH::Node ) || header.sourceSize != sourceSize || header.sourceHash != sourceHash ) {
+		return false;
+	}
+
+	uint64_t expectedSize = sizeof( SceneCacheHeader ) + sizeof( CameraRecord ) +
+							uint64_t( header.surfaceCount ) * sizeof( SurfaceRecord ) +
+							uint64_t( header.vertexCount ) * 3 * sizeof( real ) +
+							uint64_t( header.lightCount ) * sizeof( LightRecord ) +
+							uint64_t( header.nodeCount ) * sizeof( BVH::Node ) +
+							uint64_t( header.primitiveIndexCount ) * sizeof( int );
+	if( expectedSize != file.getSize( ) ) {
+		return false;
+	}
+
+	const unsigned char * cursor = file.getData( ) + sizeof( SceneCacheHeader );
+
+	memcpy( &records.camera, cursor, sizeof( CameraRecord ) );
+	cursor += sizeof( CameraRecord );
+
+	std::vector<BVH::Node> nodes;
+	std::vector<int> primitiveIndices;
+
+	readArray( cursor, records.surfaces, header.surfaceCount );
+	readArray( cursor, records.vertices, 3 * size_t( header.vertexCount ) );
+	readArray( cursor, records.lights, header.lightCount );
+	readArray( cursor, nodes, header.nodeCount );
+	readArray( cursor, primitiveIndices, header.primitiveIndexCount );
+
+	for( const SurfaceRecord & surface : records.surfaces ) {
+		if( surface.type > SurfaceType::POLYGON ||
+			( surface.type == SurfaceType::POLYGON &&
+			  ( surface.vertexCount < 3 || uint64_t( surface.firstVertex ) + surface.vertexCount > header.vertexCount ) ) ) {
+			return false;
+		}
+	}
+	for( const LightRecord & light : records.lights ) {
+		if( light.type > LightType::SPOTLIGHT ) {
+			return false;
+		}
+	}
+
+	// Scene::build checks the hierarchy against the surfaces before using it
+	hierarchy.assign( std::move( nodes ), std::move( primitiveIndices ) );
+	return true;
+
+} // end readSceneCache
+
+
+template <class T>
+static void writeArray( std::ofstream & file, const std::vector<T> & values )
+{
+	file.write( (const char *)values.data( ), values.size( ) * sizeof( T ) );
+
+} // end writeArray
+
+
+/**
+* Writes a cache. The file is written under a temporary name and renamed, so
+* that a program loading the scene at the same time never maps half of it.
+* The temporary name holds the process id, because the worker processes of a
+* distributed render load the same scene at the same time.
+*/
+static bool writeSceneCache( const string & cacheName, uint64_t sourceSize, uint64_t sourceHash,
+							 const SceneRecords & records, const BVH & hierarchy )
+{
+	SceneCacheHeader header;
+	memcpy( header.magic, SCENE_CACHE_MAGIC, sizeof( header.magic ) );
+	header.version = SCENE_CACHE_VERSION;
+	header.realSize = sizeof( real );
+	header.surfaceRecordSize = sizeof( SurfaceRecord );
+	header.lightRecordSize = sizeof( LightRecord );
+	header.nodeSize = sizeof( BVH::Node );
+	header.surfaceCount = static_cast<uint32_t>( records.surfaces.size( ) );
+	header.vertexCount = static_cast<uint32_t>( records.vertices.size( ) / 3 );
+	header.lightCount = static_cast<uint32_t>( records.lights.size( ) );
+	header.nodeCount = static_cast<uint32_t>( hierarchy.getNodes( ).size( ) );
+	header.primitiveIndexCount = static_cast<uint32_t>( hierarchy.getPrimitiveIndices( ).size( ) );
+	header.sourceSize = sourceSize;
+	header.sourceHash = sourceHash;
+
+	string temporaryName = cacheName + ".tmp";
+#if defined( __unix__ ) || defined( __APPLE__ )
+	temporaryName += std::to_string( getpid( ) );
+#endif
+	{
+		std::ofstream file( temporaryName.c_str( ), std::ios::binary );
+		if( !file ) {
+			return false;
+		}
+
+		file.write( (const char *)&header, sizeof( header ) );
+		file.write( (const char *)&records.camera, sizeof( CameraRecord ) );
+		writeArray( file, records.surfaces );
+		writeArray( file, records.vertices );
+		writeArray( file, records.lights );
+		writeArray( file, hierarchy.getNodes( ) );
+		writeArray( file, hierarchy.getPrimitiveIndices( ) );
+
+		if( !file.good( ) ) {
+			file.close( );
+			std::remove( temporaryName.c_str( ) );
+			return false;
+		}
+	}
+
+	return std::rename( temporaryName.c_str( ), cacheName.c_str( ) ) == 0;
+
+} // end writeSceneCache
+
+
+bool loadScene( const string & fileName, SceneDescription & scene, string & error, ThreadPool * threadPool )
+{
+	MappedFile source;
+	if( !source.open( fileName ) ) {
+		error = "Could not read " + fileName;
+		return false;
+	}
+
+	uint64_t sourceSize = source.getSize( );
+	uint64_t sourceHash = hashBytes( source.getData( ), source.getSize( ) );
+	string cacheName = getSceneCacheName( fileName );
+
+	SceneRecords records;
+	if( readSceneCache( cacheName, sourceSize, sourceHash, records, scene.hierarchy ) ) {
+		createScene( records, scene );
+		return true;
+	}
+
+	string text( (const char *)source.getData( ), source.getSize( ) );
+	if( !parseScene( text, fileName, records, error ) ) {
+		return false;
+	}
+
+	createScene( records, scene );
+
+	// Build the hierarchy the way committing the scene would
+	Scene compiled;
+	compiled.build( scene.surfaces, threadPool );
+	scene.hierarchy = compiled.getHierarchy( );
+
+	writeSceneCache( cacheName, sourceSize, sourceHash, records, scene.hierarchy );
+	return true;
+
+} // end loadScene
@@ -0,0 +1,110 @@
+#include "SceneGenerator.h"
+
+#include <random>
+
+#include "Sphere.h"
+#include "Cylinder.h"
+#include "Ellipsoid.h"
+#include "SimplePolygon.h"
+#include "SphereSet.h"
+#include "QuadricSet.h"
+#include "CylinderSet.h"
+
+// Region that is filled with generated primitives
+static const vec3 FIELD_MIN( -24.0, -6.0, -70.0 );
+static const vec3 FIELD_MAX( 24.0, 12.0, -14.0 );
+
+
+void generateScene( DemoScene & scene, const SceneGeneratorSettings & settings, ThreadPool * threadPool )
+{
+	buildDemoScene( scene );
+
+	int count = std::max( settings.primitiveCount - static_cast<int>( scene.surfaces.size( ) ), 0 );
+
+	if( count == 0 ) {
+		return;
+	}
+
+	std::mt19937 random( settings.seed );
+	std::uniform_real_distribution<real> unit( 0.0, 1.0 );
+
+	// Give every primitive about the same share of the field and fill a fifth of it
+	vec3 fieldSize = FIELD_MAX - FIELD_MIN;
+	real cellSize = std::cbrt( fieldSize.x * fieldSize.y * fieldSize.z / count );
+	real size = 0.2 * cellSize;
+
+	std::vector<vec3> sphereCenters;
+	std::vector<real> sphereRadii;
+	std::vector<shared_ptr<QuadricSurface>> quadrics;
+	std::vector<shared_ptr<Cylinder>> cylinders;
+
+	for( int i = 0; i < count; i++ ) {
+
+		vec3 position = FIELD_MIN + fieldSize * vec3( unit( random ), unit( random ), unit( random ) );
+		real scale = size * ( 0.5 + unit( random ) );
+		real kind = unit( random );
+
+		if( kind < 0.6 ) {
+
+			if( settings.groupPrimitives ) {
+				sphereCenters.push_back( position );
+				sphereRadii.push_back( scale );
+			}
+			else {
+				scene.surfaces.push_back( make_shared<Sphere>( position, scale, BLUE ) );
+			}
+		}
+		else if( kind < 0.75 ) {
+
+			Material material( color( unit( random ), unit( random ), unit( random ) ) );
+
+			shared_ptr<Cylinder> cylinder = make_shared<Cylinder>( position, material, 0.5 * scale, 2.0 * scale );
+
+			if( settings.groupPrimitives ) {
+				cylinders.push_back( cylinder );
+			}
+			else {
+				scene.surfaces.push_back( cylinder );
+			}
+		}
+		else if( kind < 0.9 ) {
+
+			Material material( color( unit( random ), unit( random ), unit( random ) ) );
+
+			shared_ptr<QuadricSurface> quadric = make_shared<Ellipsoid>( position, material, scale, 0.5 * scale, 0.75 * scale );
+
+			if( settings.groupPrimitives ) {
+				quadrics.push_back( quadric );
+			}
+			else {
+				scene.surfaces.push_back( quadric );
+			}
+		}
+		else {
+
+			// Square with a random orientation
+			vec3 normal = glm::normalize( vec3( unit( random ), unit( random ), unit( random ) ) - real( 0.5 ) + real( 1e-6 ) );
+			vec3 side = glm::normalize( glm::cross( normal, std::abs( normal.x ) < 0.9 ? vec3( 1, 0, 0 ) : vec3( 0, 1, 0 ) ) );
+			vec3 otherSide = glm::cross( normal, side );
+
+			std::vector<vec3> vertices = {
+				position + scale * ( side + otherSide ), position + scale * ( -side + otherSide ),
+				position + scale * ( -side - otherSide ), position + scale * ( side - otherSide ) };
+
+			scene.surfaces.push_back( make_shared<SimplePolygon>( vertices, color( unit( random ), unit( random ), unit( random ) ) ) );
+		}
+	}
+
+	if( !sphereCenters.empty( ) ) {
+		scene.surfaces.push_back( make_shared<SphereSet>( sphereCenters, sphereRadii, Material( BLUE ), threadPool ) );
+	}
+
+	if( !quadrics.empty( ) ) {
+		scene.surfaces.push_back( make_shared<QuadricSet>( quadrics, threadPool ) );
+	}
+
+	if( !cylinders.empty( ) ) {
+		scene.surfaces.push_back( make_shared<CylinderSet>( cylinders, threadPool ) );
+	}
+
+} // end generateScene
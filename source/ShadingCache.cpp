@@ -0,0 +1,84 @@
+#include "ShadingCache.h"
+
+
+/**
+* Copies the components of a color into three floats.
+*/
+static inline void storeColor(float * out, const color & value)
+{
+	out[0] = (float)value.r;
+	out[1] = (float)value.g;
+	out[2] = (float)value.b;
+
+} // end storeColor
+
+
+/**
+* Reads a color stored by storeColor.
+*/
+static inline color loadColor(const float * in)
+{
+	return color(in[0], in[1], in[2]);
+
+} // end loadColor
+
+
+void ShadingCache::resize(int width, int height, int lightCount)
+{
+	this->width = width;
+	this->height = height;
+	this->lightCount = lightCount;
+
+	size_t pixels = (size_t)width * height;
+
+	terms.resize(pixels * lightCount * FLOATS_PER_TERMS);
+	constants.resize(3 * pixels);
+
+} // end resize
+
+
+void ShadingCache::release()
+{
+	*this = ShadingCache();
+
+} // end release
+
+
+void ShadingCache::store(int x, int y, const LightTerms * lightTerms, const color & constant)
+{
+	size_t pixel = index(x, y);
+
+	float * out = &terms[pixel * lightCount * FLOATS_PER_TERMS];
+	for (int light = 0; light < lightCount; light++, out += FLOATS_PER_TERMS) {
+		storeColor(out, lightTerms[light].ambient);
+		storeColor(out + 3, lightTerms[light].diffuse);
+		storeColor(out + 6, lightTerms[light].specular);
+		storeColor(out + 9, lightTerms[light].constant);
+	}
+
+	storeColor(&constants[3 * pixel], constant);
+
+} // end store
+
+
+color ShadingCache::shade(int x, int y, const std::vector<const LightSource *> & lights) const
+{
+	size_t pixel = index(x, y);
+
+	color total = loadColor(&constants[3 * pixel]);
+
+	const float * in = &terms[pixel * lightCount * FLOATS_PER_TERMS];
+	for (int light = 0; light < lightCount; light++, in += FLOATS_PER_TERMS) {
+
+		LightTerms lightTerms;
+		lightTerms.ambient = loadColor(in);
+		lightTerms.diffuse = loadColor(in + 3);
+		lightTerms.specular = loadColor(in + 6);
+		lightTerms.constant = loadColor(in + 9);
+
+		total += lights[light]->combineTerms(lightTerms);
+	}
+
+	return total;
+
+} // end shade
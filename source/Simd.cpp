@@ -0,0 +1,58 @@
+#include "Simd.h"
+
+#include <cstdlib>
+#include <cstring>
+
+
+static SimdLevel detectSimdLevel()
+{
+	SimdLevel level = SimdLevel::SCALAR;
+
+#ifdef RAYTRACER_X86_SIMD
+	// SSE2 is part of every x86-64 processor
+	level = SimdLevel::SSE2;
+
+	__builtin_cpu_init();
+	if( __builtin_cpu_supports( "avx2" ) ) {
+		level = SimdLevel::AVX2;
+	}
+#endif
+
+	const char * requested = std::getenv( "RAYTRACER_SIMD" );
+
+	if( requested != nullptr ) {
+
+		if( std::strcmp( requested, "scalar" ) == 0 ) {
+			level = SimdLevel::SCALAR;
+		}
+		else if( std::strcmp( requested, "sse2" ) == 0 && level > SimdLevel::SSE2 ) {
+			level = SimdLevel::SSE2;
+		}
+	}
+
+	return level;
+
+} // end detectSimdLevel
+
+
+SimdLevel getSimdLevel()
+{
+	static const SimdLevel level = detectSimdLevel();
+
+	return level;
+
+} // end getSimdLevel
+
+
+const char * getSimdLevelName( SimdLevel level )
+{
+	switch( level ) {
+	case SimdLevel::AVX2:
+		return "avx2";
+	case SimdLevel::SSE2:
+		return "sse2";
+	default:
+		return "scalar";
+	}
+
+} // end getSimdLevelName
@@ -1,33 +1,272 @@
 #include "SimplePolygon.h"
 
+#include <numeric>
 
-SimplePolygon::SimplePolygon(std::vector<dvec3> vertices, const color & material)
-    : Plane(vertices, material), vertices(vertices)
+
+/**
+* Twice the signed area of the triangle p, q, r. Positive if the corners are
+* counterclockwise.
+*/
+static real cross2(const vec2 & p, const vec2 & q, const vec2 & r)
+{
+	return (q.x - p.x) * (r.y - p.y) - (q.y - p.y) * (r.x - p.x);
+
+} // end cross2
+
+
+/**
+* Returns the number of times that a sequence of values changes sign. Zeros
+* do not count as either sign.
+*/
+static int countSignChanges(const std::vector<real> & values)
+{
+	int changes = 0;
+	real previous = 0;
+
+	for (real value : values) {
+		if (value != 0) {
+			if (previous != 0 && (value > 0) != (previous > 0)) {
+				changes++;
+			}
+			previous = value;
+		}
+	}
+
+	return changes;
+
+} // end countSignChanges
+
+
+SimplePolygon::SimplePolygon(std::vector<vec3> vertices, const color & material)
+	: Plane(vertices, material), vertices(vertices)
+{
+	size_t count = vertices.size();
+
+	// Newell's method gives the normal of the whole polygon, which does not
+	// depend on the first three vertices being a convex corner
+	vec3 normal(0.0, 0.0, 0.0);
+	for (size_t i = 0; i < count; i++) {
+		const vec3 & p = vertices[i];
+		const vec3 & q = vertices[(i + 1) % count];
+		normal.x += (p.y - q.y) * (p.z + q.z);
+		normal.y += (p.z - q.z) * (p.x + q.x);
+		normal.z += (p.x - q.x) * (p.y + q.y);
+	}
+	if (glm::length(normal) > 0) {
+		n = glm::normalize(normal);
+	}
+
+	// Drop the coordinate in which the polygon is largest when seen along it
+	int dropped = 0;
+	for (int i = 1; i < 3; i++) {
+		if (std::abs(n[i]) > std::abs(n[dropped])) {
+			dropped = i;
+		}
+	}
+	uAxis = (dropped + 1) % 3;
+	vAxis = (dropped + 2) % 3;
+
+	std::vector<vec2> projected(count);
+	for (size_t i = 0; i < count; i++) {
+		projected[i] = vec2(vertices[i][uAxis], vertices[i][vAxis]);
+	}
+
+	real area = 0;
+	for (size_t i = 1; i + 1 < count; i++) {
+		area += cross2(projected[0], projected[i], projected[i + 1]);
+	}
+
+	if (!(area != 0)) {
+
+		// Degenerate polygons cannot be hit
+		convex = false;
+		return;
+	}
+	orientation = area > 0 ? real(1) : real(-1);
+
+	// Convex if every corner turns the same way and the edges wind around once,
+	// which is the case when their directions change sign at most twice along
+	// each axis
+	std::vector<real> edgeU(count), edgeV(count);
+	for (size_t i = 0; i < count; i++) {
+
+		const vec2 & p = projected[i];
+		const vec2 & q = projected[(i + 1) % count];
+		const vec2 & r = projected[(i + 2) % count];
+
+		if (cross2(p, q, r) * orientation < 0) {
+			convex = false;
+		}
+
+		edgeU[i] = q.x - p.x;
+		edgeV[i] = q.y - p.y;
+	}
+	if (countSignChanges(edgeU) > 2 || countSignChanges(edgeV) > 2) {
+		convex = false;
+	}
+
+	if (convex) {
+
+		for (size_t k = 1; k < count; k++) {
+			fanLines.push_back(makeEdgeFunction(projected[0], projected[k]));
+		}
+		for (size_t k = 1; k + 1 < count; k++) {
+			fanLines.push_back(makeEdgeFunction(projected[k], projected[k + 1]));
+		}
+	}
+	else {
+		clipEars(projected);
+	}
+
+} // end SimplePolygon constructor
+
+
+SimplePolygon::EdgeFunction SimplePolygon::makeEdgeFunction(const vec2 & p, const vec2 & q) const
+{
+	EdgeFunction line;
+	line.a = (p.y - q.y) * orientation;
+	line.b = (q.x - p.x) * orientation;
+	line.c = -(line.a * p.x + line.b * p.y);
+
+	return line;
+
+} // end makeEdgeFunction
+
+
+/*
+* Repeatedly cuts off a convex corner whose triangle holds no other vertex.
+* Gives up on the rest of the polygon if no such corner is left, which only
+* happens when the edges cross.
+*/
+void SimplePolygon::clipEars(const std::vector<vec2> & projected)
 {
-}
+	std::vector<int> remaining(projected.size());
+	std::iota(remaining.begin(), remaining.end(), 0);
+
+	while (remaining.size() >= 3) {
+
+		size_t count = remaining.size();
+		bool clipped = false;
+
+		for (size_t i = 0; i < count && !clipped; i++) {
+
+			const vec2 & p = projected[remaining[(i + count - 1) % count]];
+			const vec2 & q = projected[remaining[i]];
+			const vec2 & r = projected[remaining[(i + 1) % count]];
+
+			real corner = cross2(p, q, r) * orientation;
+			if (corner < 0 || (corner == 0 && count > 3)) {
+				continue;
+			}
+
+			EdgeFunction edges[3] = { makeEdgeFunction(p, q), makeEdgeFunction(q, r), makeEdgeFunction(r, p) };
+
+			bool empty = true;
+			for (size_t j = 0; j < count && empty; j++) {
 
-HitRecord SimplePolygon::findClosestIntersection(const Ray & ray)
+				const vec2 & s = projected[remaining[j]];
+				if (&s != &p && &s != &q && &s != &r &&
+					edges[0](s.x, s.y) >= 0 && edges[1](s.x, s.y) >= 0 && edges[2](s.x, s.y) >= 0) {
+					empty = false;
+				}
+			}
+
+			if (empty) {
+
+				// Triangles without area would contain every point of their line
+				if (corner > 0) {
+					triangleEdges.insert(triangleEdges.end(), edges, edges + 3);
+				}
+				remaining.erase(remaining.begin() + i);
+				clipped = true;
+			}
+		}
+
+		if (!clipped) {
+			break;
+		}
+	}
+
+} // end clipEars
+
+
+bool SimplePolygon::intersect(const Ray & ray, real tMin, real tMax, RayHit & hit) const
 {
-    HitRecord hr = Plane::findClosestIntersection(ray);
+	return SimplePolygon::intersectFromOrigin(ray, Plane::computeOriginTerm(ray.origin), tMin, tMax, hit);
 
-    if (!intersectionInsidePolygon(hr.interceptPoint)) {
-        hr.t = FLT_MAX;
-    }
+} // end intersect
 
-    return hr;
-}
 
-bool SimplePolygon::intersectionInsidePolygon(dvec3 p)
+bool SimplePolygon::intersectFromOrigin(const Ray & ray, real originTerm, real tMin, real tMax, RayHit & hit) const
 {
-    double curResult;
+	// Only run the inside test if the plane is hit within the interval
+	RayHit planeHit;
+	if (!Plane::intersectFromOrigin(ray, originTerm, tMin, tMax, planeHit) ||
+		!intersectionInsidePolygon(ray.origin + planeHit.t * ray.direct)) {
+		return false;
+	}
+
+	hit = planeHit;
+	return true;
+
+} // end intersectFromOrigin
+
+
+BoundingBox SimplePolygon::bounds() const
+{
+	BoundingBox box;
+	for (const vec3 & vertex : vertices) {
+		box.expand(vertex);
+	}
+
+	// Pad the box so that it has volume even when the polygon is axis aligned
+	box.minPoint -= vec3(EPSILON);
+	box.maxPoint += vec3(EPSILON);
+
+	return box;
+
+} // end bounds
+
+
+bool SimplePolygon::intersectionInsidePolygon(const vec3 & p) const
+{
+	real u = p[uAxis];
+	real v = p[vAxis];
+
+	if (convex) {
+
+		// Lines through the first vertex, and edges that close the fan triangles
+		int lineCount = static_cast<int>(vertices.size()) - 1;
+		const EdgeFunction * lines = fanLines.data();
+		const EdgeFunction * edges = lines + lineCount;
+
+		// Outside of the two edges that meet at the first vertex
+		if (lines[0](u, v) <= 0 || lines[lineCount - 1](u, v) >= 0) {
+			return false;
+		}
+
+		// Find the fan triangle whose corner at the first vertex holds the point
+		int low = 0;
+		int high = lineCount - 1;
+		while (high - low > 1) {
+			int middle = (low + high) / 2;
+			if (lines[middle](u, v) >= 0) {
+				low = middle;
+			}
+			else {
+				high = middle;
+			}
+		}
+
+		return edges[low](u, v) > 0;
+	}
+
+	for (size_t i = 0; i < triangleEdges.size(); i += 3) {
+		if (triangleEdges[i](u, v) >= 0 && triangleEdges[i + 1](u, v) >= 0 && triangleEdges[i + 2](u, v) >= 0) {
+			return true;
+		}
+	}
 
-    for (int i = 0; i < vertices.size(); i++) {
-        curResult = glm::dot(glm::cross(vertices[(i+1) % vertices.size()] - vertices[i], p - vertices[i]), n);
-        if (curResult <= 0) 
-        {
-            return false;
-        }
-    }
+	return false;
 
-    return true;
-}
+} // end intersectionInsidePolygon
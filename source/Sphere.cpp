@@ -1,77 +1,146 @@
 #include "Sphere.h"
 
 
-Sphere::Sphere(const dvec3 & position, double radius, const color & material)
+Sphere::Sphere(const vec3 & position, real radius, const color & material)
 	: Surface(material), center(position), radius(radius)
 {
 }
 
 /*
-* Checks a ray for intersection with the surface. Finds the closest point of intersection
-* if one exits. Returns a HitRecord with the t parmeter set to FLT_MAX if there is no
-* intersection.
+* Checks a ray for intersection with the surface. Finds the parameter of the closest
+* point of intersection within the interval [tMin, tMax) if one exits.
 */
-HitRecord Sphere::findClosestIntersection( const Ray & ray )
+bool Sphere::intersect( const Ray & ray, real tMin, real tMax, RayHit & hit ) const
 {
-	HitRecord hitRecord;
+	return Sphere::intersectFromOrigin( ray, Sphere::computeOriginTerm( ray.origin ), tMin, tMax, hit );
+
+} // end intersect
+
+
+/*
+* The constant term of the quadratic equation, |o - c|^2 - r^2.
+*/
+real Sphere::computeOriginTerm( const vec3 & origin ) const
+{
+	vec3 toOrigin = origin - center;
+
+	return glm::dot(toOrigin, toOrigin) - radius * radius;
+
+} // end computeOriginTerm
+
+
+bool Sphere::intersectFromOrigin( const Ray & ray, real originTerm, real tMin, real tMax, RayHit & hit ) const
+{
+	vec3 toOrigin = ray.origin - center;
+
+	real a = glm::dot(ray.direct, ray.direct);
+	real b = glm::dot(ray.direct, toOrigin);
+	real c = originTerm;
 
 	// Calculate the discriminant to determine if there are any intersections.
-	double discriminant = pow(glm::dot(ray.direct, ray.origin - center), 2) - dot(ray.direct, ray.direct)*(glm::dot(ray.origin - center, ray.origin - center) - radius * radius);
+	real discriminant = b * b - a * c;
 
-	if( discriminant >= 0 ) {
+	if( discriminant < 0 ) {
+		return false;
+	}
 
-		double t = FLT_MAX;
+	// The intercepts lie sqrt(discriminant) / a on either side of the point on
+	// the ray that is closest to the center. Comparing squared distances rejects
+	// spheres that lie entirely outside the interval without taking the root.
+	real tClosest = -b / a;
 
-		if( discriminant > 0 ) {
+	real beyondMax = tClosest - tMax;
+	if( beyondMax >= 0 && beyondMax * beyondMax * a * a >= discriminant ) {
+		return false;
+	}
 
-			// Two intercepts. Find and return the closest one.
-			double t1 = (glm::dot(-ray.direct, ray.origin - center) - sqrt(discriminant)) / dot(ray.direct, ray.direct);
-			double t2 = (glm::dot(-ray.direct, ray.origin - center) + sqrt(discriminant)) / dot(ray.direct, ray.direct);
-	
-			if (t1 < 0) {
-				t1 = FLT_MAX;
-			}
-			if (t2 < 0) {
-				t2 = FLT_MAX;
-			}
+	real beforeMin = tMin - tClosest;
+	if( beforeMin > 0 && beforeMin * beforeMin * a * a > discriminant ) {
+		return false;
+	}
 
-			if (t1 < t2) {
+	real halfChord = sqrt(discriminant) / a;
 
-				t = t1;
-			}
-			else {
+	// Use the near intercept unless it is before the start of the interval.
+	real t = tClosest - halfChord;
+	if( t < tMin ) {
+		t = tClosest + halfChord;
+	}
 
-				t = t2;
-			}
-		}
-		else {
-			// One Intercept. Find and return the t for the single point of intersection.
-			t = glm::dot(-ray.direct, ray.origin - center) / dot(ray.direct, ray.direct);
-			if (t < 0) {
-				t = FLT_MAX;
-			}
-		}
+	if( t < tMin || t >= tMax ) {
+		return false;
+	}
+
+	hit.t = t;
+	hit.element = 0;
+	return true;
+
+} // end intersectFromOrigin
+
+
+unsigned Sphere::intersectPacket( const RayPacket & packet, unsigned laneMask, real tMin,
+								  real tMax[], RayHit hits[] ) const
+{
+	unsigned hitMask = 0;
 
-		// Set hit record information about the intersetion.
-		hitRecord.t = t;
-		hitRecord.interceptPoint = ray.origin + t * ray.direct;
-		
-		dvec3 n = glm::normalize(hitRecord.interceptPoint - center);
-		
-		// Check for back face intersection
-		if (glm::dot(n, ray.direct) > 0) {
+	for( int lane = 0; lane < packet.size; lane++ ) {
 
-			n = -n; // reverse the normal
+		if( ( laneMask & ( 1u << lane ) ) && Sphere::intersect( packet.getRay( lane ), tMin, tMax[lane], hits[lane] ) ) {
+			tMax[lane] = hits[lane].t;
+			hitMask |= 1u << lane;
 		}
+	}
+
+	return hitMask;
+
+} // end intersectPacket
+
+
+unsigned Sphere::intersectPacketFromOrigin( const RayPacket & packet, real originTerm, unsigned laneMask,
+											real tMin, real tMax[], RayHit hits[] ) const
+{
+	unsigned hitMask = 0;
+
+	for( int lane = 0; lane < packet.size; lane++ ) {
 
-		hitRecord.surfaceNormal = n;
-		hitRecord.material = material;
+		if( ( laneMask & ( 1u << lane ) ) &&
+			Sphere::intersectFromOrigin( packet.getRay( lane ), originTerm, tMin, tMax[lane], hits[lane] ) ) {
+			tMax[lane] = hits[lane].t;
+			hitMask |= 1u << lane;
+		}
 	}
-	else {
-		// Set parameter, t, in the hit record to indicate "no intersection."
-		hitRecord.t = FLT_MAX;
+
+	return hitMask;
+
+} // end intersectPacketFromOrigin
+
+
+/*
+* Computes the point of intersection, normal, and material for a hit found by
+* intersect.
+*/
+void Sphere::completeHitRecord( const Ray & ray, const RayHit & hit, HitRecord & hitRecord ) const
+{
+	// Set hit record information about the intersetion.
+	hitRecord.t = hit.t;
+	hitRecord.interceptPoint = ray.origin + hit.t * ray.direct;
+
+	vec3 n = glm::normalize(hitRecord.interceptPoint - center);
+
+	// Check for back face intersection
+	if (glm::dot(n, ray.direct) > 0) {
+
+		n = -n; // reverse the normal
 	}
 
-	return hitRecord;
+	hitRecord.surfaceNormal = n;
+	hitRecord.material = &material;
+
+} // end completeHitRecord
+
+
+BoundingBox Sphere::bounds( ) const
+{
+	return BoundingBox( center - vec3( radius ), center + vec3( radius ) );
 
-} // end findClosestIntersection
\ No newline at end of file
+} // end bounds
\ No newline at end of file
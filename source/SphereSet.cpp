@@ -0,0 +1,659 @@
+#include "SphereSet.h"
+
+#include <algorithm>
+#include <limits>
+
+// Spheres per leaf of the hierarchy. Two groups of lanes per leaf.
+static const int MAX_LEAF_SIZE = 2 * SphereSet::LANE_GROUP_SIZE;
+
+
+/*
+* Reference kernel. Also used on processors without SSE2 or AVX2. Because the
+* ray direction is a unit vector, the quadratic reduces to t*t + 2bt + c = 0.
+* Its discriminant b*b - c is computed as the squared radius minus the squared
+* distance from the center to the line of the ray, which does not lose digits
+* to cancellation when the sphere is far away, as b*b - c does in single
+* precision.
+*/
+static bool intersectScalar( const SphereSet::Lanes & lanes, int begin, int end, const Ray & ray,
+							 real tMin, real & tMax, int & hitSlot, bool anyHit )
+{
+	bool found = false;
+
+	for( int slot = begin; slot < end; slot++ ) {
+
+		real ocX = ray.origin.x - lanes.centerX[slot];
+		real ocY = ray.origin.y - lanes.centerY[slot];
+		real ocZ = ray.origin.z - lanes.centerZ[slot];
+
+		real b = ray.direct.x * ocX + ray.direct.y * ocY + ray.direct.z * ocZ;
+		real pX = ocX - b * ray.direct.x;
+		real pY = ocY - b * ray.direct.y;
+		real pZ = ocZ - b * ray.direct.z;
+		real discriminant = lanes.radiusSquared[slot] - ( pX * pX + pY * pY + pZ * pZ );
+
+		if( discriminant < 0 ) {
+			continue;
+		}
+
+		real halfChord = std::sqrt( discriminant );
+
+		// Use the near intercept unless it is before the start of the interval
+		real t = -b - halfChord;
+		if( t < tMin ) {
+			t = -b + halfChord;
+		}
+
+		if( t >= tMin && t < tMax ) {
+
+			tMax = t;
+			hitSlot = slot;
+			found = true;
+
+			if( anyHit ) {
+				return true;
+			}
+		}
+	}
+
+	return found;
+
+} // end intersectScalar
+
+
+/*
+* Reference packet kernel. Tests every sphere against one ray at a time.
+*/
+static unsigned intersectPacketScalar( const SphereSet::Lanes & lanes, int begin, int end,
+									   const SphereSet::PacketRays & rays, unsigned laneMask, real tMin,
+									   real tMax[], int hitSlots[] )
+{
+	unsigned hitMask = 0;
+
+	for( int slot = begin; slot < end; slot++ ) {
+
+		for( int lane = 0; lane < rays.size; lane++ ) {
+
+			if( !( laneMask & ( 1u << lane ) ) ) {
+				continue;
+			}
+
+			real ocX = rays.originX[lane] - lanes.centerX[slot];
+			real ocY = rays.originY[lane] - lanes.centerY[slot];
+			real ocZ = rays.originZ[lane] - lanes.centerZ[slot];
+
+			real b = rays.directX[lane] * ocX + rays.directY[lane] * ocY + rays.directZ[lane] * ocZ;
+			real pX = ocX - b * rays.directX[lane];
+			real pY = ocY - b * rays.directY[lane];
+			real pZ = ocZ - b * rays.directZ[lane];
+			real discriminant = lanes.radiusSquared[slot] - ( pX * pX + pY * pY + pZ * pZ );
+
+			if( discriminant < 0 ) {
+				continue;
+			}
+
+			real halfChord = std::sqrt( discriminant );
+
+			real t = -b - halfChord;
+			if( t < tMin ) {
+				t = -b + halfChord;
+			}
+
+			if( t >= tMin && t < tMax[lane] ) {
+				tMax[lane] = t;
+				hitSlots[lane] = slot;
+				hitMask |= 1u << lane;
+			}
+		}
+	}
+
+	return hitMask;
+
+} // end intersectPacketScalar
+
+
+#ifdef RAYTRACER_X86_SIMD
+
+/*
+* Tests SSE2_LANES spheres per instruction: two in double precision and four
+* in single precision.
+*/
+static bool intersectSse2( const SphereSet::Lanes & lanes, int begin, int end, const Ray & ray,
+						   real tMin, real & tMax, int & hitSlot, bool anyHit )
+{
+	const Sse2Real originX = sse2Set( ray.origin.x );
+	const Sse2Real originY = sse2Set( ray.origin.y );
+	const Sse2Real originZ = sse2Set( ray.origin.z );
+	const Sse2Real directX = sse2Set( ray.direct.x );
+	const Sse2Real directY = sse2Set( ray.direct.y );
+	const Sse2Real directZ = sse2Set( ray.direct.z );
+	const Sse2Real start = sse2Set( tMin );
+	const Sse2Real zero = sse2Zero();
+
+	bool found = false;
+
+	for( int slot = begin; slot < end; slot += SSE2_LANES ) {
+
+		Sse2Real ocX = sse2Sub( originX, sse2LoadUnaligned( &lanes.centerX[slot] ) );
+		Sse2Real ocY = sse2Sub( originY, sse2LoadUnaligned( &lanes.centerY[slot] ) );
+		Sse2Real ocZ = sse2Sub( originZ, sse2LoadUnaligned( &lanes.centerZ[slot] ) );
+
+		Sse2Real b = sse2Add( sse2Add( sse2Mul( directX, ocX ), sse2Mul( directY, ocY ) ), sse2Mul( directZ, ocZ ) );
+		Sse2Real pX = sse2Sub( ocX, sse2Mul( b, directX ) );
+		Sse2Real pY = sse2Sub( ocY, sse2Mul( b, directY ) );
+		Sse2Real pZ = sse2Sub( ocZ, sse2Mul( b, directZ ) );
+		Sse2Real discriminant = sse2Sub( sse2LoadUnaligned( &lanes.radiusSquared[slot] ),
+									   sse2Add( sse2Add( sse2Mul( pX, pX ), sse2Mul( pY, pY ) ), sse2Mul( pZ, pZ ) ) );
+
+		Sse2Real hit = sse2GreaterEqual( discriminant, zero );
+		if( sse2Mask( hit ) == 0 ) {
+			continue;
+		}
+
+		Sse2Real halfChord = sse2Sqrt( sse2Max( discriminant, zero ) );
+		Sse2Real minusB = sse2Sub( zero, b );
+		Sse2Real nearT = sse2Sub( minusB, halfChord );
+		Sse2Real farT = sse2Add( minusB, halfChord );
+
+		Sse2Real t = sse2Select( sse2Less( nearT, start ), farT, nearT );
+
+		hit = sse2And( hit, sse2GreaterEqual( t, start ) );
+		hit = sse2And( hit, sse2Less( t, sse2Set( tMax ) ) );
+
+		int mask = sse2Mask( hit );
+		if( mask == 0 ) {
+			continue;
+		}
+
+		real tLanes[SSE2_LANES];
+		sse2Store( tLanes, t );
+
+		for( int lane = 0; lane < SSE2_LANES; lane++ ) {
+
+			if( ( mask & ( 1 << lane ) ) && tLanes[lane] < tMax ) {
+
+				tMax = tLanes[lane];
+				hitSlot = slot + lane;
+				found = true;
+
+				if( anyHit ) {
+					return true;
+				}
+			}
+		}
+	}
+
+	return found;
+
+} // end intersectSse2
+
+
+/*
+* Tests AVX2_LANES spheres per instruction: four in double precision and eight
+* in single precision. Compiled for AVX2 regardless of the compiler flags and
+* only called when the processor supports it.
+*/
+RAYTRACER_AVX2
+static bool intersectAvx2( const SphereSet::Lanes & lanes, int begin, int end, const Ray & ray,
+						   real tMin, real & tMax, int & hitSlot, bool anyHit )
+{
+	const Avx2Real originX = avx2Set( ray.origin.x );
+	const Avx2Real originY = avx2Set( ray.origin.y );
+	const Avx2Real originZ = avx2Set( ray.origin.z );
+	const Avx2Real directX = avx2Set( ray.direct.x );
+	const Avx2Real directY = avx2Set( ray.direct.y );
+	const Avx2Real directZ = avx2Set( ray.direct.z );
+	const Avx2Real start = avx2Set( tMin );
+	const Avx2Real zero = avx2Zero();
+
+	bool found = false;
+
+	for( int slot = begin; slot < end; slot += AVX2_LANES ) {
+
+		Avx2Real ocX = avx2Sub( originX, avx2LoadUnaligned( &lanes.centerX[slot] ) );
+		Avx2Real ocY = avx2Sub( originY, avx2LoadUnaligned( &lanes.centerY[slot] ) );
+		Avx2Real ocZ = avx2Sub( originZ, avx2LoadUnaligned( &lanes.centerZ[slot] ) );
+
+		Avx2Real b = avx2Add( avx2Add( avx2Mul( directX, ocX ), avx2Mul( directY, ocY ) ), avx2Mul( directZ, ocZ ) );
+		Avx2Real pX = avx2Sub( ocX, avx2Mul( b, directX ) );
+		Avx2Real pY = avx2Sub( ocY, avx2Mul( b, directY ) );
+		Avx2Real pZ = avx2Sub( ocZ, avx2Mul( b, directZ ) );
+		Avx2Real discriminant = avx2Sub( avx2LoadUnaligned( &lanes.radiusSquared[slot] ),
+									   avx2Add( avx2Add( avx2Mul( pX, pX ), avx2Mul( pY, pY ) ), avx2Mul( pZ, pZ ) ) );
+
+		Avx2Real hit = avx2GreaterEqual( discriminant, zero );
+		if( avx2Mask( hit ) == 0 ) {
+			continue;
+		}
+
+		Avx2Real halfChord = avx2Sqrt( avx2Max( discriminant, zero ) );
+		Avx2Real minusB = avx2Sub( zero, b );
+		Avx2Real nearT = avx2Sub( minusB, halfChord );
+		Avx2Real farT = avx2Add( minusB, halfChord );
+
+		Avx2Real t = avx2Select( avx2Less( nearT, start ), farT, nearT );
+
+		hit = avx2And( hit, avx2GreaterEqual( t, start ) );
+		hit = avx2And( hit, avx2Less( t, avx2Set( tMax ) ) );
+
+		int mask = avx2Mask( hit );
+		if( mask == 0 ) {
+			continue;
+		}
+
+		real tLanes[AVX2_LANES];
+		avx2Store( tLanes, t );
+
+		for( int lane = 0; lane < AVX2_LANES; lane++ ) {
+
+			if( ( mask & ( 1 << lane ) ) && tLanes[lane] < tMax ) {
+
+				tMax = tLanes[lane];
+				hitSlot = slot + lane;
+				found = true;
+
+				if( anyHit ) {
+					return true;
+				}
+			}
+		}
+	}
+
+	return found;
+
+} // end intersectAvx2
+
+/*
+* Tests one sphere against SSE2_LANES rays of a packet per instruction.
+*/
+static unsigned intersectPacketSse2( const SphereSet::Lanes & lanes, int begin, int end,
+									 const SphereSet::PacketRays & rays, unsigned laneMask, real tMin,
+									 real tMax[], int hitSlots[] )
+{
+	const Sse2Real start = sse2Set( tMin );
+	const Sse2Real zero = sse2Zero();
+	const int laneBits = ( 1 << SSE2_LANES ) - 1;
+
+	unsigned hitMask = 0;
+
+	for( int slot = begin; slot < end; slot++ ) {
+
+		const Sse2Real centerX = sse2Set( lanes.centerX[slot] );
+		const Sse2Real centerY = sse2Set( lanes.centerY[slot] );
+		const Sse2Real centerZ = sse2Set( lanes.centerZ[slot] );
+		const Sse2Real radiusSquared = sse2Set( lanes.radiusSquared[slot] );
+
+		for( int lane = 0; lane < rays.size; lane += SSE2_LANES ) {
+
+			int groupMask = ( laneMask >> lane ) & laneBits;
+			if( groupMask == 0 ) {
+				continue;
+			}
+
+			Sse2Real ocX = sse2Sub( sse2Load( &rays.originX[lane] ), centerX );
+			Sse2Real ocY = sse2Sub( sse2Load( &rays.originY[lane] ), centerY );
+			Sse2Real ocZ = sse2Sub( sse2Load( &rays.originZ[lane] ), centerZ );
+
+			Sse2Real directX = sse2Load( &rays.directX[lane] );
+			Sse2Real directY = sse2Load( &rays.directY[lane] );
+			Sse2Real directZ = sse2Load( &rays.directZ[lane] );
+
+			Sse2Real b = sse2Add( sse2Add( sse2Mul( directX, ocX ), sse2Mul( directY, ocY ) ), sse2Mul( directZ, ocZ ) );
+			Sse2Real pX = sse2Sub( ocX, sse2Mul( b, directX ) );
+			Sse2Real pY = sse2Sub( ocY, sse2Mul( b, directY ) );
+			Sse2Real pZ = sse2Sub( ocZ, sse2Mul( b, directZ ) );
+			Sse2Real discriminant = sse2Sub( radiusSquared,
+									   sse2Add( sse2Add( sse2Mul( pX, pX ), sse2Mul( pY, pY ) ), sse2Mul( pZ, pZ ) ) );
+
+			Sse2Real hit = sse2GreaterEqual( discriminant, zero );
+			if( ( sse2Mask( hit ) & groupMask ) == 0 ) {
+				continue;
+			}
+
+			Sse2Real halfChord = sse2Sqrt( sse2Max( discriminant, zero ) );
+			Sse2Real minusB = sse2Sub( zero, b );
+			Sse2Real nearT = sse2Sub( minusB, halfChord );
+			Sse2Real farT = sse2Add( minusB, halfChord );
+
+			Sse2Real t = sse2Select( sse2Less( nearT, start ), farT, nearT );
+
+			hit = sse2And( hit, sse2GreaterEqual( t, start ) );
+			hit = sse2And( hit, sse2Less( t, sse2LoadUnaligned( &tMax[lane] ) ) );
+
+			int mask = sse2Mask( hit ) & groupMask;
+			if( mask == 0 ) {
+				continue;
+			}
+
+			real tLanes[SSE2_LANES];
+			sse2Store( tLanes, t );
+
+			for( int i = 0; i < SSE2_LANES; i++ ) {
+				if( mask & ( 1 << i ) ) {
+					tMax[lane + i] = tLanes[i];
+					hitSlots[lane + i] = slot;
+					hitMask |= 1u << ( lane + i );
+				}
+			}
+		}
+	}
+
+	return hitMask;
+
+} // end intersectPacketSse2
+
+
+/*
+* Tests one sphere against AVX2_LANES rays of a packet per instruction.
+*/
+RAYTRACER_AVX2
+static unsigned intersectPacketAvx2( const SphereSet::Lanes & lanes, int begin, int end,
+									 const SphereSet::PacketRays & rays, unsigned laneMask, real tMin,
+									 real tMax[], int hitSlots[] )
+{
+	const Avx2Real start = avx2Set( tMin );
+	const Avx2Real zero = avx2Zero();
+	const int laneBits = ( 1 << AVX2_LANES ) - 1;
+
+	unsigned hitMask = 0;
+
+	for( int slot = begin; slot < end; slot++ ) {
+
+		const Avx2Real centerX = avx2Set( lanes.centerX[slot] );
+		const Avx2Real centerY = avx2Set( lanes.centerY[slot] );
+		const Avx2Real centerZ = avx2Set( lanes.centerZ[slot] );
+		const Avx2Real radiusSquared = avx2Set( lanes.radiusSquared[slot] );
+
+		for( int lane = 0; lane < rays.size; lane += AVX2_LANES ) {
+
+			int groupMask = ( laneMask >> lane ) & laneBits;
+			if( groupMask == 0 ) {
+				continue;
+			}
+
+			Avx2Real ocX = avx2Sub( avx2Load( &rays.originX[lane] ), centerX );
+			Avx2Real ocY = avx2Sub( avx2Load( &rays.originY[lane] ), centerY );
+			Avx2Real ocZ = avx2Sub( avx2Load( &rays.originZ[lane] ), centerZ );
+
+			Avx2Real directX = avx2Load( &rays.directX[lane] );
+			Avx2Real directY = avx2Load( &rays.directY[lane] );
+			Avx2Real directZ = avx2Load( &rays.directZ[lane] );
+
+			Avx2Real b = avx2Add( avx2Add( avx2Mul( directX, ocX ), avx2Mul( directY, ocY ) ), avx2Mul( directZ, ocZ ) );
+			Avx2Real pX = avx2Sub( ocX, avx2Mul( b, directX ) );
+			Avx2Real pY = avx2Sub( ocY, avx2Mul( b, directY ) );
+			Avx2Real pZ = avx2Sub( ocZ, avx2Mul( b, directZ ) );
+			Avx2Real discriminant = avx2Sub( radiusSquared,
+									   avx2Add( avx2Add( avx2Mul( pX, pX ), avx2Mul( pY, pY ) ), avx2Mul( pZ, pZ ) ) );
+
+			Avx2Real hit = avx2GreaterEqual( discriminant, zero );
+			if( ( avx2Mask( hit ) & groupMask ) == 0 ) {
+				continue;
+			}
+
+			Avx2Real halfChord = avx2Sqrt( avx2Max( discriminant, zero ) );
+			Avx2Real minusB = avx2Sub( zero, b );
+			Avx2Real nearT = avx2Sub( minusB, halfChord );
+			Avx2Real farT = avx2Add( minusB, halfChord );
+
+			Avx2Real t = avx2Select( avx2Less( nearT, start ), farT, nearT );
+
+			hit = avx2And( hit, avx2GreaterEqual( t, start ) );
+			hit = avx2And( hit, avx2Less( t, avx2LoadUnaligned( &tMax[lane] ) ) );
+
+			int mask = avx2Mask( hit ) & groupMask;
+			if( mask == 0 ) {
+				continue;
+			}
+
+			real tLanes[AVX2_LANES];
+			avx2Store( tLanes, t );
+
+			for( int i = 0; i < AVX2_LANES; i++ ) {
+				if( mask & ( 1 << i ) ) {
+					tMax[lane + i] = tLanes[i];
+					hitSlots[lane + i] = slot;
+					hitMask |= 1u << ( lane + i );
+				}
+			}
+		}
+	}
+
+	return hitMask;
+
+} // end intersectPacketAvx2
+
+#endif // RAYTRACER_X86_SIMD
+
+
+SphereSet::SphereSet( const std::vector<vec3> & centers, const std::vector<real> & radii,
+					  const Material & mat, ThreadPool * threadPool )
+	: Surface( mat ), centers( centers ), radii( radii ),
+	  kernel( getKernel( getSimdLevel() ) ), packetKernel( getPacketKernel( getSimdLevel() ) )
+{
+	std::vector<BoundingBox> sphereBounds( centers.size() );
+
+	for( size_t i = 0; i < centers.size(); i++ ) {
+		sphereBounds[i] = BoundingBox( centers[i] - vec3( radii[i] ), centers[i] + vec3( radii[i] ) );
+	}
+
+	bvh.build( sphereBounds, threadPool, MAX_LEAF_SIZE );
+
+	fillLanes();
+
+} // end SphereSet constructor
+
+
+SphereSet::Kernel SphereSet::getKernel( SimdLevel level )
+{
+#ifdef RAYTRACER_X86_SIMD
+	if( level == SimdLevel::AVX2 ) {
+		return intersectAvx2;
+	}
+	if( level == SimdLevel::SSE2 ) {
+		return intersectSse2;
+	}
+#endif
+	return intersectScalar;
+
+} // end getKernel
+
+
+SphereSet::PacketKernel SphereSet::getPacketKernel( SimdLevel level )
+{
+#ifdef RAYTRACER_X86_SIMD
+	if( level == SimdLevel::AVX2 ) {
+		return intersectPacketAvx2;
+	}
+	if( level == SimdLevel::SSE2 ) {
+		return intersectPacketSse2;
+	}
+#endif
+	return intersectPacketScalar;
+
+} // end getPacketKernel
+
+
+void SphereSet::fillLanes( )
+{
+	const std::vector<BVH::Node> & nodes = bvh.getNodes();
+	const std::vector<int> & primitiveIndices = bvh.getPrimitiveIndices();
+
+	// Lay the leaves out in the order of the primitive index list, which keeps
+	// spheres that are close in space close in memory.
+	std::vector<const BVH::Node *> leaves;
+	for( const BVH::Node & node : nodes ) {
+		if( node.isLeaf() ) {
+			leaves.push_back( &node );
+		}
+	}
+	std::sort( leaves.begin(), leaves.end(), []( const BVH::Node * a, const BVH::Node * b ) {
+		return a->firstIndex < b->firstIndex;
+	} );
+
+	lanes = Lanes();
+	leafSlots.assign( primitiveIndices.size(), -1 );
+
+	for( const BVH::Node * leaf : leaves ) {
+
+		leafSlots[leaf->firstIndex] = static_cast<int>( lanes.sphere.size() );
+
+		int paddedCount = ( leaf->primitiveCount + LANE_GROUP_SIZE - 1 ) / LANE_GROUP_SIZE * LANE_GROUP_SIZE;
+
+		for( int i = 0; i < paddedCount; i++ ) {
+
+			if( i < leaf->primitiveCount ) {
+
+				int sphere = primitiveIndices[leaf->firstIndex + i];
+				lanes.centerX.push_back( centers[sphere].x );
+				lanes.centerY.push_back( centers[sphere].y );
+				lanes.centerZ.push_back( centers[sphere].z );
+				lanes.radiusSquared.push_back( radii[sphere] * radii[sphere] );
+				lanes.sphere.push_back( sphere );
+			}
+			else {
+
+				// A negative squared radius makes the discriminant negative for every ray
+				lanes.centerX.push_back( 0.0 );
+				lanes.centerY.push_back( 0.0 );
+				lanes.centerZ.push_back( 0.0 );
+				lanes.radiusSquared.push_back( -std::numeric_limits<real>::max() );
+				lanes.sphere.push_back( -1 );
+			}
+		}
+	}
+
+} // end fillLanes
+
+
+/*
+* Checks a ray for intersection with every sphere in the collection. Finds the
+* parameter of the closest point of intersection within [tMin, tMax) if one exits.
+*/
+bool SphereSet::intersect( const Ray & ray, real tMin, real tMax, RayHit & hit ) const
+{
+	int hitSlot = -1;
+	real limit = tMax;
+
+	bvh.traverseLeaves( ray, tMin, tMax, [&]( const BVH::Node & leaf, real & tMax ) {
+
+		int begin = leafSlots[leaf.firstIndex];
+		int end = begin + ( leaf.primitiveCount + LANE_GROUP_SIZE - 1 ) / LANE_GROUP_SIZE * LANE_GROUP_SIZE;
+
+		kernel( lanes, begin, end, ray, tMin, limit, hitSlot, false );
+		tMax = limit;
+		return false;
+	} );
+
+	if( hitSlot < 0 ) {
+		return false;
+	}
+
+	hit.t = limit;
+	hit.element = lanes.sphere[hitSlot];
+	return true;
+
+} // end intersect
+
+
+unsigned SphereSet::intersectPacket( const RayPacket & packet, unsigned laneMask, real tMin,
+									 real tMax[], RayHit hits[] ) const
+{
+	int hitSlots[RayPacket::MAX_SIZE];
+	unsigned hitMask = 0;
+
+	PacketRays rays;
+	rays.size = packet.size;
+
+#ifdef RAYTRACER_SINGLE_PRECISION
+	// The packet keeps its rays in double precision. They are converted once
+	// for all of the leaves rather than in every kernel call.
+	alignas( 32 ) real converted[6][RayPacket::MAX_SIZE];
+	const double * components[6] = { packet.originX, packet.originY, packet.originZ,
+									  packet.directX, packet.directY, packet.directZ };
+	for( int i = 0; i < 6; i++ ) {
+		std::copy( components[i], components[i] + RayPacket::MAX_SIZE, converted[i] );
+	}
+	rays.originX = converted[0];
+	rays.originY = converted[1];
+	rays.originZ = converted[2];
+	rays.directX = converted[3];
+	rays.directY = converted[4];
+	rays.directZ = converted[5];
+#else
+	rays.originX = packet.originX;
+	rays.originY = packet.originY;
+	rays.originZ = packet.originZ;
+	rays.directX = packet.directX;
+	rays.directY = packet.directY;
+	rays.directZ = packet.directZ;
+#endif
+
+	bvh.traversePacket( packet, laneMask, tMin, tMax, [&]( const BVH::Node & leaf, unsigned leafMask ) {
+
+		// Only the occupied slots of the leaf are tested. Each sphere is tested
+		// against several rays at a time. The kernel lowers the limits that the
+		// traversal culls with.
+		int begin = leafSlots[leaf.firstIndex];
+
+		hitMask |= packetKernel( lanes, begin, begin + leaf.primitiveCount, rays, leafMask, tMin, tMax, hitSlots );
+		return false;
+	} );
+
+	for( int lane = 0; lane < packet.size; lane++ ) {
+
+		if( hitMask & ( 1u << lane ) ) {
+			hits[lane].t = tMax[lane];
+			hits[lane].element = lanes.sphere[hitSlots[lane]];
+		}
+	}
+
+	return hitMask;
+
+} // end intersectPacket
+
+
+/*
+* Computes the point of intersection, normal, and material for a hit found by
+* intersect.
+*/
+void SphereSet::completeHitRecord( const Ray & ray, const RayHit & hit, HitRecord & hitRecord ) const
+{
+	hitRecord.t = hit.t;
+	hitRecord.interceptPoint = ray.origin + hit.t * ray.direct;
+
+	vec3 n = glm::normalize( hitRecord.interceptPoint - centers[hit.element] );
+
+	// Check for back face intersection
+	if( glm::dot( n, ray.direct ) > 0 ) {
+
+		n = -n; // reverse the normal
+	}
+
+	hitRecord.surfaceNormal = n;
+	hitRecord.material = &material;
+
+} // end completeHitRecord
+
+
+bool SphereSet::occludes( const Ray & ray, real tMin, real tMax ) const
+{
+	real limit = tMax;
+
+	return bvh.traverseLeaves( ray, tMin, tMax, [&]( const BVH::Node & leaf, real & ) {
+
+		int begin = leafSlots[leaf.firstIndex];
+		int end = begin + ( leaf.primitiveCount + LANE_GROUP_SIZE - 1 ) / LANE_GROUP_SIZE * LANE_GROUP_SIZE;
+		int hitSlot;
+
+		return kernel( lanes, begin, end, ray, tMin, limit, hitSlot, true );
+	} );
+
+} // end occludes
+
+
+BoundingBox SphereSet::bounds( ) const
+{
+	return bvh.getBounds();
+
+} // end bounds
@@ -1,5 +1,7 @@
 #include "Surface.h"
 
+#include <limits>
+
 Surface::Surface(const color & diffuseColor)
 	:	material(Material( diffuseColor ))
 {
@@ -10,10 +12,82 @@ Surface::Surface( const Material & mat )
 {
 }
 
-HitRecord Surface::findClosestIntersection( const Ray & ray )
+bool Surface::intersect( const Ray & ray, real tMin, real tMax, RayHit & hit ) const
+{
+	return false;
+}
+
+void Surface::completeHitRecord( const Ray & ray, const RayHit & hit, HitRecord & hitRecord ) const
+{
+	hitRecord.t = hit.t;
+	hitRecord.interceptPoint = ray.origin + hit.t * ray.direct;
+	hitRecord.material = &material;
+}
+
+unsigned Surface::intersectPacket( const RayPacket & packet, unsigned laneMask, real tMin,
+								   real tMax[], RayHit hits[] ) const
+{
+	unsigned hitMask = 0;
+
+	for( int lane = 0; lane < packet.size; lane++ ) {
+
+		if( ( laneMask & ( 1u << lane ) ) && intersect( packet.getRay( lane ), tMin, tMax[lane], hits[lane] ) ) {
+			tMax[lane] = hits[lane].t;
+			hitMask |= 1u << lane;
+		}
+	}
+
+	return hitMask;
+}
+
+real Surface::computeOriginTerm( const vec3 & origin ) const
+{
+	return std::numeric_limits<real>::quiet_NaN( );
+}
+
+bool Surface::intersectFromOrigin( const Ray & ray, real originTerm, real tMin, real tMax, RayHit & hit ) const
+{
+	return intersect( ray, tMin, tMax, hit );
+}
+
+unsigned Surface::intersectPacketFromOrigin( const RayPacket & packet, real originTerm, unsigned laneMask,
+											 real tMin, real tMax[], RayHit hits[] ) const
+{
+	unsigned hitMask = 0;
+
+	for( int lane = 0; lane < packet.size; lane++ ) {
+
+		if( ( laneMask & ( 1u << lane ) ) &&
+			intersectFromOrigin( packet.getRay( lane ), originTerm, tMin, tMax[lane], hits[lane] ) ) {
+			tMax[lane] = hits[lane].t;
+			hitMask |= 1u << lane;
+		}
+	}
+
+	return hitMask;
+}
+
+HitRecord Surface::findClosestIntersection( const Ray & ray, real tMin, real tMax ) const
 {
 	HitRecord hitRecord;
 	hitRecord.t = FLT_MAX;
 
+	RayHit hit;
+	if( intersect( ray, tMin, tMax, hit ) ) {
+		completeHitRecord( ray, hit, hitRecord );
+	}
+
 	return hitRecord;
 }
+
+bool Surface::occludes( const Ray & ray, real tMin, real tMax ) const
+{
+	RayHit hit;
+
+	return intersect( ray, tMin, tMax, hit );
+}
+
+BoundingBox Surface::bounds( ) const
+{
+	return BoundingBox::infinite( );
+}
@@ -0,0 +1,163 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+
+ThreadPool::ThreadPool(int threadCount)
+	: queuedTasks(0), pendingTasks(0), nextQueue(0), stopping(false)
+{
+	start(threadCount);
+
+} // end ThreadPool constructor
+
+
+ThreadPool::~ThreadPool()
+{
+	stop();
+
+} // end ThreadPool destructor
+
+
+void ThreadPool::setThreadCount(int threadCount)
+{
+	stop();
+	start(threadCount);
+
+} // end setThreadCount
+
+
+void ThreadPool::start(int threadCount)
+{
+	if (threadCount <= 0) {
+		threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+	}
+
+	stopping = false;
+
+	for (int i = 0; i < threadCount; i++) {
+		queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+	}
+
+	// The thread calling wait acts as the worker for queue zero
+	for (int i = 1; i < threadCount; i++) {
+		workers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+	}
+
+} // end start
+
+
+void ThreadPool::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		stopping = true;
+	}
+	workAvailable.notify_all();
+
+	for (auto & worker : workers) {
+		worker.join();
+	}
+
+	workers.clear();
+	queues.clear();
+
+} // end stop
+
+
+void ThreadPool::submit(const std::function<void()> & task)
+{
+	pendingTasks++;
+
+	WorkQueue & queue = *queues[nextQueue++ % queues.size()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.tasks.push_back(task);
+	}
+	{
+		// Increment under the sleep lock so that no worker misses the wake up
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		queuedTasks++;
+	}
+	workAvailable.notify_one();
+
+} // end submit
+
+
+void ThreadPool::wait()
+{
+	std::function<void()> task;
+
+	// Help the workers until there is nothing left to start
+	while (findTask(0, task)) {
+		runTask(task);
+	}
+
+	std::unique_lock<std::mutex> lock(sleepMutex);
+	allTasksDone.wait(lock, [this] { return pendingTasks == 0; });
+
+} // end wait
+
+
+bool ThreadPool::findTask(int queueIndex, std::function<void()> & task)
+{
+	int queueCount = static_cast<int>(queues.size());
+
+	for (int i = 0; i < queueCount; i++) {
+
+		WorkQueue & queue = *queues[(queueIndex + i) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+
+		if (!queue.tasks.empty()) {
+
+			// Own queue is used as a stack, other queues are robbed from the front
+			if (i == 0) {
+				task = std::move(queue.tasks.back());
+				queue.tasks.pop_back();
+			}
+			else {
+				task = std::move(queue.tasks.front());
+				queue.tasks.pop_front();
+			}
+			queuedTasks--;
+			return true;
+		}
+	}
+
+	return false;
+
+} // end findTask
+
+
+void ThreadPool::runTask(std::function<void()> & task)
+{
+	task();
+	task = nullptr;
+
+	if (--pendingTasks == 0) {
+		std::lock_guard<std::mutex> lock(sleepMutex);
+		allTasksDone.notify_all();
+	}
+
+} // end runTask
+
+
+void ThreadPool::workerLoop(int queueIndex)
+{
+	std::function<void()> task;
+
+	while (true) {
+
+		if (findTask(queueIndex, task)) {
+			runTask(task);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(sleepMutex);
+		workAvailable.wait(lock, [this] { return stopping || queuedTasks > 0; });
+
+		if (stopping) {
+			return;
+		}
+	}
+
+} // end workerLoop
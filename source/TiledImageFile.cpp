@@ -0,0 +1,235 @@
+#include "TiledImageFile.h"
+
+#include <climits>
+#include <cstring>
+
+#ifdef RAYTRACER_HAS_PWRITE
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+/**
+* Returns the size of a tile in bytes.
+*/
+static size_t getTileBytes( const TiledImageHeader & header )
+{
+	return (size_t)header.tileSize * header.tileSize * header.bytesPerPixel;
+
+} // end getTileBytes
+
+
+/**
+* Stores a value as four bytes, least significant first.
+*/
+static void storeLittleEndian( unsigned char * out, uint32_t value )
+{
+	for( int i = 0; i < 4; i++ ) {
+		out[i] = (unsigned char)( value >> ( 8 * i ) );
+	}
+
+} // end storeLittleEndian
+
+
+/**
+* Reads a value stored by storeLittleEndian.
+*/
+static uint32_t loadLittleEndian( const unsigned char * in )
+{
+	return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+
+} // end loadLittleEndian
+
+
+/**
+* Lays out a header as it is stored in the file.
+*/
+static void serializeHeader( const TiledImageHeader & header, unsigned char * out )
+{
+	std::memcpy( out, header.magic, sizeof( header.magic ) );
+	storeLittleEndian( out + 8, header.version );
+	storeLittleEndian( out + 12, header.width );
+	storeLittleEndian( out + 16, header.height );
+	storeLittleEndian( out + 20, header.tileSize );
+	storeLittleEndian( out + 24, header.bytesPerPixel );
+	storeLittleEndian( out + 28, header.reserved );
+
+} // end serializeHeader
+
+
+/**
+* Reads a header laid out by serializeHeader.
+*/
+static TiledImageHeader deserializeHeader( const unsigned char * in )
+{
+	TiledImageHeader header;
+	std::memcpy( header.magic, in, sizeof( header.magic ) );
+	header.version = loadLittleEndian( in + 8 );
+	header.width = loadLittleEndian( in + 12 );
+	header.height = loadLittleEndian( in + 16 );
+	header.tileSize = loadLittleEndian( in + 20 );
+	header.bytesPerPixel = loadLittleEndian( in + 24 );
+	header.reserved = loadLittleEndian( in + 28 );
+	return header;
+
+} // end deserializeHeader
+
+
+bool TiledImageWriter::open( const string & fileName, int width, int height, int tileSize )
+{
+	close( );
+
+	if( width <= 0 || height <= 0 || tileSize <= 0 || tileSize > MAX_TILED_IMAGE_TILE_SIZE ) {
+		return false;
+	}
+
+	TiledImageHeader newHeader = TiledImageHeader( );
+	std::memcpy( newHeader.magic, TILED_IMAGE_MAGIC, sizeof( newHeader.magic ) );
+	newHeader.version = TILED_IMAGE_VERSION;
+	newHeader.width = width;
+	newHeader.height = height;
+	newHeader.tileSize = tileSize;
+	newHeader.bytesPerPixel = 4;
+
+	unsigned char headerBytes[TILED_IMAGE_HEADER_BYTES];
+	serializeHeader( newHeader, headerBytes );
+
+	int across = ( width + tileSize - 1 ) / tileSize;
+	int down = ( height + tileSize - 1 ) / tileSize;
+	size_t fileSize = TILED_IMAGE_HEADER_BYTES + (size_t)across * down * getTileBytes( newHeader );
+
+#ifdef RAYTRACER_HAS_PWRITE
+	descriptor = ::open( fileName.c_str( ), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	if( descriptor < 0 ) {
+		return false;
+	}
+
+	// Setting the size first leaves the tiles that are not written yet as holes
+	if( ftruncate( descriptor, (off_t)fileSize ) != 0 ||
+		pwrite( descriptor, headerBytes, sizeof( headerBytes ), 0 ) != (ssize_t)sizeof( headerBytes ) ) {
+		::close( descriptor );
+		descriptor = -1;
+		return false;
+	}
+#else
+	stream.open( fileName.c_str( ), std::ios::binary | std::ios::in | std::ios::out | std::ios::trunc );
+	stream.write( (const char *)headerBytes, sizeof( headerBytes ) );
+	stream.seekp( (std::streamoff)fileSize - 1 );
+	stream.put( 0 );
+	if( !stream ) {
+		stream.close( );
+		return false;
+	}
+#endif
+
+	header = newHeader;
+	tilesAcross = across;
+	failed = false;
+	return true;
+
+} // end open
+
+
+bool TiledImageWriter::writeTile( int tileX, int tileY, const unsigned char * pixels )
+{
+	size_t tileBytes = getTileBytes( header );
+	size_t offset = TILED_IMAGE_HEADER_BYTES + ( (size_t)tileY * tilesAcross + tileX ) * tileBytes;
+
+#ifdef RAYTRACER_HAS_PWRITE
+	size_t written = 0;
+	while( written < tileBytes ) {
+		ssize_t result = pwrite( descriptor, pixels + written, tileBytes - written, (off_t)( offset + written ) );
+		if( result <= 0 ) {
+			failed = true;
+			return false;
+		}
+		written += (size_t)result;
+	}
+#else
+	std::lock_guard<std::mutex> lock( streamMutex );
+	stream.seekp( (std::streamoff)offset );
+	if( !stream.write( (const char *)pixels, tileBytes ) ) {
+		failed = true;
+		return false;
+	}
+#endif
+
+	return true;
+
+} // end writeTile
+
+
+bool TiledImageWriter::close( )
+{
+	if( !isOpen( ) ) {
+		return false;
+	}
+
+	bool succeeded = !failed;
+
+#ifdef RAYTRACER_HAS_PWRITE
+	if( ::close( descriptor ) != 0 ) {
+		succeeded = false;
+	}
+	descriptor = -1;
+#else
+	stream.close( );
+	if( stream.fail( ) ) {
+		succeeded = false;
+	}
+#endif
+
+	header = TiledImageHeader( );
+	tilesAcross = 0;
+
+	return succeeded;
+
+} // end close
+
+
+bool TiledImageReader::open( const string & fileName )
+{
+	header = TiledImageHeader( );
+	tiles = nullptr;
+
+	if( !file.open( fileName ) || file.getSize( ) < TILED_IMAGE_HEADER_BYTES ) {
+		return false;
+	}
+
+	TiledImageHeader fileHeader = deserializeHeader( file.getData( ) );
+
+	// The tile size is limited before anything is multiplied by it
+	if( std::memcmp( fileHeader.magic, TILED_IMAGE_MAGIC, sizeof( fileHeader.magic ) ) != 0 ||
+		fileHeader.version != TILED_IMAGE_VERSION || fileHeader.bytesPerPixel != 4 ||
+		fileHeader.width == 0 || fileHeader.width > INT_MAX ||
+		fileHeader.height == 0 || fileHeader.height > INT_MAX ||
+		fileHeader.tileSize == 0 || fileHeader.tileSize > (uint32_t)MAX_TILED_IMAGE_TILE_SIZE ) {
+		return false;
+	}
+
+	// Compared by division, so that a large image cannot wrap the product of
+	// the tile counts and the tile size
+	uint64_t across = ( (uint64_t)fileHeader.width + fileHeader.tileSize - 1 ) / fileHeader.tileSize;
+	uint64_t down = ( (uint64_t)fileHeader.height + fileHeader.tileSize - 1 ) / fileHeader.tileSize;
+	uint64_t tilesInFile = ( file.getSize( ) - TILED_IMAGE_HEADER_BYTES ) / getTileBytes( fileHeader );
+	if( across > tilesInFile / down ) {
+		return false;
+	}
+
+	header = fileHeader;
+	tilesAcross = (int)across;
+	tiles = file.getData( ) + TILED_IMAGE_HEADER_BYTES;
+	return true;
+
+} // end open
+
+
+const unsigned char * TiledImageReader::getPixel( int x, int y ) const
+{
+	int tileSize = header.tileSize;
+	size_t tile = (size_t)( y / tileSize ) * tilesAcross + x / tileSize;
+	size_t pixel = (size_t)( y % tileSize ) * tileSize + x % tileSize;
+
+	return tiles + ( tile * tileSize * tileSize + pixel ) * header.bytesPerPixel;
+
+} // end getPixel
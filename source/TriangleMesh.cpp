@@ -0,0 +1,225 @@
+#include "TriangleMesh.h"
+
+// Triangles per leaf of the hierarchy
+static const int MAX_LEAF_SIZE = 4;
+
+
+/*
+* Moller-Trumbore test. Solves origin + t * direct = v0 + u * edge1 + v * edge2
+* for t and the barycentric coordinates u and v by Cramer's rule, and rejects
+* the hit as soon as one of the coordinates falls outside of the triangle.
+*/
+static bool intersectTriangle( const vec3 & v0, const vec3 & edge1, const vec3 & edge2,
+							   const vec3 & origin, const vec3 & direct, real tMin, real tMax, real & t )
+{
+	vec3 p = glm::cross( direct, edge2 );
+	real determinant = glm::dot( edge1, p );
+
+	// The ray is parallel to the plane of the triangle, or the triangle is degenerate
+	if( determinant == 0 ) {
+		return false;
+	}
+
+	real inverse = 1 / determinant;
+
+	vec3 s = origin - v0;
+	real u = glm::dot( s, p ) * inverse;
+	if( u < 0 || u > 1 ) {
+		return false;
+	}
+
+	vec3 q = glm::cross( s, edge1 );
+	real v = glm::dot( direct, q ) * inverse;
+	if( v < 0 || u + v > 1 ) {
+		return false;
+	}
+
+	t = glm::dot( edge2, q ) * inverse;
+	return t >= tMin && t < tMax;
+
+} // end intersectTriangle
+
+
+TriangleMesh::TriangleMesh( std::vector<float> positions, std::vector<uint32_t> indices,
+							const Material & mat, ThreadPool * threadPool )
+	: Surface( mat ), ownedPositions( std::move( positions ) ), ownedIndices( std::move( indices ) )
+{
+	this->positions = ownedPositions.data();
+	this->indices = ownedIndices.data();
+	vertexCount = static_cast<uint32_t>( ownedPositions.size() / 3 );
+	triangleCount = static_cast<uint32_t>( ownedIndices.size() / 3 );
+
+	buildHierarchy( threadPool );
+
+} // end TriangleMesh constructor
+
+
+TriangleMesh::TriangleMesh( MappedFile && file, const MeshData & mesh, const Material & mat, ThreadPool * threadPool )
+	: Surface( mat ), file( std::move( file ) ), positions( mesh.positions ), indices( mesh.indices ),
+	  vertexCount( mesh.vertexCount ), triangleCount( mesh.triangleCount )
+{
+	buildHierarchy( threadPool );
+
+} // end TriangleMesh constructor
+
+
+shared_ptr<TriangleMesh> TriangleMesh::load( const string & fileName, const Material & mat, ThreadPool * threadPool )
+{
+	MappedFile file;
+	MeshData mesh;
+
+	if( !file.open( fileName ) || !getMeshData( file.getData(), file.getSize(), mesh ) ) {
+		return nullptr;
+	}
+
+	// A bad index would make the intersection tests read outside of the file
+	for( size_t i = 0; i < size_t( mesh.triangleCount ) * 3; i++ ) {
+		if( mesh.indices[i] >= mesh.vertexCount ) {
+			return nullptr;
+		}
+	}
+
+	return shared_ptr<TriangleMesh>( new TriangleMesh( std::move( file ), mesh, mat, threadPool ) );
+
+} // end load
+
+
+void TriangleMesh::buildHierarchy( ThreadPool * threadPool )
+{
+	std::vector<BoundingBox> triangleBounds( triangleCount );
+
+	for( uint32_t i = 0; i < triangleCount; i++ ) {
+
+		vec3 v0, v1, v2;
+		getCorners( i, v0, v1, v2 );
+		triangleBounds[i] = BoundingBox( glm::min( v0, glm::min( v1, v2 ) ), glm::max( v0, glm::max( v1, v2 ) ) );
+	}
+
+	bvh.build( triangleBounds, threadPool, MAX_LEAF_SIZE );
+
+} // end buildHierarchy
+
+
+void TriangleMesh::getCorners( int triangle, vec3 & v0, vec3 & v1, vec3 & v2 ) const
+{
+	const uint32_t * corners = indices + 3 * size_t( triangle );
+
+	v0 = getVertex( corners[0] );
+	v1 = getVertex( corners[1] );
+	v2 = getVertex( corners[2] );
+
+} // end getCorners
+
+
+bool TriangleMesh::intersect( const Ray & ray, real tMin, real tMax, RayHit & hit ) const
+{
+	int hitTriangle = -1;
+
+	bvh.traverse( ray, tMin, tMax, [&]( int triangle, real & tMax ) {
+
+		vec3 v0, v1, v2;
+		getCorners( triangle, v0, v1, v2 );
+
+		real t;
+		if( intersectTriangle( v0, v1 - v0, v2 - v0, ray.origin, ray.direct, tMin, tMax, t ) ) {
+			tMax = t;
+			hitTriangle = triangle;
+		}
+		return false;
+	} );
+
+	if( hitTriangle < 0 ) {
+		return false;
+	}
+
+	hit.t = tMax;
+	hit.element = hitTriangle;
+	return true;
+
+} // end intersect
+
+
+unsigned TriangleMesh::intersectPacket( const RayPacket & packet, unsigned laneMask, real tMin,
+										real tMax[], RayHit hits[] ) const
+{
+	unsigned hitMask = 0;
+	const std::vector<int> & primitiveIndices = bvh.getPrimitiveIndices();
+
+	bvh.traversePacket( packet, laneMask, tMin, tMax, [&]( const BVH::Node & leaf, unsigned leafMask ) {
+
+		for( int i = leaf.firstIndex; i < leaf.firstIndex + leaf.primitiveCount; i++ ) {
+
+			int triangle = primitiveIndices[i];
+
+			vec3 v0, v1, v2;
+			getCorners( triangle, v0, v1, v2 );
+			vec3 edge1 = v1 - v0;
+			vec3 edge2 = v2 - v0;
+
+			for( int lane = 0; lane < packet.size; lane++ ) {
+
+				if( !( leafMask & ( 1u << lane ) ) ) {
+					continue;
+				}
+
+				vec3 origin( packet.originX[lane], packet.originY[lane], packet.originZ[lane] );
+				vec3 direct( packet.directX[lane], packet.directY[lane], packet.directZ[lane] );
+
+				real t;
+				if( intersectTriangle( v0, edge1, edge2, origin, direct, tMin, tMax[lane], t ) ) {
+					tMax[lane] = t;
+					hits[lane].t = t;
+					hits[lane].element = triangle;
+					hitMask |= 1u << lane;
+				}
+			}
+		}
+		return false;
+	} );
+
+	return hitMask;
+
+} // end intersectPacket
+
+
+bool TriangleMesh::occludes( const Ray & ray, real tMin, real tMax ) const
+{
+	return bvh.traverse( ray, tMin, tMax, [&]( int triangle, real & tMax ) {
+
+		vec3 v0, v1, v2;
+		getCorners( triangle, v0, v1, v2 );
+
+		real t;
+		return intersectTriangle( v0, v1 - v0, v2 - v0, ray.origin, ray.direct, tMin, tMax, t );
+	} );
+
+} // end occludes
+
+
+void TriangleMesh::completeHitRecord( const Ray & ray, const RayHit & hit, HitRecord & hitRecord ) const
+{
+	hitRecord.t = hit.t;
+	hitRecord.interceptPoint = ray.origin + hit.t * ray.direct;
+
+	vec3 v0, v1, v2;
+	getCorners( hit.element, v0, v1, v2 );
+
+	vec3 n = glm::normalize( glm::cross( v1 - v0, v2 - v0 ) );
+
+	// Check for back face intersection
+	if( glm::dot( n, ray.direct ) > 0 ) {
+
+		n = -n; // reverse the normal
+	}
+
+	hitRecord.surfaceNormal = n;
+	hitRecord.material = &material;
+
+} // end completeHitRecord
+
+
+BoundingBox TriangleMesh::bounds( ) const
+{
+	return bvh.getBounds();
+
+} // end bounds
@@ -0,0 +1,450 @@
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "RayTracer.h"
+#include "SceneGenerator.h"
+#include "Simd.h"
+#include "Sphere.h"
+#include "Plane.h"
+#include "Cylinder.h"
+#include "Ellipsoid.h"
+#include "SimplePolygon.h"
+
+/**
+* Performance benchmarks of the ray tracer. Microbenchmarks time the intersection
+* tests of the individual primitives and the illuminate functions of the lights.
+* Frame benchmarks render generated scenes of increasing size with different
+* numbers of threads. Results are written as JSON so that they can be compared
+* between releases.
+*/
+
+typedef std::chrono::steady_clock Clock;
+
+/**
+* Benchmark settings collected from the command line.
+*/
+struct BenchmarkOptions
+{
+	std::vector<int> sceneSizes = { 7, 1000, 100000, 1000000 };
+	std::vector<int> threadCounts;
+	unsigned seed = 1;
+	int width = WINDOW_WIDTH;
+	int height = WINDOW_HEIGHT;
+
+	// Frames rendered per measurement. The fastest one is reported.
+	int frames = 3;
+
+	// Shortest time spent on each microbenchmark in seconds
+	double minTime = 0.25;
+
+	bool groupPrimitives = true;
+	bool runMicro = true;
+	bool runFrames = true;
+	string output;
+};
+
+/**
+* Time taken to trace a number of rays.
+*/
+struct Measurement
+{
+	long long rays = 0;
+	double seconds = 0.0;
+};
+
+// Keeps the compiler from removing work whose result is not used
+static volatile double sink;
+
+
+static double secondsSince( Clock::time_point start )
+{
+	return std::chrono::duration<double>( Clock::now( ) - start ).count( );
+
+} // end secondsSince
+
+
+/**
+* Writes the fields shared by all measurements.
+*/
+static void writeMeasurement( std::ostream & json, const Measurement & m )
+{
+	json << "\"rays\": " << m.rays << ", \"seconds\": " << m.seconds
+		<< ", \"raysPerSecond\": " << m.rays / m.seconds
+		<< ", \"nsPerRay\": " << 1.0e9 * m.seconds / m.rays;
+
+} // end writeMeasurement
+
+
+/**
+* Creates rays that start at the origin and point at random positions around a
+* target, so that some of them hit it and some of them miss.
+*/
+static std::vector<Ray> makeRays( const vec3 & target, real spread, std::mt19937 & random )
+{
+	std::uniform_real_distribution<real> offset( -spread, spread );
+
+	std::vector<Ray> rays( 4096 );
+	for( size_t i = 0; i < rays.size( ); i++ ) {
+		rays[i] = Ray( vec3( 0, 0, 0 ), target + vec3( offset( random ), offset( random ), offset( random ) ) );
+	}
+	return rays;
+
+} // end makeRays
+
+
+/**
+* Repeatedly tests a surface for intersection with a set of rays until minTime
+* has passed.
+*/
+static Measurement timeIntersect( const Surface & surface, const std::vector<Ray> & rays, double minTime )
+{
+	Measurement m;
+	int hits = 0;
+
+	Clock::time_point start = Clock::now( );
+	do {
+		for( size_t i = 0; i < rays.size( ); i++ ) {
+			RayHit hit;
+			hits += surface.intersect( rays[i], 0.0, FLT_MAX, hit );
+		}
+		m.rays += rays.size( );
+		m.seconds = secondsSince( start );
+
+	} while( m.seconds < minTime );
+
+	sink = hits;
+	return m;
+
+} // end timeIntersect
+
+
+/**
+* Repeatedly has a light illuminate a set of intersections until minTime has passed.
+*/
+static Measurement timeIlluminate( const LightSource & light, const std::vector<Ray> & rays,
+								   const std::vector<HitRecord> & hits, const Scene & scene, double minTime )
+{
+	Measurement m;
+	double total = 0.0;
+
+	Clock::time_point start = Clock::now( );
+	do {
+		for( size_t i = 0; i < hits.size( ); i++ ) {
+			total += light.illuminate( -rays[i].direct, hits[i], scene ).r;
+		}
+		m.rays += hits.size( );
+		m.seconds = secondsSince( start );
+
+	} while( m.seconds < minTime );
+
+	sink = total;
+	return m;
+
+} // end timeIlluminate
+
+
+static void runMicrobenchmarks( std::ostream & json, const BenchmarkOptions & options )
+{
+	std::mt19937 random( options.seed );
+
+	struct Case
+	{
+		const char * name;
+		shared_ptr<Surface> surface;
+		vec3 target;
+		real spread;
+	};
+
+	std::vector<vec3> polygonVector = { vec3( 2, 0, -10 ), vec3( 2, 2, -10 ), vec3( -2, 2, -10 ), vec3( -2, 0, -10 ) };
+
+	std::vector<Case> cases = {
+		{ "Sphere", make_shared<Sphere>( vec3( 0.0, -1.0, -10.0 ), 1.5, RED ), vec3( 0.0, -1.0, -10.0 ), 2.0 },
+		{ "Plane", make_shared<Plane>( vec3( 0, -20.0, 0.0 ), vec3( 0, 1, 0 ), WHITE ), vec3( 0.0, -1.0, -10.0 ), 10.0 },
+		{ "SimplePolygon", make_shared<SimplePolygon>( polygonVector, RED ), vec3( 0.0, 1.0, -10.0 ), 2.5 },
+		{ "QuadricSurface", make_shared<Ellipsoid>( vec3( -3.0, 0.0, -10.0 ), BLACK, 1, 2, 2 ), vec3( -3.0, 0.0, -10.0 ), 2.5 },
+		{ "Cylinder", make_shared<Cylinder>( vec3( 2.7, 2.8, -10.0 ), GREEN, 1, 2 ), vec3( 2.7, 2.8, -10.0 ), 2.0 },
+	};
+
+	json << "  \"micro\": [\n";
+
+	for( size_t c = 0; c < cases.size( ); c++ ) {
+		std::vector<Ray> rays = makeRays( cases[c].target, cases[c].spread, random );
+		Measurement m = timeIntersect( *cases[c].surface, rays, options.minTime );
+
+		json << "    { \"name\": \"intersect/" << cases[c].name << "\", ";
+		writeMeasurement( json, m );
+		json << " },\n";
+	}
+
+	// Shade the points of the demonstration scene that are seen from the origin
+	DemoScene demoScene;
+	buildDemoScene( demoScene );
+
+	Scene scene;
+	scene.build( demoScene.surfaces );
+
+	std::vector<Ray> rays = makeRays( vec3( 0, 0, -10 ), 4.0, random );
+	std::vector<Ray> hitRays;
+	std::vector<HitRecord> hits;
+	for( size_t i = 0; i < rays.size( ); i++ ) {
+		HitRecord hit = scene.findIntersection( rays[i] );
+		if( hit.t < FLT_MAX ) {
+			hitRays.push_back( rays[i] );
+			hits.push_back( hit );
+		}
+	}
+
+	struct LightCase
+	{
+		const char * name;
+		shared_ptr<LightSource> light;
+	};
+
+	std::vector<LightCase> lights = {
+		{ "LightSource", demoScene.ambientLight },
+		{ "PositionalLight", demoScene.lightPos },
+		{ "DirectionalLight", demoScene.lightDir },
+		{ "Spotlight", demoScene.spotlight },
+	};
+
+	for( size_t l = 0; l < lights.size( ); l++ ) {
+		Measurement m = timeIlluminate( *lights[l].light, hitRays, hits, scene, options.minTime );
+
+		json << "    { \"name\": \"illuminate/" << lights[l].name << "\", ";
+		writeMeasurement( json, m );
+		json << " }" << ( l + 1 < lights.size( ) ? "," : "" ) << "\n";
+	}
+
+	json << "  ]";
+
+} // end runMicrobenchmarks
+
+
+static void runFrameBenchmarks( std::ostream & json, const BenchmarkOptions & options )
+{
+	json << "  \"frames\": [\n";
+
+	for( size_t s = 0; s < options.sceneSizes.size( ); s++ ) {
+
+		FrameBuffer frameBuffer( options.width, options.height );
+		RayTracer rayTrace( frameBuffer );
+		rayTrace.setCameraFrame( vec3( 0, 0, 0 ), vec3( 0, 0, -1 ), vec3( 0, 1, 0 ) );
+		rayTrace.calculatePerspectiveViewingParameters( 45.0 );
+
+		SceneGeneratorSettings settings;
+		settings.primitiveCount = options.sceneSizes[s];
+		settings.seed = options.seed;
+		settings.groupPrimitives = options.groupPrimitives;
+
+		ThreadPool threadPool;
+		DemoScene scene;
+
+		Clock::time_point start = Clock::now( );
+		generateScene( scene, settings, &threadPool );
+		double generateSeconds = secondsSince( start );
+
+		start = Clock::now( );
+		rayTrace.commitScene( scene.surfaces, scene.lights );
+		double commitSeconds = secondsSince( start );
+
+		json << "    { \"primitives\": " << settings.primitiveCount
+			<< ", \"surfaces\": " << scene.surfaces.size( )
+			<< ", \"grouped\": " << ( settings.groupPrimitives ? "true" : "false" )
+			<< ", \"width\": " << options.width << ", \"height\": " << options.height
+			<< ", \"generateSeconds\": " << generateSeconds << ", \"commitSeconds\": " << commitSeconds << ",\n      \"runs\": [\n";
+
+		// Speedups are relative to the first thread count in the list
+		double firstSeconds = 0.0;
+
+		for( size_t t = 0; t < options.threadCounts.size( ); t++ ) {
+
+			rayTrace.setThreadCount( options.threadCounts[t] );
+
+			Measurement best;
+			for( int frame = 0; frame < options.frames; frame++ ) {
+				start = Clock::now( );
+				rayTrace.raytraceScene( );
+				double seconds = secondsSince( start );
+
+				if( frame == 0 || seconds < best.seconds ) {
+					best.seconds = seconds;
+				}
+			}
+			best.rays = (long long)options.width * options.height;
+
+			if( t == 0 ) {
+				firstSeconds = best.seconds;
+			}
+
+			json << "        { \"threads\": " << options.threadCounts[t] << ", ";
+			writeMeasurement( json, best );
+			json << ", \"speedup\": " << firstSeconds / best.seconds
+				<< " }" << ( t + 1 < options.threadCounts.size( ) ? "," : "" ) << "\n";
+
+			std::cerr << settings.primitiveCount << " primitives, " << options.threadCounts[t] << " threads: "
+				<< best.seconds << " sec." << std::endl;
+		}
+
+		json << "      ] }" << ( s + 1 < options.sceneSizes.size( ) ? "," : "" ) << "\n";
+	}
+
+	json << "  ]";
+
+} // end runFrameBenchmarks
+
+
+/**
+* Reads a comma separated list of positive integers.
+*/
+static std::vector<int> parseList( const string & text )
+{
+	std::vector<int> values;
+	std::stringstream stream( text );
+	string item;
+
+	while( std::getline( stream, item, ',' ) ) {
+		int value = atoi( item.c_str( ) );
+		if( value > 0 ) {
+			values.push_back( value );
+		}
+	}
+	return values;
+
+} // end parseList
+
+
+static void printUsage( const char * program )
+{
+	std::cerr << "Usage: " << program << " [options]" << endl
+		<< "  -o, --output FILE       write the JSON results to a file instead of stdout" << endl
+		<< "  --quick                 small scenes, one frame and short microbenchmarks" << endl
+		<< "  --sizes N,N,...         primitive counts of the frame benchmarks (default 7,1000,100000,1000000)" << endl
+		<< "  --threads N,N,...       thread counts of the frame benchmarks (default 1,2,4,... up to the core count)" << endl
+		<< "  --seed N                seed of the scene generator (default 1)" << endl
+		<< "  --width N, --height N   frame size in pixels" << endl
+		<< "  --frames N              frames per measurement, the fastest is reported (default 3)" << endl
+		<< "  --ungrouped             add every generated primitive as its own surface" << endl
+		<< "  --micro-only            skip the frame benchmarks" << endl
+		<< "  --frames-only           skip the microbenchmarks" << endl;
+
+} // end printUsage
+
+
+/**
+* Reads the options from the command line.
+* @return false if an option is unknown or is missing a value
+*/
+static bool parseOptions( int argc, char** argv, BenchmarkOptions & options )
+{
+	for( int i = 1; i < argc; i++ ) {
+
+		string arg = argv[i];
+
+		if( arg == "--quick" ) {
+			options.sceneSizes = { 7, 1000, 10000 };
+			options.frames = 1;
+			options.minTime = 0.05;
+		}
+		else if( arg == "--ungrouped" ) {
+			options.groupPrimitives = false;
+		}
+		else if( arg == "--micro-only" ) {
+			options.runFrames = false;
+		}
+		else if( arg == "--frames-only" ) {
+			options.runMicro = false;
+		}
+		else if( i + 1 >= argc ) {
+			std::cerr << "Unknown option or missing value: " << arg << endl;
+			return false;
+		}
+		else if( arg == "-o" || arg == "--output" ) {
+			options.output = argv[++i];
+		}
+		else if( arg == "--sizes" ) {
+			options.sceneSizes = parseList( argv[++i] );
+		}
+		else if( arg == "--threads" ) {
+			options.threadCounts = parseList( argv[++i] );
+		}
+		else if( arg == "--seed" ) {
+			options.seed = (unsigned)atol( argv[++i] );
+		}
+		else if( arg == "--width" ) {
+			options.width = std::max( atoi( argv[++i] ), 1 );
+		}
+		else if( arg == "--height" ) {
+			options.height = std::max( atoi( argv[++i] ), 1 );
+		}
+		else if( arg == "--frames" ) {
+			options.frames = std::max( atoi( argv[++i] ), 1 );
+		}
+		else {
+			std::cerr << "Unknown option " << arg << endl;
+			return false;
+		}
+	}
+
+	// Powers of two up to the number of hardware threads, and that number itself
+	if( options.threadCounts.empty( ) ) {
+		int hardwareThreads = std::max( 1, static_cast<int>( std::thread::hardware_concurrency( ) ) );
+		for( int threads = 1; threads < hardwareThreads; threads *= 2 ) {
+			options.threadCounts.push_back( threads );
+		}
+		options.threadCounts.push_back( hardwareThreads );
+	}
+
+	return true;
+
+} // end parseOptions
+
+
+int main( int argc, char** argv )
+{
+	BenchmarkOptions options;
+
+	if( !parseOptions( argc, argv, options ) ) {
+		printUsage( argv[0] );
+		return 1;
+	}
+
+	std::ostringstream json;
+	json.precision( 6 );
+
+	json << "{\n  \"simd\": \"" << getSimdLevelName( getSimdLevel( ) ) << "\",\n"
+		<< "  \"precision\": \"" << ( sizeof( real ) == sizeof( float ) ? "float" : "double" ) << "\",\n"
+		<< "  \"hardwareThreads\": " << std::thread::hardware_concurrency( ) << ",\n"
+		<< "  \"seed\": " << options.seed;
+
+	if( options.runMicro ) {
+		json << ",\n";
+		runMicrobenchmarks( json, options );
+	}
+
+	if( options.runFrames ) {
+		json << ",\n";
+		runFrameBenchmarks( json, options );
+	}
+
+	json << "\n}\n";
+
+	if( options.output.empty( ) ) {
+		std::cout << json.str( );
+	}
+	else {
+		std::ofstream file( options.output.c_str( ) );
+		file << json.str( );
+
+		if( !file ) {
+			std::cerr << "Could not write " << options.output << endl;
+			return 1;
+		}
+	}
+
+	return 0;
+
+} // end main
@@ -0,0 +1,120 @@
+#include <cstdlib>
+#include <fstream>
+
+#include "Defines.h"
+
+/**
+* Compares two binary PPM images written by the renderer channel by channel.
+* Prints the largest difference and the number of channel values that differ
+* by more than a tolerance. Exits with a nonzero status if the images have
+* different sizes or differ by more than the limits given on the command line,
+* so that checks run by ctest can compare images that are not expected to be
+* identical, such as renders in single and double precision.
+*/
+
+/**
+* Reads a binary PPM (P6) file with 8 bit channels.
+* @return false if the file is missing or is not such a file
+*/
+static bool readPPM( const string & fileName, int & width, int & height, std::vector<unsigned char> & pixels )
+{
+	std::ifstream file( fileName, std::ios::binary );
+
+	string magic;
+	int maxValue = 0;
+	file >> magic >> width >> height >> maxValue;
+
+	// A single whitespace character separates the header from the pixels
+	file.get( );
+
+	if( !file || magic != "P6" || maxValue != 255 || width <= 0 || height <= 0 ) {
+		return false;
+	}
+
+	pixels.resize( (size_t)3 * width * height );
+	file.read( (char *)pixels.data( ), pixels.size( ) );
+
+	return file.gcount( ) == (std::streamsize)pixels.size( );
+
+} // end readPPM
+
+
+static void printUsage( const char * program )
+{
+	std::cerr << "Usage: " << program << " FIRST.ppm SECOND.ppm [options]" << endl
+		<< "  --tolerance N           channel differences up to N are not counted (default 0)" << endl
+		<< "  --max-outliers F        largest fraction of channel values that may differ by" << endl
+		<< "                          more than the tolerance (default 0)" << endl
+		<< "  --max-difference N      largest difference allowed in any channel (default 255)" << endl;
+
+} // end printUsage
+
+
+int main( int argc, char** argv )
+{
+	if( argc < 3 ) {
+		printUsage( argv[0] );
+		return 1;
+	}
+
+	int tolerance = 0;
+	double maxOutliers = 0.0;
+	int maxDifference = 255;
+
+	for( int i = 3; i < argc; i++ ) {
+
+		string arg = argv[i];
+		if( i + 1 >= argc ) {
+			printUsage( argv[0] );
+			return 1;
+		}
+
+		if( arg == "--tolerance" ) {
+			tolerance = atoi( argv[++i] );
+		}
+		else if( arg == "--max-outliers" ) {
+			maxOutliers = atof( argv[++i] );
+		}
+		else if( arg == "--max-difference" ) {
+			maxDifference = atoi( argv[++i] );
+		}
+		else {
+			printUsage( argv[0] );
+			return 1;
+		}
+	}
+
+	int width[2], height[2];
+	std::vector<unsigned char> pixels[2];
+	for( int image = 0; image < 2; image++ ) {
+		if( !readPPM( argv[1 + image], width[image], height[image], pixels[image] ) ) {
+			std::cerr << "Could not read " << argv[1 + image] << endl;
+			return 1;
+		}
+	}
+
+	if( width[0] != width[1] || height[0] != height[1] ) {
+		std::cerr << "The images have different sizes" << endl;
+		return 1;
+	}
+
+	int largest = 0;
+	size_t outliers = 0;
+	for( size_t i = 0; i < pixels[0].size( ); i++ ) {
+		int difference = std::abs( (int)pixels[0][i] - (int)pixels[1][i] );
+		largest = std::max( largest, difference );
+		outliers += difference > tolerance;
+	}
+
+	double fraction = (double)outliers / pixels[0].size( );
+	cout << "Largest difference " << largest << ", " << outliers << " of " << pixels[0].size( )
+		 << " channel values (" << 100.0 * fraction << "%) differ by more than " << tolerance << endl;
+
+	if( largest > maxDifference || fraction > maxOutliers ) {
+		std::cerr << "The images differ by more than the limits" << endl;
+		return 1;
+	}
+
+	return 0;
+
+} // end main
@@ -0,0 +1,37 @@
+#include "MeshFile.h"
+
+/**
+* Converts a Wavefront OBJ file into the binary mesh format that TriangleMesh
+* maps into memory, so that large exports are only parsed once.
+*/
+
+int main( int argc, char** argv )
+{
+	if( argc != 3 ) {
+		std::cerr << "Usage: " << argv[0] << " INPUT.obj OUTPUT.mesh" << endl;
+		return 1;
+	}
+
+	std::vector<float> positions;
+	std::vector<uint32_t> indices;
+
+	if( !readObjFile( argv[1], positions, indices ) ) {
+		std::cerr << "Could not read " << argv[1] << endl;
+		return 1;
+	}
+
+	if( positions.size( ) / 3 > UINT32_MAX || indices.size( ) / 3 > UINT32_MAX ) {
+		std::cerr << argv[1] << " has too many vertices or faces" << endl;
+		return 1;
+	}
+
+	if( !writeMeshFile( argv[2], positions, indices ) ) {
+		std::cerr << "Could not write " << argv[2] << endl;
+		return 1;
+	}
+
+	cout << positions.size( ) / 3 << " vertices, " << indices.size( ) / 3 << " triangles" << endl;
+
+	return 0;
+
+} // end main
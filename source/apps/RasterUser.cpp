@@ -6,25 +6,41 @@
 FrameBuffer frameBuffer(WINDOW_WIDTH, WINDOW_HEIGHT);
 
 // Some predefined colors.
-const color LIGHT_BLUE(0.784, 0.784, 1.0, 1.0);
+const color LIGHT_BLUE(0.784, 0.784, 1.0);
 
 // Raytracer
 RayTracer rayTrace(frameBuffer);
 
-// Vector holding all the surfaces in the scene
-SurfaceVector surfaces;
+// Surfaces and light sources in the scene
+DemoScene demoScene;
 
-// Vector holding all the light sources in the scene
-LightVector lights;
+// boolean to keep track of it being day or night
+bool isNight = false;
 
-shared_ptr<LightSource> ambientLight ;
-shared_ptr<PositionalLight> lightPos ;
-shared_ptr<DirectionalLight> lightDir;
+// True if only the lights changed since the last frame, so the frame can be
+// shaded again without tracing rays
+bool lightsChanged = false;
 
-shared_ptr<Spotlight> spotlight;
+// Positions in the surface list of the surfaces that were moved since the
+// last frame, so that only the tiles they affect are traced again
+std::vector<int> changedSurfaces;
 
-// boolean to keep track of it being day or night
-bool isNight = false;
+/**
+* Copies the frame buffer into the color buffer of the window and swaps buffers.
+*/
+static void showColorBuffer()
+{
+	// Insure raster position is lower left hand corner of the window. (OpenGL command)
+	glRasterPos2d(-1, -1);
+
+	// Copy color buffer to raster (Legacy OpenGL command)
+	glDrawPixels(frameBuffer.getWindowWidth(), frameBuffer.getWindowHeight(), GL_RGBA, GL_UNSIGNED_BYTE,
+				 frameBuffer.getColorBuffer());
+
+	// Flush all drawing commands and swapbuffers (Glut command)
+	glutSwapBuffers();
+
+} // end showColorBuffer
 
 /**
 * Acts as the display function for the window. 
@@ -36,10 +52,17 @@ static void RenderSceneCB()
 	// Clear the color buffer
 
 	// Ray trace the scene to determine the color of all the pixels in the scene
-	rayTrace.raytraceScene( surfaces, lights);
+	if (!changedSurfaces.empty()) {
+		rayTrace.raytraceChanges(changedSurfaces);
+	}
+	else if (!(lightsChanged && rayTrace.reshadeScene())) {
+		rayTrace.raytraceScene( demoScene.surfaces, demoScene.lights);
+	}
+	lightsChanged = false;
+	changedSurfaces.clear();
 
 	// Display the color buffer
-	frameBuffer.showColorBuffer();
+	showColorBuffer();
 
 	// Calculate and display time required to render scene.
 	int frameEndTime = glutGet( GLUT_ELAPSED_TIME ); // Get end time
@@ -55,10 +78,15 @@ static void RenderSceneCB()
 // resized.
 static void ResizeCB(int width, int height)
 {
+	// Set pixel storage modes. 
+	// (https://www.opengl.org/archives/resources/features/KilgardTechniques/oglpitfall/)
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
 	// Size the color buffer to match the window size.
 	frameBuffer.setFrameBufferSize( width, height );
 
-	rayTrace.setCameraFrame( dvec3( 0, 0, 0 ), dvec3( 0, 0, -1 ), dvec3( 0, 1, 0 ) );
+	rayTrace.setCameraFrame( vec3( 0, 0, 0 ), vec3( 0, 0, -1 ), vec3( 0, 1, 0 ) );
 
 	rayTrace.calculatePerspectiveViewingParameters(45.0);
 
@@ -69,23 +97,8 @@ static void ResizeCB(int width, int height)
 
 void switchTimeOfDay(char c)
 {
-    ambientLight->enabled = true;
-    lightPos->enabled = true;
-    lightDir->enabled = true;
-    spotlight->enabled = true;
-
-    ambientLight->ambientLightColor = color(0.15, 0.15, 0.15, 1.0);
-	lightPos->diffuseLightColor = color(1.0, 1.0, 1.0, 1);
-	lightDir->diffuseLightColor = color(0.75, 0.75, 0.75, 1);
-    spotlight->diffuseLightColor = color(0.75, 0.75, 0.75, 1.0);
- 
-    if (c == 'n')
-    {
-        ambientLight->ambientLightColor =  ambientLight->ambientLightColor * 0.0002;
-        lightPos->diffuseLightColor = lightPos->diffuseLightColor * 0.0002;
-        lightDir->diffuseLightColor = lightDir->diffuseLightColor * 0.0002;
-        spotlight->enabled = false; 
-    } 
+    isNight = c == 'n';
+    setDemoTimeOfDay(demoScene, isNight);
 }
 
 // Responds to 'f' and escape keys. 'f' key allows 
@@ -103,21 +116,27 @@ static void KeyboardCB(unsigned char key, int x, int y)
 		rayTrace.setRecursionDepth( 0 );
 		break;
     case('a'):
-        ambientLight->enabled = ambientLight->enabled ? false : true;
+        lightsChanged = true;
+        demoScene.ambientLight->enabled = demoScene.ambientLight->enabled ? false : true;
         break;
     case('p'):
-        lightPos->enabled = lightPos->enabled ? false : true;
+        lightsChanged = true;
+        demoScene.lightPos->enabled = demoScene.lightPos->enabled ? false : true;
         break;
     case('d'):
-        lightDir->enabled = lightDir->enabled ? false : true;
+        lightsChanged = true;
+        demoScene.lightDir->enabled = demoScene.lightDir->enabled ? false : true;
         break;
     case('s'):
-        spotlight->enabled = spotlight->enabled ? false : true;
+        lightsChanged = true;
+        demoScene.spotlight->enabled = demoScene.spotlight->enabled ? false : true;
         break;
     case('m'):
+       lightsChanged = true;
        switchTimeOfDay('m');
        break;
     case('n'):
+        lightsChanged = true;
         switchTimeOfDay('n');
         break;
     case('1') :
@@ -141,16 +160,35 @@ static void KeyboardCB(unsigned char key, int x, int y)
 } // end KeyboardCB
 
 
-// Responds to presses of the arrow keys
+/**
+* Moves the white ball of the demonstration scene and records the change.
+*/
+static void moveWhiteBall(const vec3 & offset)
+{
+	demoScene.whiteBall->center += offset;
+
+	auto ball = std::find(demoScene.surfaces.begin(), demoScene.surfaces.end(), demoScene.whiteBall);
+	changedSurfaces.push_back((int)(ball - demoScene.surfaces.begin()));
+
+} // end moveWhiteBall
+
+
+// Responds to presses of the arrow keys. Moves the white ball.
 static void SpecialKeysCB(int key, int x, int y)
 {
 	switch(key) {
 	
 	case(GLUT_KEY_RIGHT):
-		
+		moveWhiteBall(vec3(0.25, 0, 0));
 		break;
 	case(GLUT_KEY_LEFT):
-		
+		moveWhiteBall(vec3(-0.25, 0, 0));
+		break;
+	case(GLUT_KEY_UP):
+		moveWhiteBall(vec3(0, 0.25, 0));
+		break;
+	case(GLUT_KEY_DOWN):
+		moveWhiteBall(vec3(0, -0.25, 0));
 		break;
 	default:
 		std::cout << key << " key pressed." << std::endl;
@@ -166,40 +204,7 @@ void buildScene()
 	// Initialize random seed - used to create random colors
 	srand((unsigned int)time(NULL));
 
-    Material redMat(RED);
-    redMat.emissiveColor = .03 * RED;
-
-    std::vector<dvec3> polygonVector = {dvec3(2, 0, -10), dvec3(2, 2, -10), dvec3(-2, 2, -10), dvec3(-2, 0, -10)};
-
-    shared_ptr<SimplePolygon> polygon = make_shared<SimplePolygon>(polygonVector, RED);
-    shared_ptr<Ellipsoid> ellipsoid = make_shared<Ellipsoid>(dvec3(-3.0, 0.0, -10.0), BLACK, 1, 2, 2);
-    shared_ptr<Cylinder> cylinder = make_shared<Cylinder>(dvec3(2.7, 2.8, -10.0), GREEN, 1, 2 );
-	shared_ptr<Sphere> redBall = make_shared<Sphere>(dvec3( 0.0, -1.0, -10.0 ), 1.5, RED);
-	shared_ptr<Sphere> blueBall = make_shared<Sphere>(dvec3( -1.5, 0.25, -8.0 ), 0.5, BLUE);
-	shared_ptr<Sphere> whiteBall = make_shared<Sphere>(dvec3( 1.5, 0.25, -8.0 ), 0.5, WHITE);
-	shared_ptr<Plane> plane = make_shared<Plane>(dvec3(0, -20.0, 0.0), dvec3(0, 1, 0), WHITE);
-    redBall->material = redMat;    
-    
-
-    surfaces.push_back(plane);
-    surfaces.push_back(ellipsoid);
-	surfaces.push_back(whiteBall);
-	surfaces.push_back(blueBall);
-	surfaces.push_back(redBall);
-    surfaces.push_back(cylinder);
-    surfaces.push_back(polygon); 
-
-
-    ambientLight = make_shared<LightSource>(BLACK);
-    ambientLight->ambientLightColor = color(0.15, 0.15, 0.15, 1.0);
-	lightPos = make_shared<PositionalLight>(dvec3(-10.0, 10.0, 10.0), color(1.0, 1.0, 1.0, 1));
-	lightDir = make_shared<DirectionalLight>(dvec3(-10.0,10.0 ,-10.0), color(0.75, 0.75, 0.75, 1));
-    spotlight = make_shared<Spotlight>(dvec3(500, 1000, -10), dvec3(0,-1,0), glm::cos(glm::radians(15.0)), color(0.75, 0.75, 0.75, 1.0));
-
-    lights.push_back(spotlight);
-	lights.push_back(lightPos);
-	lights.push_back(lightDir);
-	lights.push_back(ambientLight);
+	buildDemoScene(demoScene);
 }
 
 
@@ -238,11 +243,17 @@ int main(int argc, char** argv)
 	//glutFullScreenToggle();
 
 	// Set red, green, blue, and alpha to which the color buffer is cleared.
-	frameBuffer.setClearColor(color(0,0,0,1));
+	frameBuffer.setClearColor(color(0,0,0));
 
 	// Set the color to which pixels will be cleared if there is no intersection.
     rayTrace.setDefaultColor(LIGHT_BLUE);
 
+	// Keep what is needed to reshade frames when only the lights change
+	rayTrace.setReshadingEnabled(true);
+
+	// Keep what is needed to trace only the tiles that a moved surface affects
+	rayTrace.setDependencyTracking(true);
+
 	// Callback for window redisplay
 	glutDisplayFunc(RenderSceneCB);		
 	glutReshapeFunc(ResizeCB);
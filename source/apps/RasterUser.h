@@ -3,13 +3,21 @@
 
 #include <time.h> 
 
+// Glut takes care of all the system-specific chores required for creating windows, 
+// initializing OpenGL contexts, and handling input events
+#ifdef __APPLE__
+#include <GLUT/GLUT.h>
+#else
+#include <GL/glut.h>
+#endif
+
 #include "RayTracer.h"
-#include "Sphere.h"
-#include "Plane.h"
-#include "Cylinder.h"
-#include "Ellipsoid.h"
-#include "QuadricSurface.h"
-#include "SimplePolygon.h"
+#include "DemoScene.h"
+
+/**
+* Copies the frame buffer into the color buffer of the window and swaps buffers.
+*/
+static void showColorBuffer();
 
 /**
 * Acts as the display function for the window. 
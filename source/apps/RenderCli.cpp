@@ -0,0 +1,461 @@
+#include <chrono>
+
+#include "RayTracer.h"
+#include "DemoScene.h"
+#include "ImageWriter.h"
+#include "RenderFarm.h"
+#include "SceneFile.h"
+#include "TiledImageFile.h"
+#include "TriangleMesh.h"
+
+/**
+* Headless front end of the ray tracer. Renders a scene file or the demonstration scene without
+* opening a window and writes the frame buffer to a PPM or PNG file, so that
+* images can be produced on machines without a display. Images written to a
+* ".tiles" file are streamed tile by tile and never held in memory as a whole.
+*
+* With --workers the process becomes the coordinator of a render by several
+* worker processes, each of which runs this program again with the same
+* options and --worker-fd.
+*/
+
+// Color to which pixels are set if there is no intersection
+const color LIGHT_BLUE(0.784, 0.784, 1.0);
+
+/**
+* Rendering settings collected from the command line.
+*/
+struct RenderOptions
+{
+	int width = WINDOW_WIDTH;
+	int height = WINDOW_HEIGHT;
+	int recursionDepth = 2;
+	int threadCount = 0;
+	int packetSize = 4;
+
+	// Rays per side of the pixels that differ from their neighbors by more
+	// than aaThreshold, and the extra rays allowed per pixel of the frame
+	int aaSamples = 1;
+	real aaThreshold = 0.1;
+	real aaBudget = 1.0;
+
+	// Order of the pixels in the frame buffer
+	PixelLayout layout = PixelLayout::TILED;
+
+	vec3 eye = vec3( 0, 0, 0 );
+	vec3 direction = vec3( 0, 0, -1 );
+	vec3 up = vec3( 0, 1, 0 );
+
+	// Vertical field of view in degrees for perspective views
+	real fieldOfView = 45.0;
+
+	// Height of the projection plane for orthographic views. Zero for perspective.
+	real orthoHeight = 0.0;
+
+	// True if any of the camera options was given
+	bool cameraSet = false;
+
+	// Text scene file to render instead of the demonstration scene
+	string scene;
+
+	bool night = false;
+
+	// Binary mesh files to add to the scene
+	std::vector<string> meshes;
+
+	string output = "render.ppm";
+
+	// Tiles kept in memory while streaming into a tiled image file
+	int residentTiles = 256;
+
+	// Number of worker processes to coordinate. Zero renders in this process.
+	int workerCount = 0;
+
+	// Socket to the coordinator when running as a worker, or -1
+	int workerFd = -1;
+
+	// Seconds a worker may take for a range of tiles. Zero waits forever.
+	real workerTimeout = 120.0;
+
+	// Failure caused in the first worker after it has delivered
+	// faultAfterTiles tiles, to test the recovery of a distributed render
+	WorkerFault fault = WorkerFault::NONE;
+	int faultAfterTiles = 0;
+};
+
+
+static void printUsage( const char * program )
+{
+	std::cerr << "Usage: " << program << " [options]" << endl
+		<< "  -o, --output FILE       image to write, .png, .ppm, or .tiles (default render.ppm)" << endl
+		<< "  -w, --width N           width in pixels (default " << WINDOW_WIDTH << ")" << endl
+		<< "  -h, --height N          height in pixels (default " << WINDOW_HEIGHT << ")" << endl
+		<< "  -d, --depth N           recursion depth for reflections (default 2)" << endl
+		<< "  --eye X Y Z             position of the view point (default 0 0 0)" << endl
+		<< "  --dir X Y Z             viewing direction (default 0 0 -1)" << endl
+		<< "  --up X Y Z              approximate up vector (default 0 1 0)" << endl
+		<< "  --fov DEGREES           vertical field of view (default 45)" << endl
+		<< "  --ortho HEIGHT          orthographic view with the given plane height" << endl
+		<< "  --threads N             worker threads, 0 for one per core (default 0)" << endl
+		<< "  --packet N              width of primary ray packets, 1, 2, or 4 (default 4)" << endl
+		<< "  --aa N                  trace N x N rays in pixels that differ from their neighbors" << endl
+		<< "                          (default 1, off). Rejected with --workers and .tiles output," << endl
+		<< "                          which have no whole frame to compare pixels in." << endl
+		<< "  --aa-threshold T        color difference that marks a pixel for --aa (default 0.1)" << endl
+		<< "  --aa-budget B           extra rays of --aa per pixel of the frame (default 1)" << endl
+		<< "  --workers N             render with N worker processes, each with --threads" << endl
+		<< "                          threads (default 1)" << endl
+		<< "  --worker-timeout SEC    seconds a worker may take for a range of tiles before it" << endl
+		<< "                          is replaced, 0 to wait forever (default 120)" << endl
+		<< "  --kill-worker-after N   testing: kill the first worker after it sent N tiles" << endl
+		<< "  --stop-worker-after N   testing: make the first worker hang after it sent N tiles" << endl
+		<< "  --worker-fd FD          run as a worker of a coordinator connected to FD" << endl
+		<< "  --resident-tiles N      tiles kept in memory while writing .tiles (default 256)" << endl
+		<< "  --layout NAME           pixel storage: linear, tiled, or morton (default tiled)" << endl
+		<< "  --scene FILE            render a text scene file instead of the demonstration scene." << endl
+		<< "                          Camera options replace the camera of the file." << endl
+		<< "  --mesh FILE             add a binary mesh file to the scene, may be repeated" << endl
+		<< "  --night                 dim the lights of the demonstration scene" << endl;
+
+} // end printUsage
+
+
+/**
+* Reads the options from the command line.
+* @return false if an option is unknown or is missing a value
+*/
+static bool parseOptions( int argc, char** argv, RenderOptions & options )
+{
+	for( int i = 1; i < argc; i++ ) {
+
+		string arg = argv[i];
+
+		if( arg == "--help" ) {
+			return false;
+		}
+
+		// Number of values that follow the option
+		int valueCount = 1;
+		if( arg == "--eye" || arg == "--dir" || arg == "--up" ) {
+			valueCount = 3;
+		}
+		else if( arg == "--night" ) {
+			valueCount = 0;
+		}
+		else if( arg.size( ) < 2 || arg[0] != '-' ) {
+			std::cerr << "Unknown option " << arg << endl;
+			return false;
+		}
+
+		if( i + valueCount >= argc ) {
+			std::cerr << "Missing value for " << arg << endl;
+			return false;
+		}
+
+		char** values = argv + i + 1;
+		i += valueCount;
+
+		if( arg == "--eye" || arg == "--dir" || arg == "--up" || arg == "--fov" || arg == "--ortho" ) {
+			options.cameraSet = true;
+		}
+
+		if( arg == "-o" || arg == "--output" ) {
+			options.output = values[0];
+		}
+		else if( arg == "-w" || arg == "--width" ) {
+			options.width = atoi( values[0] );
+		}
+		else if( arg == "-h" || arg == "--height" ) {
+			options.height = atoi( values[0] );
+		}
+		else if( arg == "-d" || arg == "--depth" ) {
+			options.recursionDepth = atoi( values[0] );
+		}
+		else if( arg == "--eye" ) {
+			options.eye = vec3( atof( values[0] ), atof( values[1] ), atof( values[2] ) );
+		}
+		else if( arg == "--dir" ) {
+			options.direction = vec3( atof( values[0] ), atof( values[1] ), atof( values[2] ) );
+		}
+		else if( arg == "--up" ) {
+			options.up = vec3( atof( values[0] ), atof( values[1] ), atof( values[2] ) );
+		}
+		else if( arg == "--fov" ) {
+			options.fieldOfView = atof( values[0] );
+		}
+		else if( arg == "--ortho" ) {
+			options.orthoHeight = atof( values[0] );
+		}
+		else if( arg == "--threads" ) {
+			options.threadCount = atoi( values[0] );
+		}
+		else if( arg == "--packet" ) {
+			options.packetSize = atoi( values[0] );
+			if( options.packetSize != 1 && options.packetSize != 2 && options.packetSize != 4 ) {
+				std::cerr << "Packet width must be 1, 2, or 4" << endl;
+				return false;
+			}
+		}
+		else if( arg == "--aa" ) {
+			options.aaSamples = atoi( values[0] );
+		}
+		else if( arg == "--aa-threshold" ) {
+			options.aaThreshold = atof( values[0] );
+		}
+		else if( arg == "--aa-budget" ) {
+			options.aaBudget = atof( values[0] );
+		}
+		else if( arg == "--workers" ) {
+			options.workerCount = atoi( values[0] );
+		}
+		else if( arg == "--worker-timeout" ) {
+			options.workerTimeout = atof( values[0] );
+		}
+		else if( arg == "--kill-worker-after" ) {
+			options.fault = WorkerFault::DIE;
+			options.faultAfterTiles = atoi( values[0] );
+		}
+		else if( arg == "--stop-worker-after" ) {
+			options.fault = WorkerFault::HANG;
+			options.faultAfterTiles = atoi( values[0] );
+		}
+		else if( arg == "--worker-fd" ) {
+			options.workerFd = atoi( values[0] );
+		}
+		else if( arg == "--resident-tiles" ) {
+			options.residentTiles = atoi( values[0] );
+		}
+		else if( arg == "--layout" ) {
+			string name = values[0];
+			if( name == "linear" ) {
+				options.layout = PixelLayout::LINEAR;
+			}
+			else if( name == "tiled" ) {
+				options.layout = PixelLayout::TILED;
+			}
+			else if( name == "morton" ) {
+				options.layout = PixelLayout::MORTON;
+			}
+			else {
+				std::cerr << "Unknown layout " << name << endl;
+				return false;
+			}
+		}
+		else if( arg == "--scene" ) {
+			options.scene = values[0];
+		}
+		else if( arg == "--mesh" ) {
+			options.meshes.push_back( values[0] );
+		}
+		else if( arg == "--night" ) {
+			options.night = true;
+		}
+		else {
+			std::cerr << "Unknown option " << arg << endl;
+			return false;
+		}
+	}
+
+	if( options.width <= 0 || options.height <= 0 ) {
+		std::cerr << "Width and height must be positive" << endl;
+		return false;
+	}
+
+	if( glm::length( glm::cross( options.direction, options.up ) ) == 0.0 ) {
+		std::cerr << "The up vector cannot be parallel to the viewing direction" << endl;
+		return false;
+	}
+
+	return true;
+
+} // end parseOptions
+
+
+/**
+* Prints the throughput of every worker process of a distributed render.
+*/
+static void printWorkerStats( const std::vector<WorkerStats> & stats )
+{
+	for( const WorkerStats & worker : stats ) {
+
+		double rate = worker.busySeconds > 0.0 ? worker.pixels / worker.busySeconds / 1.0e6 : 0.0;
+
+		cout << "Worker " << worker.processId << ": " << worker.tiles << " tiles, " << worker.pixels
+			 << " pixels, " << worker.busySeconds << " sec busy, " << rate << " Mpixels/sec"
+			 << ( worker.timedOut ? ", timed out" : worker.failed ? ", failed" : "" ) << endl;
+	}
+
+} // end printWorkerStats
+
+
+int main( int argc, char** argv )
+{
+	RenderOptions options;
+
+	if( !parseOptions( argc, argv, options ) ) {
+		printUsage( argv[0] );
+		return 1;
+	}
+
+	bool serving = options.workerFd >= 0;
+	bool coordinating = options.workerCount > 0 && !serving;
+
+	// Streamed images only get their buffers from setStreamingOutput
+	bool streaming = options.output.size( ) > 6 &&
+					 options.output.compare( options.output.size( ) - 6, 6, ".tiles" ) == 0;
+
+	// Pixels are compared with their neighbors after the whole frame is
+	// traced, but streamed tiles, and the tiles that workers send, leave
+	// memory as soon as they are done
+	if( streaming && options.aaSamples > 1 ) {
+		std::cerr << "--aa cannot be used with .tiles output" << endl;
+		return 1;
+	}
+	if( coordinating && options.aaSamples > 1 ) {
+		std::cerr << "--aa cannot be used with --workers" << endl;
+		return 1;
+	}
+
+	FrameBuffer frameBuffer( streaming || serving ? 1 : options.width, streaming || serving ? 1 : options.height );
+	TiledImageWriter tiledImage;
+	WorkerConnection connection( options.workerFd, options.width, options.height, frameBuffer.getTileSize( ) );
+	frameBuffer.setClearColor( color( 0, 0, 0 ) );
+	if( serving ) {
+
+		// Workers send every tile to the coordinator as soon as it is done
+		frameBuffer.setStreamingOutput( &connection, options.residentTiles );
+	}
+	else if( streaming ) {
+
+		if( !tiledImage.open( options.output, options.width, options.height, frameBuffer.getTileSize( ) ) ) {
+			std::cerr << "Could not create " << options.output << endl;
+			return 1;
+		}
+		if( !coordinating ) {
+			frameBuffer.setStreamingOutput( &tiledImage, options.residentTiles );
+		}
+	}
+	else {
+		frameBuffer.setPixelLayout( options.layout );
+	}
+
+	if( coordinating ) {
+
+		FarmSettings farm;
+		farm.workerCommand.assign( argv, argv + argc );
+		farm.workerCount = options.workerCount;
+		farm.rangeTimeout = options.workerTimeout;
+		farm.fault = options.fault;
+		farm.faultAfterTiles = options.faultAfterTiles;
+
+		FrameBufferTileOutput bufferOutput( frameBuffer );
+		TileOutput & output = streaming ? static_cast<TileOutput &>( tiledImage ) : bufferOutput;
+
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now( );
+
+		std::vector<WorkerStats> stats;
+		string error;
+		bool rendered = renderWithWorkers( farm, output, stats, error );
+
+		std::chrono::duration<double> renderTime = std::chrono::steady_clock::now( ) - start;
+		std::cout << "Render time: " << renderTime.count( ) << " sec." << std::endl;
+		printWorkerStats( stats );
+
+		if( !rendered ) {
+			std::cerr << error << endl;
+			return 1;
+		}
+
+		if( streaming ? !tiledImage.close( ) : !writeImage( frameBuffer, options.output ) ) {
+			std::cerr << "Could not write " << options.output << endl;
+			return 1;
+		}
+
+		return 0;
+	}
+
+	RayTracer rayTrace( frameBuffer );
+	rayTrace.setDefaultColor( LIGHT_BLUE );
+	rayTrace.setRecursionDepth( options.recursionDepth );
+	rayTrace.setPacketSize( options.packetSize );
+	rayTrace.setAdaptiveSampling( options.aaSamples, options.aaThreshold, options.aaBudget );
+	if( options.threadCount > 0 ) {
+		rayTrace.setThreadCount( options.threadCount );
+	}
+	else if( serving ) {
+		rayTrace.setThreadCount( 1 );
+	}
+
+	SceneDescription scene;
+	if( !options.scene.empty( ) ) {
+
+		string error;
+		if( !loadScene( options.scene, scene, error ) ) {
+			std::cerr << error << endl;
+			return 1;
+		}
+
+		rayTrace.setDefaultColor( scene.background );
+		if( !options.cameraSet ) {
+			options.eye = scene.eye;
+			options.direction = scene.direction;
+			options.up = scene.up;
+			options.fieldOfView = scene.fieldOfView;
+			options.orthoHeight = scene.orthoHeight;
+		}
+	}
+	else {
+
+		DemoScene demoScene;
+		buildDemoScene( demoScene );
+		if( options.night ) {
+			setDemoTimeOfDay( demoScene, true );
+		}
+
+		scene.surfaces = demoScene.surfaces;
+		scene.lights = demoScene.lights;
+	}
+
+	rayTrace.setCameraFrame( options.eye, options.direction, options.up );
+	if( options.orthoHeight > 0.0 ) {
+		rayTrace.calculateOrthographicViewingParameters( options.orthoHeight );
+	}
+	else {
+		rayTrace.calculatePerspectiveViewingParameters( options.fieldOfView );
+	}
+
+	for( const string & meshFile : options.meshes ) {
+
+		shared_ptr<TriangleMesh> mesh = TriangleMesh::load( meshFile, Material( LIGHT_GRAY ) );
+		if( !mesh ) {
+			std::cerr << "Could not load " << meshFile << endl;
+			return 1;
+		}
+		scene.surfaces.push_back( mesh );
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now( );
+
+	// The hierarchy of a scene file is only used if no meshes were added
+	rayTrace.commitScene( scene.surfaces, scene.lights, &scene.hierarchy );
+
+	if( serving ) {
+		return connection.serve( rayTrace ) ? 0 : 1;
+	}
+
+	rayTrace.raytraceScene( );
+
+	std::chrono::duration<double> renderTime = std::chrono::steady_clock::now( ) - start;
+	std::cout << "Render time: " << renderTime.count( ) << " sec." << std::endl;
+	if( options.aaSamples > 1 ) {
+		std::cout << "Supersampled pixels: " << rayTrace.getSupersampledPixelCount( ) << std::endl;
+	}
+
+	if( streaming ? !tiledImage.close( ) : !writeImage( frameBuffer, options.output ) ) {
+		std::cerr << "Could not write " << options.output << endl;
+		return 1;
+	}
+
+	return 0;
+
+} // end main
@@ -0,0 +1,53 @@
+#include <fstream>
+
+#include "TiledImageFile.h"
+
+/**
+* Converts a tiled image file written by the renderer into a binary PPM file.
+* Rows are written one at a time from the top of the image, so only the tiles
+* of one row of tiles are brought into memory at once.
+*/
+
+int main( int argc, char** argv )
+{
+	if( argc != 3 ) {
+		std::cerr << "Usage: " << argv[0] << " INPUT.tiles OUTPUT.ppm" << endl;
+		return 1;
+	}
+
+	TiledImageReader image;
+	if( !image.open( argv[1] ) ) {
+		std::cerr << "Could not read " << argv[1] << endl;
+		return 1;
+	}
+
+	std::ofstream file( argv[2], std::ios::binary );
+	if( !file ) {
+		std::cerr << "Could not write " << argv[2] << endl;
+		return 1;
+	}
+
+	int width = image.getWidth( );
+	int height = image.getHeight( );
+	file << "P6\n" << width << " " << height << "\n255\n";
+
+	std::vector<unsigned char> row( (size_t)3 * width );
+	for( int y = height - 1; y >= 0; y-- ) {
+
+		for( int x = 0; x < width; x++ ) {
+			const unsigned char * pixel = image.getPixel( x, y );
+			row[3 * x] = pixel[0];
+			row[3 * x + 1] = pixel[1];
+			row[3 * x + 2] = pixel[2];
+		}
+		file.write( (const char *)row.data( ), row.size( ) );
+	}
+
+	if( !file.good( ) ) {
+		std::cerr << "Could not write " << argv[2] << endl;
+		return 1;
+	}
+
+	return 0;
+
+} // end main
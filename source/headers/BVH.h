@@ -0,0 +1,358 @@
+#pragma once
+
+#include "BoundingBox.h"
+#include "Ray.h"
+#include "ThreadPool.h"
+
+/**
+* Bounding volume hierarchy over a set of primitives that are described only by
+* their bounding boxes. The tree is built top down using a binned surface area
+* heuristic. Large subtrees are built concurrently on a ThreadPool.
+*
+* The hierarchy does not know what the primitives are. Traversal hands the index
+* of every primitive in a leaf whose box is hit to a caller supplied function that
+* performs the actual intersection test.
+*/
+class BVH
+{
+public:
+
+	/**
+	* Node of the tree. Interior nodes store the index of their first child. The
+	* second child always directly follows the first one. Leaves store a range of
+	* entries in the primitive index list.
+	*/
+	struct Node
+	{
+		BoundingBox bounds;
+
+		// Index of the first child for interior nodes. Index of the first entry
+		// in the primitive index list for leaves.
+		int firstIndex = 0;
+
+		// Number of primitives in a leaf. Zero for interior nodes.
+		int primitiveCount = 0;
+
+		bool isLeaf() const { return primitiveCount > 0; }
+	};
+
+	/**
+	* Builds the hierarchy. Discards any previously built tree.
+	* @param primitiveBounds - bounding box of every primitive. Boxes must be finite.
+	* @param threadPool - pool used to build subtrees concurrently. May be null.
+	* @param maxLeafSize - nodes with this many primitives or fewer become leaves.
+	*/
+	void build( const std::vector<BoundingBox> & primitiveBounds, ThreadPool * threadPool = nullptr, int maxLeafSize = 4 );
+
+	/**
+	* Replaces the tree by one that was built earlier, such as one read back from
+	* a file. The arrays must come from getNodes and getPrimitiveIndices.
+	* @param nodes - nodes of the tree. Node zero is the root.
+	* @param primitiveIndices - primitive indices referenced by the leaves
+	*/
+	void assign( std::vector<Node> nodes, std::vector<int> primitiveIndices )
+	{
+		this->nodes = std::move( nodes );
+		this->primitiveIndices = std::move( primitiveIndices );
+	}
+
+	/**
+	* Checks that every node refers to existing nodes or index list entries, that
+	* children follow their parents, that the tree is shallow enough for the
+	* traversal stack, and that the leaves hold every primitive of a set exactly
+	* once. Used to check a tree that was passed to assign.
+	* @param primitiveCount - number of primitives the tree should hold
+	*/
+	bool isConsistent( int primitiveCount ) const;
+
+	/**
+	* Removes all nodes from the hierarchy.
+	*/
+	void clear() { nodes.clear(); primitiveIndices.clear(); }
+
+	/**
+	* Returns true if the hierarchy contains no primitives.
+	*/
+	bool isEmpty() const { return nodes.empty(); }
+
+	/**
+	* Returns the bounding box of all primitives in the hierarchy.
+	*/
+	BoundingBox getBounds() const { return nodes.empty() ? BoundingBox() : nodes[0].bounds; }
+
+	/**
+	* Returns the nodes of the tree. Node zero is the root.
+	*/
+	const std::vector<Node> & getNodes() const { return nodes; }
+
+	/**
+	* Returns the primitive indices referenced by the leaves, in leaf order.
+	*/
+	const std::vector<int> & getPrimitiveIndices() const { return primitiveIndices; }
+
+	/**
+	* Visits the primitives in every leaf whose box is hit by the ray, nearest
+	* boxes first. Boxes that start beyond tMax are skipped, so a leaf function
+	* that finds a hit should lower tMax.
+	* @param ray - ray being traced
+	* @param tMin - smallest parameter value of interest along the ray
+	* @param tMax - largest parameter value of interest along the ray
+	* @param leafFunction - callable as bool(int primitiveIndex, real & tMax).
+	* Returning true ends the traversal.
+	* @returns true if the leaf function ended the traversal
+	*/
+	template <class LeafFunction>
+	bool traverse( const Ray & ray, real tMin, real & tMax, LeafFunction leafFunction ) const;
+
+	/**
+	* Visits every leaf whose box is hit by the ray, nearest boxes first. Used by
+	* callers that test all of the primitives of a leaf at once.
+	* @param ray - ray being traced
+	* @param tMin - smallest parameter value of interest along the ray
+	* @param tMax - largest parameter value of interest along the ray
+	* @param leafFunction - callable as bool(const Node & leaf, real & tMax).
+	* Returning true ends the traversal.
+	* @returns true if the leaf function ended the traversal
+	*/
+	template <class LeafFunction>
+	bool traverseLeaves( const Ray & ray, real tMin, real & tMax, LeafFunction leafFunction ) const;
+
+	/**
+	* Visits every leaf whose box is hit by at least one ray of a packet. Each
+	* node is visited once for the whole packet, with a mask of the lanes that
+	* may hit its box. The mask can include lanes whose rays miss the box.
+	* Children are visited in the order in which the first of those rays
+	* reaches them.
+	* @param packet - rays being traced
+	* @param laneMask - lanes of the packet to trace
+	* @param tMin - smallest parameter value of interest along the rays
+	* @param tMax - largest parameter value of interest along the ray in each
+	* lane. The leaf function should lower the entries of lanes that hit something.
+	* @param leafFunction - callable as bool(const Node & leaf, unsigned laneMask).
+	* Returning true ends the traversal.
+	* @returns true if the leaf function ended the traversal
+	*/
+	template <class LeafFunction>
+	bool traversePacket( const RayPacket & packet, unsigned laneMask, real tMin, const real tMax[],
+						 LeafFunction leafFunction ) const;
+
+protected:
+
+	/**
+	* Range of primitives that still has to be turned into a subtree.
+	*/
+	struct BuildTask
+	{
+		int nodeIndex;
+		int begin;
+		int end;
+		int depth;
+	};
+
+	/**
+	* Builds the subtree for a range of the primitive index list into a separate
+	* node list. Node zero of the list is the root of the subtree. Child indices
+	* are relative to that list.
+	*/
+	void buildSubtree( std::vector<Node> & subtreeNodes, int nodeIndex, int begin, int end, int depth );
+
+	/**
+	* Computes the bounds of a range of primitives and decides how to split it.
+	* Reorders the range so that the primitives of the first child come first.
+	* @param node - node for the range. Its bounds are set.
+	* @param begin - first entry of the range in the primitive index list
+	* @param end - one past the last entry of the range
+	* @param depth - depth of the node in the tree
+	* @param mid - set to the first entry that belongs to the second child
+	* @returns false if the range should become a leaf
+	*/
+	bool splitRange( Node & node, int begin, int end, int depth, int & mid );
+
+	std::vector<Node> nodes;
+
+	// Primitive indices referenced by the leaves
+	std::vector<int> primitiveIndices;
+
+	// Bounding boxes and centroids of the primitives while building
+	const std::vector<BoundingBox> * buildBounds = nullptr;
+	std::vector<vec3> buildCentroids;
+
+	int maxLeafSize = 4;
+
+	// Below this depth splits are chosen with the surface area heuristic. Deeper
+	// nodes are split at the median so that the traversal stack cannot overflow.
+	static const int MAX_SAH_DEPTH = 48;
+
+	// Maximum number of nodes on the traversal stack
+	static const int MAX_STACK_SIZE = 128;
+
+}; // end BVH class
+
+
+template <class LeafFunction>
+bool BVH::traverse( const Ray & ray, real tMin, real & tMax, LeafFunction leafFunction ) const
+{
+	return traverseLeaves( ray, tMin, tMax, [&]( const Node & leaf, real & tMax ) {
+
+		for( int i = leaf.firstIndex; i < leaf.firstIndex + leaf.primitiveCount; i++ ) {
+			if( leafFunction( primitiveIndices[i], tMax ) ) {
+				return true;
+			}
+		}
+		return false;
+	} );
+
+} // end traverse
+
+
+template <class LeafFunction>
+bool BVH::traverseLeaves( const Ray & ray, real tMin, real & tMax, LeafFunction leafFunction ) const
+{
+	if( nodes.empty() ) {
+		return false;
+	}
+
+	vec3 inverseDirection = real( 1.0 ) / ray.direct;
+
+	real tEntry;
+	if( !nodes[0].bounds.intersect( ray, inverseDirection, tMin, tMax, tEntry ) ) {
+		return false;
+	}
+
+	// Nodes still to be visited along with the parameter at which the ray enters them
+	int stack[MAX_STACK_SIZE];
+	real stackEntry[MAX_STACK_SIZE];
+	int stackSize = 0;
+
+	stack[stackSize] = 0;
+	stackEntry[stackSize++] = tEntry;
+
+	while( stackSize > 0 ) {
+
+		stackSize--;
+		if( stackEntry[stackSize] > tMax ) {
+			continue; // a closer hit was found after this node was pushed
+		}
+
+		const Node & node = nodes[stack[stackSize]];
+
+		if( node.isLeaf() ) {
+
+			if( leafFunction( node, tMax ) ) {
+				return true;
+			}
+			continue;
+		}
+
+		int first = node.firstIndex;
+		int second = node.firstIndex + 1;
+		real firstEntry = 0.0, secondEntry = 0.0;
+		bool hitFirst = nodes[first].bounds.intersect( ray, inverseDirection, tMin, tMax, firstEntry );
+		bool hitSecond = nodes[second].bounds.intersect( ray, inverseDirection, tMin, tMax, secondEntry );
+
+		if( hitFirst && hitSecond ) {
+
+			// Push the farther child first so that the nearer one is visited next
+			if( firstEntry < secondEntry ) {
+				std::swap( first, second );
+				std::swap( firstEntry, secondEntry );
+			}
+			stack[stackSize] = first;
+			stackEntry[stackSize++] = firstEntry;
+			stack[stackSize] = second;
+			stackEntry[stackSize++] = secondEntry;
+		}
+		else if( hitFirst ) {
+			stack[stackSize] = first;
+			stackEntry[stackSize++] = firstEntry;
+		}
+		else if( hitSecond ) {
+			stack[stackSize] = second;
+			stackEntry[stackSize++] = secondEntry;
+		}
+	}
+
+	return false;
+
+} // end traverseLeaves
+
+
+template <class LeafFunction>
+bool BVH::traversePacket( const RayPacket & packet, unsigned laneMask, real tMin, const real tMax[],
+						  LeafFunction leafFunction ) const
+{
+	if( nodes.empty() ) {
+		return false;
+	}
+
+	// Nodes still to be visited along with the lanes that reached their parent
+	int stack[MAX_STACK_SIZE];
+	unsigned stackMask[MAX_STACK_SIZE];
+	int stackSize = 0;
+
+	stack[stackSize] = 0;
+	stackMask[stackSize++] = laneMask;
+
+	while( stackSize > 0 ) {
+
+		stackSize--;
+		const Node & node = nodes[stack[stackSize]];
+		unsigned nodeMask = stackMask[stackSize];
+
+		// Boxes are tested when a node is visited rather than when it is pushed,
+		// so that lanes that found a closer hit in the meantime are accounted for.
+		real packetMax = 0.0;
+		for( int lane = 0; lane < packet.size; lane++ ) {
+			if( ( nodeMask & ( 1u << lane ) ) && tMax[lane] > packetMax ) {
+				packetMax = tMax[lane];
+			}
+		}
+
+		if( node.bounds.missedBy( packet, tMin, packetMax ) ) {
+			continue;
+		}
+
+		// If the first ray hits the box the node is visited with all of the lanes,
+		// since the rays are coherent and the leaves test every lane anyway.
+		// Otherwise only the lanes that hit the box continue.
+		int lane = 0;
+		while( !( nodeMask & ( 1u << lane ) ) ) {
+			lane++;
+		}
+		if( !node.bounds.intersect( packet, 1u << lane, tMin, tMax ) ) {
+			nodeMask = node.bounds.intersect( packet, nodeMask & ~( 1u << lane ), tMin, tMax );
+			if( nodeMask == 0 ) {
+				continue;
+			}
+			while( !( nodeMask & ( 1u << lane ) ) ) {
+				lane++;
+			}
+		}
+
+		if( node.isLeaf() ) {
+
+			if( leafFunction( node, nodeMask ) ) {
+				return true;
+			}
+			continue;
+		}
+
+		int first = node.firstIndex;
+		int second = node.firstIndex + 1;
+
+		// Order the children along the direction of the first active ray
+		vec3 offset = nodes[second].bounds.centroid() - nodes[first].bounds.centroid();
+		if( offset.x * packet.directX[lane] + offset.y * packet.directY[lane] + offset.z * packet.directZ[lane] < 0 ) {
+			std::swap( first, second );
+		}
+
+		// Push the farther child first so that the nearer one is visited next
+		stack[stackSize] = second;
+		stackMask[stackSize++] = nodeMask;
+		stack[stackSize] = first;
+		stackMask[stackSize++] = nodeMask;
+	}
+
+	return false;
+
+} // end traversePacket
@@ -0,0 +1,234 @@
+#pragma once
+
+#include "Defines.h"
+#include "Ray.h"
+#include "RayPacket.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+/**
+* Simple struct that represents an axis aligned bounding box. A default
+* constructed box is empty. Surfaces without finite extent, such as planes,
+* report a box that covers all of space.
+*/
+struct BoundingBox
+{
+	vec3 minPoint; // corner with the smallest x, y, and z values
+	vec3 maxPoint; // corner with the largest x, y, and z values
+
+	BoundingBox()
+		: minPoint( vec3( std::numeric_limits<real>::max() ) ), maxPoint( vec3( -std::numeric_limits<real>::max() ) )
+	{ }
+
+	BoundingBox( const vec3 & minPoint, const vec3 & maxPoint )
+		: minPoint( minPoint ), maxPoint( maxPoint )
+	{ }
+
+	/**
+	* Returns a box that covers all of space.
+	*/
+	static BoundingBox infinite()
+	{
+		return BoundingBox( vec3( -INFINITY ), vec3( INFINITY ) );
+	}
+
+	/**
+	* Grows the box to contain a point.
+	*/
+	void expand( const vec3 & point )
+	{
+		minPoint = glm::min( minPoint, point );
+		maxPoint = glm::max( maxPoint, point );
+	}
+
+	/**
+	* Grows the box to contain another box.
+	*/
+	void expand( const BoundingBox & box )
+	{
+		minPoint = glm::min( minPoint, box.minPoint );
+		maxPoint = glm::max( maxPoint, box.maxPoint );
+	}
+
+	/**
+	* Returns true if the box does not contain any points.
+	*/
+	bool isEmpty() const
+	{
+		return minPoint.x > maxPoint.x || minPoint.y > maxPoint.y || minPoint.z > maxPoint.z;
+	}
+
+	/**
+	* Returns true if the box has a finite extent along every axis.
+	*/
+	bool isFinite() const
+	{
+		return std::isfinite( minPoint.x ) && std::isfinite( minPoint.y ) && std::isfinite( minPoint.z ) &&
+			std::isfinite( maxPoint.x ) && std::isfinite( maxPoint.y ) && std::isfinite( maxPoint.z );
+	}
+
+	/**
+	* Returns true if the box shares at least one point with another box.
+	*/
+	bool overlaps( const BoundingBox & box ) const
+	{
+		return minPoint.x <= box.maxPoint.x && box.minPoint.x <= maxPoint.x &&
+			minPoint.y <= box.maxPoint.y && box.minPoint.y <= maxPoint.y &&
+			minPoint.z <= box.maxPoint.z && box.minPoint.z <= maxPoint.z;
+	}
+
+	vec3 centroid() const { return real( 0.5 ) * ( minPoint + maxPoint ); }
+
+	vec3 extent() const { return maxPoint - minPoint; }
+
+	/**
+	* Returns the surface area of the box. Used to estimate how likely a ray
+	* is to hit it.
+	*/
+	real surfaceArea() const
+	{
+		if( isEmpty() ) {
+			return 0.0;
+		}
+		vec3 e = extent();
+		return 2.0 * ( e.x * e.y + e.x * e.z + e.y * e.z );
+	}
+
+	/**
+	* Returns the axis (0 = x, 1 = y, 2 = z) along which the box is longest.
+	*/
+	int longestAxis() const
+	{
+		vec3 e = extent();
+		if( e.x > e.y && e.x > e.z ) {
+			return 0;
+		}
+		return e.y > e.z ? 1 : 2;
+	}
+
+	/**
+	* Slab test of a ray against the box.
+	* @param ray - ray being checked for intersection
+	* @param inverseDirection - component wise reciprocal of the ray direction
+	* @param tMin - smallest parameter value of interest along the ray
+	* @param tMax - largest parameter value of interest along the ray
+	* @param tEntry - set to the parameter at which the ray enters the box
+	* @returns true if the ray passes through the box within [tMin, tMax]
+	*/
+	bool intersect( const Ray & ray, const vec3 & inverseDirection, real tMin, real tMax, real & tEntry ) const
+	{
+		for( int axis = 0; axis < 3; axis++ ) {
+
+			real t0 = ( minPoint[axis] - ray.origin[axis] ) * inverseDirection[axis];
+			real t1 = ( maxPoint[axis] - ray.origin[axis] ) * inverseDirection[axis];
+
+			if( t0 > t1 ) {
+				std::swap( t0, t1 );
+			}
+
+			tMin = t0 > tMin ? t0 : tMin;
+			tMax = t1 < tMax ? t1 : tMax;
+
+			if( tMin > tMax ) {
+				return false;
+			}
+		}
+
+		tEntry = tMin;
+		return true;
+	}
+
+	/**
+	* Conservative test of a whole packet against the box. Bounds the parameters
+	* at which the rays of the packet enter and leave the box using the ranges of
+	* their origins and reciprocal directions. Works in double precision, like
+	* the packet itself.
+	* @param packet - rays being checked for intersection
+	* @param tMin - smallest parameter value of interest along the rays
+	* @param tMax - largest parameter value of interest along any of the rays
+	* @returns true if it is certain that none of the rays pass through the box
+	*/
+	bool missedBy( const RayPacket & packet, real tMin, real tMax ) const
+	{
+		double entry = tMin;
+		double exit = tMax;
+
+		for( int axis = 0; axis < 3; axis++ ) {
+
+			if( !packet.coherentAxis[axis] ) {
+				continue;
+			}
+
+			// The slab is entered at the near plane and left at the far plane
+			bool positive = packet.inverseMin[axis] > 0;
+			double nearPlane = positive ? minPoint[axis] : maxPoint[axis];
+			double farPlane = positive ? maxPoint[axis] : minPoint[axis];
+
+			entry = std::max( entry, productRange( nearPlane - packet.originMax[axis], nearPlane - packet.originMin[axis],
+												   packet.inverseMin[axis], packet.inverseMax[axis] ).first );
+			exit = std::min( exit, productRange( farPlane - packet.originMax[axis], farPlane - packet.originMin[axis],
+												 packet.inverseMin[axis], packet.inverseMax[axis] ).second );
+		}
+
+		return entry > exit;
+	}
+
+	/**
+	* Returns the smallest and largest product of a value in [a0, a1] and a
+	* value in [b0, b1].
+	*/
+	static std::pair<double, double> productRange( double a0, double a1, double b0, double b1 )
+	{
+		double p0 = a0 * b0, p1 = a0 * b1, p2 = a1 * b0, p3 = a1 * b1;
+		return std::make_pair( std::min( std::min( p0, p1 ), std::min( p2, p3 ) ),
+							   std::max( std::max( p0, p1 ), std::max( p2, p3 ) ) );
+	}
+
+	/**
+	* Slab test of the rays of a packet against the box.
+	* @param packet - rays being checked for intersection
+	* @param laneMask - lanes of the packet to test
+	* @param tMin - smallest parameter value of interest along the rays
+	* @param tMax - largest parameter value of interest along the ray in each lane
+	* @returns mask of the tested lanes whose rays pass through the box
+	*/
+	unsigned intersect( const RayPacket & packet, unsigned laneMask, real tMin, const real tMax[] ) const
+	{
+		unsigned hitMask = 0;
+
+		for( int lane = 0; lane < packet.size; lane++ ) {
+
+			if( !( laneMask & ( 1u << lane ) ) ) {
+				continue;
+			}
+
+			const double origin[3] = { packet.originX[lane], packet.originY[lane], packet.originZ[lane] };
+			const double inverse[3] = { packet.inverseX[lane], packet.inverseY[lane], packet.inverseZ[lane] };
+
+			double entry = tMin;
+			double exit = tMax[lane];
+
+			for( int axis = 0; axis < 3; axis++ ) {
+
+				double t0 = ( minPoint[axis] - origin[axis] ) * inverse[axis];
+				double t1 = ( maxPoint[axis] - origin[axis] ) * inverse[axis];
+
+				if( t0 > t1 ) {
+					std::swap( t0, t1 );
+				}
+
+				entry = t0 > entry ? t0 : entry;
+				exit = t1 < exit ? t1 : exit;
+			}
+
+			if( entry <= exit ) {
+				hitMask |= 1u << lane;
+			}
+		}
+
+		return hitMask;
+	}
+};
@@ -1,11 +1,99 @@
-#include "QuadricSurface.h"
+#pragma once
 
-class Cylinder : public QuadricSurface
+#include "Surface.h"
+
+/**
+* Sub-class of Surface that represents a cylinder of finite length around an
+* arbitrary axis, optionally closed by flat end caps. Rays are intersected with
+* the infinite cylinder and with the slab between the planes of the two ends,
+* and the hit is taken from the overlap of the two intervals, so a single solve
+* of the quadratic equation finds both the near and the far side.
+*
+* The element of a hit is SIDE or CAP.
+*/
+class Cylinder : public Surface
 {
-    public:
-    double radius, length;
+	public:
+
+	/**
+	* Constructor for an open cylinder around an axis parallel to the x axis.
+	* @param - position: xyz position of the center of the cylinder
+	* @param - mat: diffuse color of the cylinder
+	* @param - radius: radius of the cylinder
+	* @param - length: distance between the two ends
+	*/
+	Cylinder(const vec3 & position, const color & mat, real radius, real length);
+
+	/**
+	* Constructor for an open cylinder around an axis parallel to the x axis.
+	* @param - position: xyz position of the center of the cylinder
+	* @param - mat: material properties of the cylinder
+	* @param - radius: radius of the cylinder
+	* @param - length: distance between the two ends
+	*/
+	Cylinder(const vec3 & position, const Material & mat, real radius, real length);
+
+	/**
+	* Constructor for a cylinder around an arbitrary axis.
+	* @param - position: xyz position of the center of the cylinder
+	* @param - axis: direction of the axis. Does not need to be a unit vector.
+	* @param - mat: material properties of the cylinder
+	* @param - radius: radius of the cylinder
+	* @param - length: distance between the two ends
+	* @param - capped: true to close the ends with disks
+	*/
+	Cylinder(const vec3 & position, const vec3 & axis, const Material & mat, real radius, real length,
+			 bool capped = false);
+
+	/**
+	* Checks a ray for intersection with the cylinder. Finds the parameter of the
+	* closest point of intersection within [tMin, tMax) if one exits.
+	*/
+	virtual bool intersect( const Ray & ray, real tMin, real tMax, RayHit & hit ) const;
+
+	/**
+	* Returns the constant term of the quadratic equation for rays that start at
+	* the origin: the squared distance of the origin from the axis minus the
+	* squared radius.
+	*/
+	virtual real computeOriginTerm( const vec3 & origin ) const;
+
+	/**
+	* Same as intersect, with the constant term computed in advance.
+	*/
+	virtual bool intersectFromOrigin( const Ray & ray, real originTerm, real tMin, real tMax,
+									  RayHit & hit ) const;
+
+	/**
+	* Computes the point of intersection, the normal of the side or of the cap
+	* that was hit, and the material for a hit found by intersect.
+	*/
+	virtual void completeHitRecord( const Ray & ray, const RayHit & hit, HitRecord & hitRecord ) const;
+
+	/**
+	* Returns the smallest axis aligned box that encloses the cylinder.
+	*/
+	virtual BoundingBox bounds( ) const;
+
+	/**
+	* Values of the element of a hit
+	*/
+	enum Element { SIDE, CAP };
+
+	/**
+	* xyz location of the center of the cylinder, halfway between the ends
+	*/
+	vec3 center;
+
+	/**
+	* Unit vector along the axis of the cylinder
+	*/
+	vec3 axis;
+
+	real radius, length;
 
-    Cylinder(const dvec3 & position, const color & mat, double radius, double length);
-    Cylinder(const dvec3 & position, const Material & mat, double radius, double length);
-    HitRecord findClosestIntersection(const Ray & ray) override;
+	/**
+	* True if the ends are closed by disks
+	*/
+	bool capped;
 };
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "BVH.h"
+#include "Cylinder.h"
+#include "Simd.h"
+
+/**
+* Collection of finite cylinders, such as the bonds of a molecule or the struts
+* of a lattice, that is intersected as a single surface. The cylinders are placed
+* in their own bounding volume hierarchy. Centers, axes, squared radii, and half
+* lengths are stored in separate arrays, in leaf order, so that a single ray is
+* tested against several cylinders of a leaf at a time with SSE2 or AVX2
+* instructions. The kernel is chosen when the program runs. Processors without
+* those instructions use a scalar kernel.
+*
+* Each cylinder is intersected as in Cylinder::intersect: the interval in which
+* the ray is inside the infinite cylinder is overlapped with the slab between the
+* planes of its ends.
+*
+* The element of a hit is twice the index of the cylinder in the list passed to
+* the constructor, plus one if an end cap was hit. Normals and materials come
+* from that cylinder.
+*/
+class CylinderSet : public Surface
+{
+public:
+
+	/**
+	* Constructor. Copies the shapes of the cylinders and builds the hierarchy.
+	* The cylinders must not be changed afterwards.
+	* @param cylinders - surfaces in the collection
+	* @param threadPool - pool used to build the hierarchy concurrently. May be null.
+	*/
+	CylinderSet( const std::vector<std::shared_ptr<Cylinder>> & cylinders, ThreadPool * threadPool = nullptr );
+
+	/**
+	* Checks a ray for intersection with every cylinder in the collection. Finds the
+	* parameter of the closest point of intersection within [tMin, tMax) if one exits.
+	* @param ray - Ray being checked for intersection. Its direction is a unit vector.
+	* @param tMin - Smallest parameter value of interest along the ray.
+	* @param tMax - Parameter of the closest intersection found so far.
+	* @param hit - Set to the parameter and the element that was hit.
+	* returns true if there is an intersection within the interval.
+	*/
+	virtual bool intersect( const Ray & ray, real tMin, real tMax, RayHit & hit ) const;
+
+	/**
+	* Has the cylinder that was hit describe the intersection.
+	*/
+	virtual void completeHitRecord( const Ray & ray, const RayHit & hit, HitRecord & hitRecord ) const;
+
+	/**
+	* Checks whether any of the cylinders blocks a ray within [tMin, tMax). Stops at
+	* the first cylinder that does.
+	*/
+	virtual bool occludes( const Ray & ray, real tMin, real tMax ) const;
+
+	/**
+	* Returns the box that encloses all of the cylinders.
+	*/
+	virtual BoundingBox bounds( ) const;
+
+	/**
+	* Returns the number of cylinders in the collection.
+	*/
+	int size( ) const { return static_cast<int>( cylinders.size( ) ); }
+
+	/**
+	* Number of cylinders that are tested together, the width of an AVX2
+	* vector of real numbers. Leaves of the hierarchy are padded to a multiple
+	* of this.
+	*/
+#ifdef RAYTRACER_SINGLE_PRECISION
+	static const int LANE_GROUP_SIZE = 8;
+#else
+	static const int LANE_GROUP_SIZE = 4;
+#endif
+
+	/**
+	* Cylinders in structure of arrays layout, in the precision of the tracer.
+	* Every leaf of the hierarchy occupies a contiguous range of slots that
+	* starts at a multiple of LANE_GROUP_SIZE. Unused slots hold cylinders that
+	* no ray can hit.
+	*/
+	struct Lanes
+	{
+		std::vector<real> centerX;
+		std::vector<real> centerY;
+		std::vector<real> centerZ;
+
+		// Unit vector along the axis
+		std::vector<real> axisX;
+		std::vector<real> axisY;
+		std::vector<real> axisZ;
+
+		std::vector<real> radiusSquared;
+		std::vector<real> halfLength;
+
+		// 1 if the ends are closed by disks, 0 otherwise
+		std::vector<real> capped;
+
+		// Index of the cylinder in each slot. -1 for padding.
+		std::vector<int> cylinder;
+	};
+
+	/**
+	* Tests a ray against the cylinders in a range of slots.
+	* @param lanes - cylinders of the collection
+	* @param begin - first slot. Must be a multiple of LANE_GROUP_SIZE.
+	* @param end - one past the last slot. Must be a multiple of LANE_GROUP_SIZE.
+	* @param ray - ray being checked for intersection. Its direction is a unit vector.
+	* @param tMin - smallest parameter value of interest along the ray
+	* @param tMax - lowered to the parameter of every closer hit that is found
+	* @param hitSlot - set to the slot of the closest hit
+	* @param hitElement - set to Cylinder::SIDE or Cylinder::CAP for the closest hit
+	* @param anyHit - stop at the first hit instead of looking for the closest one
+	* @returns true if a hit was found within the interval
+	*/
+	typedef bool ( *Kernel )( const Lanes & lanes, int begin, int end, const Ray & ray,
+							  real tMin, real & tMax, int & hitSlot, int & hitElement, bool anyHit );
+
+	/**
+	* Returns the kernel for an instruction set level. Levels that were not
+	* compiled into the program return the scalar kernel.
+	*/
+	static Kernel getKernel( SimdLevel level );
+
+protected:
+
+	/**
+	* Copies the cylinders into the slots in the leaf order of the hierarchy.
+	*/
+	void fillLanes( );
+
+	std::vector<std::shared_ptr<Cylinder>> cylinders;
+
+	Lanes lanes;
+
+	BVH bvh;
+
+	// First slot of each leaf, indexed by the first primitive index entry of the leaf
+	std::vector<int> leafSlots;
+
+	Kernel kernel;
+
+}; // end CylinderSet class
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "Lights.h"
+#include "Sphere.h"
+#include "Surface.h"
+
+/**
+* Surfaces and light sources of the demonstration scene that is rendered by both
+* the windowed and the headless programs. The individual lights are kept so that
+* they can be switched on and off.
+*/
+struct DemoScene
+{
+	// All of the surfaces in the scene
+	SurfaceVector surfaces;
+
+	// All of the light sources in the scene
+	LightVector lights;
+
+	shared_ptr<LightSource> ambientLight;
+	shared_ptr<PositionalLight> lightPos;
+	shared_ptr<DirectionalLight> lightDir;
+	shared_ptr<Spotlight> spotlight;
+
+	// Ball that the windowed program lets the user move
+	shared_ptr<Sphere> whiteBall;
+};
+
+/**
+* Creates the objects and light sources of the demonstration scene.
+* @param scene - filled with the surfaces and lights. Anything it holds is kept.
+*/
+void buildDemoScene( DemoScene & scene );
+
+/**
+* Switches all of the lights of the demonstration scene on and sets their colors
+* for day or night.
+* @param scene - scene created by buildDemoScene
+* @param night - true to dim the lights and switch off the spotlight
+*/
+void setDemoTimeOfDay( DemoScene & scene, bool night );
@@ -1,11 +1,16 @@
+#pragma once
+
 #include "QuadricSurface.h"
 
 class Ellipsoid : public QuadricSurface
 {
     public:
     // a, b, and c for the equation of an ellipsoid
-    double a, b, c;
+    real a, b, c;
+
+    Ellipsoid(const vec3 & position, const color & mat, real a, real b, real c);
+    Ellipsoid(const vec3 & position, const Material & mat, real a, real b, real c);
 
-    Ellipsoid(const dvec3 & position, const color & mat, double a, double b, double c);
-    Ellipsoid(const dvec3 & position, const Material & mat, double a, double b, double c);
+    protected:
+    void setCoefficients();
 };
@@ -1,8 +1,13 @@
 #pragma once
 
+#include <condition_variable>
+#include <mutex>
+
 #include "Defines.h"
 #include "Lights.h"
 
+class TileOutput;
+
 
 /**
 * Preprocessor statement for text substitution
@@ -13,6 +18,32 @@
 */
 #define BYTES_PER_PIXEL 4
 
+/**
+* Number of floats per pixel in the accumulation buffer: the red, green, and
+* blue sums and the sum of the weights of the samples.
+*/
+#define FLOATS_PER_ACCUMULATED_PIXEL 4
+
+/**
+* Operators that resolve applies to the average color of a pixel before it is
+* quantized to bytes.
+*/
+enum class ToneMapping
+{
+	CLAMP,   // components above one are cut off
+	REINHARD // every component c becomes c / (1 + c)
+};
+
+/**
+* Orders in which the color and accumulation buffers store the pixels.
+*/
+enum class PixelLayout
+{
+	LINEAR, // rows from the bottom of the window to the top
+	TILED,  // square tiles one after another, and rows within each tile
+	MORTON  // square tiles one after another, and Z order within each tile
+};
+
 /**
 * Structure to hold the width and height of the rendering window
 *
@@ -32,9 +63,25 @@ struct Window {
 * Class which controls memory that stores a color value for every pixel
 * in a rendering window with a specified width and height. setBufferSize
 * is used to match the size of the memory to the size of the window.
+*
+* Besides the 8 bit color buffer, every pixel has a floating point
+* accumulation slot that holds the weighted sum of the colors of its samples.
+* Colors are accumulated without losing precision and are converted to bytes
+* by resolve, which tone maps, gamma corrects, and quantizes whole rows at a
+* time with SSE2 instructions when the processor has them.
+*
+* The color and accumulation buffers can store the pixels tile by tile, so
+* that the pixels of a tile share cache lines only with each other and threads
+* that render different tiles never write to the same line. The pixels are put
+* back into rows only when getColorBuffer is called to present or save them.
+*
+* Images that do not fit into memory are streamed into a tiled image file
+* instead. Only a fixed number of tiles are kept, and every tile is written to
+* the file as soon as all of its pixels have been resolved.
 * clearColorBuffer to the color that is specifed using setClearColor.
-* showColorBuffer copies the memory into the color buffer for display
-* by the graphics card.
+* The class does not depend on OpenGL. Programs with a window copy the
+* memory returned by getColorBuffer to the screen themselves, while
+* headless programs write it to an image file.
 */
 class FrameBuffer
 {
@@ -62,6 +109,61 @@ public:
 	*/
 	void setFrameBufferSize(const int width, const int height);
 
+	/**
+	* Selects the order in which the pixels are stored. Reallocates the buffers,
+	* which discards their contents.
+	*
+	* @param layout of the color and accumulation buffers
+	* @param tileSize - edge length of the tiles in pixels, rounded up to a
+	* power of two. Ignored by the linear layout.
+	*/
+	void setPixelLayout(PixelLayout layout, int tileSize = 32);
+
+	/**
+	* Returns the order in which the pixels are stored.
+	*/
+	PixelLayout getPixelLayout() const { return layout; }
+
+	/**
+	* Returns the edge length of the tiles of the storage in pixels. Blocks that
+	* are aligned to the tiles are written and resolved fastest.
+	*/
+	int getTileSize() const { return 1 << tileShift; }
+
+	/**
+	* Streams the image into a tiled image file, or another output of tiles,
+	* instead of keeping all of it in memory. The window takes the size of the
+	* output, and the layout becomes tiled with the tile size of the output,
+	* which must be a power of two.
+	*
+	* A tile is brought into memory when writeTile or writeSpan first writes to
+	* it. Once resolve has converted every pixel of it that lies in the window,
+	* it is written to the output and dropped. Every pixel must be resolved
+	* exactly once. Blocks that are written at the same time must not need more
+	* tiles than are kept in memory. The other pixel functions only reach tiles
+	* in memory, getColorBuffer returns null, and there is no depth buffer.
+	*
+	* @param output - receives the tiles, such as an open TiledImageWriter. Null
+	* keeps the whole image in memory again.
+	* @param residentTiles - number of tiles kept in memory at once
+	*/
+	void setStreamingOutput(TileOutput * output, int residentTiles);
+
+	/**
+	* Returns true if tiles are streamed into an output.
+	*/
+	bool isStreaming() const { return streamWriter != nullptr; }
+
+	/**
+	* Returns the position of a pixel in the color and accumulation buffers, in
+	* pixels. The position must be in the window, and when streaming, in a tile
+	* that is in memory.
+	*
+	* @param x coordinate of the pixel.
+	* @param y coordinate of the pixel.
+	*/
+	size_t getStorageIndex(const int x, const int y) const;
+
 	/**
 	* Sets the color to which the window will be cleared. Does NOT
 	* actually clear the window
@@ -74,22 +176,25 @@ public:
 	void clearColorAndDepthBuffers();
 
 	/**
-	* Copies memory into frame buffer and updates the window
-	* using an OpenGL command.
+	* Returns the red, green, blue, alpha values of all the pixels, one byte
+	* per component. Alpha is always 255. Rows are stored from the bottom of the window to the top,
+	* which is the layout expected by glDrawPixels. Tiled layouts are copied into
+	* rows first, so the call must not overlap with rendering. Null when
+	* streaming.
 	*/
-	void showColorBuffer();
+	const unsigned char * getColorBuffer() const;
 
 	/**
 	* Returns the width of the rendering window in pixels
 	* @ return width of the rendering window
 	*/
-	int getWindowWidth(){ return window.width; }
+	int getWindowWidth() const { return window.width; }
 
 	/**
 	* Returns the height of the rendering window in pixels
 	* @ return height of the rendering window
 	*/
-	int getWindowHeight(){ return window.height; }
+	int getWindowHeight() const { return window.height; }
 
 	/**
 	* Sets an individual pixel value in the color buffer. Origin (0,0)
@@ -101,6 +206,106 @@ public:
 	*/
 	void setPixel(const int x, const int y, const color & rgba);
 
+	/**
+	* Replaces the accumulated samples of a pixel by a single sample. The
+	* color buffer is not changed until resolve is called.
+	*
+	* @param x coordinate of the pixel.
+	* @param y coordinate of the pixel.
+	* @param color of the sample. Components may exceed one.
+	*/
+	void setHdrPixel(const int x, const int y, const color & rgb);
+
+	/**
+	* Adds a sample to the accumulated samples of a pixel. The color buffer is
+	* not changed until resolve is called.
+	*
+	* @param x coordinate of the pixel.
+	* @param y coordinate of the pixel.
+	* @param color of the sample. Components may exceed one.
+	* @param weight of the sample in the average of the pixel.
+	*/
+	void accumulatePixel(const int x, const int y, const color & rgb, const float weight = 1.0f);
+
+	/**
+	* Returns the average of the accumulated samples of a pixel, or black if
+	* it has none or is not stored.
+	*
+	* @param x coordinate of the pixel.
+	* @param y coordinate of the pixel.
+	*/
+	color getHdrPixel(const int x, const int y);
+
+	/**
+	* Same as setHdrPixel for a run of pixels in one row. The run is clipped to
+	* the window once instead of checking every pixel.
+	*
+	* @param x coordinate of the first pixel.
+	* @param y coordinate of the row.
+	* @param count - number of pixels in the run
+	* @param colors of the pixels from left to right
+	*/
+	void writeSpan(const int x, const int y, const int count, const color * colors);
+
+	/**
+	* Same as setHdrPixel for a rectangular block of the window. Safe to call
+	* concurrently for blocks that do not overlap.
+	*
+	* @param xStart - first column of the block
+	* @param yStart - first row of the block
+	* @param xEnd - one past the last column of the block
+	* @param yEnd - one past the last row of the block
+	* @param colors of the pixels of the block, row by row from the bottom
+	*/
+	void writeTile(const int xStart, const int yStart, const int xEnd, const int yEnd, const color * colors);
+
+	/**
+	* Copies a finished tile, laid out like the tiles of a tiled image file,
+	* into the color buffer. Pixels of the tile outside of the window are
+	* skipped. Does nothing when streaming.
+	*
+	* @param tileX - column of the tile, counted from the left
+	* @param tileY - row of the tile, counted from the bottom
+	* @param tileSize - edge length of the tile in pixels
+	* @param pixels - tileSize * tileSize RGBA pixels, rows from the bottom up
+	*/
+	void writeColorTile(const int tileX, const int tileY, const int tileSize, const unsigned char * pixels);
+
+	/**
+	* Discards the accumulated samples of every pixel.
+	*/
+	void clearAccumulationBuffer();
+
+	/**
+	* Returns the accumulated samples, FLOATS_PER_ACCUMULATED_PIXEL floats per
+	* pixel in the order given by getStorageIndex.
+	*/
+	const float * getAccumulationBuffer() const { return accumulationBuffer; }
+
+	/**
+	* Sets how resolve turns average colors into bytes.
+	* @param toneMapping - operator applied to the average color
+	* @param exposure - factor applied to the average color before the operator
+	* @param gamma - the result is raised to the power 1 / gamma. One leaves it unchanged.
+	*/
+	void setToneMapping(ToneMapping toneMapping, float exposure = 1.0f, float gamma = 1.0f);
+
+	/**
+	* Converts the average color of every pixel that has accumulated samples
+	* into the color buffer. Pixels without samples are left unchanged.
+	*/
+	void resolve();
+
+	/**
+	* Same as resolve for a rectangular block of the window. Safe to call
+	* concurrently for blocks that do not overlap.
+	* @param xStart - first column of the block
+	* @param yStart - first row of the block
+	* @param xEnd - one past the last column of the block
+	* @param yEnd - one past the last row of the block
+	*/
+	void resolve(const int xStart, const int yStart, const int xEnd, const int yEnd);
+
 	/**
 	* Returns the stored RGBA color valute for an individual pixel position
 	* in the color buffer. Origin (0,0) is the lower left hand corner
@@ -155,6 +360,37 @@ public:
 	*/
 	inline bool checkInWindow(const int & x, const int & y);
 
+	/**
+	* Check if the color of a pixel is in memory. False for pixels outside of
+	* the window and for pixels of tiles that are not in memory while streaming.
+	*/
+	bool checkStored(const int x, const int y);
+
+	/**
+	* Brings the tiles that hold the pixels of a block into memory when
+	* streaming. Waits for tiles to be written out if no slot is free.
+	*/
+	void acquireTiles(const int xStart, const int yStart, const int xEnd, const int yEnd);
+
+	/**
+	* Counts pixels of a tile as resolved when streaming. Writes the tile to the
+	* file and frees its slot once all of its pixels are resolved.
+	*/
+	void releaseResolvedPixels(const int tileX, const int tileY, const int count);
+
+	/**
+	* Stores samples of weight one for a run of pixels in one row without
+	* checking them against the window.
+	*/
+	void storeSpan(int x, const int y, int count, const color * colors);
+
+	/**
+	* Resolves the part of a tile of the storage that lies in a block. Tiles that
+	* the block covers entirely are converted in one call of the kernel.
+	*/
+	void resolveTile(const int tileX, const int tileY, const int xStart, const int yStart,
+					 const int xEnd, const int yEnd);
+
 	/**
 	* Struct that maintains the width and height of the rendering window
 	*/
@@ -163,17 +399,67 @@ public:
 	/**
 	* Color to which memory is cleared when clearColorBuffer is called.
 	*/
-	GLubyte clearColor[BYTES_PER_PIXEL];
+	unsigned char clearColor[BYTES_PER_PIXEL];
+
+	/**
+	* Order of the pixels in the color and accumulation buffers. Tiles have
+	* 2 ^ tileShift pixels on a side, and tilesAcross of them cover a row of
+	* the window. Tiles at the right and top edges are stored whole.
+	*/
+	PixelLayout layout = PixelLayout::LINEAR;
+	int tileShift = 5;
+	int tilesAcross = 0;
+	int tilesDown = 0;
+
+	/**
+	* Number of pixels in the color and accumulation buffers
+	*/
+	size_t storedPixelCount = 0;
 
 	/**
 	* Storage for red, green, blue, alpha color values
 	*/
-	GLubyte* colorBuffer;
+	unsigned char* colorBuffer = nullptr;
+
+	/**
+	* Color buffer copied into rows by getColorBuffer for tiled layouts
+	*/
+	mutable std::vector<unsigned char> linearColorBuffer;
 
 	/*
 	* Storage for fragment depth values
 	*/
-	float* depthBuffer;
+	float* depthBuffer = nullptr;
+
+	/**
+	* Storage for the weighted sums of the samples of every pixel
+	*/
+	float* accumulationBuffer = nullptr;
+
+	/**
+	* Settings of resolve. When gamma is not one, quantized values are looked
+	* up in gammaTable, which maps GAMMA_TABLE_SIZE evenly spaced values in
+	* [0, 1] to bytes.
+	*/
+	ToneMapping toneMapping = ToneMapping::CLAMP;
+	float exposure = 1.0f;
+	float gamma = 1.0f;
+	std::vector<unsigned char> gammaTable;
+
+	/**
+	* Streaming output. While streamWriter is set, the color and accumulation
+	* buffers hold residentTileCount slots of one tile each. tileSlots gives the
+	* slot of every tile of the window, or -1 if it is not in memory, and
+	* pendingPixels the number of its pixels in the window that have not been
+	* resolved. slotMutex guards the three vectors.
+	*/
+	TileOutput * streamWriter = nullptr;
+	int residentTileCount = 0;
+	std::vector<int> tileSlots;
+	std::vector<int> pendingPixels;
+	std::vector<int> freeSlots;
+	std::mutex slotMutex;
+	std::condition_variable slotReleased;
 
 }; // end FrameBuffer class
 
@@ -3,6 +3,21 @@
 #include "Defines.h"
 #include "Material.h"
 
+/**
+* Minimal result of a ray/surface intersection test. Intersection tests only
+* find the ray parameter of a hit and which primitive was hit. Everything else
+* about the hit is computed afterwards, for the closest hit only.
+*/
+struct RayHit {
+
+	real t = FLT_MAX; // Paremeter in parametric a ray at point of intersection
+
+	int primitive = -1; // Index of the intersected surface in the scene
+
+	int element = 0; // Index of the intersected element within the surface
+
+};
+
 /**
 * Simple struct to hold information about points of intersection.
 */
@@ -10,14 +25,14 @@ struct HitRecord {
 
 	HitRecord(){ t = FLT_MAX; }
 
-	glm::dvec3 interceptPoint; // xyz location of intersection
+	vec3 interceptPoint; // xyz location of intersection
 
-	glm::dvec2 textureCoordinates; // 2D texture coordinates for point of intersection.
+	vec2 textureCoordinates; // 2D texture coordinates for point of intersection.
 
-	glm::dvec3 surfaceNormal; // surface normal at the point of intersection
+	vec3 surfaceNormal; // surface normal at the point of intersection
 
-	Material material; // Color of the surface
+	const Material * material = nullptr; // Material of the intersected surface
 
-	double t; // Paremeter in parametric a ray at point of intersectopm
+	real t; // Paremeter in parametric a ray at point of intersectopm
 
 };
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "FrameBuffer.h"
+
+/**
+* Writes the color buffer of a frame buffer to a binary PPM (P6) file. The
+* alpha channel is dropped and the top row of the window is written first.
+* @param frameBuffer - holds the pixels to write
+* @param fileName - path of the file to create
+* @return true if the file was written
+*/
+bool writePPM( const FrameBuffer & frameBuffer, const string & fileName );
+
+/**
+* Writes the color buffer of a frame buffer to an 8 bit RGB PNG file. The image
+* data is stored without compression so that no external library is needed.
+* @param frameBuffer - holds the pixels to write
+* @param fileName - path of the file to create
+* @return true if the file was written
+*/
+bool writePNG( const FrameBuffer & frameBuffer, const string & fileName );
+
+/**
+* Writes the color buffer of a frame buffer to a file. The format is chosen from
+* the extension of the file name: ".png" for PNG and anything else for PPM.
+* @param frameBuffer - holds the pixels to write
+* @param fileName - path of the file to create
+* @return true if the file was written
+*/
+bool writeImage( const FrameBuffer & frameBuffer, const string & fileName );
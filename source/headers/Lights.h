@@ -4,9 +4,32 @@
 #include "HitRecord.h"
 #include "Surface.h"
 #include "Ray.h"
+#include "Scene.h"
 
 HitRecord findIntersection( const Ray & ray, const SurfaceVector & surfaces );
 
+/**
+* Light that a light source sends to a point, split by the color of the light
+* that each part is proportional to. For an enabled light, illuminate returns
+*
+*   ambient * ambientLightColor + diffuse * diffuseLightColor
+*       + specular * specularLightColor + constant
+*
+* so the light of a point can be recomputed for new colors of the light
+* without tracing any rays.
+*/
+struct LightTerms
+{
+	color ambient = BLACK;
+
+	color diffuse = BLACK;
+
+	color specular = BLACK;
+
+	// Part that does not depend on the colors of the light
+	color constant = BLACK;
+};
+
 
 /**
 * Base struct for all types of lights. Supports only specification of the 
@@ -27,18 +50,61 @@ struct LightSource
 	LightSource(const color & lightColor) 
 	: diffuseLightColor(lightColor)
 	{
-		ambientLightColor = 0.15 * diffuseLightColor;
+		ambientLightColor = real(0.15) * diffuseLightColor;
 		specularLightColor = WHITE;
 	}
 
-	virtual color illuminate(const dvec3 & eyeVector, HitRecord & closestHit, const SurfaceVector & surfaces)
+	virtual color illuminate(const vec3 & eyeVector, const HitRecord & closestHit, const Scene & scene) const
 	{
         if (enabled) {
-            return closestHit.material.ambientColor * ambientLightColor;
+            return closestHit.material->ambientColor * ambientLightColor;
         }
         return BLACK;
 	}
 
+	/**
+	* Returns the terms of the light that illuminate would return for the
+	* point if the light were enabled, whether it is or not.
+	*/
+	virtual LightTerms getTerms(const vec3 & eyeVector, const HitRecord & closestHit, const Scene & scene) const
+	{
+		LightTerms terms;
+		terms.ambient = closestHit.material->ambientColor;
+		return terms;
+	}
+
+	/**
+	* Returns the light that a point receives for terms returned by getTerms,
+	* using the current colors of the light. Black if the light is disabled.
+	*/
+	color combineTerms(const LightTerms & terms) const
+	{
+		if (!enabled) {
+			return BLACK;
+		}
+		return terms.ambient * ambientLightColor + terms.diffuse * diffuseLightColor +
+			   terms.specular * specularLightColor + terms.constant;
+	}
+
+	/**
+	* Sets position to the point from which the light shines and returns true,
+	* or returns false if the light has no position.
+	*/
+	virtual bool getPosition(vec3 & position) const
+	{
+		return false;
+	}
+
+	/**
+	* Sets direction to the unit vector that points toward a light without a
+	* position, along which its shadow rays are traced, and returns true, or
+	* returns false if the light does not shine from one direction.
+	*/
+	virtual bool getDirection(vec3 & direction) const
+	{
+		return false;
+	}
+
 	/*
 	* Ambient color and intensity of the light.
 	*/
@@ -63,27 +129,27 @@ struct LightSource
 */
 struct PositionalLight : public LightSource
 {
-	PositionalLight(glm::dvec3 position, const color & lightColor)
+	PositionalLight(vec3 position, const color & lightColor)
 	: LightSource(lightColor), lightPosition(position)
 	{}
 
-	virtual color illuminate(const glm::dvec3 & eyeVector, HitRecord & closestHit, const SurfaceVector & surfaces)
+	virtual color illuminate(const vec3 & eyeVector, const HitRecord & closestHit, const Scene & scene) const
 	{
         color totalLight = BLACK;
         if(enabled) {
 
-            dvec3 lightDirection = (lightPosition - closestHit.interceptPoint) 
+            vec3 lightDirection = (lightPosition - closestHit.interceptPoint) 
                                 / glm::length(lightPosition - closestHit.interceptPoint);
-            dvec3 reflectionVec = glm::normalize(glm::reflect(lightDirection, closestHit.surfaceNormal));
-
-            Ray shadow(closestHit.interceptPoint + (EPSILON * closestHit.surfaceNormal), (lightDirection));
-            HitRecord hr = findIntersection(shadow, surfaces);
-            if (hr.t == FLT_MAX){
-                totalLight += glm::max(glm::dot(lightDirection, closestHit.surfaceNormal), 0.0) *
-                          diffuseLightColor * closestHit.material.diffuseColor;
-                totalLight += glm::pow(glm::max(0.0, glm::dot(reflectionVec, eyeVector)),
-                         closestHit.material.shininess) * specularLightColor * closestHit.material.specularColor;
-                totalLight += LightSource::illuminate(eyeVector, closestHit, surfaces);
+            vec3 reflectionVec = glm::normalize(glm::reflect(lightDirection, closestHit.surfaceNormal));
+
+            bool inShadow = !reaches(closestHit, scene);
+
+            if (!inShadow){
+                totalLight += glm::max(glm::dot(lightDirection, closestHit.surfaceNormal), real(0.0)) *
+                          diffuseLightColor * closestHit.material->diffuseColor;
+                totalLight += glm::pow(glm::max(real(0.0), glm::dot(reflectionVec, eyeVector)),
+                         closestHit.material->shininess) * specularLightColor * closestHit.material->specularColor;
+                totalLight += LightSource::illuminate(eyeVector, closestHit, scene);
             } 
             return totalLight;
         }
@@ -91,10 +157,58 @@ struct PositionalLight : public LightSource
 	}
 
 
+	virtual LightTerms getTerms(const vec3 & eyeVector, const HitRecord & closestHit, const Scene & scene) const
+	{
+		LightTerms terms;
+		if (reaches(closestHit, scene)) {
+
+			vec3 lightDirection = (lightPosition - closestHit.interceptPoint) / glm::length(lightPosition - closestHit.interceptPoint);
+			vec3 reflectionVec = glm::normalize(glm::reflect(lightDirection, closestHit.surfaceNormal));
+
+			terms = LightSource::getTerms(eyeVector, closestHit, scene);
+			terms.diffuse = glm::max(glm::dot(lightDirection, closestHit.surfaceNormal), real(0.0)) *
+							closestHit.material->diffuseColor;
+			terms.specular = glm::pow(glm::max(real(0.0), glm::dot(reflectionVec, eyeVector)),
+									  closestHit.material->shininess) * closestHit.material->specularColor;
+		}
+		return terms;
+	}
+
+	/**
+	* Returns true if no surface lies between the point of a hit and the light.
+	*/
+	bool reaches(const HitRecord & closestHit, const Scene & scene) const
+	{
+		vec3 lightDirection = (lightPosition - closestHit.interceptPoint)
+							/ glm::length(lightPosition - closestHit.interceptPoint);
+
+		// Only surfaces between the point and the light cast a shadow. Keeping
+		// EPSILON away from the point keeps the point from shadowing itself.
+		real distanceToLight = glm::length(lightPosition - closestHit.interceptPoint);
+
+		// Every shadow ray ends at the light. Tracing it from the light lets the
+		// scene use the terms that it computed for that point.
+		const OriginContext * context = scene.getOriginContext(lightPosition);
+		if (context != nullptr) {
+			Ray shadow(lightPosition, -lightDirection);
+			return !scene.occluded(shadow, 0.0, distanceToLight - EPSILON, context);
+		}
+		else {
+			Ray shadow(closestHit.interceptPoint, (lightDirection));
+			return !scene.occluded(shadow, EPSILON, distanceToLight);
+		}
+	}
+
+	virtual bool getPosition(vec3 & position) const
+	{
+		position = lightPosition;
+		return true;
+	}
+
 	/**
 	* x, y, z position of the light source. 
 	*/
-	glm::dvec3 lightPosition; 
+	vec3 lightPosition; 
 };
 
 /**
@@ -105,41 +219,65 @@ struct PositionalLight : public LightSource
 */
 struct DirectionalLight : public LightSource
 {
-	DirectionalLight(dvec3 direction, const color & lightColor)
+	DirectionalLight(vec3 direction, const color & lightColor)
 	: LightSource(lightColor), lightDirection(glm::normalize(direction))
 	{}
 
-	virtual color illuminate(const dvec3 & eyeVector, HitRecord & closestHit, const SurfaceVector & surfaces)
+	virtual color illuminate(const vec3 & eyeVector, const HitRecord & closestHit, const Scene & scene) const
 	{
         if (enabled) {
-            color totalLight = closestHit.material.emissiveColor;
-            dvec3 reflectionVec = glm::normalize(glm::reflect(lightDirection, closestHit.surfaceNormal));
+            color totalLight = closestHit.material->emissiveColor;
+            vec3 reflectionVec = glm::normalize(glm::reflect(lightDirection, closestHit.surfaceNormal));
             
-            Ray shadow(closestHit.interceptPoint + (EPSILON * closestHit.surfaceNormal), (lightDirection));
-            HitRecord hr = findIntersection(shadow, surfaces);
-            if (hr.t == FLT_MAX){
+            Ray shadow(closestHit.interceptPoint, (lightDirection));
+            if (!scene.occluded(shadow, EPSILON, FLT_MAX)){
 
                 //ambient
-                totalLight += (LightSource::illuminate(eyeVector, closestHit, surfaces));
+                totalLight += (LightSource::illuminate(eyeVector, closestHit, scene));
 
                 //diffuse
-                totalLight += glm::max(glm::dot(lightDirection, closestHit.surfaceNormal), 0.0) *
-                          diffuseLightColor * closestHit.material.diffuseColor;
+                totalLight += glm::max(glm::dot(lightDirection, closestHit.surfaceNormal), real(0.0)) *
+                          diffuseLightColor * closestHit.material->diffuseColor;
 
                 // specular color
-                totalLight += glm::pow(glm::max(0.0, glm::dot(reflectionVec, eyeVector)),
-                         closestHit.material.shininess) * specularLightColor * closestHit.material.specularColor;
+                totalLight += glm::pow(glm::max(real(0.0), glm::dot(reflectionVec, eyeVector)),
+                         closestHit.material->shininess) * specularLightColor * closestHit.material->specularColor;
             }  
             return totalLight;
         }
         return BLACK;
 	}
 
+	virtual LightTerms getTerms(const vec3 & eyeVector, const HitRecord & closestHit, const Scene & scene) const
+	{
+		LightTerms terms;
+
+		Ray shadow(closestHit.interceptPoint, (lightDirection));
+		if (!scene.occluded(shadow, EPSILON, FLT_MAX)) {
+
+			vec3 reflectionVec = glm::normalize(glm::reflect(lightDirection, closestHit.surfaceNormal));
+
+			terms = LightSource::getTerms(eyeVector, closestHit, scene);
+			terms.diffuse = glm::max(glm::dot(lightDirection, closestHit.surfaceNormal), real(0.0)) *
+							closestHit.material->diffuseColor;
+			terms.specular = glm::pow(glm::max(real(0.0), glm::dot(reflectionVec, eyeVector)),
+									  closestHit.material->shininess) * closestHit.material->specularColor;
+		}
+		terms.constant = closestHit.material->emissiveColor;
+		return terms;
+	}
+
+	virtual bool getDirection(vec3 & direction) const
+	{
+		direction = lightDirection;
+		return true;
+	}
+
 	/**
 	* Unit vector that points in the direction that is opposite 
 	* the direction in which the light is shining.
 	*/
-	glm::dvec3 lightDirection; 
+	vec3 lightDirection; 
 };
 
 /**
@@ -152,29 +290,45 @@ struct DirectionalLight : public LightSource
 struct Spotlight: public PositionalLight {
     // unit vector that points in the direction 
     // that the light is shining
-    dvec3 spotDirection;
+    vec3 spotDirection;
 
     //angle in radians of half the spot light beam;
-    double cutOffCosineRadians;
+    real cutOffCosineRadians;
 
-    Spotlight(dvec3 position, dvec3 direction, double cutOffCosineRadians, const color & colorOfLight ): 
+    Spotlight(vec3 position, vec3 direction, real cutOffCosineRadians, const color & colorOfLight ): 
               PositionalLight(position, colorOfLight), spotDirection(glm::normalize(direction)),
               cutOffCosineRadians(glm::radians(cutOffCosineRadians)) {}
 
-    virtual color illuminate(const glm::dvec3& eyeVector,HitRecord& closestHit,const SurfaceVector& surfaces) {
+    virtual color illuminate(const vec3& eyeVector,const HitRecord& closestHit,const Scene& scene) const {
 
-        dvec3 lightDirection = (PositionalLight::lightPosition - closestHit.interceptPoint) 
+        vec3 lightDirection = (PositionalLight::lightPosition - closestHit.interceptPoint) 
                            / glm::length(lightPosition - closestHit.interceptPoint);
         
-        double spotCosine = glm::dot(-lightDirection, spotDirection);
+        real spotCosine = glm::dot(-lightDirection, spotDirection);
 
         if(spotCosine > cutOffCosineRadians) {
-            double falloffFactor = (1-(1-spotCosine)) / (1-cutOffCosineRadians);
-            return falloffFactor * PositionalLight::illuminate(eyeVector, closestHit, surfaces);
+            real falloffFactor = (1-(1-spotCosine)) / (1-cutOffCosineRadians);
+            return falloffFactor * PositionalLight::illuminate(eyeVector, closestHit, scene);
         }
 
         return BLACK; 
     }
+
+    virtual LightTerms getTerms(const vec3& eyeVector, const HitRecord& closestHit, const Scene& scene) const {
+
+        vec3 lightDirection = (lightPosition - closestHit.interceptPoint) / glm::length(lightPosition - closestHit.interceptPoint);
+        real spotCosine = glm::dot(-lightDirection, spotDirection);
+
+        LightTerms terms;
+        if (spotCosine > cutOffCosineRadians) {
+            real falloffFactor = (1-(1-spotCosine)) / (1-cutOffCosineRadians);
+            terms = PositionalLight::getTerms(eyeVector, closestHit, scene);
+            terms.ambient *= falloffFactor;
+            terms.diffuse *= falloffFactor;
+            terms.specular *= falloffFactor;
+        }
+        return terms;
+    }
 };
 
 
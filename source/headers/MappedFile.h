@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Defines.h"
+
+/**
+* Read only view of the contents of a file. On POSIX systems the file is mapped
+* into memory, so opening it costs nothing but the system calls and pages are
+* only read from disk when they are touched. Elsewhere the file is read into a
+* buffer that the object owns.
+*
+* The object cannot be copied because it owns the mapping. It can be moved.
+*/
+class MappedFile
+{
+public:
+
+	MappedFile( ) { }
+
+	~MappedFile( ) { close( ); }
+
+	MappedFile( MappedFile && other );
+
+	MappedFile & operator=( MappedFile && other );
+
+	MappedFile( const MappedFile & ) = delete;
+
+	MappedFile & operator=( const MappedFile & ) = delete;
+
+	/**
+	* Maps a file. Closes any file that was mapped before.
+	* @param fileName - path of the file to map
+	* @return true if the file was mapped. Empty files cannot be mapped.
+	*/
+	bool open( const string & fileName );
+
+	/**
+	* Releases the mapping. Pointers returned by getData become invalid.
+	*/
+	void close( );
+
+	/**
+	* Returns true if a file is mapped.
+	*/
+	bool isOpen( ) const { return data != nullptr; }
+
+	/**
+	* Returns the first byte of the file, or null if no file is mapped. The
+	* mapping starts at a page boundary, so the data is suitably aligned for any
+	* type.
+	*/
+	const unsigned char * getData( ) const { return data; }
+
+	/**
+	* Returns the size of the file in bytes.
+	*/
+	size_t getSize( ) const { return size; }
+
+protected:
+
+	const unsigned char * data = nullptr;
+
+	size_t size = 0;
+
+	// Contents of the file on systems without mmap
+	std::vector<unsigned char> buffer;
+
+}; // end MappedFile class
@@ -15,7 +15,7 @@ struct Material
 	// Diffuse color of the surface.
 	color diffuseColor;
 
-    double shininess = 128.0;
+    real shininess = 128.0;
    
     // emissive color of the surface
     color emissiveColor = BLACK;
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "Defines.h"
+
+/**
+* Binary mesh format. The file is laid out exactly like the arrays that a
+* TriangleMesh traces against, so it is used in place after being mapped into
+* memory and nothing has to be parsed:
+*
+*   MeshFileHeader                  24 bytes
+*   float positions[3 * vertexCount]  xyz of every vertex
+*   uint32_t indices[3 * triangleCount]  vertices of every triangle
+*
+* All values are little endian. Positions are stored in single precision, which
+* is the precision that CAD exports carry in practice.
+*/
+struct MeshFileHeader
+{
+	char magic[8];
+
+	uint32_t version;
+
+	uint32_t vertexCount;
+
+	uint32_t triangleCount;
+
+	// Keeps the header a multiple of eight bytes long. Written as zero.
+	uint32_t reserved;
+};
+
+// First bytes of every mesh file
+const char MESH_FILE_MAGIC[8] = { 'R', 'T', 'M', 'E', 'S', 'H', '\r', '\n' };
+
+// Version written by writeMeshFile and accepted by getMeshData
+const uint32_t MESH_FILE_VERSION = 1;
+
+/**
+* Arrays of a mesh that are stored somewhere else, such as in a mapped file.
+*/
+struct MeshData
+{
+	const float * positions = nullptr;
+
+	const uint32_t * indices = nullptr;
+
+	uint32_t vertexCount = 0;
+
+	uint32_t triangleCount = 0;
+};
+
+/**
+* Locates the arrays of a mesh in the contents of a mesh file. Checks the header
+* and the size of the file, but not the indices.
+* @param data - contents of the file. Must be aligned for uint32_t.
+* @param size - size of the contents in bytes
+* @param mesh - set to point into the contents
+* @return false if the contents are not a mesh file of a supported version
+*/
+bool getMeshData( const unsigned char * data, size_t size, MeshData & mesh );
+
+/**
+* Writes a mesh file.
+* @param fileName - path of the file to create
+* @param positions - xyz of every vertex
+* @param indices - three vertex indices for every triangle
+* @return true if the file was written
+*/
+bool writeMeshFile( const string & fileName, const std::vector<float> & positions,
+					const std::vector<uint32_t> & indices );
+
+/**
+* Reads the vertices and faces of a Wavefront OBJ file. Faces with more than
+* three vertices are split into fans of triangles. Texture coordinates, normals,
+* groups, and materials are ignored.
+* @param fileName - path of the file to read
+* @param positions - set to the xyz of every vertex
+* @param indices - set to three vertex indices for every triangle
+* @return false if the file cannot be read or a face refers to a missing vertex
+*/
+bool readObjFile( const string & fileName, std::vector<float> & positions,
+				  std::vector<uint32_t> & indices );
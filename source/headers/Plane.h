@@ -14,26 +14,49 @@ class Plane : public Surface
 	* @param - normal: unit Vector that is perpendicular to the front face of the plane
 	* @param - material: color of the plane.
 	*/
-	Plane(const dvec3 & point, const dvec3 & normal, const color & material);
+	Plane(const vec3 & point, const vec3 & normal, const color & material);
 
-	Plane(std::vector<dvec3> vertices, const color & material);
+	Plane(std::vector<vec3> vertices, const color & material);
 
 	/**
-	* Checks a ray for intersection with the surface. Finds the closest point of intersection
-	* if one exits. Returns a HitRecord with the t parmeter set to FLT_MAX if there is no 
-	* intersection.
-	* @param rayOrigin - Origin of the ray being check for intersetion
-	* @param rayDirection - Unit vector represention the direction of the ray.
-	* returns HitRecord containing intormation about the point of intersection.
+	* Checks a ray for intersection with the surface. Finds the parameter of the closest
+	* point of intersection within [tMin, tMax) if one exits.
+	* @param ray - Ray being checked for intersection.
+	* @param tMin - Smallest parameter value of interest along the ray.
+	* @param tMax - Parameter of the closest intersection found so far.
+	* @param hit - Set to the parameter of the intersection.
+	* returns true if there is an intersection within the interval.
 	*/
-	virtual HitRecord findClosestIntersection( const Ray & ray );
+	virtual bool intersect( const Ray & ray, real tMin, real tMax, RayHit & hit ) const;
+
+	/**
+	* Returns the distance from the origin to the plane along the normal.
+	*/
+	virtual real computeOriginTerm( const vec3 & origin ) const;
+
+	/**
+	* Same as intersect, with the distance to the plane computed in advance.
+	*/
+	virtual bool intersectFromOrigin( const Ray & ray, real originTerm, real tMin, real tMax,
+									  RayHit & hit ) const;
+
+	/**
+	* Computes the point of intersection and a normal that faces the ray for a
+	* hit found by intersect.
+	*/
+	virtual void completeHitRecord( const Ray & ray, const RayHit & hit, HitRecord & hitRecord ) const;
+
+	/**
+	* Planes extend infinitely, so the box covers all of space.
+	*/
+	virtual BoundingBox bounds( ) const;
 
 	/** Point on the plane */
-	dvec3 a;
+	vec3 a;
 
 	/** Unit Vector that is perpendicular to the front face of the plane 
 	* (surface normal */
-	dvec3 n;
+	vec3 n;
 
 };
 
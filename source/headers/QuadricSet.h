@@ -0,0 +1,155 @@
+#pragma once
+
+#include "BVH.h"
+#include "QuadricSurface.h"
+#include "Simd.h"
+
+/**
+* Collection of quadric surfaces, such as ellipsoids, that is
+* intersected as a single surface. The coefficients and centers of the quadrics
+* are stored in separate arrays, in the leaf order of a bounding volume hierarchy,
+* so that a single ray is tested against several quadrics of a leaf at a time
+* with SSE2 or AVX2 instructions.
+*
+* Leaves in which every quadric is axis aligned, meaning that D through I are
+* zero, are tested with a kernel that is compiled without those terms. Quadrics
+* without a finite bounding box are tested against every ray.
+*
+* The element of a hit is the index of the quadric in the list passed to the
+* constructor. Normals and materials come from that quadric.
+*/
+class QuadricSet : public Surface
+{
+public:
+
+	/**
+	* Constructor. Copies the coefficients of the quadrics and builds the hierarchy.
+	* The quadrics must not be changed afterwards.
+	* @param quadrics - surfaces in the collection
+	* @param threadPool - pool used to build the hierarchy concurrently. May be null.
+	*/
+	QuadricSet( const std::vector<std::shared_ptr<QuadricSurface>> & quadrics, ThreadPool * threadPool = nullptr );
+
+	/**
+	* Checks a ray for intersection with every quadric in the collection. Finds the
+	* parameter of the closest point of intersection within [tMin, tMax) if one exits.
+	* @param ray - Ray being checked for intersection.
+	* @param tMin - Smallest parameter value of interest along the ray.
+	* @param tMax - Parameter of the closest intersection found so far.
+	* @param hit - Set to the parameter and the index of the quadric that was hit.
+	* returns true if there is an intersection within the interval.
+	*/
+	virtual bool intersect( const Ray & ray, real tMin, real tMax, RayHit & hit ) const;
+
+	/**
+	* Has the quadric that was hit describe the intersection.
+	*/
+	virtual void completeHitRecord( const Ray & ray, const RayHit & hit, HitRecord & hitRecord ) const;
+
+	/**
+	* Checks whether any of the quadrics blocks a ray within [tMin, tMax). Stops at
+	* the first quadric that does.
+	*/
+	virtual bool occludes( const Ray & ray, real tMin, real tMax ) const;
+
+	/**
+	* Returns the box that encloses all of the quadrics. Infinite if any of them
+	* is unbounded.
+	*/
+	virtual BoundingBox bounds( ) const;
+
+	/**
+	* Returns the number of quadrics in the collection.
+	*/
+	int size( ) const { return static_cast<int>( quadrics.size( ) ); }
+
+	/**
+	* Number of quadrics that are tested together. Leaves of the hierarchy are
+	* padded to a multiple of this.
+	*/
+	static const int LANE_GROUP_SIZE = 4;
+
+	/**
+	* Quadrics in structure of arrays layout. Every leaf of the hierarchy occupies a
+	* contiguous range of slots that starts at a multiple of LANE_GROUP_SIZE.
+	* Unused slots hold quadrics that no ray can hit.
+	*/
+	struct Lanes
+	{
+		std::vector<double> centerX;
+		std::vector<double> centerY;
+		std::vector<double> centerZ;
+
+		// Coeficients of Ax2 + By2 + Cz2 + Dxy+ Exz + Fyz + Gx + Hy + Iz + J = 0
+		std::vector<double> A, B, C, D, E, F, G, H, I, J;
+
+		// Index of the quadric in each slot. -1 for padding.
+		std::vector<int> quadric;
+	};
+
+	/**
+	* Tests a ray against the quadrics in a range of slots.
+	* @param lanes - quadrics of the collection
+	* @param begin - first slot. Must be a multiple of LANE_GROUP_SIZE.
+	* @param end - one past the last slot. Must be a multiple of LANE_GROUP_SIZE.
+	* @param ray - ray being checked for intersection
+	* @param tMin - smallest parameter value of interest along the ray
+	* @param tMax - lowered to the parameter of every closer hit that is found
+	* @param hitSlot - set to the slot of the closest hit
+	* @param anyHit - stop at the first hit instead of looking for the closest one
+	* @returns true if a hit was found within the interval
+	*/
+	typedef bool ( *Kernel )( const Lanes & lanes, int begin, int end, const Ray & ray,
+							  double tMin, double & tMax, int & hitSlot, bool anyHit );
+
+	/**
+	* Returns the kernel for an instruction set level. Levels that were not
+	* compiled into the program return the scalar kernel.
+	* @param level - instruction set to use
+	* @param axisAligned - true for the kernel that skips the D through I terms
+	*/
+	static Kernel getKernel( SimdLevel level, bool axisAligned );
+
+protected:
+
+	/**
+	* Range of slots that is tested as a unit.
+	*/
+	struct SlotRange
+	{
+		int begin = 0;
+		int end = 0;
+		bool axisAligned = true;
+	};
+
+	/**
+	* Appends a group of quadrics to the slots and returns the range they occupy.
+	*/
+	SlotRange appendSlots( const int * quadricIndices, int count );
+
+	/**
+	* Tests a ray against a range of slots with the matching kernel.
+	*/
+	bool intersectSlots( const SlotRange & range, const Ray & ray, double tMin, double & tMax,
+						 int & hitSlot, bool anyHit ) const
+	{
+		Kernel kernel = range.axisAligned ? axisAlignedKernel : generalKernel;
+		return kernel( lanes, range.begin, range.end, ray, tMin, tMax, hitSlot, anyHit );
+	}
+
+	std::vector<std::shared_ptr<QuadricSurface>> quadrics;
+
+	Lanes lanes;
+
+	BVH bvh;
+
+	// Slots of each leaf, indexed by the first primitive index entry of the leaf
+	std::vector<SlotRange> leafSlots;
+
+	// Slots of the quadrics that are not in the hierarchy
+	SlotRange unboundedSlots;
+
+	Kernel generalKernel;
+	Kernel axisAlignedKernel;
+
+}; // end QuadricSet class
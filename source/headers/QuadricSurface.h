@@ -18,29 +18,55 @@ public:
 	* @param - position: specifies an xyz position of the center of the surface
 	* @param - mat: diffuse color of the surface.
 	*/
-	QuadricSurface(const dvec3 & position, const color & mat);
+	QuadricSurface(const vec3 & position, const color & mat);
 
 	/**
 	* Constructor for qudric surface.
 	* @param - position: specifies an xyz position of the center of the surface
 	* @param - mat: material properties of the surface.
 	*/
-	QuadricSurface( const dvec3 & position, const Material & mat );
+	QuadricSurface( const vec3 & position, const Material & mat );
 
 	/**
-	* Checks a ray for intersection with the surface. Finds the closest point of intersection
-	* if one exits. Returns a HitRecord with the t parmeter set to FLT_MAX if there is no
-	* intersection.
-	* @param rayOrigin - Origin of the ray being check for intersetion
-	* @param rayDirection - Unit vector represention the direction of the ray.
-	* returns HitRecord containing intormation about the point of intersection.
+	* Checks a ray for intersection with the surface. Finds the parameter of the closest
+	* point of intersection within [tMin, tMax) if one exits.
+	* @param ray - Ray being checked for intersection.
+	* @param tMin - Smallest parameter value of interest along the ray.
+	* @param tMax - Parameter of the closest intersection found so far.
+	* @param hit - Set to the parameter of the intersection.
+	* returns true if there is an intersection within the interval.
 	*/
-	virtual HitRecord findClosestIntersection( const Ray & ray );
+	virtual bool intersect( const Ray & ray, real tMin, real tMax, RayHit & hit ) const;
+
+	/**
+	* Returns Cq, the quadric equation evaluated at the origin, which is the constant
+	* term of the quadratic equation for rays that start there.
+	*/
+	virtual real computeOriginTerm( const vec3 & origin ) const;
+
+	/**
+	* Same as intersect, with the constant term computed in advance.
+	*/
+	virtual bool intersectFromOrigin( const Ray & ray, real originTerm, real tMin, real tMax,
+									  RayHit & hit ) const;
+
+	/**
+	* Computes the point of intersection and the normal from the gradient of the
+	* quadric equation for a hit found by intersect.
+	*/
+	virtual void completeHitRecord( const Ray & ray, const RayHit & hit, HitRecord & hitRecord ) const;
+
+	/**
+	* Returns the axis aligned box that encloses the surface. Only closed, axis
+	* aligned ellipsoidal forms (D through I equal to zero and A, B, and C
+	* positive) are finite. All other forms return an infinite box.
+	*/
+	virtual BoundingBox bounds( ) const;
 
 	/**
 	* xyz location of the center of the surface
 	*/
-	dvec3 center;
+	vec3 center;
 
 	protected:
 
@@ -48,7 +74,10 @@ public:
 	* Coeficients is the  quadric surface equation
 	* Ax2 + By2 + Cz2 + Dxy+ Exz + Fyz + Gx + Hy + Iz + J = 0
 	*/
-	double A, B, C, D, E, F, G, H, I, J;
+	real A, B, C, D, E, F, G, H, I, J;
+
+	// Copies the coefficients into its structure of arrays layout
+	friend class QuadricSet;
 
 };
 
@@ -7,10 +7,10 @@
 */
 struct Ray
 {
-	dvec3 origin;		// starting point for this ray.
-	dvec3 direct;		// direction for this ray, given it's origin.
+	vec3 origin;		// starting point for this ray.
+	vec3 direct;		// direction for this ray, given it's origin.
 
-	Ray( const dvec3 &rayOrigin = dvec3( 0.0, 0.0, 0.0 ), const dvec3 &rayDirection = dvec3( 0.0, 0.0, -1.0 ) ) :
+	Ray( const vec3 &rayOrigin = vec3( 0.0, 0.0, 0.0 ), const vec3 &rayDirection = vec3( 0.0, 0.0, -1.0 ) ) :
 		origin( rayOrigin ), direct( glm::normalize( rayDirection ) )
 	{
 	}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include "Ray.h"
+
+#include <cmath>
+
+/**
+* Group of up to MAX_SIZE rays that are traced together, stored in structure of
+* arrays layout so that intersection kernels can load several rays with a single
+* instruction. Used for primary rays, which start at the same point (perspective)
+* or travel in the same direction (orthographic) and tend to hit the same
+* surfaces.
+*
+* Which rays take part in an operation is described by a lane mask in which bit i
+* stands for the ray in lane i.
+*/
+struct RayPacket
+{
+	static const int MAX_SIZE = 16;
+
+	// Number of lanes in use. Lanes at or beyond size hold a copy of lane zero.
+	int size = 0;
+
+	alignas( 32 ) double originX[MAX_SIZE];
+	alignas( 32 ) double originY[MAX_SIZE];
+	alignas( 32 ) double originZ[MAX_SIZE];
+
+	// Unit direction of each ray
+	alignas( 32 ) double directX[MAX_SIZE];
+	alignas( 32 ) double directY[MAX_SIZE];
+	alignas( 32 ) double directZ[MAX_SIZE];
+
+	// Component wise reciprocal of each direction, used for box tests
+	alignas( 32 ) double inverseX[MAX_SIZE];
+	alignas( 32 ) double inverseY[MAX_SIZE];
+	alignas( 32 ) double inverseZ[MAX_SIZE];
+
+	// Range of the origins and of the reciprocal directions of all lanes along
+	// each axis. Used to reject boxes that every ray of the packet misses with
+	// a single test. Set by prepare.
+	dvec3 originMin, originMax;
+	dvec3 inverseMin, inverseMax;
+
+	// True for the axes along which the reciprocal directions of all lanes are
+	// finite and have the same sign. Only those axes take part in the range test.
+	bool coherentAxis[3];
+
+	/**
+	* Returns the mask with a bit set for every lane in use.
+	*/
+	unsigned activeMask() const { return size >= 32 ? ~0u : ( 1u << size ) - 1u; }
+
+	/**
+	* Stores a ray in a lane. The packet keeps its rays in double precision
+	* whatever the precision of the rest of the tracer.
+	* @param lane - index of the lane
+	* @param origin - starting point of the ray
+	* @param direction - unit direction of the ray
+	*/
+	void setRay( int lane, const vec3 & origin, const vec3 & direction )
+	{
+		originX[lane] = origin.x;
+		originY[lane] = origin.y;
+		originZ[lane] = origin.z;
+		directX[lane] = direction.x;
+		directY[lane] = direction.y;
+		directZ[lane] = direction.z;
+		inverseX[lane] = 1.0 / direction.x;
+		inverseY[lane] = 1.0 / direction.y;
+		inverseZ[lane] = 1.0 / direction.z;
+	}
+
+	/**
+	* Must be called after all of the rays have been set. Copies lane zero into the
+	* lanes that are not in use, so that kernels can process whole groups of lanes
+	* without reading uninitialized values, and computes the ranges of the rays.
+	*/
+	void prepare()
+	{
+		for( int lane = size; lane < MAX_SIZE; lane++ ) {
+			originX[lane] = originX[0];
+			originY[lane] = originY[0];
+			originZ[lane] = originZ[0];
+			directX[lane] = directX[0];
+			directY[lane] = directY[0];
+			directZ[lane] = directZ[0];
+			inverseX[lane] = inverseX[0];
+			inverseY[lane] = inverseY[0];
+			inverseZ[lane] = inverseZ[0];
+		}
+
+		originMin = originMax = dvec3( originX[0], originY[0], originZ[0] );
+		inverseMin = inverseMax = dvec3( inverseX[0], inverseY[0], inverseZ[0] );
+
+		for( int lane = 1; lane < size; lane++ ) {
+			dvec3 origin( originX[lane], originY[lane], originZ[lane] );
+			dvec3 inverse( inverseX[lane], inverseY[lane], inverseZ[lane] );
+			originMin = glm::min( originMin, origin );
+			originMax = glm::max( originMax, origin );
+			inverseMin = glm::min( inverseMin, inverse );
+			inverseMax = glm::max( inverseMax, inverse );
+		}
+
+		for( int axis = 0; axis < 3; axis++ ) {
+			coherentAxis[axis] = std::isfinite( inverseMin[axis] ) && std::isfinite( inverseMax[axis] ) &&
+				( inverseMin[axis] > 0 || inverseMax[axis] < 0 );
+		}
+	}
+
+	/**
+	* Returns the ray in a lane.
+	*/
+	Ray getRay( int lane ) const
+	{
+		Ray ray;
+		ray.origin = vec3( originX[lane], originY[lane], originZ[lane] );
+		ray.direct = vec3( directX[lane], directY[lane], directZ[lane] );
+		return ray;
+	}
+};
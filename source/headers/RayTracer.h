@@ -5,6 +5,26 @@
 #include "HitRecord.h"
 #include "Surface.h"
 #include "Ray.h"
+#include "Scene.h"
+#include "ShadingCache.h"
+#include "ThreadPool.h"
+
+/**
+* What the pixels of a tile of a traced frame depend on: the primitives that
+* its rays hit and where its paths went, as recorded by a DependencySet.
+*/
+struct TileDependencies
+{
+	// Primitive indices in increasing order
+	std::vector<int> primitives;
+
+	// Box around the points hit after every number of reflections
+	std::vector<BoundingBox> pathBounds;
+
+	// Box around the directions of the reflected rays that hit nothing after
+	// every number of reflections
+	std::vector<BoundingBox> escapeDirections;
+};
 
 /**
 * Class that supports simple ray tracing of a scene containing a number of object 
@@ -20,17 +40,52 @@ class RayTracer
 	* @param default color to which pixel will be set when there it no intersection
 	* for a ray associated with a particular pixel.
 	*/
-	RayTracer(FrameBuffer & cBuffer, color defaultColor = color(0,0,0,1));
+	RayTracer(FrameBuffer & cBuffer, color defaultColor = color(0,0,0));
 
 	/**
 	* Ray traces a scene containing a number of surfaces and light sources. Sets every
 	* pixel in the rendering window. Pixels that are not associated with a ray/surface
-	* intersection are set to a default color.
+	* intersection are set to a default color. The lists are committed first unless
+	* they hold the same surfaces and lights as the committed scene.
 	* @param surfaces - list of the surfaces in the scene
 	* @param lights - list of the light sources in the scene
 	*/
 	void raytraceScene(const SurfaceVector & surfaces, const LightVector & lights);
 
+	/**
+	* Ray traces the scene that was last committed.
+	*/
+	void raytraceScene();
+
+	/**
+	* Ray traces the pixels of a block of the rendering window, such as the
+	* part of a frame that one of several processes renders. The block is cut
+	* into tiles starting at its lower left corner, so blocks that start on the
+	* tiles of a tiled frame buffer keep the tasks aligned to them.
+	* @param xStart - first column of the block
+	* @param yStart - first row of the block
+	* @param xEnd - one past the last column of the block
+	* @param yEnd - one past the last row of the block
+	*/
+	void raytraceRegion(const int xStart, const int yStart, const int xEnd, const int yEnd);
+
+	/**
+	* Takes a snapshot of the surfaces and light sources that later frames render
+	* from, and builds the acceleration structure over the surfaces. Must be called
+	* again after a surface is added, removed, moved, or changed. Lights may be
+	* switched on and off or changed between frames without a commit.
+	* @param surfaces - list of the surfaces in the scene
+	* @param lights - list of the light sources in the scene
+	* @param hierarchy - hierarchy built earlier for the same surfaces, such as
+	* one read from a scene cache. Used instead of building a new one. May be null.
+	*/
+	void commitScene(const SurfaceVector & surfaces, const LightVector & lights, const BVH * hierarchy = nullptr);
+
+	/**
+	* Returns the version of the committed scene. Increased by every commit.
+	*/
+	unsigned getSceneVersion() const { return scene.getVersion(); }
+
 	/**
 	* Sets the w, u, and v orthonormal basis vectors associated with the coordinate
 	* frame that is tied to the viewing position and the eye data member of the
@@ -39,7 +94,7 @@ class RayTracer
 	* @param viewingDirection - vector that points in the viewing direction
 	* @param up - approximation of the up vector (cannot be parallel to viewing direction)
 	*/
-	void setCameraFrame(const dvec3 & viewPosition, const dvec3 & viewingDirection, dvec3 up);
+	void setCameraFrame(const vec3 & viewPosition, const vec3 & viewingDirection, vec3 up);
 
 	/**
 	* Set the following members of the class: topLimit, bottomLimit, rightLimit,
@@ -48,7 +103,7 @@ class RayTracer
 	* rendering window.
 	* @param viewPlaneHeight - distance to the top of the projection plane
 	*/
-	void calculateOrthographicViewingParameters(const double & viewPlaneHeight = 10.0);
+	void calculateOrthographicViewingParameters(const real & viewPlaneHeight = 10.0);
 
 	/**
 	* Set the following members of the class: topLimit, bottomLimit, rightLimit,
@@ -56,14 +111,14 @@ class RayTracer
 	* view and height and width of the rendering window.
 	* @param verticalFieldOfViewDegrees - vertical field of view in degrees
 	*/
-	void calculatePerspectiveViewingParameters(const double & verticalFieldOfViewDegrees = 45.0);
+	void calculatePerspectiveViewingParameters(const real & verticalFieldOfViewDegrees = 45.0);
 
 	/**
 	* Set the color to which pixels are set when the associated ray does not
 	* intersect any object in the scene.
 	* @param default - color for pixels for which no ray-object intersections occur.
 	*/
-	void setDefaultColor(color defaultColor) { this->defaultColor = defaultColor; }
+	void setDefaultColor(color defaultColor) { this->defaultColor = defaultColor; invalidateFrame(); }
 
 	/**
 	* Sets the recusion depth to determine how many reflected and refracted bounces for viewing 
@@ -71,7 +126,104 @@ class RayTracer
 	* @param recursionDepth - Number of times refracted and reflected rays will be generated 
 	* for each view ray.
 	*/
-	void setRecursionDepth( int recursionDepth ) { this->recursionDepth = recursionDepth; }
+	void setRecursionDepth( int recursionDepth ) { this->recursionDepth = recursionDepth; invalidateFrame(); }
+
+	/**
+	* Sets the number of threads used to trace a frame. With more than one thread
+	* the frame is divided into square tiles that are traced by a persistent pool
+	* of worker threads. A value of one traces every pixel on the calling thread.
+	* @param threadCount - Number of threads. Zero or less uses the number of
+	* hardware threads.
+	*/
+	void setThreadCount( int threadCount ) { threadPool.setThreadCount( threadCount ); }
+
+	/**
+	* Sets the width and height, in pixels, of the tiles that are handed to the
+	* worker threads. Frame buffers with a tiled layout use their own tile size.
+	* @param tileSize - Tile edge length in pixels. Values less than one are ignored.
+	*/
+	void setTileSize( int tileSize ) { if( tileSize > 0 ) this->tileSize = tileSize; }
+
+	/**
+	* Sets the width and height, in pixels, of the square groups of primary rays
+	* that are traced together as a packet. Shadow and reflection rays are always
+	* traced one at a time.
+	* @param packetSize - 2 for 2x2 packets, 4 for 4x4 packets, or 1 to trace every
+	* primary ray on its own. Other values are rounded to the nearest of these,
+	* with 3 and larger values becoming 4.
+	*/
+	void setPacketSize( int packetSize ) { this->packetSize = packetSize >= 3 ? 4 : packetSize == 2 ? 2 : 1; }
+
+	/**
+	* Sets whether traced frames keep a shading cache: the first hit of every
+	* pixel and the terms of every light summed along the path of the pixel.
+	* The cache lets reshadeScene shade the frame again after lights are
+	* switched on or off or change color. Costs about 48 + 49 * lights bytes per
+	* pixel. Frame buffers that stream their tiles keep no cache.
+	* @param enabled - true to keep the cache, false to free it
+	*/
+	void setReshadingEnabled( bool enabled );
+
+	/**
+	* Shades the last traced frame again for the current colors and enabled
+	* flags of the lights, without tracing any rays.
+	* @returns false, leaving the frame unchanged, if the frame has to be traced
+	* instead: there is no cache, or the scene, camera, default color, recursion
+	* depth, or size of the frame changed after the frame was traced
+	*/
+	bool reshadeScene();
+
+	/**
+	* Returns the shading cache of the last traced frame.
+	*/
+	const ShadingCache & getShadingCache() const { return shadingCache; }
+
+	/**
+	* Sets whether traced frames record, for every tile, the surfaces that the
+	* primary, reflection, and shadow rays of the tile hit and a bound on where
+	* the rays went. The records let raytraceChanges trace only the tiles that
+	* an edit can change.
+	* Frame buffers that stream their tiles record nothing.
+	* @param enabled - true to record the sets, false to free them
+	*/
+	void setDependencyTracking( bool enabled );
+
+	/**
+	* Updates the last traced frame after some surfaces of the committed list
+	* were changed in place, such as a Sphere or Cylinder that was moved.
+	* Commits the list again and traces the tiles whose rays hit a changed
+	* surface, or whose primary rays, reflections, or shadow rays may reach the
+	* new bounding box of a changed surface. Lights must not have changed.
+	* Traces the whole frame if there are no sets for the last frame, or if the
+	* camera or settings changed after it was traced.
+	* @param changedSurfaces - positions of the changed surfaces in the list
+	* @returns number of tiles traced, or -1 if the whole frame was traced
+	*/
+	int raytraceChanges( const std::vector<int> & changedSurfaces );
+
+	/**
+	* Sets up adaptive antialiasing of the frames traced by raytraceScene and
+	* raytraceChanges. Every pixel is first traced with one ray through its
+	* center. Pixels whose color differs from a neighbor by more than a
+	* threshold, as on edges, silhouettes, and shadow boundaries, are then
+	* traced again with a jittered grid of rays, most different first, until
+	* the sample budget of the frame is used up. Frame buffers that stream
+	* their tiles, and regions traced by raytraceRegion, are not antialiased.
+	* reshadeScene keeps the pixels that the traced frame sampled again.
+	* @param samplesPerSide - rays along each side of the grid of a pixel. One
+	* or less turns antialiasing off.
+	* @param contrastThreshold - difference of a color component, clamped to
+	* one, above which a pixel is sampled again
+	* @param sampleBudget - largest number of extra rays in a frame, as a
+	* multiple of the number of pixels
+	*/
+	void setAdaptiveSampling( int samplesPerSide, real contrastThreshold = 0.1, real sampleBudget = 1.0 );
+
+	/**
+	* Returns the number of pixels that the last frame traced with more than
+	* one ray.
+	*/
+	int getSupersampledPixelCount() const { return supersampledPixelCount; }
 
 protected:
 
@@ -82,11 +234,150 @@ protected:
 	*
 	* Can be called recursively to trace rays associated with reflection and
 	* refraction.
-	* @param e - origin of the ray being traced
-	* @param d - unit length vector representing the direction of the ray
+	* @param viewRay - ray being traced
+	* @param recursionLevel - number of reflection bounces still allowed
+	* @param tMin - smallest parameter value of interest along the ray. Reflected
+	* rays use EPSILON to skip the surface they start on.
+	* @param context - precomputed terms for the origin of the ray. May be null.
+	* @returns color for the point of intersection
+	*/
+	color traceIndividualRay( const Ray & viewRay, int recursionLevel = 0, real tMin = 0.0,
+							  const OriginContext * context = nullptr ) const;
+
+	/**
+	* Computes the color for the closest intersection of a ray. Traces the reflected
+	* ray and a shadow ray for every light source.
+	* @param viewRay - ray that was traced
+	* @param closest - closest intersection of the ray
+	* @param recursionLevel - number of reflection bounces still allowed
 	* @returns color for the point of intersection
 	*/
-	color traceIndividualRay( const Ray & viewRay, int recursionLevel = 0);
+	color shadeHit( const Ray & viewRay, const HitRecord & closest, int recursionLevel ) const;
+
+	/**
+	* Traces every pixel in a rectangular block of the rendering window. Safe to
+	* call concurrently for blocks that do not overlap.
+	* @param xStart - first column of the block
+	* @param yStart - first row of the block
+	* @param xEnd - one past the last column of the block
+	* @param yEnd - one past the last row of the block
+	*/
+	void traceTile( const int xStart, const int yStart, const int xEnd, const int yEnd );
+
+	/**
+	* Sets every pixel in a rectangular block of the rendering window from the
+	* shading cache. Safe to call concurrently for blocks that do not overlap.
+	*/
+	void reshadeTile( const int xStart, const int yStart, const int xEnd, const int yEnd );
+
+	/**
+	* Traces a block like traceTile and records the surfaces that its rays
+	* were tested against as the dependency set of its tile.
+	*/
+	void recordTile( const int xStart, const int yStart, const int xEnd, const int yEnd );
+
+	/**
+	* Finds the pixels of a block whose color differs from a neighbor by more
+	* than the contrast threshold and lists them for its tile.
+	*/
+	void measureTile( const int xStart, const int yStart, const int xEnd, const int yEnd );
+
+	/**
+	* Traces every pixel listed for the tile of a block with a jittered grid of
+	* rays and stores the average color.
+	*/
+	void sampleTile( const int xStart, const int yStart, const int xEnd, const int yEnd );
+
+	/**
+	* Antialiases the tiles of the frame that were just traced.
+	* @param tileMask - one entry per tile of the frame. Tiles whose entry is
+	* zero are left as they are. May be null for every tile.
+	*/
+	void refineFrame( const std::vector<char> * tileMask );
+
+	/**
+	* Returns the index of the tile of the frame that starts at a pixel.
+	*/
+	int getTileIndex( const int x, const int y ) const;
+
+	/**
+	* Returns the ray through a point of a pixel.
+	* @param x column of a pixel in the rendering window
+	* @param y row of a pixel in the rendering window
+	* @param offset - position in the pixel, from (0, 0) at its lower left
+	* corner to (1, 1) at its upper right corner
+	*/
+	Ray getSampleViewRay( const int x, const int y, const vec2 & offset ) const;
+
+	/**
+	* Cuts a block of the rendering window into tiles and runs a task for every
+	* tile, on the worker threads if there are more than one.
+	* @param task - member function called with the bounds of a tile
+	* @param tileMask - one entry per tile, row by row from the lower left tile
+	* of the block. Tiles whose entry is zero are skipped. May be null.
+	*/
+	void runTiles( const int xStart, const int yStart, const int xEnd, const int yEnd,
+				   void ( RayTracer::*task )( const int, const int, const int, const int ),
+				   const std::vector<char> * tileMask = nullptr );
+
+	/**
+	* Computes the origin terms for the frame and sizes the shading cache and
+	* the dependency sets for the frame buffer.
+	*/
+	void prepareFrame();
+
+	/**
+	* Returns the width and height of the tiles that frames are traced in.
+	*/
+	int getTaskSize() const;
+
+	/**
+	* Finds the pixels whose primary rays may hit a box.
+	* @param box - box in world coordinates
+	* @param xMin, yMin, xMax, yMax - set to the first and last column and row
+	* of the pixels, which may lie outside the rendering window
+	* @returns false if the box reaches behind the eye, so that any pixel may
+	* see it
+	*/
+	bool getScreenBounds( const BoundingBox & box, int & xMin, int & yMin, int & xMax, int & yMax ) const;
+
+	/**
+	* Marks the last traced frame as no longer matching the camera and settings.
+	*/
+	void invalidateFrame() { shadingCacheValid = false; dependenciesValid = false; }
+
+	/**
+	* Returns true if a reflection or shadow ray of a tile may pass through a
+	* box. Primary rays are left to getScreenBounds.
+	*/
+	bool mayReach( const TileDependencies & dependencies, const BoundingBox & box ) const;
+
+	/**
+	* Adds a hit, or a miss of a reflected ray, to the dependency set of the
+	* calling thread, if there is one.
+	*/
+	void recordPath( const Ray & viewRay, const HitRecord & closest, int recursionLevel ) const;
+
+	/**
+	* Finds the color of a pixel from the closest hit of its primary ray through
+	* the shading cache, and stores the record of the pixel in the cache.
+	* @param lightTerms - room for the terms of every light
+	*/
+	color shadeCached( const int x, const int y, const Ray & viewRay, const HitRecord & closest,
+					   std::vector<LightTerms> & lightTerms );
+
+	/**
+	* Adds the light terms and constant light of a hit, and of the reflections
+	* seen from it, weighted the same way shadeHit weights them.
+	* @param viewRay - ray that was traced
+	* @param closest - closest intersection of the ray
+	* @param recursionLevel - number of reflection bounces still allowed
+	* @param weight - factor of the light of the hit in the color of the pixel
+	* @param lightTerms - terms of every light, added to
+	* @param constant - light that does not depend on any light, added to
+	*/
+	void accumulateTerms( const Ray & viewRay, const HitRecord & closest, int recursionLevel, real weight,
+						  LightTerms * lightTerms, color & constant ) const;
 	
 	/**
 	* Sets the rayOrigin and rayDirection data members of the class based on row and
@@ -96,7 +387,7 @@ protected:
 	* @param x column of a pixel in the rendering window
 	* @param y row of a pixel in the rendering window
 	*/
-	Ray getOrthoViewRay( const int x, const int y);
+	Ray getOrthoViewRay( const int x, const int y) const;
 
 	/**
 	* Sets the rayOrigin and rayDirection data members of the class based on row and 
@@ -106,7 +397,20 @@ protected:
 	* @param x column of a pixel in the rendering window
 	* @param y row of a pixel in the rendering window
 	*/
-	Ray getPerspectiveViewRay( const int x, const int y);
+	Ray getPerspectiveViewRay( const int x, const int y) const;
+
+	/**
+	* Fills a packet with the view rays for a rectangular group of pixels, row by
+	* row. Uses the same calculation as getPerspectiveViewRay and getOrthoViewRay,
+	* so every lane holds exactly the ray those functions return.
+	* @param x column of the lower left pixel of the group
+	* @param y row of the lower left pixel of the group
+	* @param width number of columns in the group
+	* @param height number of rows in the group. width * height must not exceed
+	* RayPacket::MAX_SIZE.
+	* @param packet set to the rays of the group
+	*/
+	void getViewRayPacket( const int x, const int y, const int width, const int height, RayPacket & packet ) const;
 
 	/**
 	* Finds the projection plane coordinates, u and v, for the pixel identified
@@ -115,7 +419,7 @@ protected:
 	* @param y row of a pixel in the rendering window
 	* @returns two dimensional vector containing the projection plane coordinates
 	*/
-	dvec2 getImagePlaneCoordinates(const int x, const int y);
+	vec2 getImagePlaneCoordinates(const int x, const int y) const;
 
 	// Alias for an object controls memory that stores a rgba color value f
 	// or every pixel.
@@ -126,38 +430,96 @@ protected:
 	color defaultColor;
 
 	// View frame parameters
-	dvec3 eye; // position of the viewpoint
-	dvec3 u; // "right" relative to the viewing direction
-	dvec3 v; //  "up" relative to the viewing vector
-	dvec3 w; // camera looks in the negative w direction
+	vec3 eye; // position of the viewpoint
+	vec3 u; // "right" relative to the viewing direction
+	vec3 v; //  "up" relative to the viewing vector
+	vec3 w; // camera looks in the negative w direction
 
 	// Projection plane parameters
 	// Measured relative to u (right)
-	double rightLimit;
-	double leftLimit;
+	real rightLimit;
+	real leftLimit;
 	// Measured relative to v (up)
-	double topLimit;
-	double bottomLimit;
+	real topLimit;
+	real bottomLimit;
 
 	// Rendering window parameters
-	double nx; // Width in pixels
-	double ny; // Height in pixel
+	real nx; // Width in pixels
+	real ny; // Height in pixel
 
 	// Distance from the viewpoint to the projection plane
-	double distToPlane;
+	real distToPlane;
 
-	// List of the surfaces in the scene that is being ray traced
+	// List of the surfaces in the committed scene. Keeps them alive.
 	SurfaceVector surfacesInScene;
 
-	// List of the light sources in the scene that is being ray traced
+	// List of the light sources in the committed scene. Keeps them alive.
 	LightVector lightsInScene;
 
+	// Snapshot of the committed scene that rendering reads from
+	Scene scene;
+
+	// Points for which origin terms were computed, and the scene version they
+	// were computed for
+	std::vector<vec3> preparedOrigins;
+	unsigned preparedVersion = 0;
+
 	// True to generate rays for perspective viewing. False for orthographic viewing.
 	bool renderPerspectiveView = true;
 
 	// Max recursion depth
 	int recursionDepth;
 
+	// Persistent worker threads used to trace tiles in parallel
+	ThreadPool threadPool;
+
+	// Width and height of the tiles traced by the worker threads
+	int tileSize = 32;
+
+	// Width and height of the groups of primary rays traced as a packet
+	int packetSize = 4;
+
+	// First hits and light terms of the pixels of the last traced frame
+	ShadingCache shadingCache;
+	bool reshadingEnabled = false;
+
+	// True if the cache holds every pixel of a frame traced with the current
+	// camera and settings from the scene version shadedVersion
+	bool shadingCacheValid = false;
+	unsigned shadedVersion = 0;
+
+	// Dependencies of every tile of the last traced frame, row by row from the
+	// lower left tile
+	std::vector<TileDependencies> tileDependencies;
+	bool trackingDependencies = false;
+	int dependencyTileSize = 0;
+	int dependencyTilesAcross = 0;
+
+	// True if the sets are those of a whole frame traced with the current
+	// camera and settings from the scene version dependencyVersion
+	bool dependenciesValid = false;
+	unsigned dependencyVersion = 0;
+
+	// Adaptive antialiasing settings
+	int samplesPerSide = 1;
+	real contrastThreshold = 0.1;
+	real sampleBudget = 1.0;
+
+	/**
+	* Pixel that differs from a neighbor.
+	*/
+	struct SampleCandidate
+	{
+		int x, y;
+		float contrast;
+	};
+
+	// Pixels of every tile of the frame to trace with more rays, row by row
+	// from the lower left tile
+	std::vector<std::vector<SampleCandidate>> tileCandidates;
+
+	int supersampledPixelCount = 0;
+
 };
 
 
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <mutex>
+
+#include "RayTracer.h"
+#include "TiledImageFile.h"
+
+/**
+* Rendering one image with several processes on the local machine. The
+* coordinator starts worker processes that each load the scene and run their
+* own RayTracer, hands out ranges of tiles to them over a socket, and collects
+* the finished tiles. A worker that dies, or that does not finish its range in
+* time, has its range handed to a replacement, so the processes stand in for
+* the nodes of a render farm.
+*
+* Tiles are numbered row by row from the lower left corner of the image, as in
+* a tiled image file. The coordinator sends a worker a RangeMessage, and the
+* worker answers with one TileMessage, followed by the pixels of the tile, for
+* every tile of the range in any order. A range of zero tiles tells the worker
+* to stop.
+*/
+
+/**
+* Tiles that the coordinator hands to a worker at once.
+*/
+struct RangeMessage
+{
+	int32_t firstTile;
+
+	int32_t tileCount;
+};
+
+/**
+* Header of a finished tile sent by a worker. Followed by tileSize * tileSize
+* RGBA pixels, rows from the bottom up.
+*/
+struct TileMessage
+{
+	int32_t tileX;
+
+	int32_t tileY;
+};
+
+/**
+* Throughput of one worker process. A worker that replaces a failed one gets
+* its own entry.
+*/
+struct WorkerStats
+{
+	int processId = 0;
+
+	// Tiles and pixels that the worker delivered
+	int tiles = 0;
+	long long pixels = 0;
+
+	// Seconds from handing out ranges to receiving their last tile
+	double busySeconds = 0.0;
+
+	// True if the worker died, broke the protocol, or ran out of time
+	bool failed = false;
+
+	// True if the worker was stopped for not finishing its range in time
+	bool timedOut = false;
+};
+
+/**
+* Failures that renderWithWorkers can cause on purpose, to test its recovery.
+*/
+enum class WorkerFault
+{
+	NONE,
+
+	// The worker is killed
+	DIE,
+
+	// The worker is suspended without exiting
+	HANG
+};
+
+/**
+* Settings of renderWithWorkers.
+*/
+struct FarmSettings
+{
+	// Program and arguments that start a worker. "--worker-fd" and the socket
+	// of the worker are appended.
+	std::vector<string> workerCommand;
+
+	// Number of workers that run at once
+	int workerCount = 2;
+
+	// Number of tiles handed to a worker at once
+	int tilesPerRange = 16;
+
+	// Number of times a range is handed out before the render fails
+	int maxAttempts = 3;
+
+	// Seconds that a worker may take to deliver all tiles of a range. A
+	// worker that takes longer is killed and its range handed out again, as
+	// if it had died. Zero or less waits forever.
+	double rangeTimeout = 120.0;
+
+	// Failure caused in the first worker once it has delivered faultAfterTiles
+	// tiles in the middle of a range
+	WorkerFault fault = WorkerFault::NONE;
+	int faultAfterTiles = 0;
+};
+
+/**
+* Renders an image with worker processes and passes the finished tiles to an
+* output. Workers that die or run out of time are replaced until every range
+* has been tried maxAttempts times.
+* @param settings - how to start the workers and divide the image
+* @param output - receives the tiles. Its size and tile size must match the
+* command of the workers.
+* @param stats - set to the throughput of every worker that was started
+* @param error - set to a description of the problem if the render fails
+* @return true if every tile was rendered and stored
+*/
+bool renderWithWorkers( const FarmSettings & settings, TileOutput & output, std::vector<WorkerStats> & stats,
+						string & error );
+
+/**
+* Worker end of the socket to a coordinator. Used as the streaming output of
+* the frame buffer of the worker, so every tile is sent as soon as it is
+* resolved, from whichever thread resolved it.
+*/
+class WorkerConnection : public TileOutput
+{
+public:
+
+	/**
+	* @param socket - descriptor connected to the coordinator
+	* @param width of the image in pixels
+	* @param height of the image in pixels
+	* @param tileSize - edge length of the tiles in pixels
+	*/
+	WorkerConnection( int socket, int width, int height, int tileSize )
+		: socket( socket ), width( width ), height( height ), tileSize( tileSize ) { }
+
+	int getWidth( ) const override { return width; }
+
+	int getHeight( ) const override { return height; }
+
+	int getTileSize( ) const override { return tileSize; }
+
+	/**
+	* Sends a tile to the coordinator.
+	*/
+	bool writeTile( int tileX, int tileY, const unsigned char * pixels ) override;
+
+	/**
+	* Renders the ranges that the coordinator hands out until it says to stop.
+	* @param rayTracer - set up with the scene and camera of the image. Its
+	* frame buffer must stream into this connection.
+	* @return false if the connection broke
+	*/
+	bool serve( RayTracer & rayTracer );
+
+protected:
+
+	int socket;
+
+	int width, height, tileSize;
+
+	// Keeps the messages of different threads apart
+	std::mutex sendMutex;
+
+	// True once a tile could not be sent
+	bool failed = false;
+
+}; // end WorkerConnection class
+
+/**
+* Output that copies the tiles into the color buffer of a frame buffer, for
+* images that are saved as a whole once they are complete.
+*/
+class FrameBufferTileOutput : public TileOutput
+{
+public:
+
+	FrameBufferTileOutput( FrameBuffer & frameBuffer ) : frameBuffer( frameBuffer ) { }
+
+	int getWidth( ) const override { return frameBuffer.getWindowWidth( ); }
+
+	int getHeight( ) const override { return frameBuffer.getWindowHeight( ); }
+
+	int getTileSize( ) const override { return frameBuffer.getTileSize( ); }
+
+	bool writeTile( int tileX, int tileY, const unsigned char * pixels ) override
+	{
+		frameBuffer.writeColorTile( tileX, tileY, frameBuffer.getTileSize( ), pixels );
+		return true;
+	}
+
+protected:
+
+	FrameBuffer & frameBuffer;
+
+}; // end FrameBufferTileOutput class
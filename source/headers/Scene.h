@@ -0,0 +1,329 @@
+#pragma once
+
+#include "BVH.h"
+#include "Cylinder.h"
+#include "HitRecord.h"
+#include "Plane.h"
+#include "QuadricSurface.h"
+#include "Ray.h"
+#include "SimplePolygon.h"
+#include "Sphere.h"
+#include "Surface.h"
+
+struct LightSource;
+
+/**
+* Set of the primitives of a scene that some rays hit, such as the rays of one
+* tile of a frame. Moving any other primitive out of the way leaves what the
+* rays hit unchanged.
+*
+* The set can also hold where the paths of the rays went: for every number of
+* reflections, a box around the points that were hit and a box around the
+* directions of the reflected rays that hit nothing. A primitive moved to where
+* no path reaches changes none of the rays either.
+*/
+class DependencySet
+{
+public:
+
+	/**
+	* Empties the set and sizes it for the primitives of a scene.
+	*/
+	void reset( int primitiveCount )
+	{
+		marks.assign( primitiveCount, false );
+		indices.clear();
+		pathBounds.clear();
+		escapeDirections.clear();
+	}
+
+	/**
+	* Adds a primitive index to the set.
+	*/
+	void add( int index )
+	{
+		if( !marks[index] ) {
+			marks[index] = true;
+			indices.push_back( index );
+		}
+	}
+
+	/**
+	* Returns the primitive indices in the set in increasing order.
+	*/
+	std::vector<int> getSortedIndices( ) const;
+
+	/**
+	* Adds a point at which a path hit a surface.
+	* @param level - number of reflections before the hit
+	*/
+	void addPathPoint( int level, const vec3 & point );
+
+	/**
+	* Adds the direction of a reflected ray that hit nothing.
+	* @param level - number of reflections, including this one
+	*/
+	void addEscape( int level, const vec3 & direction );
+
+	/**
+	* Returns a box around the points hit after every number of reflections.
+	* Levels without a hit have an empty box.
+	*/
+	const std::vector<BoundingBox> & getPathBounds( ) const { return pathBounds; }
+
+	/**
+	* Returns a box around the directions of the rays that left the scene after
+	* every number of reflections. Levels without such rays have an empty box.
+	*/
+	const std::vector<BoundingBox> & getEscapeDirections( ) const { return escapeDirections; }
+
+protected:
+
+	std::vector<bool> marks;
+
+	std::vector<int> indices;
+
+	std::vector<BoundingBox> pathBounds;
+
+	std::vector<BoundingBox> escapeDirections;
+};
+
+/**
+* Tagged index of a primitive of a scene: the concrete type of the primitive and
+* its slot in the array that the scene keeps for that type.
+*/
+struct PrimitiveRef
+{
+	enum class Type : unsigned char
+	{
+		SPHERE,
+		PLANE,
+		QUADRIC, // QuadricSurface and Ellipsoid
+		CYLINDER,
+		POLYGON, // SimplePolygon
+		CUSTOM   // any other subclass of Surface
+	};
+
+	Type type;
+	int slot;
+};
+
+/**
+* Terms of the intersection tests that depend only on where a ray starts,
+* computed once for every surface of a scene. Rays that start at the origin of
+* the context are intersected with these terms instead of recomputing them.
+*/
+struct OriginContext
+{
+	// Point at which the rays start
+	vec3 origin;
+
+	// Term of every surface, indexed by primitive index. NaN for surfaces that
+	// do not use one.
+	std::vector<real> terms;
+};
+
+/**
+* Read only snapshot of a scene that rendering works from. Surfaces with a finite
+* bounding box are placed in a bounding volume hierarchy. Surfaces that extend
+* infinitely, such as planes, are kept in a separate list that is tested
+* against every ray.
+*
+* Surfaces of the built in types are copied into one contiguous array per type
+* and tested by qualified calls, without going through the virtual functions of
+* Surface. Surfaces of any other type, such as SphereSet or subclasses defined
+* by users, are referred to by raw pointers and tested through the virtual
+* functions. Lights are also referred to by raw pointers, so reading the snapshot
+* from many threads touches no reference counts.
+*
+* Every build gives the snapshot a new version number, which lets callers tell
+* whether data they derived from it is still current.
+*/
+class Scene
+{
+public:
+
+	/**
+	* Rebuilds the acceleration structure for a list of surfaces. Surfaces that
+	* are not of a built in type must remain alive and unchanged for as long as
+	* the scene is used.
+	* @param surfaces - list of the surfaces in the scene
+	* @param threadPool - pool used to build the hierarchy concurrently. May be null.
+	*/
+	void build( const SurfaceVector & surfaces, ThreadPool * threadPool = nullptr );
+
+	/**
+	* Rebuilds the acceleration structure for a list of surfaces and records the
+	* lights of the scene. The lights and the surfaces that are not of a built in
+	* type must remain alive, and the surfaces unchanged, for as long as the scene
+	* is used.
+	* @param surfaces - list of the surfaces in the scene
+	* @param lights - list of the light sources in the scene
+	* @param threadPool - pool used to build the hierarchy concurrently. May be null.
+	* @param hierarchy - hierarchy returned by getHierarchy for an earlier build
+	* from an equal list of surfaces, such as one read from a scene cache. Used
+	* instead of building a new one. May be null.
+	*/
+	void build( const SurfaceVector & surfaces, const LightVector & lights, ThreadPool * threadPool = nullptr,
+				const BVH * hierarchy = nullptr );
+
+	/**
+	* Returns the bounding volume hierarchy over the surfaces with a finite
+	* bounding box.
+	*/
+	const BVH & getHierarchy( ) const { return bvh; }
+
+	/**
+	* Returns the lights that were passed to build.
+	*/
+	const std::vector<const LightSource *> & getLights( ) const { return lights; }
+
+	/**
+	* Returns the number of the snapshot. Starts at zero and is increased by every
+	* call to build.
+	*/
+	unsigned getVersion( ) const { return version; }
+
+	/**
+	* Computes the origin terms of every surface for points at which many rays
+	* start, such as the eye of a perspective view or the position of a light.
+	* Replaces the contexts of any earlier call. Must be called after build.
+	* @param origins - points at which the rays start
+	*/
+	void prepareOrigins( const std::vector<vec3> & origins );
+
+	/**
+	* Returns the context for a point that was passed to prepareOrigins, or null
+	* if there is none.
+	*/
+	const OriginContext * getOriginContext( const vec3 & origin ) const;
+
+	/**
+	* Finds the closest intersection of a ray with any surface in the scene
+	* within the interval [tMin, tMax). Returns a HitRecord with the t parameter
+	* set to FLT_MAX if there is no intersection.
+	* @param ray - ray being checked for intersection
+	* @param tMin - smallest parameter value of interest along the ray
+	* @param tMax - largest parameter value of interest along the ray
+	* @param context - terms for the origin of the ray. May be null.
+	* @returns HitRecord containing information about the closest intersection
+	*/
+	HitRecord findIntersection( const Ray & ray, real tMin = 0.0, real tMax = FLT_MAX,
+								const OriginContext * context = nullptr ) const;
+
+	/**
+	* Finds the closest intersection of every ray in a packet. The packet is
+	* traced through the hierarchy as a whole and surfaces are tested against
+	* all of the rays that reach them at once.
+	* @param packet - rays being checked for intersection
+	* @param tMin - smallest parameter value of interest along the rays
+	* @param hitRecords - set to the closest intersection of the ray in each lane
+	* of the packet. Lanes without an intersection have t set to FLT_MAX.
+	* @param context - terms for the origin that every ray of the packet starts at.
+	* May be null.
+	*/
+	void findIntersections( const RayPacket & packet, real tMin, HitRecord hitRecords[],
+							const OriginContext * context = nullptr ) const;
+
+	/**
+	* Checks whether any surface blocks a ray within the interval [tMin, tMax).
+	* Stops at the first blocking surface found and does not compute normals or
+	* materials.
+	* @param ray - ray being checked for intersection
+	* @param tMin - smallest parameter value of interest along the ray
+	* @param tMax - parameter of the end of the ray segment being checked
+	* @param context - terms for the origin of the ray. May be null.
+	* @returns true if some surface intersects the ray within the interval
+	*/
+	bool occluded( const Ray & ray, real tMin, real tMax, const OriginContext * context = nullptr ) const;
+
+	/**
+	* Returns the number of surfaces in the scene.
+	*/
+	int getPrimitiveCount( ) const { return static_cast<int>( primitives.size( ) ); }
+
+	/**
+	* Returns the surface with a primitive index.
+	*/
+	const Surface & getSurface( int index ) const;
+
+	/**
+	* Returns the primitive index of a surface.
+	* @param surfaceIndex - position of the surface in the list passed to build
+	*/
+	int getPrimitiveIndex( int surfaceIndex ) const { return surfacePrimitives[surfaceIndex]; }
+
+	/**
+	* Makes the queries on the calling thread add the primitives that their
+	* rays hit to a set, until this is called again with null. These are the
+	* closest hits that findIntersection and findIntersections return and the
+	* primitives that occluded finds blocking a ray.
+	* @param dependencies - set to add to, sized for this scene. May be null.
+	*/
+	static void recordDependencies( DependencySet * dependencies ) { recordedDependencies = dependencies; }
+
+	/**
+	* Returns the set that the queries on the calling thread add to, or null.
+	*/
+	static DependencySet * getRecordedDependencies( ) { return recordedDependencies; }
+
+protected:
+
+	/**
+	* Copies a surface of a built in type into the array for its type, or records
+	* a pointer to a surface of any other type.
+	* @returns the tagged index of the surface
+	*/
+	PrimitiveRef addPrimitive( const Surface * surface );
+
+	/**
+	* Adds a primitive to the set of the calling thread, if there is one.
+	*/
+	static void recordHit( int index )
+	{
+		if( recordedDependencies != nullptr ) {
+			recordedDependencies->add( index );
+		}
+	}
+
+	/**
+	* Calls a function object with the surface of a tagged index, passed as its
+	* concrete type. Surfaces that are not of a built in type are passed as
+	* Surface.
+	*/
+	template <class Function>
+	typename Function::result_type visit( PrimitiveRef primitive, const Function & function ) const;
+
+	// Surfaces of the built in types, grouped by type
+	std::vector<Sphere> spheres;
+	std::vector<Plane> planes;
+	std::vector<QuadricSurface> quadrics;
+	std::vector<Cylinder> cylinders;
+	std::vector<SimplePolygon> polygons;
+
+	// Surfaces of any other type
+	std::vector<const Surface *> customSurfaces;
+
+	// Every surface, indexed by primitive index. The surfaces in the bounding
+	// volume hierarchy come first. The surfaces without a finite bounding box
+	// follow, sorted by type so that each type is tested in a single run.
+	std::vector<PrimitiveRef> primitives;
+
+	// Primitive index of every surface, in the order passed to build
+	std::vector<int> surfacePrimitives;
+
+	// Number of surfaces in the bounding volume hierarchy
+	int boundedCount = 0;
+
+	BVH bvh;
+
+	std::vector<const LightSource *> lights;
+
+	std::vector<OriginContext> originContexts;
+
+	unsigned version = 0;
+
+	// Set that the queries of each thread add the primitives they hit to
+	static thread_local DependencySet * recordedDependencies;
+
+}; // end Scene class
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "BVH.h"
+#include "Lights.h"
+#include "Surface.h"
+
+/**
+* Everything that a scene file describes: the surfaces, the light sources, and
+* the camera, along with the hierarchy over the surfaces so that committing the
+* scene does not have to build one.
+*/
+struct SceneDescription
+{
+	// All of the surfaces in the scene, in the order of the file
+	SurfaceVector surfaces;
+
+	// All of the light sources in the scene, in the order of the file
+	LightVector lights;
+
+	// Camera frame, as passed to RayTracer::setCameraFrame
+	vec3 eye = vec3( 0, 0, 0 );
+	vec3 direction = vec3( 0, 0, -1 );
+	vec3 up = vec3( 0, 1, 0 );
+
+	// Vertical field of view in degrees for perspective views
+	real fieldOfView = 45.0;
+
+	// Height of the projection plane for orthographic views. Zero for perspective.
+	real orthoHeight = 0.0;
+
+	// Color of pixels whose rays do not hit anything
+	color background = color( 0.784, 0.784, 1.0 );
+
+	// Hierarchy that Scene::build would build for the surfaces
+	BVH hierarchy;
+};
+
+/**
+* Loads a text scene file. Every line holds one statement, and everything after
+* a # is a comment:
+*
+*   camera EX EY EZ DX DY DZ UX UY UZ FOV      perspective view
+*   ortho EX EY EZ DX DY DZ UX UY UZ HEIGHT    orthographic view
+*   background R G B
+*   material NAME R G B [shininess S] [specular R G B] [emissive R G B] [ambient R G B]
+*   sphere X Y Z RADIUS MATERIAL
+*   plane X Y Z NX NY NZ MATERIAL
+*   ellipsoid X Y Z A B C MATERIAL
+*   cylinder X Y Z AX AY AZ RADIUS LENGTH MATERIAL [capped]
+*   polygon MATERIAL X Y Z X Y Z X Y Z ...
+*   ambient R G B
+*   positional X Y Z R G B
+*   directional DX DY DZ R G B
+*   spotlight X Y Z DX DY DZ CUTOFF R G B      CUTOFF is half the beam in degrees
+*
+* Materials must be defined before they are used. A material that is only
+* given a color gets the defaults of Material.
+*
+* The scene is compiled into a binary cache next to the file, named after it
+* with ".cache" appended. The cache holds the surfaces and lights as flat arrays
+* of records and the hierarchy over the surfaces. As long as the text file does
+* not change, later loads map the cache instead of parsing the text and
+* building the hierarchy. A cache that cannot be written is not an error.
+* @param fileName - path of the text scene file
+* @param scene - set to the contents of the file
+* @param error - set to a description of the problem if loading fails
+* @param threadPool - pool used to build the hierarchy concurrently. May be null.
+* @return true if the scene was loaded
+*/
+bool loadScene( const string & fileName, SceneDescription & scene, string & error,
+				ThreadPool * threadPool = nullptr );
+
+/**
+* Returns the path of the cache that loadScene keeps for a scene file.
+*/
+string getSceneCacheName( const string & fileName );
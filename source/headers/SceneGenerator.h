@@ -0,0 +1,33 @@
+#pragma once
+
+#include "DemoScene.h"
+#include "ThreadPool.h"
+
+/**
+* Settings for generateScene.
+*/
+struct SceneGeneratorSettings
+{
+	// Total number of primitives, including the seven of the demonstration scene
+	int primitiveCount = 7;
+
+	// Seed of the random number generator. Equal settings produce equal scenes.
+	unsigned seed = 1;
+
+	// True to place the added spheres in a SphereSet, the added ellipsoids in a
+	// QuadricSet, and the added cylinders in a CylinderSet. False to add every
+	// primitive to the scene as its own surface.
+	bool groupPrimitives = true;
+};
+
+/**
+* Creates the demonstration scene and fills the space behind it with randomly
+* placed spheres, cylinders, ellipsoids, and polygons until the scene holds the
+* requested number of primitives. The size of the primitives shrinks as their
+* number grows so that the density of the field stays about the same. The camera
+* of the demonstration scene (at the origin looking down -z) sees all of them.
+* @param scene - filled with the surfaces and lights. Anything it holds is kept.
+* @param settings - number of primitives and seed
+* @param threadPool - pool used to build the hierarchies of grouped primitives. May be null.
+*/
+void generateScene( DemoScene & scene, const SceneGeneratorSettings & settings, ThreadPool * threadPool = nullptr );
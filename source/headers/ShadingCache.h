@@ -0,0 +1,70 @@
+#pragma once
+
+#include "Lights.h"
+
+/**
+* Per pixel record of a traced frame from which the frame can be shaded again
+* without tracing rays. Every pixel keeps, for each light, the LightTerms
+* summed over all of the hits along the path of the pixel, weighted like the reflections that reach the
+* eye. The light that does not depend on any light source, such as the
+* background seen in reflections, is kept separately.
+*
+* The color of a pixel is a sum of the terms times the colors of the enabled
+* lights, so new light colors and enabled flags only need that sum recomputed.
+* Terms are stored in single precision.
+*/
+class ShadingCache
+{
+public:
+
+	/**
+	* Sizes the buffers for a frame. Keeps the memory when the size does not
+	* change.
+	* @param width of the frame in pixels
+	* @param height of the frame in pixels
+	* @param lightCount - number of light sources of the scene
+	*/
+	void resize(int width, int height, int lightCount);
+
+	/**
+	* Frees the memory of the buffers.
+	*/
+	void release();
+
+	/**
+	* Stores the record of a pixel. Safe to call concurrently for different pixels.
+	* @param x coordinate of the pixel.
+	* @param y coordinate of the pixel.
+	* @param terms - terms of every light summed along the path of the pixel.
+	* @param constant - light of the path that does not depend on any light
+	*/
+	void store(int x, int y, const LightTerms * terms, const color & constant);
+
+	/**
+	* Returns the color of a pixel for the current colors and enabled flags of
+	* the lights.
+	* @param lights - the lights that the terms were computed for, in order
+	*/
+	color shade(int x, int y, const std::vector<const LightSource *> & lights) const;
+
+	int getWidth() const { return width; }
+	int getHeight() const { return height; }
+	int getLightCount() const { return lightCount; }
+
+protected:
+
+	size_t index(int x, int y) const { return (size_t)y * width + x; }
+
+	int width = 0;
+	int height = 0;
+	int lightCount = 0;
+
+	// Floats per light per pixel: ambient, diffuse, specular, and constant
+	static const int FLOATS_PER_TERMS = 12;
+
+	// FLOATS_PER_TERMS floats per light per pixel
+	std::vector<float> terms;
+
+	// Three floats per pixel
+	std::vector<float> constants;
+};
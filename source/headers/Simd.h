@@ -0,0 +1,159 @@
+#pragma once
+
+#include "Defines.h"
+
+// The SIMD kernels use x86 intrinsics and the target attribute of GCC and
+// Clang, which lets a single binary contain SSE2 and AVX2 versions of a
+// function. Other compilers and processors use the scalar kernels.
+#if ( defined( __GNUC__ ) || defined( __clang__ ) ) && defined( __x86_64__ )
+#define RAYTRACER_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/**
+* Instruction sets that batch intersection kernels can be written for, from
+* least to most capable.
+*/
+enum class SimdLevel
+{
+	SCALAR,
+	SSE2, // two doubles or four floats per instruction
+	AVX2  // four doubles or eight floats per instruction
+};
+
+/**
+* Returns the most capable instruction set supported by the processor. The
+* environment variable RAYTRACER_SIMD can be set to scalar, sse2, or avx2 to
+* lower the level, which is useful for comparing the kernels. The level is
+* determined on the first call.
+*/
+SimdLevel getSimdLevel();
+
+/**
+* Returns the name of an instruction set level as it is written in RAYTRACER_SIMD.
+*/
+const char * getSimdLevelName( SimdLevel level );
+
+#ifdef RAYTRACER_X86_SIMD
+
+/*
+* Vectors of real numbers and the operations that kernels written for either
+* precision use. A vector holds twice as many lanes in single precision, so a
+* kernel written with these steps by SSE2_LANES or AVX2_LANES slots. The AVX2
+* operations may only be called from functions compiled for AVX2.
+*/
+#ifdef RAYTRACER_SINGLE_PRECISION
+
+typedef __m128 Sse2Real;
+typedef __m256 Avx2Real;
+
+const int SSE2_LANES = 4;
+const int AVX2_LANES = 8;
+
+inline Sse2Real sse2Set( real value ) { return _mm_set1_ps( value ); }
+inline Sse2Real sse2Zero( ) { return _mm_setzero_ps( ); }
+inline Sse2Real sse2Load( const real * values ) { return _mm_load_ps( values ); }
+inline Sse2Real sse2LoadUnaligned( const real * values ) { return _mm_loadu_ps( values ); }
+inline void sse2Store( real * values, Sse2Real a ) { _mm_storeu_ps( values, a ); }
+inline Sse2Real sse2Add( Sse2Real a, Sse2Real b ) { return _mm_add_ps( a, b ); }
+inline Sse2Real sse2Sub( Sse2Real a, Sse2Real b ) { return _mm_sub_ps( a, b ); }
+inline Sse2Real sse2Mul( Sse2Real a, Sse2Real b ) { return _mm_mul_ps( a, b ); }
+inline Sse2Real sse2Div( Sse2Real a, Sse2Real b ) { return _mm_div_ps( a, b ); }
+inline Sse2Real sse2Min( Sse2Real a, Sse2Real b ) { return _mm_min_ps( a, b ); }
+inline Sse2Real sse2Max( Sse2Real a, Sse2Real b ) { return _mm_max_ps( a, b ); }
+inline Sse2Real sse2Sqrt( Sse2Real a ) { return _mm_sqrt_ps( a ); }
+inline Sse2Real sse2And( Sse2Real a, Sse2Real b ) { return _mm_and_ps( a, b ); }
+inline Sse2Real sse2Or( Sse2Real a, Sse2Real b ) { return _mm_or_ps( a, b ); }
+inline Sse2Real sse2GreaterEqual( Sse2Real a, Sse2Real b ) { return _mm_cmpge_ps( a, b ); }
+inline Sse2Real sse2Less( Sse2Real a, Sse2Real b ) { return _mm_cmplt_ps( a, b ); }
+inline int sse2Mask( Sse2Real a ) { return _mm_movemask_ps( a ); }
+
+// SSE2 has no blend instruction, so lanes are selected with bit masks
+inline Sse2Real sse2Select( Sse2Real mask, Sse2Real ifSet, Sse2Real ifClear )
+{
+	return _mm_or_ps( _mm_and_ps( mask, ifSet ), _mm_andnot_ps( mask, ifClear ) );
+}
+
+#define RAYTRACER_AVX2 __attribute__(( target( "avx2" ) ))
+
+RAYTRACER_AVX2 inline Avx2Real avx2Set( real value ) { return _mm256_set1_ps( value ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Zero( ) { return _mm256_setzero_ps( ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Load( const real * values ) { return _mm256_load_ps( values ); }
+RAYTRACER_AVX2 inline Avx2Real avx2LoadUnaligned( const real * values ) { return _mm256_loadu_ps( values ); }
+RAYTRACER_AVX2 inline void avx2Store( real * values, Avx2Real a ) { _mm256_storeu_ps( values, a ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Add( Avx2Real a, Avx2Real b ) { return _mm256_add_ps( a, b ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Sub( Avx2Real a, Avx2Real b ) { return _mm256_sub_ps( a, b ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Mul( Avx2Real a, Avx2Real b ) { return _mm256_mul_ps( a, b ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Div( Avx2Real a, Avx2Real b ) { return _mm256_div_ps( a, b ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Min( Avx2Real a, Avx2Real b ) { return _mm256_min_ps( a, b ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Max( Avx2Real a, Avx2Real b ) { return _mm256_max_ps( a, b ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Sqrt( Avx2Real a ) { return _mm256_sqrt_ps( a ); }
+RAYTRACER_AVX2 inline Avx2Real avx2And( Avx2Real a, Avx2Real b ) { return _mm256_and_ps( a, b ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Or( Avx2Real a, Avx2Real b ) { return _mm256_or_ps( a, b ); }
+RAYTRACER_AVX2 inline Avx2Real avx2GreaterEqual( Avx2Real a, Avx2Real b ) { return _mm256_cmp_ps( a, b, _CMP_GE_OQ ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Less( Avx2Real a, Avx2Real b ) { return _mm256_cmp_ps( a, b, _CMP_LT_OQ ); }
+RAYTRACER_AVX2 inline int avx2Mask( Avx2Real a ) { return _mm256_movemask_ps( a ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Select( Avx2Real mask, Avx2Real ifSet, Avx2Real ifClear )
+{
+	return _mm256_blendv_ps( ifClear, ifSet, mask );
+}
+
+#else
+
+typedef __m128d Sse2Real;
+typedef __m256d Avx2Real;
+
+const int SSE2_LANES = 2;
+const int AVX2_LANES = 4;
+
+inline Sse2Real sse2Set( real value ) { return _mm_set1_pd( value ); }
+inline Sse2Real sse2Zero( ) { return _mm_setzero_pd( ); }
+inline Sse2Real sse2Load( const real * values ) { return _mm_load_pd( values ); }
+inline Sse2Real sse2LoadUnaligned( const real * values ) { return _mm_loadu_pd( values ); }
+inline void sse2Store( real * values, Sse2Real a ) { _mm_storeu_pd( values, a ); }
+inline Sse2Real sse2Add( Sse2Real a, Sse2Real b ) { return _mm_add_pd( a, b ); }
+inline Sse2Real sse2Sub( Sse2Real a, Sse2Real b ) { return _mm_sub_pd( a, b ); }
+inline Sse2Real sse2Mul( Sse2Real a, Sse2Real b ) { return _mm_mul_pd( a, b ); }
+inline Sse2Real sse2Div( Sse2Real a, Sse2Real b ) { return _mm_div_pd( a, b ); }
+inline Sse2Real sse2Min( Sse2Real a, Sse2Real b ) { return _mm_min_pd( a, b ); }
+inline Sse2Real sse2Max( Sse2Real a, Sse2Real b ) { return _mm_max_pd( a, b ); }
+inline Sse2Real sse2Sqrt( Sse2Real a ) { return _mm_sqrt_pd( a ); }
+inline Sse2Real sse2And( Sse2Real a, Sse2Real b ) { return _mm_and_pd( a, b ); }
+inline Sse2Real sse2Or( Sse2Real a, Sse2Real b ) { return _mm_or_pd( a, b ); }
+inline Sse2Real sse2GreaterEqual( Sse2Real a, Sse2Real b ) { return _mm_cmpge_pd( a, b ); }
+inline Sse2Real sse2Less( Sse2Real a, Sse2Real b ) { return _mm_cmplt_pd( a, b ); }
+inline int sse2Mask( Sse2Real a ) { return _mm_movemask_pd( a ); }
+
+// SSE2 has no blend instruction, so lanes are selected with bit masks
+inline Sse2Real sse2Select( Sse2Real mask, Sse2Real ifSet, Sse2Real ifClear )
+{
+	return _mm_or_pd( _mm_and_pd( mask, ifSet ), _mm_andnot_pd( mask, ifClear ) );
+}
+
+#define RAYTRACER_AVX2 __attribute__(( target( "avx2" ) ))
+
+RAYTRACER_AVX2 inline Avx2Real avx2Set( real value ) { return _mm256_set1_pd( value ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Zero( ) { return _mm256_setzero_pd( ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Load( const real * values ) { return _mm256_load_pd( values ); }
+RAYTRACER_AVX2 inline Avx2Real avx2LoadUnaligned( const real * values ) { return _mm256_loadu_pd( values ); }
+RAYTRACER_AVX2 inline void avx2Store( real * values, Avx2Real a ) { _mm256_storeu_pd( values, a ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Add( Avx2Real a, Avx2Real b ) { return _mm256_add_pd( a, b ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Sub( Avx2Real a, Avx2Real b ) { return _mm256_sub_pd( a, b ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Mul( Avx2Real a, Avx2Real b ) { return _mm256_mul_pd( a, b ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Div( Avx2Real a, Avx2Real b ) { return _mm256_div_pd( a, b ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Min( Avx2Real a, Avx2Real b ) { return _mm256_min_pd( a, b ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Max( Avx2Real a, Avx2Real b ) { return _mm256_max_pd( a, b ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Sqrt( Avx2Real a ) { return _mm256_sqrt_pd( a ); }
+RAYTRACER_AVX2 inline Avx2Real avx2And( Avx2Real a, Avx2Real b ) { return _mm256_and_pd( a, b ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Or( Avx2Real a, Avx2Real b ) { return _mm256_or_pd( a, b ); }
+RAYTRACER_AVX2 inline Avx2Real avx2GreaterEqual( Avx2Real a, Avx2Real b ) { return _mm256_cmp_pd( a, b, _CMP_GE_OQ ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Less( Avx2Real a, Avx2Real b ) { return _mm256_cmp_pd( a, b, _CMP_LT_OQ ); }
+RAYTRACER_AVX2 inline int avx2Mask( Avx2Real a ) { return _mm256_movemask_pd( a ); }
+RAYTRACER_AVX2 inline Avx2Real avx2Select( Avx2Real mask, Avx2Real ifSet, Avx2Real ifClear )
+{
+	return _mm256_blendv_pd( ifClear, ifSet, mask );
+}
+
+#endif // RAYTRACER_SINGLE_PRECISION
+
+#endif // RAYTRACER_X86_SIMD
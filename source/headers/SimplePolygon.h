@@ -1,12 +1,98 @@
+#pragma once
+
 #include "Plane.h"
 
+/**
+* Sub-class of Plane that represents a flat polygon whose edges do not cross.
+* Everything the inside test needs is prepared by the constructor. The polygon
+* is projected onto the coordinate plane that the normal is closest to, and the
+* edges become 2D edge functions that are positive on the inside, so testing a
+* point against an edge takes two multiply-adds.
+*
+* Convex polygons are split into a fan of triangles around the first vertex. A
+* binary search over the diagonals of the fan finds the only triangle that can
+* hold the point, so a point is tested against O(log n) lines. Other polygons
+* are split into triangles by ear clipping, and the point is tested against the
+* triangles one at a time.
+*/
 class SimplePolygon : public Plane
 {
-        public:
-        
-        std::vector<dvec3> vertices;
+	public:
+
+	/**
+	* Constructor for the polygon.
+	* @param - vertices: corners of the polygon in order around its boundary, in
+	* either direction. All of them must lie in one plane.
+	* @param - material: color of the polygon.
+	*/
+	SimplePolygon(std::vector<vec3> vertices, const color & material);
+
+	/**
+	* Checks a ray for intersection with the polygon. Finds the parameter of the
+	* closest point of intersection within [tMin, tMax) if one exits.
+	*/
+	bool intersect(const Ray & ray, real tMin, real tMax, RayHit & hit) const override;
+
+	/**
+	* Same as intersect, with the distance to the plane computed in advance.
+	*/
+	bool intersectFromOrigin(const Ray & ray, real originTerm, real tMin, real tMax, RayHit & hit) const override;
+
+	/**
+	* Returns the box that encloses the vertices, padded by EPSILON.
+	*/
+	BoundingBox bounds() const override;
+
+	/**
+	* Checks whether a point of the plane of the polygon lies inside of it.
+	* Points on the boundary of a convex polygon are outside. Points on the
+	* boundary of other polygons are inside.
+	*/
+	bool intersectionInsidePolygon(const vec3 & p) const;
+
+	/**
+	* Corners of the polygon
+	*/
+	std::vector<vec3> vertices;
+
+	protected:
+
+	/**
+	* Line in the plane of the projection, a * u + b * v + c = 0. The function is
+	* positive on the side of the line that faces the inside of the polygon.
+	*/
+	struct EdgeFunction
+	{
+		real a, b, c;
+
+		real operator()(real u, real v) const { return a * u + b * v + c; }
+	};
+
+	/**
+	* Returns the function of the line from p to q that is positive to the left
+	* of the line for counterclockwise polygons.
+	*/
+	EdgeFunction makeEdgeFunction(const vec2 & p, const vec2 & q) const;
+
+	/**
+	* Splits a polygon that is not convex into triangles.
+	*/
+	void clipEars(const std::vector<vec2> & projected);
+
+	// Coordinates that are kept by the projection
+	int uAxis = 0, vAxis = 1;
+
+	// 1 if the projected vertices are counterclockwise, -1 if they are clockwise
+	real orientation = 1;
+
+	// True if the polygon is convex and the fan below is used
+	bool convex = true;
+
+	// Convex polygons: the lines from the first vertex through vertex k, for
+	// k = 1 to n - 1, followed by the edges from vertex k to vertex k + 1, for
+	// k = 1 to n - 2
+	std::vector<EdgeFunction> fanLines;
 
-        SimplePolygon(std::vector<dvec3> vertices, const color & material);
-        HitRecord findClosestIntersection(const Ray & ray) override;
-        bool intersectionInsidePolygon(dvec3 p);
+	// Other polygons: three edge functions for every triangle
+	std::vector<EdgeFunction> triangleEdges;
 };
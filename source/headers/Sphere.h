@@ -15,28 +15,65 @@ class Sphere : 	public Surface
 	* @param - radius: radius of the sphere
 	* @param - material: color of the plane.
 	*/
-	Sphere(const dvec3 & position = dvec3(0.0, 0.0, -5.0),
-			double radius = 1.0, 
-			const color & material = color(1.0, 1.0, 1.0, 1.0) );
+	Sphere(const vec3 & position = vec3(0.0, 0.0, -5.0),
+			real radius = 1.0, 
+			const color & material = color(1.0, 1.0, 1.0) );
 
 	/**
-	* Checks a ray for intersection with the surface. Finds the closest point of intersection
-	* if one exits. Returns a HitRecord with the t parmeter set to FLT_MAX if there is no
-	* intersection.
-	* @param rayOrigin - Origin of the ray being check for intersetion
-	* @param rayDirection - Unit vector represention the direction of the ray.
-	* returns HitRecord containing intormation about the point of intersection.
+	* Checks a ray for intersection with the surface. Finds the parameter of the closest
+	* point of intersection within [tMin, tMax) if one exits.
+	* @param ray - Ray being checked for intersection.
+	* @param tMin - Smallest parameter value of interest along the ray.
+	* @param tMax - Parameter of the closest intersection found so far.
+	* @param hit - Set to the parameter of the intersection.
+	* returns true if there is an intersection within the interval.
 	*/
-	virtual HitRecord findClosestIntersection( const Ray & ray );
+	virtual bool intersect( const Ray & ray, real tMin, real tMax, RayHit & hit ) const;
+
+	/**
+	* Checks the rays of a packet for intersection with the sphere, one lane at a
+	* time, without a virtual call per lane.
+	*/
+	virtual unsigned intersectPacket( const RayPacket & packet, unsigned laneMask, real tMin,
+									  real tMax[], RayHit hits[] ) const;
+
+	/**
+	* Returns |o - c|^2 - r^2, the constant term of the quadratic equation for rays
+	* that start at the origin.
+	*/
+	virtual real computeOriginTerm( const vec3 & origin ) const;
+
+	/**
+	* Same as intersect, with the constant term computed in advance.
+	*/
+	virtual bool intersectFromOrigin( const Ray & ray, real originTerm, real tMin, real tMax,
+									  RayHit & hit ) const;
+
+	/**
+	* Same as intersectPacket, with the constant term computed in advance.
+	*/
+	virtual unsigned intersectPacketFromOrigin( const RayPacket & packet, real originTerm, unsigned laneMask,
+												real tMin, real tMax[], RayHit hits[] ) const;
+
+	/**
+	* Computes the point of intersection, outward facing normal, and material for
+	* a hit found by intersect.
+	*/
+	virtual void completeHitRecord( const Ray & ray, const RayHit & hit, HitRecord & hitRecord ) const;
+
+	/**
+	* Returns the axis aligned box that encloses the sphere.
+	*/
+	virtual BoundingBox bounds( ) const;
 
 	/**
 	* Radius of the sphere
 	*/
-	double radius;
+	real radius;
 
 	/**
 	* xyz location of the center of the sphere
 	*/
-	dvec3 center;
+	vec3 center;
 };
 
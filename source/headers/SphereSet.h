@@ -0,0 +1,185 @@
+#pragma once
+
+#include "BVH.h"
+#include "Simd.h"
+#include "Surface.h"
+
+/**
+* Large collection of spheres that share a material, such as the atoms of a
+* molecule or the particles of a simulation. The spheres are placed in their own
+* bounding volume hierarchy. Centers and squared radii are stored in separate
+* arrays, in leaf order, so that a single ray is tested against several spheres
+* of a leaf at a time with SSE2 or AVX2 instructions: four at a time with AVX2
+* in double precision and eight in single precision. The kernel is chosen when
+* the program runs. Processors without those instructions use a scalar kernel.
+*
+* The scene treats the collection as a single surface. The element of a hit is
+* the index of the sphere in the list passed to the constructor.
+*/
+class SphereSet : public Surface
+{
+public:
+
+	/**
+	* Constructor. Builds the hierarchy over the spheres.
+	* @param centers - xyz position of the center of every sphere
+	* @param radii - radius of every sphere. Must have the same size as centers.
+	* @param mat - material properties shared by all of the spheres
+	* @param threadPool - pool used to build the hierarchy concurrently. May be null.
+	*/
+	SphereSet( const std::vector<vec3> & centers, const std::vector<real> & radii,
+			   const Material & mat, ThreadPool * threadPool = nullptr );
+
+	/**
+	* Checks a ray for intersection with every sphere in the collection. Finds the
+	* parameter of the closest point of intersection within [tMin, tMax) if one exits.
+	* @param ray - Ray being checked for intersection. Its direction is a unit vector.
+	* @param tMin - Smallest parameter value of interest along the ray.
+	* @param tMax - Parameter of the closest intersection found so far.
+	* @param hit - Set to the parameter and the index of the sphere that was hit.
+	* returns true if there is an intersection within the interval.
+	*/
+	virtual bool intersect( const Ray & ray, real tMin, real tMax, RayHit & hit ) const;
+
+	/**
+	* Computes the point of intersection, outward facing normal, and material for
+	* a hit found by intersect.
+	*/
+	virtual void completeHitRecord( const Ray & ray, const RayHit & hit, HitRecord & hitRecord ) const;
+
+	/**
+	* Checks the rays of a packet for intersection with the spheres. The packet is
+	* traced through the hierarchy as a whole and every sphere of a leaf is tested
+	* against several rays at a time.
+	*/
+	virtual unsigned intersectPacket( const RayPacket & packet, unsigned laneMask, real tMin,
+									  real tMax[], RayHit hits[] ) const;
+
+	/**
+	* Checks whether any of the spheres blocks a ray within [tMin, tMax). Stops at
+	* the first sphere that does.
+	*/
+	virtual bool occludes( const Ray & ray, real tMin, real tMax ) const;
+
+	/**
+	* Returns the box that encloses all of the spheres.
+	*/
+	virtual BoundingBox bounds( ) const;
+
+	/**
+	* Returns the number of spheres in the collection.
+	*/
+	int size( ) const { return static_cast<int>( centers.size( ) ); }
+
+	/**
+	* Number of spheres that are tested together, the width of an AVX2
+	* vector of real numbers. Leaves of the hierarchy are padded to a multiple
+	* of this.
+	*/
+#ifdef RAYTRACER_SINGLE_PRECISION
+	static const int LANE_GROUP_SIZE = 8;
+#else
+	static const int LANE_GROUP_SIZE = 4;
+#endif
+
+	/**
+	* Spheres in structure of arrays layout, in the precision of the tracer.
+	* Every leaf of the hierarchy occupies a contiguous range of slots that
+	* starts at a multiple of LANE_GROUP_SIZE. Unused slots hold spheres that
+	* no ray can hit.
+	*/
+	struct Lanes
+	{
+		std::vector<real> centerX;
+		std::vector<real> centerY;
+		std::vector<real> centerZ;
+		std::vector<real> radiusSquared;
+
+		// Index of the sphere in each slot. -1 for padding.
+		std::vector<int> sphere;
+	};
+
+	/**
+	* Tests a ray against the spheres in a range of slots.
+	* @param lanes - spheres of the collection
+	* @param begin - first slot. Must be a multiple of LANE_GROUP_SIZE.
+	* @param end - one past the last slot. Must be a multiple of LANE_GROUP_SIZE.
+	* @param ray - ray being checked for intersection. Its direction is a unit vector.
+	* @param tMin - smallest parameter value of interest along the ray
+	* @param tMax - lowered to the parameter of every closer hit that is found
+	* @param hitSlot - set to the slot of the closest hit
+	* @param anyHit - stop at the first hit instead of looking for the closest one
+	* @returns true if a hit was found within the interval
+	*/
+	typedef bool ( *Kernel )( const Lanes & lanes, int begin, int end, const Ray & ray,
+							  real tMin, real & tMax, int & hitSlot, bool anyHit );
+
+	/**
+	* Returns the kernel for an instruction set level. Levels that were not
+	* compiled into the program return the scalar kernel.
+	*/
+	static Kernel getKernel( SimdLevel level );
+
+	/**
+	* Rays of a packet in the precision of the tracer. The arrays point into
+	* the packet, which is kept in double precision, or into a copy converted
+	* to single precision. Each holds RayPacket::MAX_SIZE lanes and is aligned
+	* for AVX2 loads.
+	*/
+	struct PacketRays
+	{
+		int size;
+
+		const real * originX;
+		const real * originY;
+		const real * originZ;
+
+		const real * directX;
+		const real * directY;
+		const real * directZ;
+	};
+
+	/**
+	* Tests the rays of a packet against the spheres in a range of slots.
+	* @param lanes - spheres of the collection
+	* @param begin - first slot
+	* @param end - one past the last slot
+	* @param rays - rays being checked for intersection. Lanes beyond the size
+	* of the packet must be padded.
+	* @param laneMask - lanes of the packet to test
+	* @param tMin - smallest parameter value of interest along the rays
+	* @param tMax - lowered to the parameter of every closer hit that is found
+	* @param hitSlots - set to the slot of the closest hit in each lane
+	* @returns mask of the lanes for which a closer hit was found
+	*/
+	typedef unsigned ( *PacketKernel )( const Lanes & lanes, int begin, int end, const PacketRays & rays,
+										unsigned laneMask, real tMin, real tMax[], int hitSlots[] );
+
+	/**
+	* Returns the packet kernel for an instruction set level. Levels that were
+	* not compiled into the program return the scalar kernel.
+	*/
+	static PacketKernel getPacketKernel( SimdLevel level );
+
+protected:
+
+	/**
+	* Copies the spheres into the slots in the leaf order of the hierarchy.
+	*/
+	void fillLanes( );
+
+	// Spheres in the order in which they were passed to the constructor
+	std::vector<vec3> centers;
+	std::vector<real> radii;
+
+	Lanes lanes;
+
+	BVH bvh;
+
+	// First slot of each leaf, indexed by the first primitive index entry of the leaf
+	std::vector<int> leafSlots;
+
+	Kernel kernel;
+	PacketKernel packetKernel;
+
+}; // end SphereSet class
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "BoundingBox.h"
 #include "HitRecord.h"
 #include "Ray.h"
 #include "Material.h"
@@ -25,14 +26,100 @@ public:
 	Surface( const Material & mat );
 
 	/**
-	* Checks a ray for intersection with the surface. Finds the closest point of intersection
-	* if one exits. Returns a HitRecord with the t parmeter set to FLT_MAX if there is no
-	* intersection.
-	* @param rayOrigin - Origin of the ray being check for intersetion
-	* @param rayDirection - Unit vector represention the direction of the ray.
+	* Checks a ray for intersection with the surface. Finds the parameter of the closest
+	* point of intersection within the interval [tMin, tMax) if one exits. Surfaces should
+	* give up as soon as they know that they cannot be hit before tMax. Only the t and
+	* element members of the hit are set, and only if an intersection is found.
+	* @param ray - Ray being checked for intersection. Its direction is a unit vector.
+	* @param tMin - Smallest parameter value of interest along the ray. Used to skip
+	* the surface that a secondary ray starts on.
+	* @param tMax - Parameter of the closest intersection found so far.
+	* @param hit - Set to the parameter and element of the intersection.
+	* returns true if there is an intersection within the interval.
+	*/
+	virtual bool intersect(const Ray & ray, real tMin, real tMax, RayHit & hit) const;
+
+	/**
+	* Computes the point of intersection, surface normal, texture coordinates, and
+	* material for a hit found by intersect. Called once per ray, for the closest
+	* hit only.
+	* @param ray - Ray that was passed to intersect.
+	* @param hit - Hit that was found by intersect.
+	* @param hitRecord - Set to the full description of the intersection.
+	*/
+	virtual void completeHitRecord(const Ray & ray, const RayHit & hit, HitRecord & hitRecord) const;
+
+	/**
+	* Checks the rays of a packet for intersection with the surface. For every tested
+	* lane whose ray hits the surface within [tMin, tMax[lane]), sets the t and element
+	* members of hits[lane] and lowers tMax[lane]. The default implementation calls
+	* intersect for one lane at a time.
+	* @param packet - Rays being checked for intersection.
+	* @param laneMask - Lanes of the packet to test.
+	* @param tMin - Smallest parameter value of interest along the rays.
+	* @param tMax - Parameter of the closest intersection found so far in each lane.
+	* @param hits - Closest hit found so far in each lane.
+	* returns the mask of the lanes for which a closer hit was found.
+	*/
+	virtual unsigned intersectPacket(const RayPacket & packet, unsigned laneMask, real tMin,
+									 real tMax[], RayHit hits[]) const;
+
+	/**
+	* Computes the part of the intersection test that depends only on the origin of
+	* the ray. Many rays share an origin, such as the primary rays of a perspective
+	* view, so the scene computes the term once per origin and passes it to
+	* intersectFromOrigin. The default implementation returns NaN, which tells the
+	* scene to call intersect instead.
+	* @param origin - Point at which the rays start.
+	* returns the term, or NaN if the surface does not use one.
+	*/
+	virtual real computeOriginTerm(const vec3 & origin) const;
+
+	/**
+	* Same as intersect, for a ray that starts at the origin that was passed to
+	* computeOriginTerm. Surfaces that override this must also override
+	* computeOriginTerm, and subclasses that change intersect must change this too.
+	* @param originTerm - Value returned by computeOriginTerm for the origin of the ray.
+	*/
+	virtual bool intersectFromOrigin(const Ray & ray, real originTerm, real tMin, real tMax,
+									 RayHit & hit) const;
+
+	/**
+	* Same as intersectPacket, for rays that all start at the origin that was passed
+	* to computeOriginTerm. The default implementation calls intersectFromOrigin for
+	* one lane at a time.
+	*/
+	virtual unsigned intersectPacketFromOrigin(const RayPacket & packet, real originTerm, unsigned laneMask,
+											   real tMin, real tMax[], RayHit hits[]) const;
+
+	/**
+	* Checks a ray for intersection with the surface and describes the closest point of
+	* intersection within [tMin, tMax). Returns a HitRecord with the t parmeter set to
+	* FLT_MAX if there is no intersection in the interval.
+	* @param ray - Ray being checked for intersection.
+	* @param tMin - Smallest parameter value of interest along the ray.
+	* @param tMax - Largest parameter value of interest along the ray.
 	* returns HitRecord containing intormation about the point of intersection.
 	*/
-	virtual HitRecord findClosestIntersection(const Ray & ray);
+	HitRecord findClosestIntersection(const Ray & ray, real tMin, real tMax) const;
+
+	/**
+	* Checks whether the surface blocks a ray within the interval [tMin, tMax).
+	* Nothing but the intersection test is performed, so this is the test to use
+	* for shadow rays.
+	* @param ray - ray being checked for intersection
+	* @param tMin - smallest parameter value of interest along the ray
+	* @param tMax - parameter of the end of the ray segment being checked
+	* returns true if the surface intersects the ray within the interval.
+	*/
+	virtual bool occludes(const Ray & ray, real tMin, real tMax) const;
+
+	/**
+	* Returns an axis aligned box that contains the entire surface. Surfaces that
+	* extend infinitely return BoundingBox::infinite() and are tested against every
+	* ray instead of being placed in the bounding volume hierarchy.
+	*/
+	virtual BoundingBox bounds() const;
 
 	/**
 	* Color of the surface
@@ -41,11 +128,11 @@ public:
 
 protected:
 
-	virtual glm::dvec2 calculateSphericalTextureCoordinates(/*??*/){ return glm::dvec2(0.0, 0.0); };
+	virtual vec2 calculateSphericalTextureCoordinates(/*??*/){ return vec2(0.0, 0.0); };
 
-	virtual glm::dvec2 calculatePlanarTextureCoordinates(/*??*/){ return glm::dvec2(0.0, 0.0); };
+	virtual vec2 calculatePlanarTextureCoordinates(/*??*/){ return vec2(0.0, 0.0); };
 
-	virtual glm::dvec2 calculateCylindricalTextureCoordinates(/*??*/){ return glm::dvec2(0.0, 0.0); };
+	virtual vec2 calculateCylindricalTextureCoordinates(/*??*/){ return vec2(0.0, 0.0); };
 
 };
 
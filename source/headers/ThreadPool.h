@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+* Persistent pool of worker threads that execute submitted tasks. Every worker
+* owns a task queue. Workers take new work from the back of their own queue and,
+* when it is empty, steal work from the front of the queues of other workers.
+* The thread that calls wait is counted as one of the workers and helps to
+* execute tasks until all of them have completed.
+*/
+class ThreadPool
+{
+public:
+
+	/**
+	* Constructor. Starts the worker threads.
+	* @param threadCount - total number of threads, including the thread that calls
+	* wait. Values of zero or less use the number of hardware threads.
+	*/
+	ThreadPool(int threadCount = 0);
+
+	/**
+	* Stops and joins all of the worker threads.
+	*/
+	~ThreadPool();
+
+	/**
+	* Stops the current workers and starts a new set of them. Must not be called
+	* while tasks are pending.
+	* @param threadCount - total number of threads, including the thread that calls
+	* wait. Values of zero or less use the number of hardware threads.
+	*/
+	void setThreadCount(int threadCount);
+
+	/**
+	* Returns the total number of threads that execute tasks, including the thread
+	* that calls wait.
+	*/
+	int getThreadCount() const { return static_cast<int>(queues.size()); }
+
+	/**
+	* Adds a task to the queue of one of the workers. Tasks are distributed
+	* round robin over the queues.
+	* @param task - function to be executed by one of the threads
+	*/
+	void submit(const std::function<void()> & task);
+
+	/**
+	* Blocks until every submitted task has finished. The calling thread executes
+	* queued tasks while it waits.
+	*/
+	void wait();
+
+protected:
+
+	/**
+	* Task queue owned by a single worker. Other workers steal from it.
+	*/
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<std::function<void()>> tasks;
+	};
+
+	/**
+	* Creates the queues and launches threadCount - 1 worker threads.
+	*/
+	void start(int threadCount);
+
+	/**
+	* Signals all of the workers to finish and joins them.
+	*/
+	void stop();
+
+	/**
+	* Retrieves a task from the back of the specified queue or, if it is empty,
+	* steals one from the front of another queue.
+	* @param queueIndex - index of the queue owned by the calling thread
+	* @param task - set to the retrieved task
+	* @returns true if a task was retrieved
+	*/
+	bool findTask(int queueIndex, std::function<void()> & task);
+
+	/**
+	* Executes a task and signals waiting threads if it was the last one pending.
+	*/
+	void runTask(std::function<void()> & task);
+
+	/**
+	* Main loop of each worker thread.
+	*/
+	void workerLoop(int queueIndex);
+
+	// Queue zero belongs to the thread that calls wait
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+
+	std::vector<std::thread> workers;
+
+	// Guards sleeping and waking of workers and of the waiting thread
+	std::mutex sleepMutex;
+	std::condition_variable workAvailable;
+	std::condition_variable allTasksDone;
+
+	// Number of tasks that are in a queue and have not been started
+	std::atomic<int> queuedTasks;
+
+	// Number of tasks that have been submitted and have not finished
+	std::atomic<int> pendingTasks;
+
+	// Queue to which the next task is submitted
+	std::atomic<unsigned> nextQueue;
+
+	bool stopping;
+
+}; // end ThreadPool class
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <stdint.h>
+
+#include "MappedFile.h"
+
+// Tiles are written with pwrite where it exists, which needs no locking
+#if defined( __unix__ ) || defined( __APPLE__ )
+#define RAYTRACER_HAS_PWRITE
+#endif
+
+/**
+* Tiled image format that renders too large for memory are streamed into. The
+* image is cut into square tiles in the same way as a tiled FrameBuffer, and
+* every tile has a fixed place in the file, so tiles can be written in any
+* order as soon as they are done:
+*
+*   TiledImageHeader                         32 bytes
+*   tile (0, 0), tile (1, 0), ...            tileSize * tileSize * 4 bytes each
+*
+* Tiles are numbered from the lower left corner of the image, first along the
+* bottom row of tiles. A tile holds its rows from the bottom up, and every
+* pixel is red, green, blue, and alpha, one byte each. Tiles at the right and
+* top edges are stored whole. Their pixels outside of the image are undefined.
+* All values in the header are little endian, whatever the byte order of the
+* machine that wrote the file.
+*/
+struct TiledImageHeader
+{
+	char magic[8];
+
+	uint32_t version;
+
+	uint32_t width;
+
+	uint32_t height;
+
+	uint32_t tileSize;
+
+	uint32_t bytesPerPixel;
+
+	// Keeps the header a multiple of eight bytes long. Written as zero.
+	uint32_t reserved;
+};
+
+// First bytes of every tiled image file
+const char TILED_IMAGE_MAGIC[8] = { 'R', 'T', 'T', 'I', 'L', 'E', 'S', '\n' };
+
+// Version written by TiledImageWriter and accepted by TiledImageReader
+const uint32_t TILED_IMAGE_VERSION = 1;
+
+// Size of the header in the file
+const size_t TILED_IMAGE_HEADER_BYTES = 32;
+
+// Largest tile edge that is written or accepted, which keeps the size of a
+// tile far from overflowing
+const int MAX_TILED_IMAGE_TILE_SIZE = 4096;
+
+/**
+* Destination of the finished tiles of an image. Tiles are cut from the image
+* and stored as described for the tiled image format below, and they may
+* arrive in any order and from several threads at once.
+*/
+class TileOutput
+{
+public:
+
+	virtual ~TileOutput( ) { }
+
+	virtual int getWidth( ) const = 0;
+
+	virtual int getHeight( ) const = 0;
+
+	virtual int getTileSize( ) const = 0;
+
+	/**
+	* Takes one finished tile.
+	* @param tileX - column of the tile, counted from the left
+	* @param tileY - row of the tile, counted from the bottom
+	* @param pixels - tileSize * tileSize pixels, rows from the bottom up
+	* @return false if the tile could not be stored
+	*/
+	virtual bool writeTile( int tileX, int tileY, const unsigned char * pixels ) = 0;
+
+}; // end TileOutput class
+
+/**
+* Writes the tiles of a tiled image file. The file is created at its full size
+* when it is opened, and every tile is written straight to its place, so only
+* the tiles that are being written have to be in memory. Tiles may be written
+* from several threads at once.
+*
+* The object cannot be copied because it owns the file.
+*/
+class TiledImageWriter : public TileOutput
+{
+public:
+
+	TiledImageWriter( ) { }
+
+	~TiledImageWriter( ) { close( ); }
+
+	TiledImageWriter( const TiledImageWriter & ) = delete;
+
+	TiledImageWriter & operator=( const TiledImageWriter & ) = delete;
+
+	/**
+	* Creates a file and writes its header. Closes any file that was open before.
+	* @param fileName - path of the file to create
+	* @param width of the image in pixels
+	* @param height of the image in pixels
+	* @param tileSize - edge length of the tiles in pixels, at most
+	* MAX_TILED_IMAGE_TILE_SIZE
+	* @return true if the file was created
+	*/
+	bool open( const string & fileName, int width, int height, int tileSize );
+
+	/**
+	* Writes one tile to its place in the file.
+	*/
+	bool writeTile( int tileX, int tileY, const unsigned char * pixels ) override;
+
+	/**
+	* Closes the file.
+	* @return false if any tile could not be written, or if no file was open
+	*/
+	bool close( );
+
+	bool isOpen( ) const { return header.width != 0; }
+
+	int getWidth( ) const override { return header.width; }
+
+	int getHeight( ) const override { return header.height; }
+
+	int getTileSize( ) const override { return header.tileSize; }
+
+protected:
+
+	TiledImageHeader header = TiledImageHeader( );
+
+	// Number of tiles in a row of tiles
+	int tilesAcross = 0;
+
+	// True once a write has failed
+	std::atomic<bool> failed { false };
+
+#ifdef RAYTRACER_HAS_PWRITE
+	int descriptor = -1;
+#else
+	// Position of the stream is shared, so writes take turns
+	std::mutex streamMutex;
+	std::fstream stream;
+#endif
+
+}; // end TiledImageWriter class
+
+/**
+* Reads the pixels of a tiled image file. The file is mapped into memory, so
+* reading a pixel only brings the tile that holds it into memory.
+*/
+class TiledImageReader
+{
+public:
+
+	/**
+	* Maps a tiled image file and checks its header.
+	* @param fileName - path of the file to read
+	* @return false if the file is not a tiled image of a supported version, or
+	* if it is too short for the image that its header describes
+	*/
+	bool open( const string & fileName );
+
+	int getWidth( ) const { return header.width; }
+
+	int getHeight( ) const { return header.height; }
+
+	/**
+	* Returns the red, green, blue, and alpha bytes of a pixel. Origin (0,0) is
+	* the lower left hand corner of the image. The pixel must be in the image.
+	*/
+	const unsigned char * getPixel( int x, int y ) const;
+
+protected:
+
+	TiledImageHeader header = TiledImageHeader( );
+
+	int tilesAcross = 0;
+
+	const unsigned char * tiles = nullptr;
+
+	MappedFile file;
+
+}; // end TiledImageReader class
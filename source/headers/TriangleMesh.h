@@ -0,0 +1,135 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "BVH.h"
+#include "MappedFile.h"
+#include "MeshFile.h"
+#include "Surface.h"
+
+/**
+* Indexed triangle mesh that shares a single material, such as a part exported
+* from a CAD program. Vertices and triangles are kept in two flat arrays, which
+* either belong to the mesh or are mapped straight from a mesh file, so a mesh
+* with millions of triangles needs no object per triangle. The triangles are
+* placed in their own bounding volume hierarchy and rays are intersected with
+* them by the Moller-Trumbore algorithm.
+*
+* The scene treats the mesh as a single surface. The element of a hit is the
+* index of the triangle.
+*/
+class TriangleMesh : public Surface
+{
+public:
+
+	/**
+	* Constructor. Takes over the arrays and builds the hierarchy over the triangles.
+	* @param positions - xyz of every vertex
+	* @param indices - three vertex indices for every triangle. All of them must
+	* be smaller than the number of vertices.
+	* @param mat - material properties shared by all of the triangles
+	* @param threadPool - pool used to build the hierarchy concurrently. May be null.
+	*/
+	TriangleMesh( std::vector<float> positions, std::vector<uint32_t> indices,
+				  const Material & mat, ThreadPool * threadPool = nullptr );
+
+	/**
+	* Maps a mesh file written by writeMeshFile into memory and builds the
+	* hierarchy over its triangles. The arrays are used where they are mapped.
+	* @param fileName - path of the mesh file
+	* @param mat - material properties shared by all of the triangles
+	* @param threadPool - pool used to build the hierarchy concurrently. May be null.
+	* @return the mesh, or null if the file cannot be mapped, is not a mesh file,
+	* or refers to missing vertices
+	*/
+	static shared_ptr<TriangleMesh> load( const string & fileName, const Material & mat,
+										  ThreadPool * threadPool = nullptr );
+
+	// The arrays may point into memory that the mesh owns
+	TriangleMesh( const TriangleMesh & ) = delete;
+	TriangleMesh & operator=( const TriangleMesh & ) = delete;
+
+	/**
+	* Checks a ray for intersection with every triangle of the mesh. Finds the
+	* parameter of the closest point of intersection within [tMin, tMax) if one exits.
+	*/
+	virtual bool intersect( const Ray & ray, real tMin, real tMax, RayHit & hit ) const;
+
+	/**
+	* Checks the rays of a packet for intersection with the triangles. The packet
+	* is traced through the hierarchy as a whole and the vertices of each triangle
+	* are read once for all of the rays that reach its leaf.
+	*/
+	virtual unsigned intersectPacket( const RayPacket & packet, unsigned laneMask, real tMin,
+									  real tMax[], RayHit hits[] ) const;
+
+	/**
+	* Checks whether any of the triangles blocks a ray within [tMin, tMax). Stops
+	* at the first triangle that does.
+	*/
+	virtual bool occludes( const Ray & ray, real tMin, real tMax ) const;
+
+	/**
+	* Computes the point of intersection, the normal of the triangle that was hit,
+	* and the material for a hit found by intersect.
+	*/
+	virtual void completeHitRecord( const Ray & ray, const RayHit & hit, HitRecord & hitRecord ) const;
+
+	/**
+	* Returns the box that encloses all of the triangles.
+	*/
+	virtual BoundingBox bounds( ) const;
+
+	/**
+	* Returns the number of vertices of the mesh.
+	*/
+	int getVertexCount( ) const { return static_cast<int>( vertexCount ); }
+
+	/**
+	* Returns the number of triangles of the mesh.
+	*/
+	int getTriangleCount( ) const { return static_cast<int>( triangleCount ); }
+
+	/**
+	* Returns the position of a vertex.
+	*/
+	vec3 getVertex( uint32_t vertex ) const
+	{
+		const float * p = positions + 3 * size_t( vertex );
+		return vec3( p[0], p[1], p[2] );
+	}
+
+protected:
+
+	/**
+	* Constructor for meshes whose arrays are stored in a mapped file.
+	*/
+	TriangleMesh( MappedFile && file, const MeshData & mesh, const Material & mat, ThreadPool * threadPool );
+
+	/**
+	* Builds the hierarchy over the triangles.
+	*/
+	void buildHierarchy( ThreadPool * threadPool );
+
+	/**
+	* Returns the corners of a triangle.
+	*/
+	void getCorners( int triangle, vec3 & v0, vec3 & v1, vec3 & v2 ) const;
+
+	// Arrays of a mesh that was not loaded from a file
+	std::vector<float> ownedPositions;
+	std::vector<uint32_t> ownedIndices;
+
+	// Mesh file that holds the arrays of a loaded mesh
+	MappedFile file;
+
+	// xyz of every vertex, followed by three vertex indices for every triangle
+	const float * positions = nullptr;
+	const uint32_t * indices = nullptr;
+
+	uint32_t vertexCount = 0;
+	uint32_t triangleCount = 0;
+
+	BVH bvh;
+
+}; // end TriangleMesh class
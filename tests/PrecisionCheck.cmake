@@ -0,0 +1,52 @@
+# Renders the demonstration scene and the scene files with the tracer built in
+# double precision and in single precision, and checks that the images match
+# within the tolerance documented with RAYTRACER_SINGLE_PRECISION in Defines.h:
+# at most 0.05% of the channel values may differ by more than 2 levels, and no
+# channel value by more than 64. The outliers are pixels on silhouettes and
+# shadow boundaries that a ray hits or misses depending on the precision.
+#
+# Usage: cmake -DRENDER=<render> -DOTHER_RENDER=<render of the other precision>
+#              -DIMAGEDIFF=<imagediff> -DSCENE_DIR=<directory> -DWORK_DIR=<directory>
+#              -P PrecisionCheck.cmake
+
+if(NOT RENDER OR NOT OTHER_RENDER OR NOT IMAGEDIFF OR NOT WORK_DIR)
+	message(FATAL_ERROR "RENDER, OTHER_RENDER, IMAGEDIFF, and WORK_DIR must be set")
+endif()
+
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+# Renders NAME with both builds and compares the images. The remaining
+# arguments are passed to the renderer.
+function(compare name)
+	foreach(program RENDER OTHER_RENDER)
+		execute_process(COMMAND ${${program}} -o ${WORK_DIR}/${name}_${program}.ppm ${ARGN}
+			RESULT_VARIABLE result
+			OUTPUT_QUIET
+			TIMEOUT 300)
+		if(NOT result EQUAL 0)
+			message(FATAL_ERROR "${name} render with ${${program}} failed: ${result}")
+		endif()
+	endforeach()
+
+	execute_process(COMMAND ${IMAGEDIFF} ${WORK_DIR}/${name}_RENDER.ppm ${WORK_DIR}/${name}_OTHER_RENDER.ppm
+			--tolerance 2 --max-outliers 0.0005 --max-difference 64
+		RESULT_VARIABLE result
+		OUTPUT_VARIABLE output
+		ERROR_VARIABLE output)
+	message("${name}: ${output}")
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "${name} renders in single and double precision differ by more than the tolerance")
+	endif()
+endfunction()
+
+compare(demo)
+
+# Scene files are copied, so that their caches are written outside the source tree
+if(SCENE_DIR)
+	file(GLOB scenes ${SCENE_DIR}/*.scene)
+	foreach(scene ${scenes})
+		get_filename_component(name ${scene} NAME_WE)
+		configure_file(${scene} ${WORK_DIR}/${name}.scene COPYONLY)
+		compare(scene_${name} --scene ${WORK_DIR}/${name}.scene)
+	endforeach()
+endif()
@@ -0,0 +1,46 @@
+# Renders the demonstration scene in this process and with worker processes,
+# including renders in which a worker dies or hangs in the middle of a range,
+# and checks that every image is the same, byte for byte.
+#
+# Usage: cmake -DRENDER=<render executable> -DWORK_DIR=<directory> -P RenderFarmCheck.cmake
+
+if(NOT RENDER OR NOT WORK_DIR)
+	message(FATAL_ERROR "RENDER and WORK_DIR must be set")
+endif()
+
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+# Renders into NAME.ppm with the given options and fails unless the output
+# contains EXPECT
+function(render name expect)
+	execute_process(COMMAND ${RENDER} -o ${WORK_DIR}/${name}.ppm ${ARGN}
+		RESULT_VARIABLE result
+		OUTPUT_VARIABLE output
+		ERROR_VARIABLE output
+		TIMEOUT 120)
+	message("${name}:\n${output}")
+	if(NOT result EQUAL 0)
+		message(FATAL_ERROR "${name} render failed: ${result}")
+	endif()
+	if(NOT output MATCHES "${expect}")
+		message(FATAL_ERROR "${name} render did not report \"${expect}\"")
+	endif()
+endfunction()
+
+render(single "Render time")
+render(workers1 "Render time" --workers 1)
+render(workers2 "Render time" --workers 2)
+
+# The first worker is killed after 3 tiles of its first range of 16
+render(killed ", failed" --workers 2 --kill-worker-after 3)
+
+# The first worker is suspended and has to be replaced after its timeout
+render(hung ", timed out" --workers 2 --stop-worker-after 3 --worker-timeout 2)
+
+foreach(name workers1 workers2 killed hung)
+	execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK_DIR}/single.ppm ${WORK_DIR}/${name}.ppm
+		RESULT_VARIABLE different)
+	if(different)
+		message(FATAL_ERROR "${name}.ppm differs from the image rendered in one process")
+	endif()
+endforeach()